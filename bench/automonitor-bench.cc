@@ -0,0 +1,542 @@
+/*
+运行时验证的基准测试。
+用Spot随机生成性质族(randltl式的随机LTL公式, 或randaut式的随机确定自动机),
+为每个性质生成合法轨迹和违规轨迹, 测量构建时间、内存、每秒事件数和单步延迟的p50/p99。
+
+三种模式:
+  engine  直接调用Check_word_acceptance
+  server  把合法轨迹作为AOPLogger格式的事件发给运行中的automonitor(ZeroMQ REQ), 测量往返延迟
+  replay  读取event.log, 用AMDecodeEvent解码后逐个检测
+
+随机数种子固定时, 生成的公式、自动机和轨迹都相同, 结果可以重复比较。
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include <spot/misc/random.hh>
+#include <spot/tl/apcollect.hh>
+#include <spot/tl/print.hh>
+#include <spot/tl/randomltl.hh>
+#include <spot/twaalgos/hoa.hh>
+#include <spot/twaalgos/randomgraph.hh>
+#include <spot/twaalgos/translate.hh>
+#include <spot/parseaut/public.hh>
+
+#include <zmq.hpp>
+
+#include "../src/automonitor.hh"
+#include "../src/event-decode.hh"
+#include "../src/solidity.hh"
+#include "../src/util-error.hh"
+#include "../src/util-log.hh"
+#include "../src/util-metrics.hh"
+
+typedef struct BenchOptions
+{
+    std::string family = "ltl"; //ltl: 随机公式, aut: 随机自动机
+    std::string mode = "engine";
+    unsigned aps = 3;
+    std::vector<unsigned> sizes = {4, 8, 16, 32}; //ltl为公式大小, aut为状态数
+    unsigned formulas = 5;                       //每个大小生成的性质个数
+    unsigned length = 10000;                     //轨迹长度
+    unsigned seed = 0;
+    float drop = 0.3;                            //aut族中删除边的概率, 删除后才有违规的字
+    std::string hoa;                             //给定时不随机生成, 只测这个自动机
+    std::string hoa_out;                         //保存生成的自动机, 用于启动server
+    std::string sol_out;                         //为每个性质生成packed合约, 用solc检查(make solidity-check)
+    std::string addr = "tcp://127.0.0.1:25555";
+    std::string log = "event.log";
+    std::string write_log;                       //把合法轨迹写成event.log格式, 供replay使用
+    std::string log_level = "none";
+} BenchOptions;
+
+typedef struct BenchProperty
+{
+    std::string name;
+    unsigned size;
+    spot::twa_graph_ptr aut;
+    Monitor monitor;
+    double build_ms;
+    long heap_kb;
+} BenchProperty;
+
+typedef struct BenchResult
+{
+    uint64_t events;
+    double seconds;
+    uint64_t p50;
+    uint64_t p99;
+    int64_t mismatches; //引擎的结论与自动机语义不一致的事件数, -1表示无法生成该轨迹
+} BenchResult;
+
+typedef struct BenchTrace
+{
+    std::vector<std::string> words;
+    std::vector<unsigned> states; //按自动机语义, 每个字之后的状态
+    bool violating;               //最后一个字不被接受
+} BenchTrace;
+
+static std::mt19937 rng;
+
+static void usage()
+{
+    std::cerr << "usage: automonitor-bench [--mode=engine|server|replay] [--family=ltl|aut]\n"
+                 "         [--aps=N] [--sizes=4,8,16] [--formulas=K] [--length=L] [--seed=S]\n"
+                 "         [--drop=P] [--hoa=FILE] [--hoa-out=PREFIX] [--sol-out=PREFIX] [--addr=ADDR]\n"
+                 "         [--log=FILE] [--write-log=FILE] [--log-level=LEVEL]\n";
+    exit(1);
+}
+
+static int parse_options(int argc, char **argv, BenchOptions &opt)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+        {
+            return ERROR;
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string val = arg.substr(eq + 1);
+
+        if (key == "family")
+            opt.family = val;
+        else if (key == "mode")
+            opt.mode = val;
+        else if (key == "aps")
+            opt.aps = atoi(val.c_str());
+        else if (key == "formulas")
+            opt.formulas = atoi(val.c_str());
+        else if (key == "length")
+            opt.length = atoi(val.c_str());
+        else if (key == "seed")
+            opt.seed = atoi(val.c_str());
+        else if (key == "drop")
+            opt.drop = atof(val.c_str());
+        else if (key == "hoa")
+            opt.hoa = val;
+        else if (key == "hoa-out")
+            opt.hoa_out = val;
+        else if (key == "sol-out")
+            opt.sol_out = val;
+        else if (key == "addr")
+            opt.addr = val;
+        else if (key == "log")
+            opt.log = val;
+        else if (key == "write-log")
+            opt.write_log = val;
+        else if (key == "log-level")
+            opt.log_level = val;
+        else if (key == "sizes")
+        {
+            opt.sizes.clear();
+            for (auto &s : splitstr(val, ','))
+            {
+                opt.sizes.push_back(atoi(s.c_str()));
+            }
+        }
+        else
+        {
+            return ERROR;
+        }
+    }
+    if (opt.family != "ltl" && opt.family != "aut")
+        return ERROR;
+    if (opt.mode != "engine" && opt.mode != "server" && opt.mode != "replay")
+        return ERROR;
+    return SUCCESS;
+}
+
+static long heap_in_use_kb()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return (long)(mallinfo2().uordblks >> 10);
+#else
+    return 0;
+#endif
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/*随机确定自动机, 再删掉一部分边, 使某些状态上存在不被接受的字*/
+static spot::twa_graph_ptr random_monitor_aut(unsigned states, const spot::atomic_prop_set &aps,
+                                              const spot::bdd_dict_ptr &dict, float drop)
+{
+    spot::twa_graph_ptr aut = spot::random_graph(states, 0.2, &aps, dict, 0, 0.1, 0.5, true);
+    std::uniform_real_distribution<float> coin(0, 1);
+    for (unsigned s = 0; s < aut->num_states(); s++)
+    {
+        unsigned kept = 0;
+        for (auto &e : aut->out(s))
+        {
+            if (kept > 0 && coin(rng) < drop)
+            {
+                e.cond = bddfalse;
+            }
+            else
+            {
+                kept++;
+            }
+        }
+    }
+    aut->merge_edges(); //去掉条件为false的边
+    return aut;
+}
+
+static int build_property(const BenchOptions &opt, unsigned size, unsigned k,
+                          const spot::atomic_prop_set &aps, BenchProperty &prop)
+{
+    spot::bdd_dict_ptr dict = spot::make_bdd_dict();
+    long heap0 = heap_in_use_kb();
+    auto t0 = std::chrono::steady_clock::now();
+
+    if (!opt.hoa.empty())
+    {
+        spot::parsed_aut_ptr pa = spot::parse_aut(opt.hoa, dict);
+        if (pa->format_errors(std::cerr) || pa->aborted)
+        {
+            ErrorPrintNReturn(HOA_FORMAT_ERROR);
+        }
+        prop.aut = pa->aut;
+        prop.name = opt.hoa;
+    }
+    else if (opt.family == "ltl")
+    {
+        //跳过化简为常量的公式, 它们的自动机没有可以检测的边
+        spot::random_ltl rl(&aps);
+        spot::formula f = rl.generate(size);
+        for (int tries = 0; f.is_constant() && tries < 100; tries++)
+        {
+            f = rl.generate(size);
+        }
+        spot::translator trans(dict);
+        trans.set_type(spot::postprocessor::Monitor);
+        trans.set_pref(spot::postprocessor::Deterministic);
+        prop.aut = trans.run(f);
+        prop.name = spot::str_psl(f);
+    }
+    else
+    {
+        prop.aut = random_monitor_aut(size, aps, dict, opt.drop);
+        prop.name = "randaut-" + std::to_string(size) + "-" + std::to_string(k);
+    }
+
+    if (Parse_automata_to_monitor(prop.monitor, prop.aut, prop.aut->get_dict()) != SUCCESS)
+    {
+        AMReturn(ERROR);
+    }
+    prop.monitor.init_state = prop.monitor.state_number = prop.aut->get_init_state_number();
+    prop.monitor.sampled = 0;
+    prop.build_ms = elapsed_ms(t0);
+    prop.heap_kb = heap_in_use_kb() - heap0;
+    prop.size = size;
+
+    if (!opt.hoa_out.empty())
+    {
+        std::ofstream out(opt.hoa_out + "-" + std::to_string(size) + "-" + std::to_string(k) + ".hoa");
+        spot::print_hoa(out, prop.aut) << '\n';
+    }
+    if (!opt.sol_out.empty())
+    {
+        std::string suffix = std::to_string(size) + "_" + std::to_string(k);
+        export_automata_to_solidity_packed(prop.aut, opt.sol_out + "-" + suffix + ".sol", "monitor_" + suffix);
+    }
+    return SUCCESS;
+}
+
+/*把完整赋值写成"p0 !p1 p2"的形式, 即Parse_acceptword_to_wordset接受的eventName*/
+static std::string assignment_to_word(bdd assign, const spot::atomic_prop_set &aps,
+                                      const spot::twa_graph_ptr &aut)
+{
+    std::string word;
+    const spot::bdd_dict_ptr &dict = aut->get_dict();
+    for (auto &ap : aps)
+    {
+        bool value;
+        int var = dict->has_registered_proposition(ap, aut);
+        if (var >= 0)
+        {
+            value = bdd_implies(assign, bdd_ithvar(var));
+        }
+        else
+        {
+            value = rng() & 1; //与自动机无关的命题随机取值
+        }
+        if (!word.empty())
+        {
+            word += " ";
+        }
+        word += (value ? "" : "!") + ap.ap_name();
+    }
+    return word;
+}
+
+static bdd random_assignment(bdd cond, const spot::twa_graph_ptr &aut)
+{
+    bdd vars = aut->ap_vars();
+    bdd pol = bddtrue;
+    for (bdd v = vars; v != bddtrue; v = bdd_high(v))
+    {
+        pol &= (rng() & 1) ? bdd_ithvar(bdd_var(v)) : bdd_nithvar(bdd_var(v));
+    }
+    return bdd_satoneset(cond, vars, pol);
+}
+
+/*
+在自动机上随机游走。violating为真时, 最后一个字不被当前状态的任何边接受;
+找不到这样的状态时返回ERROR。
+*/
+static int generate_trace(const spot::twa_graph_ptr &aut, const spot::atomic_prop_set &aps,
+                          unsigned length, bool violating, BenchTrace &trace)
+{
+    unsigned state = aut->get_init_state_number();
+    unsigned steps = violating ? length - 1 : length;
+    unsigned limit = steps + 10 * aut->num_states() + 100;
+
+    trace.words.clear();
+    trace.states.clear();
+    trace.violating = violating;
+    for (unsigned i = 0; i < limit; i++)
+    {
+        bdd accepted = bddfalse;
+        std::vector<unsigned> succ;
+        for (auto &e : aut->out(state))
+        {
+            accepted |= e.cond;
+            succ.push_back(aut->edge_number(e));
+        }
+        if (violating && trace.words.size() >= steps && accepted != bddtrue)
+        {
+            trace.words.push_back(assignment_to_word(random_assignment(!accepted, aut), aps, aut));
+            trace.states.push_back(state);
+            return SUCCESS;
+        }
+        if (!violating && trace.words.size() == steps)
+        {
+            return SUCCESS;
+        }
+        if (succ.empty())
+        {
+            break;
+        }
+        auto &e = aut->edge_storage(succ[rng() % succ.size()]);
+        trace.words.push_back(assignment_to_word(random_assignment(e.cond, aut), aps, aut));
+        state = e.dst;
+        trace.states.push_back(state);
+    }
+    return ERROR;
+}
+
+static void finish_result(BenchResult &r, AMHistogram *h, std::chrono::steady_clock::time_point t0)
+{
+    r.seconds = elapsed_ms(t0) / 1000;
+    r.p50 = AMHistogramQuantile(*h, 0.5);
+    r.p99 = AMHistogramQuantile(*h, 0.99);
+}
+
+/*引擎误判时按自动机语义的下一个状态继续, 使每条轨迹都跑完整个长度*/
+static BenchResult run_engine(BenchProperty &prop, const BenchTrace &trace)
+{
+    BenchResult r = {0, 0, 0, 0, 0};
+    AMHistogram *h = new AMHistogram();
+    const spot::bdd_dict_ptr &dict = prop.aut->get_dict();
+
+    prop.monitor.state_number = prop.monitor.init_state;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.words.size(); i++)
+    {
+        uint64_t s = AMMetricsNow();
+        int verdict = Check_word_acceptance(prop.aut, prop.monitor, dict, trace.words[i]);
+        AMHistogramRecord(*h, AMMetricsNow() - s);
+        r.events++;
+
+        bool expect_wrong = trace.violating && i + 1 == trace.words.size();
+        if ((verdict == WORD_ACCEPTANCE_WRONG) != expect_wrong ||
+            (verdict == SUCCESS && prop.monitor.state_number != (int)trace.states[i]))
+        {
+            r.mismatches++;
+        }
+        prop.monitor.state_number = trace.states[i];
+    }
+    finish_result(r, h, t0);
+    delete h;
+    return r;
+}
+
+static std::string event_json(uint64_t id, const std::string &word)
+{
+    std::ostringstream os;
+    os << "{\"eventId\":" << id << ",\"eventName\":\"" << word
+       << "\",\"fileName\":\"bench\",\"line\":0,\"eventTime\":\"0\"}";
+    return os.str();
+}
+
+/*服务端遇到违规会退出, 所以只发送合法轨迹*/
+static BenchResult run_server(const BenchOptions &opt, const BenchTrace &trace)
+{
+    BenchResult r = {0, 0, 0, 0, 0};
+    AMHistogram *h = new AMHistogram();
+    zmq::context_t context(1);
+    zmq::socket_t socket(context, ZMQ_REQ);
+    socket.connect(opt.addr);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.words.size(); i++)
+    {
+        std::string ev = event_json(i, trace.words[i]);
+        uint64_t s = AMMetricsNow();
+        zmq::message_t request(ev.size());
+        memcpy(request.data(), ev.data(), ev.size());
+        socket.send(request);
+        zmq::message_t reply;
+        socket.recv(&reply);
+        AMHistogramRecord(*h, AMMetricsNow() - s);
+        r.events++;
+        //"100"为继续检测, "101"为性质已经满足, 之后的事件不再检测, 两者都是合法轨迹的正常回复
+        const char *code = (const char *)reply.data();
+        if (reply.size() == 3 && (memcmp(code, "100", 3) == 0 || memcmp(code, "101", 3) == 0))
+        {
+            continue;
+        }
+        r.mismatches++; //"201"可能违规, "300"解析错误
+        if (reply.size() == 3 && memcmp(code, "200", 3) == 0)
+        {
+            break; //服务端判为违规后已经退出
+        }
+    }
+    finish_result(r, h, t0);
+    delete h;
+    return r;
+}
+
+static BenchResult run_replay(const BenchOptions &opt, BenchProperty &prop)
+{
+    BenchResult r = {0, 0, 0, 0, 0};
+    AMHistogram *h = new AMHistogram();
+    const spot::bdd_dict_ptr &dict = prop.aut->get_dict();
+    std::ifstream in(opt.log);
+    std::string line;
+
+    prop.monitor.state_number = prop.monitor.init_state;
+    auto t0 = std::chrono::steady_clock::now();
+    while (std::getline(in, line))
+    {
+        uint64_t s = AMMetricsNow();
+        AMEventView ev;
+        if (AMDecodeEvent(line.data(), line.size(), ev) != SUCCESS || ev.eventName.ptr == nullptr)
+        {
+            continue;
+        }
+        std::string word(ev.eventName.ptr, ev.eventName.len);
+        int verdict = Check_word_acceptance(prop.aut, prop.monitor, dict, word);
+        AMHistogramRecord(*h, AMMetricsNow() - s);
+        r.events++;
+        if (verdict == WORD_ACCEPTANCE_WRONG)
+        {
+            r.mismatches++; //日志中出现违规后, 从初始状态继续
+            prop.monitor.state_number = prop.monitor.init_state;
+        }
+    }
+    finish_result(r, h, t0);
+    delete h;
+    return r;
+}
+
+static void print_row(const BenchOptions &opt, const BenchProperty &prop, const char *trace,
+                      const BenchResult &r)
+{
+    double eps = r.seconds > 0 ? r.events / r.seconds : 0;
+    printf("%s,%s,%u,%u,%u,%u,%.3f,%ld,%s,%llu,%.0f,%llu,%llu,%lld,\"%s\"\n", opt.mode.c_str(),
+           opt.family.c_str(), opt.aps, prop.size, prop.aut->num_states(), prop.aut->num_edges(),
+           prop.build_ms, prop.heap_kb, trace, (unsigned long long)r.events, eps,
+           (unsigned long long)r.p50, (unsigned long long)r.p99,
+           (long long)r.mismatches, prop.name.c_str());
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opt;
+    if (parse_options(argc, argv, opt) != SUCCESS)
+    {
+        usage();
+    }
+    AMLogInit(std::max(AMLogLevelFromString(opt.log_level), 0), false, 0, "");
+    rng.seed(opt.seed);
+    spot::srand(opt.seed);
+
+    spot::atomic_prop_set aps = spot::create_atomic_prop_set(opt.aps);
+    std::ofstream write_log;
+    if (!opt.write_log.empty())
+    {
+        write_log.open(opt.write_log, std::ios::trunc);
+    }
+    if (!opt.hoa.empty())
+    {
+        opt.sizes = {0};
+        opt.formulas = 1;
+    }
+
+    printf("mode,family,aps,size,states,edges,build_ms,heap_kb,trace,events,events_per_s,"
+           "p50_ns,p99_ns,mismatches,property\n");
+    for (unsigned size : opt.sizes)
+    {
+        for (unsigned k = 0; k < opt.formulas; k++)
+        {
+            BenchProperty prop;
+            if (build_property(opt, size, k, aps, prop) != SUCCESS)
+            {
+                continue;
+            }
+
+            if (opt.mode == "replay")
+            {
+                print_row(opt, prop, "log", run_replay(opt, prop));
+                continue;
+            }
+
+            //给定的HOA文件使用其中的原子命题
+            spot::atomic_prop_set trace_aps = aps;
+            if (!opt.hoa.empty())
+            {
+                trace_aps = spot::atomic_prop_set(prop.aut->ap().begin(), prop.aut->ap().end());
+            }
+            BenchTrace valid, bad;
+            BenchResult none = {0, 0, 0, 0, -1};
+            bool have_valid = generate_trace(prop.aut, trace_aps, opt.length, false, valid) == SUCCESS;
+            bool have_bad = generate_trace(prop.aut, trace_aps, opt.length, true, bad) == SUCCESS;
+
+            if (write_log.is_open() && have_valid)
+            {
+                for (size_t i = 0; i < valid.words.size(); i++)
+                {
+                    write_log << event_json(i, valid.words[i]) << "\n";
+                }
+            }
+
+            if (opt.mode == "server")
+            {
+                print_row(opt, prop, "valid", have_valid ? run_server(opt, valid) : none);
+                continue;
+            }
+            print_row(opt, prop, "valid", have_valid ? run_engine(prop, valid) : none);
+            print_row(opt, prop, "violating", have_bad ? run_engine(prop, bad) : none);
+        }
+    }
+    return 0;
+}
@@ -41,6 +41,8 @@
 #include "common_cout.hh"
 #include "common_aoutput.hh"
 #include "common_post.hh"
+#include "common_conv.hh"
+#include "common_parallel.hh"
 
 #include <spot/twaalgos/hoa.hh>
 #include <spot/twaalgos/postproc.hh>
@@ -73,6 +75,7 @@ enum {
   OPT_MEDIUM,
   OPT_NOCHECKS,
   OPT_OMIT,
+  OPT_PARALLEL,
   OPT_STOP_ERR,
   OPT_VERBOSE,
 };
@@ -96,6 +99,9 @@ static const argp_option options[] =
       "expect that each tool preserves the input language", 0 },
     { "no-checks", OPT_NOCHECKS, nullptr, 0,
       "do not perform any sanity checks", 0 },
+    { "parallel", OPT_PARALLEL, "N", 0,
+      "run up to N tools at the same time, and check the emptiness of "
+      "products using N processes; the output does not depend on N", 0 },
     /**************************************************/
     { nullptr, 0, nullptr, 0, "Statistics output:", 7 },
     { "csv", OPT_CSV, "[>>]FILENAME", OPTION_ARG_OPTIONAL,
@@ -145,6 +151,7 @@ static bool stop_on_error = false;
 static bool no_checks = false;
 static bool opt_language_preserved = false;
 static bool opt_omit = false;
+static unsigned parallel_jobs = 1;
 static const char* csv_output = nullptr;
 static unsigned round_num = 0;
 static const char* bogus_output_filename = nullptr;
@@ -200,6 +207,9 @@ parse_opt(int key, char* arg, struct argp_state*)
     case OPT_OMIT:
       opt_omit = true;
       break;
+    case OPT_PARALLEL:
+      parallel_jobs = to_pos_int(arg, "--parallel");
+      break;
     case OPT_STOP_ERR:
       stop_on_error = true;
       break;
@@ -386,26 +396,83 @@ namespace
     {
     }
 
-    spot::twa_graph_ptr
-    run_tool(unsigned int tool_num, char l, bool& problem,
-             out_statistics& stats)
+    // A run whose command has been formatted, but not yet executed.
+    // It owns the output file of the command.
+    struct tool_run
+    {
+      unsigned tool_num;
+      char l;
+      std::string cmd;
+      spot::temporary_file* output;
+    };
+
+    tool_run
+    prepare(unsigned int tool_num, char l)
     {
       output.reset(tool_num);
 
       std::ostringstream command;
       format(command, tools[tool_num].cmd);
+      return { tool_num, l, command.str(), output.release() };
+    }
 
-      std::string cmd = command.str();
-      auto disp_cmd = [&]() {
-                        std::cerr << "Running [" << l << tool_num
-                                  << "]: " << cmd << '\n';
-                      };
+    spot::twa_graph_ptr
+    run_tool(unsigned int tool_num, char l, bool& problem,
+             out_statistics& stats)
+    {
+      tool_run r = prepare(tool_num, l);
       if (!quiet)
-        disp_cmd();
+        display_command(r);
       spot::process_timer timer;
       timer.start();
-      int es = exec_with_timeout(cmd.c_str());
+      int es = exec_with_timeout(r.cmd.c_str());
       timer.stop();
+      return result(r, es, timed_out, timer.walltime(), problem, stats);
+    }
+
+    // Run the commands in TODO, with up to JOBS of them at the same
+    // time, and store their results in RES, in the same order.
+    // Return the number of problems encountered.
+    int
+    run_tools(std::vector<tool_run>& todo, unsigned jobs,
+              vector_tool_statistics& stats,
+              std::vector<spot::twa_graph_ptr>& res)
+    {
+      std::vector<std::string> cmds;
+      cmds.reserve(todo.size());
+      for (auto& r: todo)
+        {
+          if (!quiet)
+            display_command(r);
+          cmds.push_back(r.cmd);
+        }
+      std::vector<exec_result> er;
+      exec_all_with_timeout(cmds, jobs, er);
+      int problems = 0;
+      for (size_t i = 0; i < todo.size(); ++i)
+        {
+          bool prob;
+          res[i] = result(todo[i], er[i].status, er[i].timed_out,
+                          er[i].walltime, prob, stats[i]);
+          problems += prob;
+        }
+      return problems;
+    }
+
+  private:
+    static void
+    display_command(const tool_run& r)
+    {
+      std::cerr << "Running [" << r.l << r.tool_num
+                << "]: " << r.cmd << '\n';
+    }
+
+    // Process the output of a command, once it has run.
+    spot::twa_graph_ptr
+    result(tool_run& r, int es, bool timed_out, double walltime,
+           bool& problem, out_statistics& stats)
+    {
+      auto disp_cmd = [&]() { display_command(r); };
       const char* status_str = nullptr;
 
       spot::twa_graph_ptr res = nullptr;
@@ -467,7 +534,7 @@ namespace
           problem = false;
           es = 0;
 
-          auto aut = spot::parse_aut(output.val()->name(), dict,
+          auto aut = spot::parse_aut(r.output->name(), dict,
                                      spot::default_environment::instance(),
                                      opt_parse);
           if (!aut->errors.empty())
@@ -499,11 +566,12 @@ namespace
               res = aut->aut;
             }
         }
-      output.cleanup();
+      delete r.output;
+      r.output = nullptr;
 
       stats.status_str = status_str;
       stats.status_code = es;
-      stats.time = timer.walltime();
+      stats.time = walltime;
       if (res)
         {
           stats.ok = true;
@@ -635,12 +703,20 @@ namespace
           printsize(input, true);
         }
 
-      for (size_t n = 0; n < m; ++n)
+      if (parallel_jobs > 1)
         {
-          bool prob;
-          pos[n] = runner.run_tool(n, 'A', prob, stats[n]);
-          problems += prob;
+          std::vector<autcross_runner::tool_run> todo;
+          for (size_t n = 0; n < m; ++n)
+            todo.push_back(runner.prepare(n, 'A'));
+          problems += runner.run_tools(todo, parallel_jobs, stats, pos);
         }
+      else
+        for (size_t n = 0; n < m; ++n)
+          {
+            bool prob;
+            pos[n] = runner.run_tool(n, 'A', prob, stats[n]);
+            problems += prob;
+          }
       spot::cleanup_tmpfiles();
       output_statistics.push_back(std::move(stats));
 
@@ -718,31 +794,60 @@ namespace
               };
           }
 
+          // Check the emptiness of the products pos[i]*neg[j] for
+          // all pairs (i, j) of PAIRS, using --parallel processes.
+          // Return the number of nonempty products.
+          auto check_pairs =
+            [&](const std::vector<std::pair<size_t, size_t>>& pairs)
+            {
+              std::vector<bool> nonempty =
+                parallel_tasks(pairs.size(), parallel_jobs,
+                               [&](unsigned k)
+                               {
+                                 size_t i = pairs[k].first;
+                                 size_t j = pairs[k].second;
+                                 return check_empty_prod(pos[i], neg[j],
+                                                         i, j);
+                               });
+              unsigned res = 0;
+              for (bool ne: nonempty)
+                res += ne;
+              // In a worker process, check_empty_prod() could not
+              // set the flag for us.
+              if (res)
+                global_error_flag = true;
+              return res;
+            };
+
           // Just make a circular implication check
           // A0 <= A1, A1 <= A2, ..., AN <= A0
+          std::vector<std::pair<size_t, size_t>> pairs;
           unsigned ok = 0;
           for (size_t i = 0; i < mi; ++i)
             if (pos[i])
               {
                 size_t j = ((i + 1) % mi);
                 if (i != j && neg[j])
-                  {
-                    int res = check_empty_prod(pos[i], neg[j], i, j);
-                    problems += res;
-                    ok += !res;
-                  }
+                  pairs.emplace_back(i, j);
               }
+          unsigned res = check_pairs(pairs);
+          problems += res;
+          ok += pairs.size() - res;
           // If the circular check failed, do the rest of all
           // mi(mi-1)/2 checks, as this will help diagnose the issue.
           if (ok != mi)
-            for (size_t i = 0; i < mi; ++i)
-              if (pos[i])
-                {
-                  size_t k = ((i + 1) % mi);
-                  for (size_t j = 0; j < mi; ++j)
-                  if (i != j && j != k && neg[j])
-                    problems += check_empty_prod(pos[i], neg[j], i, j);
-                }
+            {
+              pairs.clear();
+              for (size_t i = 0; i < mi; ++i)
+                if (pos[i])
+                  {
+                    size_t k = ((i + 1) % mi);
+                    for (size_t j = 0; j < mi; ++j)
+                      if (i != j && j != k && neg[j])
+                        pairs.emplace_back(i, j);
+                  }
+              problems += check_pairs(pairs);
+            }
         }
       else
         {
@@ -24,6 +24,7 @@
 #include <limits>
 #include <set>
 #include <memory>
+#include <sstream>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -39,6 +40,7 @@
 #include "common_post.hh"
 #include "common_conv.hh"
 #include "common_hoaread.hh"
+#include "common_parallel.hh"
 
 #include <spot/misc/optionmap.hh>
 #include <spot/misc/random.hh>
@@ -46,6 +48,7 @@
 #include <spot/parseaut/public.hh>
 #include <spot/tl/exclusive.hh>
 #include <spot/twaalgos/are_isomorphic.hh>
+#include <spot/twaalgos/binaut.hh>
 #include <spot/twaalgos/canonicalize.hh>
 #include <spot/twaalgos/cobuchi.hh>
 #include <spot/twaalgos/cleanacc.hh>
@@ -414,6 +417,7 @@ static const struct argp_child children[] =
     { &aoutput_argp, 0, nullptr, 0 },
     { &aoutput_io_format_argp, 0, nullptr, 4 },
     { &post_argp_disabled, 0, nullptr, 0 },
+    { &parallel_argp, 0, nullptr, 0 },
     { &misc_argp, 0, nullptr, -1 },
     { nullptr, 0, nullptr, 0 }
   };
@@ -1554,17 +1558,19 @@ namespace
           }
 
       timer.stop();
-      if (opt->uniq)
-        {
-          auto tmp =
-            spot::canonicalize(make_twa_graph(aut,
-                                                 spot::twa::prop_set::all()));
-          if (!opt->uniq->emplace(tmp->edge_vector().begin() + 1,
-                                  tmp->edge_vector().end()).second)
-            return 0;
-        }
+      if (opt->uniq && !new_automaton(aut))
+        return 0;
 
       ++match_count;
+      if (parallel_worker)
+        {
+          // BDD identifiers differ from one process to the other,
+          // so let the parent canonicalize the automaton again.
+          std::ostringstream key;
+          if (opt->uniq)
+            spot::save_binary_aut(key, aut);
+          parallel_matched(key.str());
+        }
 
       printer.print(aut, timer, nullptr, haut->filename.c_str(), -1,
                     haut, prefix, suffix);
@@ -1574,6 +1580,31 @@ namespace
 
       return 0;
     }
+
+    bool
+    parallel_merge(const std::string& key) override
+    {
+      if (opt->uniq)
+        {
+          std::istringstream is(key);
+          if (!new_automaton(spot::load_binary_aut(is, dict_)))
+            return false;
+        }
+      ++match_count;
+      if (opt_max_count >= 0 && match_count >= opt_max_count)
+        abort_run = true;
+      return true;
+    }
+
+    // For --unique: whether AUT was not seen before.
+    bool
+    new_automaton(const spot::const_twa_graph_ptr& aut)
+    {
+      auto tmp =
+        spot::canonicalize(make_twa_graph(aut, spot::twa::prop_set::all()));
+      return opt->uniq->emplace(tmp->edge_vector().begin() + 1,
+                                tmp->edge_vector().end()).second;
+    }
   };
 }
 
@@ -25,6 +25,7 @@
 #include "common_post.hh"
 #include "common_cout.hh"
 #include "common_setup.hh"
+#include "common_parallel.hh"
 
 #include <unistd.h>
 #include <ctime>
@@ -567,6 +568,9 @@ automaton_printer::automaton_printer(stat_style input)
   if (automaton_format == Count && opt_output)
     throw std::runtime_error
       ("options --output and --count are incompatible");
+  if (parallel_workers > 1 && opt_output)
+    throw std::runtime_error
+      ("options --output and --parallel are incompatible");
 }
 
 void
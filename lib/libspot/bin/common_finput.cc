@@ -19,6 +19,7 @@
 
 #include "common_finput.hh"
 #include "common_setup.hh"
+#include "common_parallel.hh"
 #include "error.h"
 
 #include <fstream>
@@ -119,6 +120,8 @@ job_processor::process_string(const std::string& input,
                               int linenum)
 {
   auto pf = parse_formula(input);
+  if (!parallel_take_item())
+    return 0;
 
   if (!pf.f || !pf.errors.empty())
     {
@@ -355,6 +358,8 @@ job_processor::process_file(const char* filename)
 int
 job_processor::run()
 {
+  if (parallel_workers > 1 && !parallel_worker)
+    return parallel_run(*this);
   int error = 0;
   for (auto& j: jobs)
     {
@@ -368,6 +373,12 @@ job_processor::run()
   return error;
 }
 
+bool
+job_processor::parallel_merge(const std::string&)
+{
+  return true;
+}
+
 void check_no_formula()
 {
   if (!jobs.empty())
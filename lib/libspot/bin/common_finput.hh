@@ -73,6 +73,15 @@ public:
   virtual int
   run();
 
+  // With --parallel, this is called in the parent process for each
+  // input matched by a worker, in the input order, with the key the
+  // worker passed to parallel_matched().  Return false to discard
+  // the output of that input.  Set abort_run to stop processing.
+  virtual bool
+  parallel_merge(const std::string& key);
+
+  friend int parallel_run(job_processor& processor);
+
   char* real_filename;
   long int col_to_read;
   char* prefix;
@@ -30,6 +30,7 @@
 #include <fstream>
 
 #include "common_finput.hh"
+#include "common_parallel.hh"
 #include <spot/parseaut/public.hh>
 
 
@@ -127,6 +128,14 @@ public:
     int err = 0;
     while (!abort_run)
       {
+        // With --parallel, the automata of other workers are skipped
+        // without being built.
+        if (!parallel_take_item())
+          {
+            if (!hp.skip())
+              break;
+            continue;
+          }
         auto haut = hp.parse(dict_);
         if (!haut->aut && haut->errors.empty())
           break;
@@ -30,6 +30,7 @@
 #include <spot/misc/formater.hh>
 #include <spot/misc/escape.hh>
 #include "common_cout.hh"
+#include "common_parallel.hh"
 #include "error.h"
 
 enum {
@@ -344,6 +345,10 @@ parse_opt_output(int key, char* arg, struct argp_state*)
       delete format;
       format = new formula_printer(std::cout, arg);
       break;
+    case ARGP_KEY_END:
+      if (outputnamer && parallel_workers > 1)
+        error(2, 0, "options --output and --parallel are incompatible");
+      break;
     default:
       return ARGP_ERR_UNKNOWN;
     }
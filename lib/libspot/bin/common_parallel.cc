@@ -0,0 +1,473 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common_parallel.hh"
+#include "common_finput.hh"
+#include "common_conv.hh"
+#include "common_cout.hh"
+#include "common_setup.hh"
+#include "error.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <spot/misc/tmpfile.hh>
+
+enum {
+  OPT_PARALLEL = 1,
+};
+
+static const argp_option options[] =
+  {
+    { nullptr, 0, nullptr, 0, "Parallel processing:", -2 },
+    { "parallel", OPT_PARALLEL, "N", 0,
+      "process the input formulas or automata using N worker processes; "
+      "the output is printed in the same order as without this option", 0 },
+    { nullptr, 0, nullptr, 0, nullptr, 0 }
+  };
+
+static int
+parse_opt_parallel(int key, char* arg, struct argp_state*)
+{
+  // Called from C code, so should not raise any exception.
+  BEGIN_EXCEPTION_PROTECT;
+  switch (key)
+    {
+    case OPT_PARALLEL:
+      parallel_workers = to_pos_int(arg, "--parallel");
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  END_EXCEPTION_PROTECT;
+  return 0;
+}
+
+const struct argp parallel_argp = { options, parse_opt_parallel,
+                                    nullptr, nullptr, nullptr,
+                                    nullptr, nullptr };
+
+unsigned parallel_workers = 0;
+bool parallel_worker = false;
+
+// Each item processed by a worker is sent to the parent as a record
+// starting with one of the following tags.  Matched and unmatched
+// records are followed by the key given to parallel_matched() and by
+// the output of the item, each preceded by its size.  The end record
+// is followed by the return value of job_processor::run().
+enum : char {
+  REC_MATCHED = 'M',
+  REC_UNMATCHED = 'U',
+  REC_END = 'E',
+};
+
+namespace
+{
+  // State of a worker process.
+  static unsigned worker_index = 0;
+  static unsigned long item_count = 0;
+  static int worker_fd = -1;
+  static bool item_pending = false;
+  static bool item_matched = false;
+  static std::string item_key;
+  static std::stringbuf item_output;
+
+  static void
+  write_all(int fd, const char* data, size_t size)
+  {
+    while (size)
+      {
+        ssize_t n = write(fd, data, size);
+        if (n < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            error(2, errno, "write error");
+          }
+        data += n;
+        size -= n;
+      }
+  }
+
+  // Return false on EOF.
+  static bool
+  read_all(int fd, char* data, size_t size)
+  {
+    while (size)
+      {
+        ssize_t n = read(fd, data, size);
+        if (n < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            error(2, errno, "failed to read from a worker process");
+          }
+        if (n == 0)
+          return false;
+        data += n;
+        size -= n;
+      }
+    return true;
+  }
+
+  static void
+  append_string(std::string& rec, const std::string& s)
+  {
+    uint64_t size = s.size();
+    rec.append(reinterpret_cast<const char*>(&size), sizeof size);
+    rec += s;
+  }
+
+  static bool
+  read_string(int fd, std::string& s)
+  {
+    uint64_t size;
+    if (!read_all(fd, reinterpret_cast<char*>(&size), sizeof size))
+      return false;
+    s.resize(size);
+    return read_all(fd, &s[0], size);
+  }
+
+  static void
+  send_pending_item()
+  {
+    if (!item_pending)
+      return;
+    std::cout.flush();
+    std::string rec(1, item_matched ? REC_MATCHED : REC_UNMATCHED);
+    append_string(rec, item_key);
+    append_string(rec, item_output.str());
+    write_all(worker_fd, rec.data(), rec.size());
+    item_output.str(std::string());
+    item_pending = false;
+  }
+
+  [[noreturn]] static void
+  run_worker(job_processor& processor, unsigned index, int fd)
+  {
+    parallel_worker = true;
+    worker_index = index;
+    worker_fd = fd;
+    std::cout.rdbuf(&item_output);
+    int32_t res = processor.run();
+    send_pending_item();
+    std::string rec(1, REC_END);
+    rec.append(reinterpret_cast<const char*>(&res), sizeof res);
+    write_all(worker_fd, rec.data(), rec.size());
+    std::cerr.flush();
+    _exit(0);
+  }
+
+  static bool
+  reads_stdin(const job& j)
+  {
+    return j.file_p && j.str[0] == '-' && (!j.str[1] || j.str[1] == '/');
+  }
+}
+
+bool
+parallel_take_item()
+{
+  if (!parallel_worker)
+    return true;
+  send_pending_item();
+  if (item_count++ % parallel_workers != worker_index)
+    return false;
+  item_pending = true;
+  item_matched = false;
+  item_key.clear();
+  return true;
+}
+
+void
+parallel_matched(const std::string& key)
+{
+  if (!parallel_worker)
+    return;
+  item_matched = true;
+  item_key = key;
+}
+
+int
+parallel_run(job_processor& processor)
+{
+  unsigned n = parallel_workers;
+
+  // The workers all need to read the standard input from the
+  // beginning, so save it in a temporary file that each of them
+  // opens separately.
+  std::vector<int> stdin_fds;
+  for (auto& j: jobs)
+    if (reads_stdin(j))
+      {
+        spot::open_temporary_file* tmp =
+          spot::create_open_tmpfile("parallel-", ".in");
+        char buf[65536];
+        ssize_t size;
+        while ((size = read(STDIN_FILENO, buf, sizeof buf)) != 0)
+          if (size < 0)
+            {
+              if (errno != EINTR)
+                error(2, errno, "failed to read standard input");
+            }
+          else
+            {
+              write_all(tmp->fd(), buf, size);
+            }
+        tmp->close();
+        for (unsigned i = 0; i < n; ++i)
+          {
+            int fd = open(tmp->name(), O_RDONLY);
+            if (fd < 0)
+              error(2, errno, "cannot open '%s'", tmp->name());
+            stdin_fds.push_back(fd);
+          }
+        delete tmp;
+        break;
+      }
+
+  // Do not let the workers inherit buffered output.
+  std::cout.flush();
+  std::cerr.flush();
+  fflush(nullptr);
+
+  std::vector<pid_t> pids(n);
+  std::vector<int> fds(n);
+  for (unsigned i = 0; i < n; ++i)
+    {
+      int p[2];
+      if (pipe(p))
+        error(2, errno, "failed to create a pipe");
+      pid_t pid = fork();
+      if (pid == -1)
+        error(2, errno, "failed to fork()");
+      if (pid == 0)
+        {
+          close(p[0]);
+          for (unsigned j = 0; j < i; ++j)
+            close(fds[j]);
+          if (!stdin_fds.empty())
+            {
+              dup2(stdin_fds[i], STDIN_FILENO);
+              for (int fd: stdin_fds)
+                close(fd);
+            }
+          run_worker(processor, i, p[1]);
+        }
+      close(p[1]);
+      pids[i] = pid;
+      fds[i] = p[0];
+    }
+  for (int fd: stdin_fds)
+    close(fd);
+
+  // Items are distributed round-robin, so reading the workers in
+  // turn gives the items in input order.  The first worker that
+  // reaches the end has seen all items.
+  int res = 0;
+  bool failed = false;
+  unsigned ended = n;
+  std::string key;
+  std::string output;
+  for (unsigned i = 0;; i = (i + 1) % n)
+    {
+      char tag;
+      if (!read_all(fds[i], &tag, 1))
+        {
+          failed = true;
+          break;
+        }
+      if (tag == REC_END)
+        {
+          int32_t r;
+          if (!read_all(fds[i], reinterpret_cast<char*>(&r), sizeof r))
+            failed = true;
+          res |= r;
+          ended = i;
+          break;
+        }
+      if (!read_string(fds[i], key) || !read_string(fds[i], output))
+        {
+          failed = true;
+          break;
+        }
+      if (tag == REC_UNMATCHED || processor.parallel_merge(key))
+        {
+          std::cout.write(output.data(), output.size());
+          check_cout();
+        }
+      if (processor.abort_run)
+        break;
+    }
+
+  // Collect the return values of the other workers.  This is only
+  // needed if all items have been processed.
+  if (ended < n)
+    for (unsigned i = 0; i < n && !failed; ++i)
+      {
+        if (i == ended)
+          continue;
+        char tag;
+        int32_t r;
+        if (!read_all(fds[i], &tag, 1) || tag != REC_END
+            || !read_all(fds[i], reinterpret_cast<char*>(&r), sizeof r))
+          failed = true;
+        else
+          res |= r;
+      }
+  // Otherwise stop the workers that are still running.
+  if (ended == n || failed)
+    for (pid_t pid: pids)
+      kill(pid, SIGTERM);
+
+  for (int fd: fds)
+    close(fd);
+  int exit_code = 0;
+  for (pid_t pid: pids)
+    {
+      int status;
+      while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+          error(2, errno, "failed to wait for a worker process");
+      if (exit_code)
+        continue;
+      if (WIFEXITED(status))
+        exit_code = WEXITSTATUS(status);
+      else if (WTERMSIG(status) != SIGTERM)
+        {
+          error(0, 0, "worker process killed by signal %d",
+                WTERMSIG(status));
+          exit_code = 2;
+        }
+    }
+  if (failed || exit_code)
+    {
+      // The worker that failed has already reported the error, as
+      // the sequential version would have, after the output of the
+      // preceding items.
+      flush_cout();
+      exit(exit_code ? exit_code : 2);
+    }
+  return res;
+}
+
+std::vector<bool>
+parallel_tasks(unsigned count, unsigned workers,
+               const std::function<bool(unsigned)>& task)
+{
+  std::vector<bool> res(count);
+  if (workers > count)
+    workers = count;
+  if (workers <= 1)
+    {
+      for (unsigned i = 0; i < count; ++i)
+        res[i] = task(i);
+      return res;
+    }
+
+  // Do not let the workers inherit buffered output.
+  std::cout.flush();
+  std::cerr.flush();
+  fflush(nullptr);
+
+  std::vector<pid_t> pids(workers);
+  std::vector<int> fds(workers);
+  for (unsigned k = 0; k < workers; ++k)
+    {
+      int p[2];
+      if (pipe(p))
+        error(2, errno, "failed to create a pipe");
+      pid_t pid = fork();
+      if (pid == -1)
+        error(2, errno, "failed to fork()");
+      if (pid == 0)
+        {
+          close(p[0]);
+          for (unsigned j = 0; j < k; ++j)
+            close(fds[j]);
+          // Each result is sent as one byte followed by what the
+          // task printed on std::cerr.  An exception stops the
+          // worker, and the parent will notice the missing record.
+          std::stringbuf err;
+          std::cerr.rdbuf(&err);
+          int status = 0;
+          try
+            {
+              for (unsigned i = k; i < count; i += workers)
+                {
+                  std::string rec(1, task(i) ? '1' : '0');
+                  std::cerr.flush();
+                  append_string(rec, err.str());
+                  err.str(std::string());
+                  write_all(p[1], rec.data(), rec.size());
+                }
+            }
+          catch (const std::exception& e)
+            {
+              std::string msg = err.str();
+              // Use the real standard error.
+              write_all(STDERR_FILENO, msg.data(), msg.size());
+              error(0, 0, "%s", e.what());
+              status = 2;
+            }
+          catch (...)
+            {
+              status = 2;
+            }
+          _exit(status);
+        }
+      close(p[1]);
+      pids[k] = pid;
+      fds[k] = p[0];
+    }
+
+  bool failed = false;
+  std::string err;
+  for (unsigned i = 0; i < count && !failed; ++i)
+    {
+      int fd = fds[i % workers];
+      char r;
+      if (!read_all(fd, &r, 1) || !read_string(fd, err))
+        {
+          failed = true;
+          break;
+        }
+      std::cerr << err;
+      res[i] = r == '1';
+    }
+  if (failed)
+    for (pid_t pid: pids)
+      kill(pid, SIGTERM);
+  for (int fd: fds)
+    close(fd);
+  for (pid_t pid: pids)
+    while (waitpid(pid, nullptr, 0) < 0)
+      if (errno != EINTR)
+        error(2, errno, "failed to wait for a worker process");
+  if (failed)
+    error(2, 0, "a worker process failed");
+  return res;
+}
@@ -0,0 +1,62 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "common_sys.hh"
+
+#include <argp.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+class job_processor;
+
+extern const struct argp parallel_argp;
+
+// Number of worker processes requested with --parallel.  0 or 1
+// means that inputs are processed sequentially.
+extern unsigned parallel_workers;
+// Set in the worker processes.
+extern bool parallel_worker;
+
+// Each worker reads all inputs, but only processes every Nth input
+// item (a formula or an automaton).  This should be called at the
+// start of each item, and the item should be skipped if it returns
+// false.  It always returns true outside of workers.
+bool parallel_take_item();
+
+// In a worker, mark the current item as matched.  KEY is passed to
+// job_processor::parallel_merge() in the parent process, which can
+// use it to implement --unique.
+void parallel_matched(const std::string& key = std::string());
+
+// Process the jobs of PROCESSOR using parallel_workers processes.
+// The output of the workers is collected and printed in the order
+// of the input.  Return value is the same as job_processor::run().
+int parallel_run(job_processor& processor);
+
+// Compute TASK(0), ..., TASK(COUNT-1) using up to WORKERS processes,
+// and return their results.  Tasks run in forked processes, so they
+// cannot modify the state of the caller: they should only compute
+// their result.  What they print on std::cerr is printed in the
+// order of the tasks.  With WORKERS <= 1, the tasks are simply run
+// in order.
+std::vector<bool> parallel_tasks(unsigned count, unsigned workers,
+                                 const std::function<bool(unsigned)>& task);
@@ -27,6 +27,9 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <cerrno>
 #ifdef HAVE_SPAWN_H
 #include <spawn.h>
 #endif
@@ -278,6 +281,13 @@ void printable_result_filename::cleanup()
   val_ = nullptr;
 }
 
+spot::temporary_file* printable_result_filename::release()
+{
+  spot::temporary_file* res = val_;
+  val_ = nullptr;
+  return res;
+}
+
 void
 printable_result_filename::print(std::ostream& os, const char*) const
 {
@@ -465,13 +475,44 @@ static unsigned timeout = 0;
 static volatile int alarm_on = 0;
 static int child_pid = -1;
 
+// Commands started by exec_all_with_timeout().  The signal handler
+// uses this array to kill them, so it is only updated while SIGALRM
+// is blocked.
+struct exec_slot
+{
+  pid_t pid = 0;                // 0 if the slot is unused
+  time_t deadline = 0;          // next signal is due then, if not 0
+  int signals_left = 0;
+  bool timed_out = false;
+};
+static exec_slot* volatile exec_slots = nullptr;
+static volatile unsigned exec_slots_count = 0;
+
+static void arm_exec_alarm(time_t now);
+
 static void
 sig_handler(int sig)
 {
   if (child_pid == 0)
     error(2, 0, "received signal %d before starting child", sig);
 
-  if (sig == SIGALRM && alarm_on)
+  if (sig == SIGALRM && exec_slots_count)
+    {
+      time_t now = time(nullptr);
+      for (unsigned i = 0; i < exec_slots_count; ++i)
+        {
+          exec_slot& s = exec_slots[i];
+          if (s.pid <= 0 || !s.deadline || s.deadline > now)
+            continue;
+          s.timed_out = true;
+          // As in exec_with_timeout(), send SIGTERM twice before
+          // really killing the command.
+          kill(-s.pid, --s.signals_left > 0 ? SIGTERM : SIGKILL);
+          s.deadline = now + 2;
+        }
+      arm_exec_alarm(now);
+    }
+  else if (sig == SIGALRM && alarm_on)
     {
       timed_out = true;
       if (--alarm_on)
@@ -491,7 +532,11 @@ sig_handler(int sig)
   else
     {
       // forward signal
-      kill(-child_pid, sig);
+      if (child_pid > 0)
+        kill(-child_pid, sig);
+      for (unsigned i = 0; i < exec_slots_count; ++i)
+        if (exec_slots[i].pid > 0)
+          kill(-exec_slots[i].pid, sig);
       // cleanup files
       spot::cleanup_tmpfiles();
       // and die verbosely
@@ -751,13 +796,11 @@ exec_command(const char* cmd)
 extern char **environ;
 #endif
 
-int
-exec_with_timeout(const char* cmd)
+// Start CMD in its own process group, and return its pid.
+static pid_t
+spawn_command(const char* cmd)
 {
-  int status;
-
-  timed_out = false;
-
+  pid_t pid;
 #ifdef HAVE_SPAWN_H
   simple_command res = parse_simple_command(cmd);
 
@@ -770,7 +813,13 @@ exec_with_timeout(const char* cmd)
     error(2, err, "posix_spawnattr_init() failed");
   if (int err = posix_spawnattr_setpgroup(&attr, 0))
     error(2, err, "posix_spawnattr_setpgroup() failed");
-  if (int err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP))
+  // exec_all_with_timeout() blocks SIGALRM while starting commands.
+  sigset_t mask;
+  sigemptyset(&mask);
+  if (int err = posix_spawnattr_setsigmask(&attr, &mask))
+    error(2, err, "posix_spawnattr_setsigmask() failed");
+  if (int err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP
+                                         | POSIX_SPAWN_SETSIGMASK))
     error(2, err, "posix_spawnattr_setflags() failed");
   posix_spawn_file_actions_t actions;
   if (int err = posix_spawn_file_actions_init(&actions))
@@ -794,7 +843,7 @@ exec_with_timeout(const char* cmd)
                                                        O_CREAT | O_WRONLY |
                                                        O_TRUNC, 0644))
           error(2, err, "posix_spawn_file_actions_addopen() failed");
-      if (int err = posix_spawnp(&child_pid, res.args[0], &actions, &attr,
+      if (int err = posix_spawnp(&pid, res.args[0], &actions, &attr,
                                  res.args.data(), environ))
         error(2, err, "failed to run '%s'", res.args[0]);
     }
@@ -806,14 +855,14 @@ exec_with_timeout(const char* cmd)
       if (has_bin_sh)
         {
           const char* args[] = { "/bin/sh", "-c", cmd, nullptr };
-          if (posix_spawn(&child_pid, args[0], &actions, &attr,
+          if (posix_spawn(&pid, args[0], &actions, &attr,
                           const_cast<char **>(args), environ))
             has_bin_sh = false;
         }
       if (!has_bin_sh)
         {
           const char* args[] = { "sh", "-c", cmd, nullptr };
-          if (int err = posix_spawnp(&child_pid, args[0], &actions, &attr,
+          if (int err = posix_spawnp(&pid, args[0], &actions, &attr,
                                      const_cast<char **>(args), environ))
             error(2, err, "failed to run '%s' via 'sh'", cmd);
         }
@@ -823,13 +872,17 @@ exec_with_timeout(const char* cmd)
   if (int err = posix_spawnattr_destroy(&attr))
     error(2, err, "posix_spawnattr_destroy() failed");
 #else
-  child_pid = fork();
-  if (child_pid == -1)
+  pid = fork();
+  if (pid == -1)
     error(2, errno, "failed to fork()");
 
-  if (child_pid == 0)
+  if (pid == 0)
     {
       setpgid(0, 0);
+      // exec_all_with_timeout() blocks SIGALRM while starting commands.
+      sigset_t set;
+      sigemptyset(&set);
+      sigprocmask(SIG_SETMASK, &set, nullptr);
       // Close stdin so that children may not read our input.  We had
       // this nice surprise with Seminator, who greedily consumes its
       // stdin (which was also ours) even if it does not use it
@@ -840,6 +893,17 @@ exec_with_timeout(const char* cmd)
       return -1;
     }
 #endif
+  return pid;
+}
+
+int
+exec_with_timeout(const char* cmd)
+{
+  int status;
+
+  timed_out = false;
+
+  child_pid = spawn_command(cmd);
   alarm(timeout);
   // Upon SIGALRM, the child will receive up to 3
   // signals: SIGTERM, SIGTERM, SIGKILL.
@@ -853,6 +917,110 @@ exec_with_timeout(const char* cmd)
   alarm(0);
   return status;
 }
+
+// Arm the alarm for the earliest deadline of the running commands.
+// Must be called with SIGALRM blocked, or from sig_handler().
+static void
+arm_exec_alarm(time_t now)
+{
+  time_t next = 0;
+  for (unsigned i = 0; i < exec_slots_count; ++i)
+    if (exec_slots[i].pid > 0 && exec_slots[i].deadline
+        && (!next || exec_slots[i].deadline < next))
+      next = exec_slots[i].deadline;
+  alarm(next ? (next > now ? next - now : 1) : 0);
+}
+
+void
+exec_all_with_timeout(const std::vector<std::string>& cmds,
+                      unsigned max_running,
+                      std::vector<exec_result>& results)
+{
+  size_t n = cmds.size();
+  results.assign(n, exec_result());
+  if (n == 0)
+    return;
+  if (max_running == 0)
+    max_running = 1;
+  if (max_running > n)
+    max_running = n;
+
+  std::vector<exec_slot> slots(max_running);
+  std::vector<size_t> slot_cmd(max_running);
+  std::vector<std::chrono::steady_clock::time_point> slot_start(max_running);
+  sigset_t alrm;
+  sigemptyset(&alrm);
+  sigaddset(&alrm, SIGALRM);
+  sigprocmask(SIG_BLOCK, &alrm, nullptr);
+  exec_slots = slots.data();
+  exec_slots_count = max_running;
+
+  size_t next_cmd = 0;
+  unsigned running = 0;
+  while (next_cmd < n || running)
+    {
+      for (unsigned s = 0; s < max_running && next_cmd < n; ++s)
+        if (slots[s].pid <= 0)
+          {
+            slot_start[s] = std::chrono::steady_clock::now();
+            pid_t pid = spawn_command(cmds[next_cmd].c_str());
+            slots[s].deadline = timeout ? time(nullptr) + timeout : 0;
+            // Upon timeout, send SIGTERM, SIGTERM, and SIGKILL.
+            slots[s].signals_left = 3;
+            slots[s].timed_out = false;
+            slots[s].pid = pid;
+            slot_cmd[s] = next_cmd++;
+            ++running;
+          }
+      arm_exec_alarm(time(nullptr));
+
+      sigprocmask(SIG_UNBLOCK, &alrm, nullptr);
+      int status;
+      pid_t w = waitpid(-1, &status, 0);
+      int err = errno;
+      sigprocmask(SIG_BLOCK, &alrm, nullptr);
+      if (w == -1)
+        {
+          if (err == EINTR)
+            continue;
+          error(2, err, "error during wait()");
+        }
+      for (unsigned s = 0; s < max_running; ++s)
+        if (slots[s].pid == w)
+          {
+            exec_result& r = results[slot_cmd[s]];
+            r.status = status;
+            r.timed_out = slots[s].timed_out;
+            std::chrono::duration<double> d =
+              std::chrono::steady_clock::now() - slot_start[s];
+            r.walltime = d.count();
+            slots[s].pid = 0;
+            --running;
+            break;
+          }
+    }
+
+  alarm(0);
+  exec_slots = nullptr;
+  exec_slots_count = 0;
+  sigprocmask(SIG_UNBLOCK, &alrm, nullptr);
+}
+#else // !ENABLE_TIMEOUT
+void
+exec_all_with_timeout(const std::vector<std::string>& cmds, unsigned,
+                      std::vector<exec_result>& results)
+{
+  size_t n = cmds.size();
+  results.assign(n, exec_result());
+  for (size_t i = 0; i < n; ++i)
+    {
+      auto start = std::chrono::steady_clock::now();
+      results[i].status = system(cmds[i].c_str());
+      std::chrono::duration<double> d =
+        std::chrono::steady_clock::now() - start;
+      results[i].walltime = d.count();
+    }
+}
 #endif // ENABLE_TIMEOUT
 
 enum {
@@ -114,6 +114,9 @@ struct printable_result_filename final:
   ~printable_result_filename();
   void reset(unsigned n);
   void cleanup();
+  // Give up the ownership of the output file, so that another
+  // command can be formatted before this one is run.
+  spot::temporary_file* release();
 
   void print(std::ostream& os, const char* pos) const override;
 };
@@ -167,6 +170,22 @@ public:
 
 extern volatile bool timed_out;
 extern unsigned timeout_count;
+
+struct exec_result
+{
+  int status = 0;               // as returned by waitpid()
+  bool timed_out = false;
+  double walltime = 0.0;        // in seconds
+};
+
+// Run all commands in CMDS, with at most MAX_RUNNING of them at the
+// same time, and fill RESULTS (one entry per command).  Each command
+// is subject to the --timeout setting.  The commands are started in
+// order.
+void exec_all_with_timeout(const std::vector<std::string>& cmds,
+                           unsigned max_running,
+                           std::vector<exec_result>& results);
+
 #if ENABLE_TIMEOUT
 void setup_sig_handler();
 int exec_with_timeout(const char* cmd);
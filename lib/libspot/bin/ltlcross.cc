@@ -21,6 +21,7 @@
 #include "common_sys.hh"
 
 #include <string>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
@@ -41,6 +42,7 @@
 #include "common_hoaread.hh"
 #include "common_aoutput.hh"
 #include "common_color.hh"
+#include "common_parallel.hh"
 #include <spot/parseaut/public.hh>
 #include <spot/tl/print.hh>
 #include <spot/tl/apcollect.hh>
@@ -96,6 +98,7 @@ enum {
   OPT_NOCHECKS,
   OPT_NOCOMP,
   OPT_OMIT,
+  OPT_PARALLEL,
   OPT_PRODUCTS,
   OPT_REFERENCE,
   OPT_SEED,
@@ -140,6 +143,10 @@ static const argp_option options[] =
       " but do not flag this as an error", 0 },
     { "fail-on-timeout", OPT_FAIL_ON_TIMEOUT, nullptr, 0,
       "consider timeouts as errors", 0 },
+    { "parallel", OPT_PARALLEL, "N", 0,
+      "run up to N translators at the same time, and check the "
+      "emptiness of products using N processes; the output does not "
+      "depend on N", 0 },
     /**************************************************/
     { nullptr, 0, nullptr, 0, "State-space generation:", 6 },
     { "states", OPT_STATES, "INT", 0,
@@ -229,6 +236,7 @@ static bool fail_on_timeout = false;
 static bool opt_automata = false;
 static bool opt_strength = false;
 static bool opt_ambiguous = false;
+static unsigned parallel_jobs = 1;
 
 static bool global_error_flag = false;
 static unsigned oom_count = 0U;
@@ -526,6 +534,9 @@ parse_opt(int key, char* arg, struct argp_state*)
     case OPT_OMIT:
       opt_omit = true;
       break;
+    case OPT_PARALLEL:
+      parallel_jobs = to_pos_int(arg, "--parallel");
+      break;
     case OPT_PRODUCTS:
       if (*arg == '+')
         {
@@ -572,26 +583,85 @@ namespace
     {
     }
 
-    spot::twa_graph_ptr
-    translate(unsigned int translator_num, char l, statistics_formula* fstats,
-              bool& problem)
+    // A translation whose command has been formatted, but not yet
+    // run.  It owns the output file of the command.
+    struct translation
+    {
+      unsigned translator_num;
+      char l;
+      std::string cmd;
+      spot::temporary_file* output;
+    };
+
+    translation
+    prepare(unsigned int translator_num, char l)
     {
       output.reset(translator_num);
 
       std::ostringstream command;
       format(command, tools[translator_num].cmd);
+      return { translator_num, l, command.str(), output.release() };
+    }
 
-      std::string cmd = command.str();
-      auto disp_cmd = [&]() {
-                        std::cerr << "Running [" << l << translator_num
-                                  << "]: " << cmd << '\n';
-                      };
+    spot::twa_graph_ptr
+    translate(unsigned int translator_num, char l, statistics_formula* fstats,
+              bool& problem)
+    {
+      translation t = prepare(translator_num, l);
       if (!quiet)
-        disp_cmd();
+        display_command(t);
       spot::process_timer timer;
       timer.start();
-      int es = exec_with_timeout(cmd.c_str());
+      int es = exec_with_timeout(t.cmd.c_str());
       timer.stop();
+      return result(t, es, timed_out, timer.walltime(), fstats, problem);
+    }
+
+    // Run the translations in TODO, with up to JOBS of them at the
+    // same time, and store their results in RES, in the same order.
+    // Return the number of problems encountered.
+    int
+    translate_all(std::vector<translation>& todo, unsigned jobs,
+                  std::vector<statistics_formula*>& fstats,
+                  std::vector<spot::twa_graph_ptr>& res)
+    {
+      std::vector<std::string> cmds;
+      cmds.reserve(todo.size());
+      for (auto& t: todo)
+        {
+          if (!quiet)
+            display_command(t);
+          cmds.push_back(t.cmd);
+        }
+      std::vector<exec_result> er;
+      exec_all_with_timeout(cmds, jobs, er);
+      int problems = 0;
+      res.resize(todo.size());
+      for (size_t i = 0; i < todo.size(); ++i)
+        {
+          bool prob;
+          res[i] = result(todo[i], er[i].status, er[i].timed_out,
+                          er[i].walltime, fstats[i], prob);
+          problems += prob;
+        }
+      return problems;
+    }
+
+  private:
+    static void
+    display_command(const translation& t)
+    {
+      std::cerr << "Running [" << t.l << t.translator_num
+                << "]: " << t.cmd << '\n';
+    }
+
+    // Process the output of a translation, once it has run.
+    spot::twa_graph_ptr
+    result(translation& t, int es, bool timed_out, double walltime,
+           statistics_formula* fstats, bool& problem)
+    {
+      unsigned translator_num = t.translator_num;
+      auto disp_cmd = [&]() { display_command(t); };
       const char* status_str = nullptr;
 
       spot::twa_graph_ptr res = nullptr;
@@ -653,7 +723,7 @@ namespace
           problem = false;
           es = 0;
 
-          auto aut = spot::parse_aut(output.val()->name(), dict,
+          auto aut = spot::parse_aut(t.output->name(), dict,
                                      spot::default_environment::instance(),
                                      opt_parse);
           if (!aut->errors.empty())
@@ -691,7 +761,7 @@ namespace
           statistics* st = &(*fstats)[translator_num];
           st->status_str = status_str;
           st->status_code = es;
-          st->time = timer.walltime();
+          st->time = walltime;
 
           // Compute statistics.
           if (res)
@@ -746,7 +816,8 @@ namespace
                 }
             }
         }
-      output.cleanup();
+      delete t.output;
+      t.output = nullptr;
       return res;
     }
   };
@@ -1093,12 +1164,23 @@ namespace
       pstats->resize(m);
       formulas.push_back(fstr);
 
+      // With --parallel, the commands are only formatted here, and
+      // all of them are run together once the negative formula has
+      // been formatted as well.
+      std::vector<xtranslator_runner::translation> todo;
+      std::vector<statistics_formula*> todo_stats;
       for (size_t n = 0; n < m; ++n)
-        {
-          bool prob;
-          pos[n] = runner.translate(n, 'P', pstats, prob);
-          problems += prob;
-        }
+        if (parallel_jobs > 1)
+          {
+            todo.push_back(runner.prepare(n, 'P'));
+            todo_stats.push_back(pstats);
+          }
+        else
+          {
+            bool prob;
+            pos[n] = runner.translate(n, 'P', pstats, prob);
+            problems += prob;
+          }
 
       // ---------- Negative Formula ----------
 
@@ -1124,11 +1206,30 @@ namespace
           runner.round_formula(nf, round);
           formulas.push_back(runner.formula());
 
+          for (size_t n = 0; n < m; ++n)
+            if (parallel_jobs > 1)
+              {
+                todo.push_back(runner.prepare(n, 'N'));
+                todo_stats.push_back(nstats);
+              }
+            else
+              {
+                bool prob;
+                neg[n] = runner.translate(n, 'N', nstats, prob);
+                problems += prob;
+              }
+        }
+
+      if (!todo.empty())
+        {
+          std::vector<spot::twa_graph_ptr> res;
+          problems += runner.translate_all(todo, parallel_jobs,
+                                           todo_stats, res);
           for (size_t n = 0; n < m; ++n)
             {
-              bool prob;
-              neg[n] = runner.translate(n, 'N', nstats, prob);
-              problems += prob;
+              pos[n] = res[n];
+              if (!no_checks)
+                neg[n] = res[m + n];
             }
         }
 
@@ -1373,7 +1474,20 @@ namespace
                           << "correct and used as references\n";
             }
 
-          // intersection test
+          // intersection test.  The products are independent, so
+          // collect them first, and run them with --parallel.
+          std::vector<std::function<bool()>> checks;
+          auto check = [&](const spot::twa_graph_ptr& aut_i,
+                           const spot::twa_graph_ptr& aut_j,
+                           size_t i, size_t j, bool icomp, bool jcomp)
+            {
+              checks.emplace_back([=]()
+                                  {
+                                    return check_empty_prod(aut_i, aut_j,
+                                                            i, j,
+                                                            icomp, jcomp);
+                                  });
+            };
           for (size_t i = 0; i < m; ++i)
             if (pos[i])
               for (size_t j = 0; j < m; ++j)
@@ -1391,8 +1505,7 @@ namespace
                           || (!tools[j].reference &&
                               smallest_pos_ref >= 0 &&
                               (size_t)smallest_pos_ref != i)))
-                      problems +=
-                        check_empty_prod(pos[i], neg[j], i, j, false, false);
+                      check(pos[i], neg[j], i, j, false, false);
 
                     // Deal with the extra complemented automata if we
                     // have some.
@@ -1411,20 +1524,25 @@ namespace
 
                     if (i != j && comp_pos[j] && !comp_neg[j])
                       if (smallest_pos_ref < 0 || i == (size_t)smallest_pos_ref)
-                        problems +=
-                          check_empty_prod(pos[i], comp_pos[j],
-                                           i, j, false, true);
+                        check(pos[i], comp_pos[j], i, j, false, true);
                     if (i != j && comp_neg[i] && !comp_pos[i])
                       if (smallest_neg_ref < 0 || j == (size_t)smallest_neg_ref)
-                        problems +=
-                          check_empty_prod(comp_neg[i], neg[j],
-                                           i, j, true, false);
+                        check(comp_neg[i], neg[j], i, j, true, false);
                     if (comp_pos[i] && comp_neg[j] &&
                         (i == j || (!comp_neg[i] && !comp_pos[j])))
-                      problems +=
-                        check_empty_prod(comp_neg[j], comp_pos[i],
-                                         j, i, true, true);
+                      check(comp_neg[j], comp_pos[i], j, i, true, true);
                   }
+          std::vector<bool> nonempty =
+            parallel_tasks(checks.size(), parallel_jobs,
+                           [&](unsigned k) { return checks[k](); });
+          for (bool ne: nonempty)
+            if (ne)
+              {
+                // In a worker process, check_empty_prod() could not
+                // set the flag for us.
+                global_error_flag = true;
+                ++problems;
+              }
         }
       else
         {
@@ -32,6 +32,7 @@
 #include "common_output.hh"
 #include "common_cout.hh"
 #include "common_conv.hh"
+#include "common_parallel.hh"
 #include "common_r.hh"
 #include "common_range.hh"
 
@@ -270,6 +271,7 @@ const struct argp_child children[] =
   {
     { &finput_argp, 0, nullptr, 1 },
     { &output_argp, 0, nullptr, 0 },
+    { &parallel_argp, 0, nullptr, 0 },
     { &misc_argp, 0, nullptr, 0 },
     { nullptr, 0, nullptr, 0 }
   };
@@ -573,6 +575,11 @@ namespace
                    const char* filename = nullptr, int linenum = 0) override
     {
       spot::parsed_formula pf = parse_formula(input);
+      // Workers parse all formulas, so that the operands of
+      // commutative operators are usually ordered as in a sequential
+      // run (this order depends on when subformulas were created).
+      if (!parallel_take_item())
+        return 0;
 
       if (!pf.f || !pf.errors.empty())
           {
@@ -806,9 +813,24 @@ namespace
           one_match = true;
           output_formula_checked(f, &timer, filename, linenum, prefix, suffix);
           ++match_count;
+          parallel_matched(unique ? str_psl(f) : std::string());
         }
       return 0;
     }
+
+    bool
+    parallel_merge(const std::string& key) override
+    {
+      // The printed formula depends on the worker that produced it,
+      // so compare the formulas parsed back.
+      if (unique && !unique_set.insert(spot::parse_formula(key)).second)
+        return false;
+      one_match = true;
+      ++match_count;
+      if (opt_max_count >= 0 && match_count >= opt_max_count)
+        abort_run = true;
+      return true;
+    }
   };
 }
 
@@ -830,6 +852,11 @@ main(int argc, char** argv)
       if (jobs.empty())
         jobs.emplace_back("-", 1);
 
+      if (parallel_workers > 1 && opt->output_define
+          && &opt->output_define->ostream() != &std::cout)
+        error(2, 0, "options --define=FILENAME and --parallel "
+              "are incompatible");
+
       if (boolean_to_isop && simplification_level == 0)
         simplification_level = 1;
       spot::tl_simplifier_options tlopt(simplification_level);
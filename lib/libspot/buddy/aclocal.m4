@@ -1165,3 +1165,4 @@ m4_include([m4/ltversion.m4])
 m4_include([m4/lt~obsolete.m4])
 m4_include([m4/ndebug.m4])
 m4_include([m4/symbolic.m4])
+m4_include([m4/threadlib.m4])
@@ -128,6 +128,153 @@ void test1()
 }
 
 
+/**************************************************************************
+  Check that results cached before a reordering are not returned after
+  it.  Sifting frees nodes and reuses them for other functions, so every
+  result is compared with a truth table computed from the operands.
+**************************************************************************/
+
+typedef unsigned truthtable;	// one bit per assignment of the varnum vars
+
+static truthtable tt_of(bdd x)
+{
+  // Walk the nodes directly: this does not go through the caches.
+  truthtable t = 0;
+  for (int i=0 ; i<(1<<varnum) ; ++i)
+  {
+    bdd n = x;
+    while (n != bddtrue && n != bddfalse)
+      n = ((i >> bdd_var(n)) & 1) ? bdd_high(n) : bdd_low(n);
+    if (n == bddtrue)
+      t |= 1u << i;
+  }
+  return t;
+}
+
+static truthtable tt_var(int v)
+{
+  truthtable t = 0;
+  for (int i=0 ; i<(1<<varnum) ; ++i)
+    if ((i >> v) & 1)
+      t |= 1u << i;
+  return t;
+}
+
+static truthtable tt_exist(truthtable t, int v)
+{
+  truthtable m = tt_var(v);
+  truthtable pos = t & m;
+  truthtable neg = t & ~m;
+  truthtable q = (pos >> (1 << v)) | neg;
+  return q | (q << (1 << v));
+}
+
+static const int poolsize = 16;
+static const int opnum = 400;
+
+struct test2_op
+{
+  int kind, a, b, c, v;
+};
+
+static bdd pool[poolsize];
+static truthtable pooltt[poolsize];
+
+static truthtable test2_expected(const test2_op& o)
+{
+  truthtable a = pooltt[o.a], b = pooltt[o.b], c = pooltt[o.c];
+  switch (o.kind)
+  {
+  case 0: return a & b;
+  case 1: return a | b;
+  case 2: return a ^ b;
+  case 3: return ~a | b;
+  case 4: return (a & b) | (~a & c);
+  case 5: return tt_exist(a, o.v);
+  default: return tt_exist(a & b, o.v);
+  }
+}
+
+static bdd test2_apply(const test2_op& o)
+{
+  bdd a = pool[o.a], b = pool[o.b], c = pool[o.c];
+  switch (o.kind)
+  {
+  case 0: return a & b;
+  case 1: return a | b;
+  case 2: return a ^ b;
+  case 3: return a >> b;
+  case 4: return bdd_ite(a, b, c);
+  case 5: return bdd_exist(a, bdd_ithvar(o.v));
+  default: return bdd_appex(a, b, bddop_and, bdd_ithvar(o.v));
+  }
+}
+
+static int test2_run(const test2_op* ops)
+{
+  int errors = 0;
+  truthtable all = ~0u >> (32 - (1<<varnum));
+
+  // Results are not kept, so their nodes can be freed and reused.
+  for (int n=0 ; n<opnum ; ++n)
+    if (tt_of(test2_apply(ops[n])) != (test2_expected(ops[n]) & all))
+      ++errors;
+  return errors;
+}
+
+int test2()
+{
+  using namespace std ;
+  int errors = 0;
+
+  bdd_gbc_hook(NULL);
+  bdd_varblockall();
+
+  for (int round=0 ; round<20 ; ++round)
+  {
+    for (int i=0 ; i<poolsize ; ++i)
+    {
+      bdd x = bddfalse;
+      for (int j=0 ; j<4 ; ++j)
+      {
+	bdd term = bddtrue;
+	for (int v=0 ; v<varnum ; ++v)
+	  if (rand() % 3 == 0)
+	    term &= rand() % 2 ? bdd_ithvar(v) : bdd_nithvar(v);
+	x |= term;
+      }
+      pool[i] = x;
+      pooltt[i] = tt_of(x);
+    }
+
+    test2_op ops[opnum];
+    for (int n=0 ; n<opnum ; ++n)
+    {
+      ops[n].kind = rand() % 7;
+      ops[n].a = rand() % poolsize;
+      ops[n].b = rand() % poolsize;
+      ops[n].c = rand() % poolsize;
+      ops[n].v = rand() % varnum;
+    }
+
+    errors += test2_run(ops);
+    bdd_reorder(BDD_REORDER_SIFT);
+    // The same operations again: they hit the entries cached above.
+    errors += test2_run(ops);
+  }
+
+  for (int i=0 ; i<poolsize ; ++i)
+    pool[i] = bddfalse;
+
+  cout << "Checking results cached before reordering: ";
+  if (errors == 0)
+    cout << "Reorder-OK.\n";
+  else
+    cout << errors << " Reorder-ERROR.\n";
+  return errors;
+}
+
+
 /**************************************************************************
   Main
 **************************************************************************/
@@ -138,8 +285,13 @@ int main()
   bdd_setvarnum(varnum);
 
   test1();
+  int errors = test2();
+
+  // Release the static BDDs before their destructors run after bdd_done().
+  allsatBDD = bddfalse;
+  allsatSumBDD = bddfalse;
 
   bdd_done();
 
-  return 0;
+  return errors != 0;
 }
@@ -47,7 +47,7 @@ static int  bdd_loaddata(FILE *);
 static int  loadhash_get(int);
 static void loadhash_add(int, int);
 
-static bddfilehandler filehandler;
+static BUDDY_TLS bddfilehandler filehandler;
 
 typedef struct s_LoadHash
 {
@@ -57,10 +57,10 @@ typedef struct s_LoadHash
    int next;
 } LoadHash;
 
-static LoadHash *lh_table;
-static int       lh_freepos;
-static int       lh_nodenum;
-static int      *loadvar2level;
+static BUDDY_TLS LoadHash *lh_table;
+static BUDDY_TLS int       lh_freepos;
+static BUDDY_TLS int       lh_nodenum;
+static BUDDY_TLS int      *loadvar2level;
 
 /*=== PRINTING ========================================================*/
 
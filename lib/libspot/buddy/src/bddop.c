@@ -41,6 +41,7 @@
 
 #include "kernel.h"
 #include "cache.h"
+#include "prime.h"
 
    /* Hash value modifiers to distinguish between entries in misccache */
 #define CACHEID_CONSTRAIN   0x0
@@ -92,40 +93,43 @@ static int oprres[OPERATOR_NUM][4] =
 
 
    /* Variables needed for the operators */
-static int applyop;                 /* Current operator for apply */
-static int appexop;                 /* Current operator for appex */
-static int appexid;                 /* Current cache id for appex */
-static int quantid;                 /* Current cache id for quantifications */
-static int *quantvarset;            /* Current variable set for quant. */
-static int quantvarsetcomp;         /* Should quantvarset be complemented?  */
-static int quantvarsetID;           /* Current id used in quantvarset */
-static int quantlast;               /* Current last variable to be quant. */
-static int replaceid;               /* Current cache id for replace */
-static int *replacepair;            /* Current replace pair */
-static int replacelast;             /* Current last var. level to replace */
-static int composelevel;            /* Current variable used for compose */
-static int miscid;                  /* Current cache id for other results */
-static int *varprofile;             /* Current variable profile */
-static int supportID;               /* Current ID (true value) for support */
-static int supportMin;              /* Min. used level in support calc. */
-static int supportMax;              /* Max. used level in support calc. */
-static int* supportSet;             /* The found support set */
-static BddCache applycache;         /* Cache for apply results */
-static BddCache itecache;           /* Cache for ITE results */
-static BddCache quantcache;         /* Cache for exist/forall results */
-static BddCache appexcache;         /* Cache for appex/appall results */
-static BddCache replacecache;       /* Cache for replace results */
-static BddCache misccache;          /* Cache for other results */
-static int cacheratio;
-static BDD satPolarity;
-static int firstReorder;            /* Used instead of local variable in order
+static BUDDY_TLS int applyop;                 /* Current operator for apply */
+static BUDDY_TLS int appexop;                 /* Current operator for appex */
+static BUDDY_TLS int appexid;                 /* Current cache id for appex */
+static BUDDY_TLS int quantid;                 /* Current cache id for quantifications */
+static BUDDY_TLS int *quantvarset;            /* Current variable set for quant. */
+static BUDDY_TLS int quantvarsetcomp;         /* Should quantvarset be complemented?  */
+static BUDDY_TLS int quantvarsetID;           /* Current id used in quantvarset */
+static BUDDY_TLS int quantlast;               /* Current last variable to be quant. */
+static BUDDY_TLS int replaceid;               /* Current cache id for replace */
+static BUDDY_TLS int *replacepair;            /* Current replace pair */
+static BUDDY_TLS int replacelast;             /* Current last var. level to replace */
+static BUDDY_TLS int composelevel;            /* Current variable used for compose */
+static BUDDY_TLS int miscid;                  /* Current cache id for other results */
+static BUDDY_TLS int *varprofile;             /* Current variable profile */
+static BUDDY_TLS int supportID;               /* Current ID (true value) for support */
+static BUDDY_TLS int supportMin;              /* Min. used level in support calc. */
+static BUDDY_TLS int supportMax;              /* Max. used level in support calc. */
+static BUDDY_TLS int* supportSet;             /* The found support set */
+static BUDDY_TLS BddCache applycache;         /* Cache for apply results */
+static BUDDY_TLS BddCache itecache;           /* Cache for ITE results */
+static BUDDY_TLS BddCache quantcache;         /* Cache for exist/forall results */
+static BUDDY_TLS BddCache appexcache;         /* Cache for appex/appall results */
+static BUDDY_TLS BddCache replacecache;       /* Cache for replace results */
+static BUDDY_TLS BddCache misccache;          /* Cache for other results */
+static BUDDY_TLS int cacheratio;
+static BUDDY_TLS int cachebase;               /* Size of the caches at scale 0 */
+static BUDDY_TLS int cacheadaptive;           /* Adapt the cache sizes at GC? */
+static BUDDY_TLS int cacheresize;             /* Some cache must be resized */
+static BUDDY_TLS BDD satPolarity;
+static BUDDY_TLS int firstReorder;            /* Used instead of local variable in order
 				       to avoid compiler warning about 'first'
 				       being clobbered by setjmp */
 
-static signed char*     allsatProfile; /* Variable profile for bdd_allsat() */
-static bddallsathandler allsatHandler; /* Callback handler for bdd_allsat() */
+static BUDDY_TLS signed char*     allsatProfile; /* Variable profile for bdd_allsat() */
+static BUDDY_TLS bddallsathandler allsatHandler; /* Callback handler for bdd_allsat() */
 
-extern bddCacheStat bddcachestats;
+extern BUDDY_TLS bddCacheStat bddcachestats;
 
    /* Internal prototypes */
 static BDD    not_rec(BDD);
@@ -182,6 +186,10 @@ static int    varset2svartable(BDD);
 /* signed check */
 #define INSVARSET(a) (abs(quantvarset[a]) == quantvarsetID)
 
+   /* Bounds of BddCache.scale for adaptive caches. */
+#define CACHE_MINSCALE (-3)
+#define CACHE_MAXSCALE 3
+
 /*************************************************************************
   Setup and shutdown
 *************************************************************************/
@@ -209,6 +217,9 @@ int bdd_operator_init(int cachesize)
    quantvarsetID = 0;
    quantvarset = NULL;
    cacheratio = 0;
+   cachebase = cachesize;
+   cacheadaptive = 1;
+   cacheresize = 0;
    supportSet = NULL;
 
    return 0;
@@ -243,6 +254,26 @@ void bdd_operator_reset(void)
 }
 
 
+/* Called after a garbage collection instead of bdd_operator_reset():
+   only drop the entries that refer to freed nodes.  The b field of the
+   apply and replace caches is not a node for all operators, so some
+   valid entries may be dropped too.  The quant and appex caches are
+   cleared: their c field (quantid, appexid) encodes the node of the
+   variable set, shifted so that it cannot be recovered reliably, and
+   a freed variable set could be reused for another set.  The misc
+   cache also stores doubles, so it is cleared as well. */
+void bdd_operator_clean(void)
+{
+   BddCache_clean(&applycache, BDDCACHE_A | BDDCACHE_B | BDDCACHE_RES);
+   BddCache_clean(&itecache,
+		  BDDCACHE_A | BDDCACHE_B | BDDCACHE_C | BDDCACHE_RES);
+   BddCache_reset(&quantcache);
+   BddCache_reset(&appexcache);
+   BddCache_clean(&replacecache, BDDCACHE_A | BDDCACHE_B | BDDCACHE_RES);
+   BddCache_reset(&misccache);
+}
+
+
 void bdd_operator_varresize(void)
 {
    if (quantvarset != NULL)
@@ -256,18 +287,98 @@ void bdd_operator_varresize(void)
 }
 
 
+   /* The operator caches, in the order of bddStat.opcache. */
+static void bdd_operator_caches(BddCache **caches)
+{
+   caches[0] = &applycache;
+   caches[1] = &itecache;
+   caches[2] = &quantcache;
+   caches[3] = &appexcache;
+   caches[4] = &replacecache;
+   caches[5] = &misccache;
+}
+
+
+   /* Resize the caches to fit the cache ratio and their scale.  This
+      must not be called during a recursive operation, since the
+      operators keep pointers into the caches. */
 static void bdd_operator_noderesize(void)
 {
+   BddCache *caches[BDD_OPCACHENUM];
+   int n;
+
    if (cacheratio > 0)
    {
-      int newcachesize = bddnodesize / cacheratio;
-      BddCache_resize(&applycache, newcachesize);
-      BddCache_resize(&itecache, newcachesize);
-      BddCache_resize(&quantcache, newcachesize);
-      BddCache_resize(&appexcache, newcachesize);
-      BddCache_resize(&replacecache, newcachesize);
-      BddCache_resize(&misccache, newcachesize);
-      bddcachesize = misccache.tablesize;
+      cachebase = bddnodesize / cacheratio;
+      bddcachesize = bdd_nextpower(cachebase);
+   }
+   cacheresize = 0;
+
+   bdd_operator_caches(caches);
+   for (n=0 ; n<BDD_OPCACHENUM ; n++)
+   {
+      BddCache *cache = caches[n];
+      int size = cache->scale >= 0 ?
+	 cachebase << cache->scale : cachebase >> -cache->scale;
+
+      if ((int)bdd_nextpower(size) != cache->tablesize)
+	 BddCache_resize(cache, size);
+   }
+}
+
+
+/* Called by the garbage collector, before the caches are cleared.
+   Each cache whose entries were all replaced at least once since the
+   previous collection is doubled, and each cache that served fewer
+   lookups than a sixteenth of its entries is halved, within
+   CACHE_MINSCALE and CACHE_MAXSCALE of the base size.  The resizing
+   itself is done by the next top-level operator. */
+void bdd_operator_adapt(void)
+{
+   BddCache *caches[BDD_OPCACHENUM];
+   int n;
+
+   bdd_operator_caches(caches);
+   for (n=0 ; n<BDD_OPCACHENUM ; n++)
+   {
+      BddCache *cache = caches[n];
+      long unsigned int size = cache->tablesize;
+      long unsigned int access = cache->epochhit + cache->epochmiss;
+
+      if (cacheadaptive)
+      {
+	 if (cache->epochmiss > size  &&  cache->scale < CACHE_MAXSCALE
+	     &&  size * 2 <= (long unsigned int)bddnodesize)
+	 {
+	    cache->scale++;
+	    cacheresize = 1;
+	 }
+	 else if (access < size / 16  &&  cache->scale > CACHE_MINSCALE)
+	 {
+	    cache->scale--;
+	    cacheresize = 1;
+	 }
+      }
+
+      cache->hit += cache->epochhit;
+      cache->miss += cache->epochmiss;
+      cache->epochhit = 0;
+      cache->epochmiss = 0;
+   }
+}
+
+
+void bdd_operator_stats(bddStat *s)
+{
+   BddCache *caches[BDD_OPCACHENUM];
+   int n;
+
+   bdd_operator_caches(caches);
+   for (n=0 ; n<BDD_OPCACHENUM ; n++)
+   {
+      s->opcache[n].size = caches[n]->tablesize;
+      s->opcache[n].hit = caches[n]->hit + caches[n]->epochhit;
+      s->opcache[n].miss = caches[n]->miss + caches[n]->epochmiss;
    }
 }
 
@@ -307,13 +418,48 @@ int bdd_setcacheratio(int r)
 }
 
 
+/*
+NAME    {* bdd\_setcacheadaptive *}
+SECTION {* kernel *}
+SHORT   {* Enables or disables the adaptive sizing of the operator caches *}
+PROTO   {* int bdd_setcacheadaptive(int on) *}
+DESCR   {* When adaptive sizing is enabled (the default), each garbage
+	   collection doubles the operator caches that had more misses
+	   than entries since the previous collection, and halves those
+	   that were hardly used.  A cache never grows beyond eight
+	   times, nor shrinks below an eighth of, the size given by
+	   {\tt bdd\_init} or {\tt bdd\_setcacheratio}.  Disabling it
+	   brings all caches back to that size.  The hits and misses of
+	   each cache are reported by {\tt bdd\_stats}. *}
+RETURN  {* The previous setting. *}
+ALSO    {* bdd\_setcacheratio, bdd\_stats *}
+*/
+int bdd_setcacheadaptive(int on)
+{
+   int old = cacheadaptive;
+   cacheadaptive = on;
+
+   if (!on  &&  bddrunning)
+   {
+      BddCache *caches[BDD_OPCACHENUM];
+      int n;
+
+      bdd_operator_caches(caches);
+      for (n=0 ; n<BDD_OPCACHENUM ; n++)
+	 caches[n]->scale = 0;
+      bdd_operator_noderesize();
+   }
+   return old;
+}
+
+
 /*************************************************************************
   Operators
 *************************************************************************/
 
 static void checkresize(void)
 {
-   if (bddresized)
+   if (bddresized  ||  cacheresize)
       bdd_operator_noderesize();
    bddresized = 0;
 }
@@ -453,7 +599,7 @@ static BDD not_rec(BDD r)
    if (ISONE(r))
       return BDDZERO;
 
-   entry = BddCache_lookup(&applycache, NOTHASH(r));
+   entry = BddCache_lookup2(&applycache, NOTHASH(r), r, bddop_not);
 
    if (entry->i.a == r  &&  entry->i.c == bddop_not)
    {
@@ -683,7 +829,8 @@ static BDD apply_rec(BDD l, BDD r)
       res = oprres[applyop][l<<1 | r];
    else
    {
-      entry = BddCache_lookup(&applycache, APPLYHASH(l,r,applyop));
+      entry = BddCache_lookup3(&applycache, APPLYHASH(l,r,applyop),
+			       l, r, applyop);
 
       /* Check entry->c last, because not_rec() does not initialize it. */
       if (entry->i.a == l  &&  entry->i.c == applyop  &&  entry->i.b == r)
@@ -829,7 +976,7 @@ BDD bdd_setxor(BDD l, BDD r)
   if (ISONE(r))
     return l;
 
-   entry = BddCache_lookup(&misccache, SETXORHASH(l,r));
+   entry = BddCache_lookup3(&misccache, SETXORHASH(l,r), l, r, CACHEID_SETXOR);
    if (entry->i.a == l &&  entry->i.b == r  && entry->i.c == CACHEID_SETXOR)
    {
 #ifdef CACHESTATS
@@ -928,7 +1075,8 @@ int bdd_implies(BDD l, BDD r)
   if (ISONE(l) || ISZERO(r))
     return 0;
 
-  entry = BddCache_lookup(&misccache, IMPLIESHASH(l,r));
+  entry = BddCache_lookup3(&misccache, IMPLIESHASH(l,r),
+			   l, r, CACHEID_IMPLIES);
   /* Check entry->b last, because not_rec() does not initialize it. */
   if (entry->i.a == l && entry->i.c == CACHEID_IMPLIES && entry->i.b == r)
    {
@@ -1050,7 +1198,7 @@ static BDD ite_rec(BDD f, BDD g, BDD h)
    if (ISZERO(g) && ISONE(h))
       return not_rec(f);
 
-   entry = BddCache_lookup(&itecache, ITEHASH(f,g,h));
+   entry = BddCache_lookup3(&itecache, ITEHASH(f,g,h), f, g, h);
    if (entry->i.a == f  &&  entry->i.c == h && entry->i.b == g)
    {
 #ifdef CACHESTATS
@@ -1223,7 +1371,7 @@ static int restrict_rec(int r)
    if (ISCONST(r)  ||  LEVEL(r) > quantlast)
       return r;
 
-   entry = BddCache_lookup(&misccache, RESTRHASH(r,miscid));
+   entry = BddCache_lookup2(&misccache, RESTRHASH(r,miscid), r, miscid);
    if (entry->i.a == r  &&  entry->i.c == miscid)
    {
 #ifdef CACHESTATS
@@ -1324,7 +1472,7 @@ static BDD constrain_rec(BDD f, BDD c)
    if (ISZERO(c))
       return BDDZERO;
 
-   entry = BddCache_lookup(&misccache, CONSTRAINHASH(f,c));
+   entry = BddCache_lookup3(&misccache, CONSTRAINHASH(f,c), f, c, miscid);
    if (entry->i.a == f  &&  entry->i.b == c  &&  entry->i.c == miscid)
    {
 #ifdef CACHESTATS
@@ -1446,7 +1594,7 @@ static BDD replace_rec(BDD r)
    if (ISCONST(r)  ||  LEVEL(r) > replacelast)
       return r;
 
-   entry = BddCache_lookup(&replacecache, REPLACEHASH(r));
+   entry = BddCache_lookup2(&replacecache, REPLACEHASH(r), r, replaceid);
    if (entry->i.a == r  &&  entry->i.c == replaceid)
    {
 #ifdef CACHESTATS
@@ -1581,7 +1729,7 @@ static BDD compose_rec(BDD f, BDD g)
    if (LEVEL(f) > composelevel)
       return f;
 
-   entry = BddCache_lookup(&replacecache, COMPOSEHASH(f,g));
+   entry = BddCache_lookup3(&replacecache, COMPOSEHASH(f,g), f, g, replaceid);
    if (entry->i.a == f  &&  entry->i.b == g  &&  entry->i.c == replaceid)
    {
 #ifdef CACHESTATS
@@ -1700,7 +1848,7 @@ static BDD veccompose_rec(BDD f)
    if (LEVEL(f) > replacelast)
       return f;
 
-   entry = BddCache_lookup(&replacecache, VECCOMPOSEHASH(f));
+   entry = BddCache_lookup2(&replacecache, VECCOMPOSEHASH(f), f, replaceid);
    if (entry->i.a == f  &&  entry->i.c == replaceid)
    {
 #ifdef CACHESTATS
@@ -1791,7 +1939,8 @@ static BDD simplify_rec(BDD f, BDD d)
    if (ISZERO(d))
       return BDDZERO;
 
-   entry = BddCache_lookup(&applycache, APPLYHASH(f,d,bddop_simplify));
+   entry = BddCache_lookup3(&applycache, APPLYHASH(f,d,bddop_simplify),
+			    f, d, bddop_simplify);
 
    /* Check entry->b last, because not_rec() does not initialize it. */
    if (entry->i.a == f && entry->i.c == bddop_simplify && entry->i.b == d)
@@ -1996,7 +2145,7 @@ static int quant_rec(int r)
    if (r < 2  ||  LEVEL(r) > quantlast)
       return r;
 
-   entry = BddCache_lookup(&quantcache, QUANTHASH(r));
+   entry = BddCache_lookup2(&quantcache, QUANTHASH(r), r, quantid);
    if (entry->i.a == r && entry->i.c == quantid)
    {
 #ifdef CACHESTATS
@@ -2239,7 +2388,8 @@ static int appquant_rec(int l, int r)
    }
    else
    {
-      entry = BddCache_lookup(&appexcache, APPEXHASH(l,r,appexop));
+      entry = BddCache_lookup3(&appexcache, APPEXHASH(l,r,appexop),
+			       l, r, appexid);
       if (entry->i.a == l  && entry->i.c == appexid && entry->i.b == r)
       {
 #ifdef CACHESTATS
@@ -2311,7 +2461,7 @@ RETURN  {* A BDD variable set. *}
 BDD bdd_support(BDD r)
 {
    BddCacheData *entry;
-   static int  supportSize = 0;
+   static BUDDY_TLS int  supportSize = 0;
    int n;
    int res=1;
 
@@ -2321,7 +2471,7 @@ BDD bdd_support(BDD r)
    if (r < 2)
       return bddtrue;
 
-   entry = BddCache_lookup(&misccache, SUPPORTHASH(r));
+   entry = BddCache_lookup2(&misccache, SUPPORTHASH(r), r, CACHEID_SUPPORT);
    if (entry->i.a == r && entry->i.c == CACHEID_SUPPORT)
    {
 #ifdef CACHESTATS
@@ -2829,7 +2979,7 @@ static double satcount_rec(int root)
    if (root < 2)
       return root;
 
-   entry = BddCache_lookup(&misccache, SATCOUHASH(root));
+   entry = BddCache_lookup2(&misccache, SATCOUHASH(root), root, miscid);
    if (entry->d.a == root  &&  entry->d.c == miscid)
      return entry->d.res;
 
@@ -2915,7 +3065,7 @@ static double satcountln_rec(int root)
    if (root == 1)
       return 0.0;
 
-   entry = BddCache_lookup(&misccache, SATCOUHASH(root));
+   entry = BddCache_lookup2(&misccache, SATCOUHASH(root), root, miscid);
    if (entry->d.a == root && entry->d.c == miscid)
       return entry->d.res;
 
@@ -3081,7 +3231,7 @@ static double bdd_pathcount_rec(BDD r)
    if (ISONE(r))
       return 1.0;
 
-   entry = BddCache_lookup(&misccache, PATHCOUHASH(r));
+   entry = BddCache_lookup2(&misccache, PATHCOUHASH(r), r, miscid);
    if (entry->d.a == r  &&  entry->d.c == miscid)
       return entry->d.res;
 
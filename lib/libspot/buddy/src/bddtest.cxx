@@ -28,6 +28,7 @@
 ========================================================================*/
 
 #include <string>
+#include <vector>
 #include <cstdlib>
 #include "bddx.h"
 #include "bvecx.h"
@@ -97,6 +98,156 @@ void testBvecIte()
 }
 
 
+/* Sum of x(i) & x(i+5), which is smallest when the pairs are adjacent */
+static bdd pairs(void)
+{
+  bdd f = bddfalse;
+  for (int i=0 ; i<5 ; ++i)
+    f |= bdd_ithvar(i) & bdd_ithvar(i+5);
+  return f;
+}
+
+
+static int siftOrder(int threads, int deterministic, int* order)
+{
+  static int identity[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  bdd_clrvarblocks();
+  bdd_setvarorder(identity);
+  bdd_varblockall();
+  bdd_reorder_threads(threads);
+  bdd_reorder_deterministic(deterministic);
+
+  bdd f = pairs();
+  bdd_reorder(BDD_REORDER_SIFT);
+  if (f != pairs())
+    ERROR("Sifting changed the function");
+  for (int v=0 ; v<10 ; ++v)
+    order[v] = bdd_var2level(v);
+  return bdd_nodecount(f);
+}
+
+
+void testParallelSift()
+{
+  cout << "Testing parallel sifting\n";
+
+  int serial[10], det1[10], det3[10], par[10];
+  int size = siftOrder(1, 0, serial);
+  if (siftOrder(1, 1, det1) > size)
+    ERROR("Deterministic sifting found a larger BDD");
+  if (siftOrder(3, 1, det3) > size)
+    ERROR("Deterministic sifting found a larger BDD");
+  for (int v=0 ; v<10 ; ++v)
+    if (det1[v] != det3[v])
+      ERROR("Deterministic sifting depends on the number of threads");
+  if (siftOrder(3, 0, par) > size)
+    ERROR("Parallel sifting found a larger BDD");
+
+  bdd_reorder_threads(1);
+  bdd_reorder_deterministic(0);
+  bdd_clrvarblocks();
+}
+
+
+static vector<int> gbcFree;
+
+static void gbcRecord(int pre, bddGbcStat* s)
+{
+  if (!pre)
+    gbcFree.push_back(s->freenodes);
+}
+
+
+/* Truth table of a BDD over the first 10 variables */
+static string truthTable(bdd f)
+{
+  string res;
+  for (int a=0 ; a<1024 ; ++a)
+  {
+    bdd g = f;
+    while (g != bddtrue  &&  g != bddfalse)
+      g = (a >> bdd_var(g)) & 1 ? bdd_high(g) : bdd_low(g);
+    res += g == bddtrue ? '1' : '0';
+  }
+  return res;
+}
+
+
+/* Combine random BDDs, dropping most of the results, with a full
+   collection every 500 steps.  Return the truth tables of the BDDs
+   still alive at the end.  BuDDy is restarted so that all runs
+   start with the same node table. */
+static vector<string> churn(int generational)
+{
+  bdd_done();
+  bdd_init(1000,1000);
+  bdd_setvarnum(10);
+  bdd_setgenerational(generational);
+  bddgbchandler old = bdd_gbc_hook(gbcRecord);
+  gbcFree.clear();
+
+  unsigned seed = 1;
+  vector<bdd> live(30, bddfalse);
+  for (int n=1 ; n<=20000 ; ++n)
+  {
+    seed = seed * 1103515245 + 12345;
+    unsigned r = seed >> 8;
+    bdd& dst = live[r % 30];
+    bdd a = live[(r >> 5) % 30];
+    bdd b = live[(r >> 10) % 30];
+    switch ((r >> 15) % 5)
+    {
+    case 0:
+      dst = bdd_ithvar((r >> 18) % 10);
+      break;
+    case 1:
+      dst = a & !b;
+      break;
+    case 2:
+      dst = a | b;
+      break;
+    default:
+      dst = a ^ b ^ bdd_ithvar((r >> 18) % 10);
+      break;
+    }
+    if (n % 500 == 0)
+      bdd_gbc();
+  }
+
+  vector<string> res;
+  for (bdd& f : live)
+    res.push_back(truthTable(f));
+  live.clear();
+  bdd_gbc();
+  bdd_gbc_hook(old);
+  bdd_setgenerational(0);
+  return res;
+}
+
+
+void testGenerational()
+{
+  cout << "Testing generational garbage collection\n";
+
+  vector<string> major = churn(0);
+  vector<int> majorFree = gbcFree;
+  vector<string> minor = churn(1);
+
+  if (minor != major)
+    ERROR("Minor collections changed live BDDs");
+  /* The workload is deterministic, so the collections can only
+   * differ if some of them were minor, leaving the old dead nodes
+   * for the next full collection.  Minor collections are not
+   * available with BUDDY_OPEN_HASH. */
+  bdd_setgenerational(1);
+  if (bdd_setgenerational(0)  &&  gbcFree == majorFree)
+    ERROR("No minor collection took place");
+  /* 40 of them are the explicit full collections */
+  if (gbcFree.size() < 50)
+    ERROR("Too few garbage collections");
+}
+
+
 int main(int ac, char** av)
 {
   bdd_init(1000,1000);
@@ -105,6 +256,8 @@ int main(int ac, char** av)
 
   testSupport();
   testBvecIte();
+  testParallelSift();
+  testGenerational();
 
   bdd_done();
   return 0;
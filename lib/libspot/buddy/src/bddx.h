@@ -130,6 +130,17 @@ typedef struct s_bddPair
 
 /*=== Status information ===============================================*/
 
+   /* Number of operator caches: apply, ite, quant, appex, replace,
+      and misc. */
+#define BDD_OPCACHENUM 6
+
+typedef struct s_bddOpCacheStat
+{
+   int size;
+   long unsigned int hit;
+   long unsigned int miss;
+} bddOpCacheStat;
+
 /*
 NAME    {* bddStat *}
 SECTION {* kernel *}
@@ -143,7 +154,9 @@ PROTO   {* typedef struct s_bddStat
    int minfreenodes;
    int varnum;
    int cachesize;
+   int hashsize;
    int gbcnum;
+   bddOpCacheStat opcache[BDD_OPCACHENUM];
 } bddStat;  *}
 DESCR   {* The fields are \\[\baselineskip] \begin{tabular}{lp{10cm}}
   {\tt produced}     & total number of new nodes ever produced \\
@@ -155,7 +168,9 @@ DESCR   {* The fields are \\[\baselineskip] \begin{tabular}{lp{10cm}}
   {\tt varnum}       & number of defined bdd variables \\
   {\tt cachesize}    & number of entries in the internal caches \\
   {\tt hashsize}     & number of entries in the node hash table \\
-  {\tt gbcnum}       & number of garbage collections done until now
+  {\tt gbcnum}       & number of garbage collections done until now \\
+  {\tt opcache}      & size, hits, and misses of the apply, ite, quant,
+		       appex, replace, and misc operator caches
   \end{tabular} *}
 ALSO    {* bdd\_stats *}
 */
@@ -170,6 +185,7 @@ typedef struct s_bddStat
    int cachesize;
    int hashsize;
    int gbcnum;
+   bddOpCacheStat opcache[BDD_OPCACHENUM];
 } bddStat;
 
 
@@ -285,6 +301,7 @@ BUDDY_API void     bdd_done(void);
 BUDDY_API int      bdd_setvarnum(int);
 BUDDY_API int      bdd_extvarnum(int);
 BUDDY_API int      bdd_isrunning(void) __purefn;
+BUDDY_API int      bdd_isthreadlocal(void) __constfn;
 BUDDY_API int      bdd_setmaxnodenum(int);
 BUDDY_API int      bdd_setmaxincrease(int);
 BUDDY_API int      bdd_setminfreenodes(int);
@@ -316,6 +333,7 @@ BUDDY_API BDD      bdd_addref(BDD);
 BUDDY_API BDD      bdd_delref_nc(BDD);
 BUDDY_API BDD      bdd_delref(BDD);
 BUDDY_API void     bdd_gbc(void);
+BUDDY_API int      bdd_setgenerational(int);
 BUDDY_API int      bdd_scanset(BDD, int**, int*);
 BUDDY_API BDD      bdd_makeset(int *, int);
 BUDDY_API bddPair* bdd_copypair(bddPair*);
@@ -331,6 +349,7 @@ BUDDY_API void     bdd_freepair(bddPair*);
   /* In bddop.c */
 
 BUDDY_API int      bdd_setcacheratio(int);
+BUDDY_API int      bdd_setcacheadaptive(int);
 BUDDY_API BDD      bdd_buildcube(int, int, BDD *);
 BUDDY_API BDD      bdd_ibuildcube(int, int, int *);
 BUDDY_API BDD      bdd_not(BDD);
@@ -414,6 +433,8 @@ BUDDY_API int      bdd_getreorder_method(void) __purefn;
 BUDDY_API void     bdd_enable_reorder(void);
 BUDDY_API void     bdd_disable_reorder(void);
 BUDDY_API int      bdd_reorder_verbose(int);
+BUDDY_API int      bdd_reorder_threads(int);
+BUDDY_API int      bdd_reorder_deterministic(int);
 BUDDY_API void     bdd_setvarorder(int *);
 BUDDY_API void     bdd_printorder(void);
 BUDDY_API void     bdd_fprintorder(FILE *);
@@ -52,9 +52,11 @@ void BddCache_reset(BddCache *cache)
 }
 
 
-int BddCache_init(BddCache *cache, int size)
+static int BddCache_alloc(BddCache *cache, int size)
 {
    size = bdd_nextpower(size);
+   if (size < BDDCACHE_WAYS)
+      size = BDDCACHE_WAYS;
 
    if ((cache->table=NEW(BddCacheData,size)) == NULL)
       return bdd_error(BDD_MEMORY);
@@ -65,6 +67,42 @@ int BddCache_init(BddCache *cache, int size)
 }
 
 
+   /* Nodes that are not in use.  Fields that do not hold a node for
+      every entry (b of not_rec(), replace_rec(), ...) may hold anything,
+      hence the range check. */
+#define DEADNODE(n) ((unsigned)(n) >= (unsigned)bddnodesize  ||  LOW(n) == -1)
+
+/* Invalidate the entries that refer to a free node, after a garbage
+   collection.  FIELDS tells which fields (BDDCACHE_A, ...) hold
+   nodes.  The other entries stay valid, since live nodes are never
+   changed or moved. */
+void BddCache_clean(BddCache *cache, int fields)
+{
+  int n;
+  for (n = 0; n < cache->tablesize; n++)
+  {
+    BddCacheData *entry = &cache->table[n];
+
+    if (entry->i.a < 0)
+      continue;
+    if (((fields & BDDCACHE_A) && DEADNODE(entry->i.a))
+	|| ((fields & BDDCACHE_B) && DEADNODE(entry->i.b))
+	|| ((fields & BDDCACHE_C) && DEADNODE(entry->i.c))
+	|| ((fields & BDDCACHE_RES) && DEADNODE(entry->i.res)))
+      entry->i.a = -1;
+  }
+}
+
+
+int BddCache_init(BddCache *cache, int size)
+{
+   cache->scale = 0;
+   cache->hit = cache->miss = 0;
+   cache->epochhit = cache->epochmiss = 0;
+   return BddCache_alloc(cache, size);
+}
+
+
 void BddCache_done(BddCache *cache)
 {
    free(cache->table);
@@ -73,10 +111,11 @@ void BddCache_done(BddCache *cache)
 }
 
 
+   /* Resizing drops the cached entries, but keeps the counters. */
 int BddCache_resize(BddCache *cache, int newsize)
 {
    free(cache->table);
-   return BddCache_init(cache, newsize);
+   return BddCache_alloc(cache, newsize);
 }
 
 
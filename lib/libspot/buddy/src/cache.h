@@ -39,6 +39,14 @@
 #define _CACHE_H
 
 
+   /* Number of entries per set of the operator caches.  A lookup
+      compares the keys of all the entries of a set, and a miss
+      evicts the least recently used entry of the set.  Each entry
+      takes 16 bytes, so up to 4 ways fit in one cache line. */
+#ifndef BDDCACHE_WAYS
+# define BDDCACHE_WAYS 2
+#endif
+
 typedef union
 {
   struct {
@@ -57,7 +65,13 @@ typedef union
 typedef struct
 {
    BddCacheData *table;
-   int tablesize;               /* a power of 2 */
+   int tablesize;               /* a power of 2, at least BDDCACHE_WAYS */
+   int scale;                   /* log2 of the size relative to the
+				   base size, set by bdd_operator_adapt */
+   long unsigned int hit;       /* since bdd_init() */
+   long unsigned int miss;
+   long unsigned int epochhit;  /* since the last garbage collection */
+   long unsigned int epochmiss;
 } BddCache;
 
 
@@ -65,8 +79,75 @@ extern int  BddCache_init(BddCache *, int);
 extern void BddCache_done(BddCache *);
 extern int  BddCache_resize(BddCache *, int);
 extern void BddCache_reset(BddCache *);
+extern void BddCache_clean(BddCache *, int);
+
+   /* Fields holding nodes, for BddCache_clean. */
+#define BDDCACHE_A   0x1
+#define BDDCACHE_B   0x2
+#define BDDCACHE_C   0x4
+#define BDDCACHE_RES 0x8
+
+   /* The first entry of the set of HASH. */
+#define BddCache_set(cache, hash) \
+   (&(cache)->table[((hash) * BDDCACHE_WAYS) & ((cache)->tablesize - 1)])
+
+   /* Move entry W of SET to the front, shifting the entries before it.
+      On a miss (W == BDDCACHE_WAYS - 1) this evicts the last entry and
+      leaves the front entry free for the caller to fill.  */
+static inline BddCacheData *BddCache_promote(BddCacheData *set, int w)
+{
+   if (w > 0)
+   {
+      BddCacheData tmp = set[w];
+      for (; w > 0; --w)
+	 set[w] = set[w - 1];
+      set[0] = tmp;
+   }
+   return set;
+}
+
+   /* Return the entry with key (A,B,C) if there is one.  Otherwise
+      return the entry to overwrite with the result: its key is
+      invalidated, so the caller's check fails.  The caller may store
+      its result in the returned entry after recursive calls; if those
+      reused the set, only a cache entry is lost. */
+static inline BddCacheData *BddCache_lookup3(BddCache *cache, unsigned hash,
+					     int a, int b, int c)
+{
+   BddCacheData *set = BddCache_set(cache, hash);
+   int w;
+
+   for (w = 0; w < BDDCACHE_WAYS; ++w)
+      if (set[w].i.a == a  &&  set[w].i.c == c  &&  set[w].i.b == b)
+      {
+	 cache->epochhit++;
+	 return BddCache_promote(set, w);
+      }
+   cache->epochmiss++;
+   set = BddCache_promote(set, BDDCACHE_WAYS - 1);
+   set->i.a = -1;
+   return set;
+}
+
+   /* Same as BddCache_lookup3 for entries keyed by (A,C) only.  This
+      also works for the entries of the "d" variant. */
+static inline BddCacheData *BddCache_lookup2(BddCache *cache, unsigned hash,
+					     int a, int c)
+{
+   BddCacheData *set = BddCache_set(cache, hash);
+   int w;
 
-#define BddCache_lookup(cache, hash) (&(cache)->table[hash & ((cache)->tablesize - 1)])
+   for (w = 0; w < BDDCACHE_WAYS; ++w)
+      if (set[w].i.a == a  &&  set[w].i.c == c)
+      {
+	 cache->epochhit++;
+	 return BddCache_promote(set, w);
+      }
+   cache->epochmiss++;
+   set = BddCache_promote(set, BDDCACHE_WAYS - 1);
+   set->i.a = -1;
+   return set;
+}
 
 
 #endif /* _CACHE_H */
@@ -67,8 +67,8 @@ static void bdd_printdot_rec(ostream&, int);
 static void fdd_printset_rec(ostream &, int, int *);
 
 
-static bddstrmhandler strmhandler_bdd;
-static bddstrmhandler strmhandler_fdd;
+static BUDDY_TLS bddstrmhandler strmhandler_bdd;
+static BUDDY_TLS bddstrmhandler strmhandler_fdd;
 
    // Avoid calling C++ version of anodecount
 #undef bdd_anodecount
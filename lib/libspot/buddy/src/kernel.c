@@ -79,43 +79,52 @@ const BDD bddfalse=0;                    /* The constant false bdd */
 
 /* Min. number of nodes (%) that has to be left after a garbage collect
    unless a resize should be done. */
-static int minfreenodes=20;
+static BUDDY_TLS int minfreenodes=20;
 
 
 /*=== GLOBAL KERNEL VARIABLES ==========================================*/
 
-int          bddrunning;            /* Flag - package initialized */
-int          bdderrorcond;          /* Some error condition */
-int          bddnodesize;           /* Number of allocated nodes */
-int          bddmaxnodesize;        /* Maximum allowed number of nodes */
-int          bddmaxnodeincrease;    /* Max. # of nodes used to inc. table */
-BddNode*     bddnodes;          /* All of the bdd nodes */
-int*         bddhash;           /* Unicity hash table */
-int          bddfreepos;        /* First free node */
-int          bddfreenum;        /* Number of free nodes */
-long int     bddproduced;       /* Number of new nodes ever produced */
-int          bddvarnum;         /* Number of defined BDD variables */
-int*         bddrefstack;       /* Internal node reference stack */
-int*         bddrefstacktop;    /* Internal node reference stack top */
-int*         bddvar2level;      /* Variable -> level table */
-int*         bddlevel2var;      /* Level -> variable table */
-jmp_buf      bddexception;      /* Long-jump point for interrupting calc. */
-int          bddresized;        /* Flag indicating a resize of the nodetable */
-int          bddcachesize;      /* Size of the operator caches */
-int          bddhashsize;       /* Size of the BDD node hash */
-
-bddCacheStat bddcachestats;
+BUDDY_TLS int          bddrunning;            /* Flag - package initialized */
+BUDDY_TLS int          bdderrorcond;          /* Some error condition */
+BUDDY_TLS int          bddnodesize;           /* Number of allocated nodes */
+BUDDY_TLS int          bddmaxnodesize;        /* Maximum allowed number of nodes */
+BUDDY_TLS int          bddmaxnodeincrease;    /* Max. # of nodes used to inc. table */
+BUDDY_TLS BddNode*     bddnodes;          /* All of the bdd nodes */
+BUDDY_TLS int*         bddhash;           /* Unicity hash table */
+BUDDY_TLS int          bddfreepos;        /* First free node */
+BUDDY_TLS int          bddfreenum;        /* Number of free nodes */
+BUDDY_TLS long int     bddproduced;       /* Number of new nodes ever produced */
+BUDDY_TLS int          bddvarnum;         /* Number of defined BDD variables */
+BUDDY_TLS int*         bddrefstack;       /* Internal node reference stack */
+BUDDY_TLS int*         bddrefstacktop;    /* Internal node reference stack top */
+BUDDY_TLS int*         bddvar2level;      /* Variable -> level table */
+BUDDY_TLS int*         bddlevel2var;      /* Level -> variable table */
+BUDDY_TLS jmp_buf      bddexception;      /* Long-jump point for interrupting calc. */
+BUDDY_TLS int          bddresized;        /* Flag indicating a resize of the nodetable */
+BUDDY_TLS int          bddcachesize;      /* Size of the operator caches */
+BUDDY_TLS int          bddhashsize;       /* Size of the BDD node hash */
+
+BUDDY_TLS bddCacheStat bddcachestats;
 
 
 /*=== PRIVATE KERNEL VARIABLES =========================================*/
 
-static BDD*     bddvarset;             /* Set of defined BDD variables */
-static int      gbcollectnum;          /* Number of garbage collections */
-static long int gbcclock;              /* Clock ticks used in GBC */
-static int      usednodes_nextreorder; /* When to do reorder next time */
-static bddinthandler  err_handler;     /* Error handler */
-static bddgbchandler  gbc_handler;     /* Garbage collection handler */
-static bdd2inthandler resize_handler;  /* Node-table-resize handler */
+static BUDDY_TLS BDD*     bddvarset;             /* Set of defined BDD variables */
+static BUDDY_TLS int      gbcollectnum;          /* Number of garbage collections */
+static BUDDY_TLS long int gbcclock;              /* Clock ticks used in GBC */
+static BUDDY_TLS int      usednodes_nextreorder; /* When to do reorder next time */
+static BUDDY_TLS bddinthandler  err_handler;     /* Error handler */
+static BUDDY_TLS bddgbchandler  gbc_handler;     /* Garbage collection handler */
+static BUDDY_TLS bdd2inthandler resize_handler;  /* Node-table-resize handler */
+#ifdef BUDDY_OPEN_HASH
+static BUDDY_TLS unsigned long long* bddunique; /* Open-addressing unique table */
+static BUDDY_TLS unsigned int bdduniquemask;    /* Its size minus one */
+#else
+static BUDDY_TLS int      generational;          /* Try minor collections */
+static BUDDY_TLS int*     bddyoung;              /* Nodes made since last GC */
+static BUDDY_TLS int      bddyoungnum;           /* Number of such nodes */
+static BUDDY_TLS unsigned char* bddyoungmap;     /* One bit per node */
+#endif
 
 
    /* Strings for all error mesages */
@@ -143,6 +152,53 @@ static const char *errorstrings[BDD_ERRNUM] =
 
 #define NODEHASH(lvl,l,h) (TRIPLE(lvl,l,h) & (bddhashsize - 1))
 
+#ifndef BUDDY_OPEN_HASH
+#define ISYOUNG(n)  (bddyoungmap[(n) >> 3] & (1 << ((n) & 7)))
+#define SETYOUNG(n) (bddyoungmap[(n) >> 3] |= (1 << ((n) & 7)))
+#define CLRYOUNG(n) (bddyoungmap[(n) >> 3] &= ~(1 << ((n) & 7)))
+#endif
+
+#if defined(__GNUC__)
+# define PREFETCHW(p) __builtin_prefetch((p), 1)
+#else
+# define PREFETCHW(p) (void)(p)
+#endif
+
+#ifdef BUDDY_OPEN_HASH
+/* With -DBUDDY_OPEN_HASH the kernel finds existing nodes through an
+   open-addressing table with linear probing instead of the chains
+   threaded through the `next' field.  Each slot holds a node number
+   in its low 32 bits and the full TRIPLE() hash of that node in the
+   high 32 bits, so a probe only touches the node table when the
+   hashes are equal.  Slot 0 is the empty slot (nodes 0 and 1 are
+   never hashed).  The table has at least twice as many slots as the
+   node table has nodes, and since nodes are only removed by the
+   garbage collector, which rebuilds the whole table, no tombstones are
+   needed.  The `bddhash' chains are still used by the reordering code,
+   which rebuilds them itself. */
+#define UNIQUESLOT(h,n) (((unsigned long long)(h) << 32) | (unsigned)(n))
+
+static int bdd_unique_alloc(void)
+{
+   unsigned int size = bdd_nextpower(2 * bddnodesize);
+
+   free(bddunique);
+   if ((bddunique=(unsigned long long*)calloc(size, sizeof(*bddunique)))
+       == NULL)
+      return bdd_error(BDD_MEMORY);
+   bdduniquemask = size - 1;
+   return 0;
+}
+
+static inline unsigned int bdd_unique_free(unsigned int hash)
+{
+   unsigned int i = hash & bdduniquemask;
+   while (bddunique[i] != 0)
+      i = (i + 1) & bdduniquemask;
+   return i;
+}
+#endif
+
 
 /*************************************************************************
   BDD misc. user operations
@@ -191,6 +247,30 @@ int bdd_init(int initnodesize, int cs)
        free(bddnodes);
        return bdd_error(BDD_MEMORY);
      }
+#ifdef BUDDY_OPEN_HASH
+   bddunique = NULL;
+   if (bdd_unique_alloc() < 0)
+     {
+       free(bddhash);
+       free(bddnodes);
+       return bdd_error(BDD_MEMORY);
+     }
+#else
+   /* No node can be made twice between two collections, so there are
+      never more young nodes than nodes. */
+   bddyoungnum = 0;
+   bddyoung = (int*)malloc(sizeof(int)*bddnodesize);
+   bddyoungmap = (unsigned char*)calloc((bddnodesize + 7) / 8, 1);
+   if (bddyoung == NULL  ||  bddyoungmap == NULL)
+     {
+       free(bddyoung);
+       free(bddyoungmap);
+       free(bddhash);
+       free(bddnodes);
+       return bdd_error(BDD_MEMORY);
+     }
+   generational = 0;
+#endif
 
    bddresized = 0;
 
@@ -277,6 +357,15 @@ void bdd_done(void)
    free(bddvar2level);
    free(bddlevel2var);
    free(bddhash);
+#ifdef BUDDY_OPEN_HASH
+   free(bddunique);
+   bddunique = NULL;
+#else
+   free(bddyoung);
+   free(bddyoungmap);
+   bddyoung = NULL;
+   bddyoungmap = NULL;
+#endif
 
    bddnodes = NULL;
    bddrefstack = NULL;
@@ -689,6 +778,28 @@ int bdd_isrunning(void)
 }
 
 
+/*
+NAME    {* bdd\_isthreadlocal *}
+SECTION {* kernel *}
+SHORT   {* test whether each thread has its own BDD package *}
+PROTO   {* int bdd_isthreadlocal(void) *}
+DESCR   {* When the library is compiled with {\tt BUDDY\_THREAD\_LOCAL}, all
+	   of its state is thread-local: every thread must call {\tt bdd\_init}
+	   and may then use the package independently of the other threads.
+	   BDDs created by one thread are meaningless in another. *}
+RETURN  {* 1 (true) if the state is thread-local, otherwise 0. *}
+ALSO    {* bdd\_init, bdd\_isrunning *}
+*/
+int bdd_isthreadlocal(void)
+{
+#ifdef BUDDY_THREAD_LOCAL
+   return 1;
+#else
+   return 0;
+#endif
+}
+
+
 /*
 NAME    {* bdd\_versionstr *}
 SECTION {* kernel *}
@@ -700,7 +811,7 @@ ALSO    {* bdd\_versionnum *}
 */
 char *bdd_versionstr(void)
 {
-   static char str[100];
+   static BUDDY_TLS char str[100];
    sprintf(str, "BuDDy -  release %d.%d", VERSION/10, VERSION%10);
    return str;
 }
@@ -742,6 +853,7 @@ void bdd_stats(bddStat *s)
    s->cachesize = bddcachesize;
    s->hashsize = bddhashsize;
    s->gbcnum = gbcollectnum;
+   bdd_operator_stats(s);
 }
 
 
@@ -800,6 +912,21 @@ void bdd_fprintstat(FILE *ofile)
 	   (s.opHit+s.opMiss > 0) ?
 	   ((float)s.opHit)/((float)s.opHit+s.opMiss) : 0);
    fprintf(ofile, "Swap count =    %lu\n", s.swapCount);
+
+   {
+      static const char* name[BDD_OPCACHENUM] =
+	 { "apply", "ite", "quant", "appex", "replace", "misc" };
+      bddStat st;
+      int n;
+
+      bdd_stats(&st);
+      fprintf(ofile, "\nOperator caches (%d-way)\n", BDDCACHE_WAYS);
+      fprintf(ofile, "------------------------\n");
+      for (n=0 ; n<BDD_OPCACHENUM ; n++)
+	 fprintf(ofile, "%-8s %9d entries  %12lu hits  %12lu misses\n",
+		 name[n], st.opcache[n].size,
+		 st.opcache[n].hit, st.opcache[n].miss);
+   }
 }
 
 
@@ -1044,9 +1171,14 @@ static void bdd_gbc_rehash(void)
       {
 	 register unsigned int hash;
 
+#ifdef BUDDY_OPEN_HASH
+	 hash = TRIPLE(LEVELp(node), LOWp(node), HIGHp(node));
+	 bddunique[bdd_unique_free(hash)] = UNIQUESLOT(hash, n);
+#else
 	 hash = NODEHASH(LEVELp(node), LOWp(node), HIGHp(node));
 	 node->next = bddhash[hash];
 	 bddhash[hash] = n;
+#endif
       }
       else
       {
@@ -1075,6 +1207,13 @@ void bdd_gbc(void)
       gbc_handler(1, &s);
    }
 
+#ifndef BUDDY_OPEN_HASH
+      /* Every surviving node becomes old. */
+   for (n=0 ; n<bddyoungnum ; n++)
+      CLRYOUNG(bddyoung[n]);
+   bddyoungnum = 0;
+#endif
+
    for (r=bddrefstack ; r<bddrefstacktop ; r++)
       bdd_mark(*r);
 
@@ -1084,7 +1223,11 @@ void bdd_gbc(void)
 	 bdd_mark(n);
    }
 
+#ifdef BUDDY_OPEN_HASH
+   memset(bddunique, 0, (bdduniquemask + 1)*sizeof(*bddunique));
+#else
    memset(bddhash, 0, bddhashsize*sizeof(*bddhash));
+#endif
 
    bddfreepos = 0;
    bddfreenum = 0;
@@ -1098,9 +1241,14 @@ void bdd_gbc(void)
 	 register unsigned int hash;
 
 	 LEVELp(node) &= MARKOFF;
+#ifdef BUDDY_OPEN_HASH
+	 hash = TRIPLE(LEVELp(node), LOWp(node), HIGHp(node));
+	 bddunique[bdd_unique_free(hash)] = UNIQUESLOT(hash, n);
+#else
 	 hash = NODEHASH(LEVELp(node), LOWp(node), HIGHp(node));
 	 node->next = bddhash[hash];
 	 bddhash[hash] = n;
+#endif
       }
       else
       {
@@ -1111,7 +1259,8 @@ void bdd_gbc(void)
       }
    }
 
-   bdd_operator_reset();
+   bdd_operator_adapt();
+   bdd_operator_clean();
 
    c2 = clock();
    gbcclock += c2-c1;
@@ -1130,6 +1279,161 @@ void bdd_gbc(void)
 }
 
 
+#ifndef BUDDY_OPEN_HASH
+static void bdd_mark_young(int i)
+{
+   BddNode *node;
+
+   if (i < 2  ||  !ISYOUNG(i))
+      return;
+
+   node = &bddnodes[i];
+   if (LEVELp(node) & MARKON)
+      return;
+
+   LEVELp(node) |= MARKON;
+
+   bdd_mark_young(LOWp(node));
+   bdd_mark_young(HIGHp(node));
+}
+
+
+/* Minor collection: only reclaim the nodes made since the previous
+   collection.  A node is always made after its children, so no older
+   node can point to a young one; the live young nodes are those
+   reachable from the young nodes that are referenced or on the
+   reference stack.  This costs time proportional to the number of
+   young nodes instead of the size of the node table.
+
+   Since bdd_makenode() inserts nodes at the head of their hash chain
+   and the full collection rebuilds all chains, the young nodes of a
+   chain always come before the old ones, so they can be unlinked
+   without walking whole chains.  The surviving young nodes become
+   old.  Old nodes that died since the previous collection are left
+   for the next full collection.  Returns the number of freed nodes. */
+static int bdd_gbc_minor(void)
+{
+   int *r;
+   int n, freed = 0;
+   long int c2, c1 = clock();
+
+   if (gbc_handler != NULL)
+   {
+      bddGbcStat s;
+      s.nodes = bddnodesize;
+      s.freenodes = bddfreenum;
+      s.time = 0;
+      s.sumtime = gbcclock;
+      s.num = gbcollectnum;
+      gbc_handler(1, &s);
+   }
+
+   for (r=bddrefstack ; r<bddrefstacktop ; r++)
+      bdd_mark_young(*r);
+
+   for (n=0 ; n<bddyoungnum ; n++)
+   {
+      if (bddnodes[bddyoung[n]].refcou > 0)
+	 bdd_mark_young(bddyoung[n]);
+   }
+
+      /* Unlink the dead young nodes from the hash chains.  Processing
+	 a chain clears the young bit of all its young nodes, so each
+	 chain is processed once. */
+   for (n=0 ; n<bddyoungnum ; n++)
+   {
+      register BddNode *node = &bddnodes[bddyoung[n]];
+      register int *link;
+
+      link = &bddhash[NODEHASH(LEVELp(node) & MARKOFF,
+			       LOWp(node), HIGHp(node))];
+      while (*link != 0  &&  ISYOUNG(*link))
+      {
+	 register BddNode *p = &bddnodes[*link];
+
+	 CLRYOUNG(*link);
+	 if (LEVELp(p) & MARKON)
+	    link = &p->next;
+	 else
+	    *link = p->next;
+      }
+   }
+
+   for (n=0 ; n<bddyoungnum ; n++)
+   {
+      register int y = bddyoung[n];
+      register BddNode *node = &bddnodes[y];
+
+      if (LEVELp(node) & MARKON)
+	 LEVELp(node) &= MARKOFF;
+      else
+      {
+	 LOWp(node) = -1;
+	 node->next = bddfreepos;
+	 bddfreepos = y;
+	 bddfreenum++;
+	 freed++;
+      }
+   }
+   bddyoungnum = 0;
+
+   bdd_operator_clean();
+
+   c2 = clock();
+   gbcclock += c2-c1;
+   gbcollectnum++;
+
+   if (gbc_handler != NULL)
+   {
+      bddGbcStat s;
+      s.nodes = bddnodesize;
+      s.freenodes = bddfreenum;
+      s.time = c2-c1;
+      s.sumtime = gbcclock;
+      s.num = gbcollectnum;
+      gbc_handler(0, &s);
+   }
+
+   return freed;
+}
+#endif
+
+
+/*
+NAME    {* bdd\_setgenerational *}
+SECTION {* kernel *}
+SHORT   {* enables or disables minor garbage collections *}
+PROTO   {* int bdd_setgenerational(int on) *}
+DESCR   {* When the node table is full, BuDDy first tries a minor
+	   garbage collection that only considers the nodes made since the
+	   previous collection, and falls back to a full collection
+	   (possibly followed by a resize of the node table) if that did
+	   not free more than the minimum number of free nodes set by
+	   {\tt bdd\_setminfreenodes}.  A minor collection is not tried
+	   when more than half of the nodes are young, since a full
+	   collection, which walks the node table sequentially, is then
+	   cheaper.  This is disabled by default, and
+	   is not available when BuDDy is compiled with
+	   {\tt BUDDY\_OPEN\_HASH}.  Explicit calls to {\tt bdd\_gbc}
+	   always do a full collection.  In all collections, the entries
+	   of the apply, ite and replace caches that only refer to live
+	   nodes are kept. *}
+RETURN  {* The previous setting. *}
+ALSO    {* bdd\_gbc, bdd\_setminfreenodes *}
+*/
+int bdd_setgenerational(int on)
+{
+#ifdef BUDDY_OPEN_HASH
+   (void)on;
+   return 0;
+#else
+   int old = generational;
+   generational = on;
+   return old;
+#endif
+}
+
+
 BDD bdd_addref_nc(BDD root)
 {
 #ifndef NDEBUG
@@ -1330,6 +1634,10 @@ int bdd_makenode(unsigned int level, int low, int high)
    register BddNode *node;
    register unsigned int hash;
    register int res;
+#ifdef BUDDY_OPEN_HASH
+   unsigned int slot;
+   unsigned long long entry;
+#endif
 
 #ifdef CACHESTATS
    bddcachestats.uniqueAccess++;
@@ -1340,6 +1648,30 @@ int bdd_makenode(unsigned int level, int low, int high)
       return low;
 
       /* Try to find an existing node of this kind */
+#ifdef BUDDY_OPEN_HASH
+   hash = TRIPLE(level, low, high);
+   slot = hash & bdduniquemask;
+
+   while ((entry = bddunique[slot]) != 0)
+   {
+      if ((unsigned int)(entry >> 32) == hash)
+      {
+	 res = (int)(unsigned int)entry;
+	 if (LEVEL(res) == level  &&  LOW(res) == low  &&  HIGH(res) == high)
+	 {
+#ifdef CACHESTATS
+	    bddcachestats.uniqueHit++;
+#endif
+	    return res;
+	 }
+      }
+
+      slot = (slot + 1) & bdduniquemask;
+#ifdef CACHESTATS
+      bddcachestats.uniqueChain++;
+#endif
+   }
+#else
    hash = NODEHASH(level, low, high);
    res = bddhash[hash];
 
@@ -1358,6 +1690,7 @@ int bdd_makenode(unsigned int level, int low, int high)
       bddcachestats.uniqueChain++;
 #endif
    }
+#endif
 
       /* No existing node -> build one */
 #ifdef CACHESTATS
@@ -1370,20 +1703,43 @@ int bdd_makenode(unsigned int level, int low, int high)
       if (bdderrorcond)
 	 return 0;
 
-	 /* Try to allocate more nodes */
-      bdd_gbc();
-
-      if ((bddnodesize-bddfreenum) >= usednodes_nextreorder  &&
-	   bdd_reorder_ready())
+	 /* Try to allocate more nodes.  A minor collection is enough
+	    if it frees more than minfreenodes percent of the table
+	    (this is never the case if there are fewer young nodes),
+	    and is only tried while at most half of the table is young:
+	    beyond that the random accesses of the minor collection cost
+	    more than the sequential sweep of a full one.
+	    It is skipped when a reordering may be due, so that
+	    automatic reordering is not delayed. */
+#ifndef BUDDY_OPEN_HASH
+      if (!(generational
+	    &&  (long)bddyoungnum*100 > (long)bddnodesize*minfreenodes
+	    &&  bddyoungnum*2 <= bddnodesize
+	    &&  !bdd_reorder_ready()
+	    &&  (long)bdd_gbc_minor()*100 > (long)bddnodesize*minfreenodes))
+#endif
       {
-	 longjmp(bddexception,1);
+	 bdd_gbc();
+
+	 if ((bddnodesize-bddfreenum) >= usednodes_nextreorder  &&
+	      bdd_reorder_ready())
+	 {
+	    longjmp(bddexception,1);
+	 }
+
+	 if ((bddfreenum*100) / bddnodesize <= minfreenodes)
+	 {
+	    bdd_noderesize(1);
+#ifndef BUDDY_OPEN_HASH
+	    hash = NODEHASH(level, low, high);
+#endif
+	 }
       }
 
-      if ((bddfreenum*100) / bddnodesize <= minfreenodes)
-      {
-	 bdd_noderesize(1);
-	 hash = NODEHASH(level, low, high);
-      }
+#ifdef BUDDY_OPEN_HASH
+	 /* The table has been rebuilt: look for the free slot again. */
+      slot = bdd_unique_free(hash);
+#endif
 
 	 /* Panic if that is not possible */
       if (bddfreepos == 0)
@@ -1400,14 +1756,24 @@ int bdd_makenode(unsigned int level, int low, int high)
    bddfreenum--;
    bddproduced++;
 
+      /* The next free node is likely to be written soon, and is
+	 usually far from this one after a garbage collection. */
+   PREFETCHW(&bddnodes[bddfreepos]);
+
    node = &bddnodes[res];
    LEVELp(node) = level;
    LOWp(node) = low;
    HIGHp(node) = high;
 
       /* Insert node */
+#ifdef BUDDY_OPEN_HASH
+   bddunique[slot] = UNIQUESLOT(hash, res);
+#else
    node->next = bddhash[hash];
    bddhash[hash] = res;
+   bddyoung[bddyoungnum++] = res;
+   SETYOUNG(res);
+#endif
 
    return res;
 }
@@ -1457,6 +1823,31 @@ int bdd_noderesize(int doRehash)
               (bddhashsize-oldhashsize)*sizeof(*bddhash));
      }
 
+#ifdef BUDDY_OPEN_HASH
+   /* Without doRehash (during reordering) the new table stays empty
+      until the garbage collection that ends the reordering refills
+      it. */
+   if (bdd_unique_alloc() < 0)
+     return bdd_error(BDD_MEMORY);
+#else
+   {
+     int *newyoung;
+     unsigned char *newmap;
+     int oldmapsize = (oldsize + 7) / 8;
+     int mapsize = (bddnodesize + 7) / 8;
+
+     newyoung = (int*)realloc(bddyoung, sizeof(int)*bddnodesize);
+     if (newyoung == NULL)
+       return bdd_error(BDD_MEMORY);
+     bddyoung = newyoung;
+     newmap = (unsigned char*)realloc(bddyoungmap, mapsize);
+     if (newmap == NULL)
+       return bdd_error(BDD_MEMORY);
+     bddyoungmap = newmap;
+     memset(bddyoungmap + oldmapsize, 0, mapsize - oldmapsize);
+   }
+#endif
+
    /* copy these global variables into local variables to help the
       optimizer */
    {
@@ -45,6 +45,19 @@
 #include "bddx.h"
 #ifdef HAVE_CONFIG_H
 # include "config.h"
+#endif
+
+   /* When compiled with -DBUDDY_THREAD_LOCAL every thread gets its own
+      BuDDy instance: the node table, the operator caches, the pairs and
+      the reordering state are all thread-local.  Each thread must call
+      bdd_init() before use, and BDDs must not be passed between
+      threads.  The initial-exec TLS model keeps each access a single
+      thread-pointer relative load; it requires the library to be linked
+      (not dlopen()ed) by programs that use this option. */
+#ifdef BUDDY_THREAD_LOCAL
+# define BUDDY_TLS __thread __attribute__((tls_model("initial-exec")))
+#else
+# define BUDDY_TLS
 #endif
 
 /*=== SANITY CHECKS ====================================================*/
@@ -115,27 +128,27 @@ typedef struct s_BddNodeInit
 extern "C" {
 #endif
 
-extern int       bddrunning;         /* Flag - package initialized */
-extern int       bdderrorcond;       /* Some error condition was met */
-extern int       bddnodesize;        /* Number of allocated nodes */
-extern int       bddhashsize;        /* Size of node hash tableq */
-extern int       bddmaxnodesize;     /* Maximum allowed number of nodes */
-extern int       bddmaxnodeincrease; /* Max. # of nodes used to inc. table */
-extern BddNode*  bddnodes;           /* All of the bdd nodes */
-extern int*      bddhash;            /* Unicity hash table */
-extern int       bddvarnum;          /* Number of defined BDD variables */
-extern int*      bddrefstack;        /* Internal node reference stack */
-extern int*      bddrefstacktop;     /* Internal node reference stack top */
-extern int*      bddvar2level;
-extern int*      bddlevel2var;
-extern jmp_buf   bddexception;
+extern BUDDY_TLS int       bddrunning;         /* Flag - package initialized */
+extern BUDDY_TLS int       bdderrorcond;       /* Some error condition was met */
+extern BUDDY_TLS int       bddnodesize;        /* Number of allocated nodes */
+extern BUDDY_TLS int       bddhashsize;        /* Size of node hash tableq */
+extern BUDDY_TLS int       bddmaxnodesize;     /* Maximum allowed number of nodes */
+extern BUDDY_TLS int       bddmaxnodeincrease; /* Max. # of nodes used to inc. table */
+extern BUDDY_TLS BddNode*  bddnodes;           /* All of the bdd nodes */
+extern BUDDY_TLS int*      bddhash;            /* Unicity hash table */
+extern BUDDY_TLS int       bddvarnum;          /* Number of defined BDD variables */
+extern BUDDY_TLS int*      bddrefstack;        /* Internal node reference stack */
+extern BUDDY_TLS int*      bddrefstacktop;     /* Internal node reference stack top */
+extern BUDDY_TLS int*      bddvar2level;
+extern BUDDY_TLS int*      bddlevel2var;
+extern BUDDY_TLS jmp_buf   bddexception;
 extern int       bddreorderdisabled;
-extern int       bddresized;
-extern int       bddcachesize;
-extern bddCacheStat bddcachestats;
+extern BUDDY_TLS int       bddresized;
+extern BUDDY_TLS int       bddcachesize;
+extern BUDDY_TLS bddCacheStat bddcachestats;
 
   /* from reorder.c */
-extern int bddreordermethod;
+extern BUDDY_TLS int bddreordermethod;
 
 #ifdef CPLUSPLUS
 }
@@ -255,6 +268,9 @@ extern int    bdd_operator_init(int);
 extern void   bdd_operator_done(void);
 extern void   bdd_operator_varresize(void);
 extern void   bdd_operator_reset(void);
+extern void   bdd_operator_adapt(void);
+extern void   bdd_operator_clean(void);
+extern void   bdd_operator_stats(bddStat *);
 
 extern void   bdd_pairs_init(void);
 extern void   bdd_pairs_done(void);
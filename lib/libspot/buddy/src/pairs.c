@@ -40,8 +40,8 @@
 
 /*======================================================================*/
 
-static int      pairsid;            /* Pair identifier */
-static bddPair* pairs;              /* List of all replacement pairs in use */
+static BUDDY_TLS int      pairsid;            /* Pair identifier */
+static BUDDY_TLS bddPair* pairs;              /* List of all replacement pairs in use */
 
 
 /*************************************************************************
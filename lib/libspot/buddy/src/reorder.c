@@ -39,6 +39,7 @@
 #include <time.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 #include "kernel.h"
 #include "bddtree.h"
 #include "imatrix.h"
@@ -63,19 +64,19 @@
 #define __USERESIZE /* FIXME */
 
    /* Current auto reord. method and number of automatic reorderings left */
-int bddreordermethod;
-static int bddreordertimes;
+BUDDY_TLS int bddreordermethod;
+static BUDDY_TLS int bddreordertimes;
 
    /* Flag for disabling reordering temporarily */
-static int reorderdisabled;
+static BUDDY_TLS int reorderdisabled;
 
    /* Store for the variable relationships */
-static BddTree *vartree;
-static int blockid;
+static BUDDY_TLS BddTree *vartree;
+static BUDDY_TLS int blockid;
 
    /* Store for the ref.cou. of the external roots */
-static int *extroots;
-static int extrootsize;
+static BUDDY_TLS int *extroots;
+static BUDDY_TLS int extrootsize;
 
 /* Level data */
 typedef struct _levelData
@@ -86,28 +87,32 @@ typedef struct _levelData
    int nodenum;  /* Number of nodes in this level */
 } levelData;
 
-static levelData *levels; /* Indexed by variable! */
+static BUDDY_TLS levelData *levels; /* Indexed by variable! */
 
    /* Interaction matrix */
-static imatrix *iactmtx;
+static BUDDY_TLS imatrix *iactmtx;
 
    /* Reordering information for the user */
-static int verbose;
-static bddinthandler reorder_handler;
-static bddfilehandler reorder_filehandler;
-static bddsizehandler reorder_nodenum;
+static BUDDY_TLS int verbose;
+static BUDDY_TLS bddinthandler reorder_handler;
+static BUDDY_TLS bddfilehandler reorder_filehandler;
+static BUDDY_TLS bddsizehandler reorder_nodenum;
+
+   /* Parallel sifting (see reorder_sift_par) */
+static BUDDY_TLS int siftthreads = 1;
+static BUDDY_TLS int siftdeterministic;
 
    /* Number of live nodes before and after a reordering session */
-static int usednum_before;
-static int usednum_after;
+static BUDDY_TLS int usednum_before;
+static BUDDY_TLS int usednum_after;
 
    /* Kernel variables needed for reordering */
-extern int bddfreepos;
-extern int bddfreenum;
-extern long int bddproduced;
+extern BUDDY_TLS int bddfreepos;
+extern BUDDY_TLS int bddfreenum;
+extern BUDDY_TLS long int bddproduced;
 
    /* Flag telling us when a node table resize is done */
-static int resizedInMakenode;
+static BUDDY_TLS int resizedInMakenode;
 
    /* New node hashing function for use with reordering */
 #define NODEHASH(var,l,h) ((PAIR((l),(h))%levels[var].size)+levels[var].start)
@@ -120,6 +125,7 @@ static void reorder_setLevellookup(void);
 static int  reorder_makenode(int, int, int);
 static int  reorder_varup(int);
 static int  reorder_vardown(int);
+static BddTree *reorder_sift_par(BddTree *, BddTree **, int);
 static int  reorder_init(void);
 static void reorder_done(void);
 
@@ -664,7 +670,10 @@ static BddTree *reorder_sift(BddTree *t)
       seq[n] = p[n].block;
 
       /* Do the sifting on this sequence */
-   t = reorder_sift_seq(t, seq, num);
+   if (siftthreads > 1  ||  siftdeterministic)
+      t = reorder_sift_par(t, seq, num);
+   else
+      t = reorder_sift_seq(t, seq, num);
 
    free(seq);
    free(p);
@@ -698,6 +707,764 @@ static BddTree *reorder_siftite(BddTree *t)
 }
 
 
+/*=== Parallel sifting ===============================================*/
+
+/* With bdd_reorder_threads(N), N > 1, the sifting sequence is handled
+   in batches.  The live part of the node table is copied into a
+   compact snapshot, and each block of a batch is sifted by a worker
+   thread on its own copy of this snapshot: swaps there only touch the
+   private copy, so the real node table, the hash tables, and all the
+   (possibly thread-local) kernel variables are left alone.  Each
+   worker returns the best position it found for its block.  The main
+   thread then moves the blocks to these positions in the real table,
+   one at a time, and moves a block back if the real node count got
+   worse (the positions were computed for the order at the start of
+   the batch).
+
+   In deterministic mode the batches have a fixed size and the moves
+   are applied in the order of the sifting sequence, so the final order
+   does not depend on the number of threads or on their scheduling.
+   Otherwise a batch has one block per thread and the moves are applied
+   as soon as the workers finish. */
+
+#define SIFTBATCH 8
+
+   /* A copy of the node table used to evaluate sifting.  Nodes are
+      reference counted with all their parents (plus one for external
+      roots), and dead nodes are reclaimed recursively, so "total" is
+      the exact number of live nodes. */
+typedef struct s_siftSim
+{
+   int *var;
+   int *low;
+   int *high;
+   int *ref;
+   int *next;         /* Hash chain or free list */
+   int size;
+   int freepos;
+   int *hash;
+   int hashsize;
+   int *var2level;
+   int *level2var;
+   int **vlist;       /* Nodes of each variable (may contain stale ids) */
+   int *vlistnum;
+   int *vlistsize;
+   char *seen;
+   int varnum;
+   int total;
+   int error;
+} siftSim;
+
+   /* Read-only state shared by all workers of a batch */
+typedef struct s_siftShared
+{
+   siftSim snap;
+   int blocknum;
+   int **blockvar;    /* Variables of each block, top-most first */
+   int *blockvarnum;
+   int middlePos;
+   int maxnodesize;
+   int maxnodeincrease;
+} siftShared;
+
+typedef struct s_siftJob
+{
+   int block;         /* Position of the block in the snapshot order */
+   int target;        /* Result: best position */
+   int done;
+} siftJob;
+
+typedef struct s_siftBatch
+{
+   siftShared *shared;
+   siftJob *job;
+   int jobnum;
+   int nextjob;
+   int donenum;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+} siftBatch;
+
+
+static void siftsim_free(siftSim *s)
+{
+   int v;
+
+   if (s->vlist != NULL)
+      for (v=0 ; v<s->varnum ; v++)
+	 free(s->vlist[v]);
+   free(s->vlist);
+   free(s->vlistnum);
+   free(s->vlistsize);
+   free(s->var);
+   free(s->low);
+   free(s->high);
+   free(s->ref);
+   free(s->next);
+   free(s->hash);
+   free(s->var2level);
+   free(s->level2var);
+   free(s->seen);
+   memset(s, 0, sizeof(siftSim));
+}
+
+
+static void siftsim_listadd(siftSim *s, int v, int n)
+{
+   if (s->vlistnum[v] == s->vlistsize[v])
+   {
+      int newsize = s->vlistsize[v] ? s->vlistsize[v]*2 : 16;
+      int *l = (int*)realloc(s->vlist[v], sizeof(int)*newsize);
+      if (l == NULL)
+      {
+	 s->error = 1;
+	 return;
+      }
+      s->vlist[v] = l;
+      s->vlistsize[v] = newsize;
+   }
+   s->vlist[v][s->vlistnum[v]++] = n;
+}
+
+
+static void siftsim_rehash(siftSim *s)
+{
+   int n;
+
+   memset(s->hash, 0, sizeof(int)*s->hashsize);
+   s->freepos = 0;
+   for (n=s->size-1 ; n>=2 ; n--)
+   {
+      if (s->ref[n] > 0)
+      {
+	 unsigned int h = TRIPLE(s->var[n],s->low[n],s->high[n]) % s->hashsize;
+	 s->next[n] = s->hash[h];
+	 s->hash[h] = n;
+      }
+      else
+      {
+	 s->next[n] = s->freepos;
+	 s->freepos = n;
+      }
+   }
+}
+
+
+   /* Double the number of nodes of the copy */
+static int siftsim_grow(siftSim *s)
+{
+   int newsize = s->size*2;
+   int *p;
+
+#define SIFTGROW(f)\
+   if ((p=(int*)realloc(s->f, sizeof(int)*newsize)) == NULL)\
+      return s->error = 1;\
+   s->f = p
+   SIFTGROW(var);
+   SIFTGROW(low);
+   SIFTGROW(high);
+   SIFTGROW(ref);
+   SIFTGROW(next);
+   SIFTGROW(hash);
+#undef SIFTGROW
+   if ((s->seen=(char*)realloc(s->seen, newsize)) == NULL)
+      return s->error = 1;
+
+   memset(s->ref+s->size, 0, sizeof(int)*(newsize-s->size));
+   memset(s->seen+s->size, 0, newsize-s->size);
+   s->size = newsize;
+   s->hashsize = newsize;
+   siftsim_rehash(s);
+   return 0;
+}
+
+
+static int siftsim_copy(siftSim *s, const siftSim *src)
+{
+   int v;
+
+   memset(s, 0, sizeof(siftSim));
+   s->size = src->size;
+   s->hashsize = src->size;
+   s->varnum = src->varnum;
+   s->total = src->total;
+
+   if ((s->var=NEW(int,s->size)) == NULL  ||
+       (s->low=NEW(int,s->size)) == NULL  ||
+       (s->high=NEW(int,s->size)) == NULL  ||
+       (s->ref=NEW(int,s->size)) == NULL  ||
+       (s->next=NEW(int,s->size)) == NULL  ||
+       (s->hash=NEW(int,s->hashsize)) == NULL  ||
+       (s->seen=(char*)calloc(s->size,1)) == NULL  ||
+       (s->var2level=NEW(int,s->varnum)) == NULL  ||
+       (s->level2var=NEW(int,s->varnum)) == NULL  ||
+       (s->vlist=(int**)calloc(s->varnum,sizeof(int*))) == NULL  ||
+       (s->vlistnum=(int*)calloc(s->varnum,sizeof(int))) == NULL  ||
+       (s->vlistsize=(int*)calloc(s->varnum,sizeof(int))) == NULL)
+   {
+      siftsim_free(s);
+      return -1;
+   }
+
+   memcpy(s->var, src->var, sizeof(int)*s->size);
+   memcpy(s->low, src->low, sizeof(int)*s->size);
+   memcpy(s->high, src->high, sizeof(int)*s->size);
+   memcpy(s->ref, src->ref, sizeof(int)*s->size);
+   memcpy(s->var2level, src->var2level, sizeof(int)*s->varnum);
+   memcpy(s->level2var, src->level2var, sizeof(int)*s->varnum);
+   siftsim_rehash(s);
+
+   for (v=2 ; v<s->size ; v++)
+      if (s->ref[v] > 0)
+	 siftsim_listadd(s, s->var[v], v);
+
+   if (s->error)
+   {
+      siftsim_free(s);
+      return -1;
+   }
+   return 0;
+}
+
+
+static void siftsim_deref(siftSim *s, int n)
+{
+   unsigned int h;
+   int *link;
+
+   if (n < 2  ||  --s->ref[n] > 0)
+      return;
+
+   h = TRIPLE(s->var[n],s->low[n],s->high[n]) % s->hashsize;
+   for (link=&s->hash[h] ; *link!=n ; link=&s->next[*link])
+      /* nil */;
+   *link = s->next[n];
+   s->next[n] = s->freepos;
+   s->freepos = n;
+   s->total--;
+
+   siftsim_deref(s, s->low[n]);
+   siftsim_deref(s, s->high[n]);
+}
+
+
+static int siftsim_makenode(siftSim *s, int var, int low, int high)
+{
+   unsigned int h;
+   int res;
+
+   if (low == high)
+   {
+      if (low >= 2)
+	 s->ref[low]++;
+      return low;
+   }
+
+   h = TRIPLE(var,low,high) % s->hashsize;
+   for (res=s->hash[h] ; res!=0 ; res=s->next[res])
+   {
+      if (s->var[res] == var  &&  s->low[res] == low  &&  s->high[res] == high)
+      {
+	 s->ref[res]++;
+	 return res;
+      }
+   }
+
+   if (s->freepos == 0)
+   {
+      if (siftsim_grow(s))
+	 return 0;
+      h = TRIPLE(var,low,high) % s->hashsize;
+   }
+
+   res = s->freepos;
+   s->freepos = s->next[res];
+   s->var[res] = var;
+   s->low[res] = low;
+   s->high[res] = high;
+   s->ref[res] = 1;
+   if (low >= 2)
+      s->ref[low]++;
+   if (high >= 2)
+      s->ref[high]++;
+   s->next[res] = s->hash[h];
+   s->hash[h] = res;
+   s->total++;
+   siftsim_listadd(s, var, res);
+
+   return res;
+}
+
+
+   /* Remove the stale and duplicate entries of a variable's list */
+static void siftsim_compact(siftSim *s, int v)
+{
+   int *l = s->vlist[v];
+   int n, num = 0;
+
+   for (n=0 ; n<s->vlistnum[v] ; n++)
+   {
+      int r = l[n];
+      if (s->ref[r] > 0  &&  s->var[r] == v  &&  !s->seen[r])
+      {
+	 s->seen[r] = 1;
+	 l[num++] = r;
+      }
+   }
+   for (n=0 ; n<num ; n++)
+      s->seen[l[n]] = 0;
+   s->vlistnum[v] = num;
+}
+
+
+   /* Same as reorder_vardown(), on the copy */
+static void siftsim_vardown(siftSim *s, int x)
+{
+   int level = s->var2level[x];
+   int y, n, num;
+
+   if (level >= s->varnum-1)
+      return;
+   y = s->level2var[level+1];
+
+   siftsim_compact(s, x);
+   num = s->vlistnum[x];
+
+   for (n=0 ; n<num  &&  !s->error ; n++)
+   {
+      int r = s->vlist[x][n];
+      int l = s->low[r];
+      int h = s->high[r];
+      int f00, f01, f10, f11, a, b;
+      unsigned int hash;
+      int *link;
+
+      if (s->var[r] != x  ||  s->ref[r] == 0)
+	 continue;
+      if ((l < 2  ||  s->var[l] != y)  &&  (h < 2  ||  s->var[h] != y))
+	 continue;
+
+      if (l >= 2  &&  s->var[l] == y)
+	 f00 = s->low[l], f01 = s->high[l];
+      else
+	 f00 = f01 = l;
+      if (h >= 2  &&  s->var[h] == y)
+	 f10 = s->low[h], f11 = s->high[h];
+      else
+	 f10 = f11 = h;
+
+      a = siftsim_makenode(s, x, f00, f10);
+      b = siftsim_makenode(s, x, f01, f11);
+      if (s->error)
+	 return;
+
+	 /* Rewrite the node in place so that its parents are kept */
+      hash = TRIPLE(x,l,h) % s->hashsize;
+      for (link=&s->hash[hash] ; *link!=r ; link=&s->next[*link])
+	 /* nil */;
+      *link = s->next[r];
+
+      s->var[r] = y;
+      s->low[r] = a;
+      s->high[r] = b;
+      hash = TRIPLE(y,a,b) % s->hashsize;
+      s->next[r] = s->hash[hash];
+      s->hash[hash] = r;
+      siftsim_listadd(s, y, r);
+
+      siftsim_deref(s, l);
+      siftsim_deref(s, h);
+   }
+   siftsim_compact(s, y);
+
+   s->level2var[level] = y;
+   s->level2var[level+1] = x;
+   s->var2level[x] = level+1;
+   s->var2level[y] = level;
+}
+
+
+   /* Same as blockdown(), on the copy */
+static void siftsim_blockdown(siftSim *s, const siftShared *sh,
+			      int *order, int pos)
+{
+   int left = order[pos];
+   int right = order[pos+1];
+   int n, m;
+
+   for (n=sh->blockvarnum[left]-1 ; n>=0 ; n--)
+      for (m=0 ; m<sh->blockvarnum[right] ; m++)
+	 siftsim_vardown(s, sh->blockvar[left][n]);
+
+   order[pos] = right;
+   order[pos+1] = left;
+}
+
+
+static int siftsim_maxallowed(const siftShared *sh, int best)
+{
+   if (sh->maxnodesize > 0)
+      return MIN(best/5+best, sh->maxnodesize-sh->maxnodeincrease-2);
+   return best/5+best;
+}
+
+
+   /* Same as reorder_sift_bestpos(), on a private copy of the
+      snapshot.  Returns the best position, or the current one if
+      memory ran out. */
+static int siftsim_bestpos(const siftShared *sh, int pos)
+{
+   siftSim s;
+   int *order;
+   int best, maxAllowed, bestpos = 0;
+   int dirIsUp = 1;
+   int orig = pos;
+   int n;
+
+   if (siftsim_copy(&s, &sh->snap) < 0)
+      return pos;
+   if ((order=NEW(int,sh->blocknum)) == NULL)
+   {
+      siftsim_free(&s);
+      return pos;
+   }
+   for (n=0 ; n<sh->blocknum ; n++)
+      order[n] = n;
+
+   best = s.total;
+   maxAllowed = siftsim_maxallowed(sh, best);
+
+   if (pos > sh->middlePos)
+      dirIsUp = 0;
+
+   for (n=0 ; n<2  &&  !s.error ; n++)
+   {
+      int first = 1;
+
+      while (!s.error  &&  (dirIsUp ? pos > 0 : pos < sh->blocknum-1)  &&
+	     (s.total <= maxAllowed  ||  first))
+      {
+	 first = 0;
+	 if (dirIsUp)
+	 {
+	    siftsim_blockdown(&s, sh, order, pos-1);
+	    pos--;
+	    bestpos--;
+	 }
+	 else
+	 {
+	    siftsim_blockdown(&s, sh, order, pos);
+	    pos++;
+	    bestpos++;
+	 }
+
+	 if (s.total < best)
+	 {
+	    best = s.total;
+	    bestpos = 0;
+	    maxAllowed = siftsim_maxallowed(sh, best);
+	 }
+      }
+
+      dirIsUp = !dirIsUp;
+   }
+
+   if (s.error)
+      pos = orig, bestpos = 0;
+
+   free(order);
+   siftsim_free(&s);
+   return pos - bestpos;
+}
+
+
+static void siftsim_kill(siftSim *s, int n)
+{
+   int l = s->low[n];
+   int h = s->high[n];
+
+   s->low[n] = -1;
+   if (l >= 2  &&  --s->ref[l] == 0)
+      siftsim_kill(s, l);
+   if (h >= 2  &&  --s->ref[h] == 0)
+      siftsim_kill(s, h);
+}
+
+
+   /* Copy the live part of the reordering node table */
+static int siftsim_snapshot(siftSim *s)
+{
+   int n;
+
+   memset(s, 0, sizeof(siftSim));
+   s->size = bddnodesize;
+   s->varnum = bddvarnum;
+
+   if ((s->var=NEW(int,s->size)) == NULL  ||
+       (s->low=NEW(int,s->size)) == NULL  ||
+       (s->high=NEW(int,s->size)) == NULL  ||
+       (s->ref=(int*)calloc(s->size,sizeof(int))) == NULL  ||
+       (s->var2level=NEW(int,s->varnum)) == NULL  ||
+       (s->level2var=NEW(int,s->varnum)) == NULL)
+   {
+      siftsim_free(s);
+      return -1;
+   }
+
+   memcpy(s->var2level, bddvar2level, sizeof(int)*s->varnum);
+   memcpy(s->level2var, bddlevel2var, sizeof(int)*s->varnum);
+
+   for (n=2 ; n<s->size ; n++)
+   {
+      BddNode *node = &bddnodes[n];
+
+      if (node->refcou > 0)
+      {
+	 s->var[n] = VARp(node);
+	 s->low[n] = LOWp(node);
+	 s->high[n] = HIGHp(node);
+      }
+      else
+	 s->low[n] = -1;
+   }
+
+   for (n=0 ; n<extrootsize ; n++)
+      if (s->low[extroots[n]] != -1)
+	 s->ref[extroots[n]]++;
+
+   for (n=2 ; n<s->size ; n++)
+   {
+      if (s->low[n] == -1)
+	 continue;
+      if (s->low[n] >= 2)
+	 s->ref[s->low[n]]++;
+      if (s->high[n] >= 2)
+	 s->ref[s->high[n]]++;
+   }
+
+      /* Nodes that are only kept alive by dead parents are dead too */
+   for (n=2 ; n<s->size ; n++)
+      if (s->low[n] != -1  &&  s->ref[n] == 0)
+	 siftsim_kill(s, n);
+
+   for (n=2 ; n<s->size ; n++)
+   {
+      if (s->low[n] == -1)
+	 s->var[n] = s->high[n] = 0;
+      else
+	 s->total++;
+   }
+
+   return 0;
+}
+
+
+static void *siftsim_worker(void *arg)
+{
+   siftBatch *b = (siftBatch*)arg;
+
+   for (;;)
+   {
+      siftJob *job;
+
+      pthread_mutex_lock(&b->lock);
+      if (b->nextjob == b->jobnum)
+      {
+	 pthread_mutex_unlock(&b->lock);
+	 return NULL;
+      }
+      job = &b->job[b->nextjob++];
+      pthread_mutex_unlock(&b->lock);
+
+      job->target = siftsim_bestpos(b->shared, job->block);
+
+      pthread_mutex_lock(&b->lock);
+      job->done = 1;
+      b->donenum++;
+      pthread_cond_signal(&b->cond);
+      pthread_mutex_unlock(&b->lock);
+   }
+}
+
+
+   /* Move a block to the given position, and back if that does not
+      reduce the number of nodes */
+static void reorder_sift_moveto(BddTree *blk, int target)
+{
+   BddTree *this;
+   int pos = 0;
+   int orig, size = reorder_nodenum();
+
+   for (this=blk->prev ; this!=NULL ; this=this->prev)
+      pos++;
+   orig = pos;
+
+   while (pos < target  &&  blk->next != NULL)
+   {
+      blockdown(blk);
+      pos++;
+   }
+   while (pos > target  &&  blk->prev != NULL)
+   {
+      blockdown(blk->prev);
+      pos--;
+   }
+
+   if (reorder_nodenum() > size)
+   {
+      while (pos < orig)
+      {
+	 blockdown(blk);
+	 pos++;
+      }
+      while (pos > orig)
+      {
+	 blockdown(blk->prev);
+	 pos--;
+      }
+   }
+}
+
+
+static BddTree *reorder_sift_par(BddTree *t, BddTree **seq, int num)
+{
+   siftShared sh;
+   siftBatch b;
+   pthread_t *thr;
+   BddTree *this, **blocks;
+   int n, batchsize, threadnum;
+
+   if (t == NULL)
+      return t;
+
+   batchsize = siftdeterministic ? SIFTBATCH : siftthreads;
+   threadnum = MIN(siftthreads, batchsize);
+
+   memset(&sh, 0, sizeof(siftShared));
+   sh.blocknum = num;
+   sh.middlePos = num/2;
+   sh.maxnodesize = bddmaxnodesize;
+   sh.maxnodeincrease = bddmaxnodeincrease;
+
+   blocks = NEW(BddTree*,num);
+   sh.blockvar = NEW(int*,num);
+   sh.blockvarnum = NEW(int,num);
+   b.job = NEW(siftJob,batchsize);
+   b.shared = &sh;
+   thr = NEW(pthread_t,threadnum);
+   n = 0;
+   if (blocks == NULL  ||  sh.blockvar == NULL  ||  sh.blockvarnum == NULL
+       ||  b.job == NULL  ||  thr == NULL)
+      goto done;
+
+   pthread_mutex_init(&b.lock, NULL);
+   pthread_cond_init(&b.cond, NULL);
+
+   for (n=0 ; n<num ; n+=batchsize)
+   {
+      int k, level, jobnum = MIN(batchsize, num-n);
+      int applied;
+
+	 /* Number the blocks in their current order.  The blocks of the
+	    list occupy consecutive levels, so their variables are read
+	    from the snapshot's level table, top-most first. */
+      for (this=t ; this->prev!=NULL ; this=this->prev)
+	 /* nil */;
+      level = bddvarnum;
+      for (k=0 ; k<=this->last-this->first ; k++)
+	 level = MIN(level, bddvar2level[this->seq[k]]);
+      if (siftsim_snapshot(&sh.snap) < 0)
+	 break;
+      for (k=0 ; this!=NULL ; this=this->next,k++)
+      {
+	 blocks[k] = this;
+	 this->pos = k;
+	 sh.blockvar[k] = sh.snap.level2var + level;
+	 sh.blockvarnum[k] = this->last - this->first + 1;
+	 level += sh.blockvarnum[k];
+      }
+
+      for (k=0 ; k<jobnum ; k++)
+      {
+	 b.job[k].block = seq[n+k]->pos;
+	 b.job[k].target = seq[n+k]->pos;
+	 b.job[k].done = 0;
+      }
+      b.jobnum = jobnum;
+      b.nextjob = 0;
+      b.donenum = 0;
+
+      for (k=0 ; k<MIN(threadnum,jobnum) ; k++)
+	 if (pthread_create(&thr[k], NULL, siftsim_worker, &b) != 0)
+	    break;
+      if (k == 0)
+	 siftsim_worker(&b);
+
+	 /* Apply the moves, in sequence order in deterministic mode,
+	    or as soon as they are known otherwise */
+      pthread_mutex_lock(&b.lock);
+      for (applied=0 ; applied<jobnum ; applied++)
+      {
+	 siftJob *job;
+	 int j;
+
+	 for (;;)
+	 {
+	    for (j=0 ; j<jobnum ; j++)
+	       if (b.job[j].done == 1  &&  (!siftdeterministic || j == applied))
+		  break;
+	    if (j < jobnum)
+	       break;
+	    pthread_cond_wait(&b.cond, &b.lock);
+	 }
+	 job = &b.job[j];
+	 job->done = 2;
+	 pthread_mutex_unlock(&b.lock);
+
+	 if (verbose > 1)
+	 {
+	    printf("Sift ");
+	    if (reorder_filehandler)
+	       reorder_filehandler(stdout, blocks[job->block]->id);
+	    else
+	       printf("%d", blocks[job->block]->id);
+	 }
+
+	 if (job->target != job->block)
+	    reorder_sift_moveto(blocks[job->block], job->target);
+
+	 if (verbose > 1)
+	    printf(": %d nodes\n", reorder_nodenum());
+
+	 pthread_mutex_lock(&b.lock);
+      }
+      pthread_mutex_unlock(&b.lock);
+
+      while (k-- > 0)
+	 pthread_join(thr[k], NULL);
+      siftsim_free(&sh.snap);
+   }
+
+   pthread_mutex_destroy(&b.lock);
+   pthread_cond_destroy(&b.cond);
+
+ done:
+   free(sh.blockvar);
+   free(sh.blockvarnum);
+   free(b.job);
+   free(thr);
+   free(blocks);
+
+      /* Out of memory: sift the remaining blocks serially */
+   if (n < num)
+      return reorder_sift_seq(t, seq+n, num-n);
+
+      /* Find first block */
+   for (this=t ; this->prev != NULL ; this=this->prev)
+      /* nil */;
+   return this;
+}
+
 /*=== Random reordering (mostly for debugging and test ) =============*/
 
 static BddTree *reorder_random(BddTree *t)
@@ -1565,7 +2332,7 @@ int bdd_swapvar(int v1, int v2)
 
 void bdd_default_reohandler(int prestate)
 {
-   static long c1;
+   static BUDDY_TLS long c1;
 
    if (verbose > 0)
    {
@@ -1700,6 +2467,11 @@ static void reorder_done(void)
    free(extroots);
    free(levels);
    imatrixDelete(iactmtx);
+
+      /* Node numbers were freed and reused for other functions while
+       * swapping levels, so bdd_operator_clean() cannot tell which cache
+       * entries are still valid: drop them all. */
+   bdd_operator_reset();
    bdd_gbc();
 }
 
@@ -2048,6 +2820,54 @@ int bdd_reorder_verbose(int v)
 }
 
 
+/*
+NAME    {* bdd\_reorder\_threads *}
+SECTION {* reorder *}
+SHORT   {* sets the number of threads used for sifting *}
+PROTO   {* int bdd_reorder_threads(int num) *}
+DESCR   {* With a value of {\tt num} greater than one, the
+	   {\tt BDD\_REORDER\_SIFT} and {\tt BDD\_REORDER\_SIFTITE} methods
+	   sift several blocks at a time: each of {\tt num} threads finds
+	   the best position of one block on a private copy of the node
+	   table, and the blocks are then moved to these positions (or
+	   left in place if that does not reduce the number of nodes).
+	   The result can differ from serial sifting, and from one run to
+	   the other unless {\tt bdd\_reorder\_deterministic} is used.
+	   The default value is one, which gives the serial sifting. *}
+RETURN  {* The old number of threads *}
+ALSO    {* bdd\_reorder, bdd\_reorder\_deterministic *}
+*/
+int bdd_reorder_threads(int num)
+{
+   int tmp = siftthreads;
+   siftthreads = num < 1 ? 1 : num;
+   return tmp;
+}
+
+
+/*
+NAME    {* bdd\_reorder\_deterministic *}
+SECTION {* reorder *}
+SHORT   {* makes parallel sifting reproducible *}
+PROTO   {* int bdd_reorder_deterministic(int on) *}
+DESCR   {* When {\tt on} is non-zero, sifting always evaluates blocks in
+	   batches of the same size and moves them in the order of the
+	   sifting sequence, so the resulting variable order only
+	   depends on the BDDs and not on the number of threads set with
+	   {\tt bdd\_reorder\_threads} or on their scheduling.  (With a
+	   single thread, this also selects the batched sifting instead of
+	   the serial one.)  The default value is zero. *}
+RETURN  {* The old setting *}
+ALSO    {* bdd\_reorder, bdd\_reorder\_threads *}
+*/
+int bdd_reorder_deterministic(int on)
+{
+   int tmp = siftdeterministic;
+   siftdeterministic = on;
+   return tmp;
+}
+
+
 /*
 NAME    {* bdd\_reorder\_probe *}
 SECTION {* reorder *}
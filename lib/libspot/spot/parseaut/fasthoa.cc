@@ -0,0 +1,765 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+#include "spot/parseaut/parsedecl.hh"
+#include <spot/twa/twagraph.hh>
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+// A reader for the common subset of the HOA format, used by
+// parse_aut() before it resorts to the Bison parser.
+//
+// The subset covers a single automaton with explicit transition
+// labels using numbered atomic propositions, existential
+// destinations, and state-based or transition-based acceptance
+// without negated sets.  The reader gives up (and the Bison parser
+// takes over) on anything else, including on every input the Bison
+// parser would diagnose, so that the two always agree on the
+// automata they accept.
+
+namespace spot
+{
+  namespace
+  {
+    // Thrown to hand the input over to the Bison parser.
+    struct hoa_fallback
+    {
+    };
+
+    [[noreturn]] static void fallback()
+    {
+      throw hoa_fallback{};
+    }
+
+    // Read-only view of a whole file.
+    class mapped_file final
+    {
+      const char* data_ = nullptr;
+      size_t size_ = 0;
+#if HAVE_SYS_MMAN_H
+      void* map_ = MAP_FAILED;
+#endif
+    public:
+      explicit mapped_file(const std::string& name)
+      {
+#if HAVE_SYS_MMAN_H
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0)
+          return;
+        struct stat s;
+        if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0)
+          {
+            map_ = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map_ != MAP_FAILED)
+              {
+                data_ = static_cast<const char*>(map_);
+                size_ = s.st_size;
+#ifdef MADV_SEQUENTIAL
+                madvise(map_, size_, MADV_SEQUENTIAL);
+#endif
+              }
+          }
+        close(fd);
+#else
+        (void) name;
+#endif
+      }
+
+      ~mapped_file()
+      {
+#if HAVE_SYS_MMAN_H
+        if (map_ != MAP_FAILED)
+          munmap(map_, size_);
+#endif
+      }
+
+      mapped_file(const mapped_file&) = delete;
+      mapped_file& operator=(const mapped_file&) = delete;
+
+      const char* data() const
+      {
+        return data_;
+      }
+
+      size_t size() const
+      {
+        return size_;
+      }
+    };
+
+    // The text of a label, pointing into the mapped file.
+    struct label_text
+    {
+      const char* str;
+      size_t len;
+
+      bool operator==(const label_text& o) const
+      {
+        return len == o.len && !memcmp(str, o.str, len);
+      }
+    };
+
+    struct label_text_hash
+    {
+      size_t operator()(const label_text& t) const noexcept
+      {
+        // FNV-1a
+        size_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < t.len; ++i)
+          h = (h ^ static_cast<unsigned char>(t.str[i])) * 1099511628211ULL;
+        return h;
+      }
+    };
+
+    static bool is_ident_start(char c)
+    {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static bool is_ident_char(char c)
+    {
+      return is_ident_start(c) || (c >= '0' && c <= '9') || c == '-';
+    }
+
+    enum acc_style_t { Mixed_Acc, State_Acc, Trans_Acc };
+
+    class hoa_fast_reader final
+    {
+      const char* pos_;
+      const char* end_;
+      environment& env_;
+      bool trust_hoa_;
+      twa_graph_ptr aut_;
+
+      // Header.
+      int states_ = -1;
+      int start_ = -1;
+      int accset_ = -1;
+      std::vector<bdd> ap_;
+      std::unordered_map<std::string, bool> props_;
+      acc_style_t acc_style_ = Mixed_Acc;
+
+      // Body.
+      std::unordered_map<label_text, bdd, label_text_hash> labels_;
+      std::vector<unsigned char> declared_;
+      std::vector<unsigned char> used_;
+      trival universal_ = trival::maybe();
+      trival complete_ = trival::maybe();
+      bool trans_acc_seen_ = false;
+
+    public:
+      hoa_fast_reader(const char* begin, const char* end,
+                      const bdd_dict_ptr& dict, environment& env,
+                      bool trust_hoa)
+        : pos_(begin), end_(end), env_(env), trust_hoa_(trust_hoa),
+          aut_(make_twa_graph(dict))
+      {
+      }
+
+      twa_graph_ptr run()
+      {
+        header();
+        body();
+        aut_->prop_universal(universal_);
+        aut_->prop_complete(complete_);
+        if (acc_style_ == State_Acc
+            || (acc_style_ == Mixed_Acc && !trans_acc_seen_))
+          aut_->prop_state_acc(true);
+        return aut_;
+      }
+
+    private:
+      // Skip white spaces.  Comments are left to the Bison parser.
+      void skip_ws()
+      {
+        while (pos_ < end_)
+          switch (*pos_)
+            {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+              ++pos_;
+              break;
+            case '/':
+              fallback();
+            default:
+              return;
+            }
+      }
+
+      char peek()
+      {
+        skip_ws();
+        return pos_ < end_ ? *pos_ : '\0';
+      }
+
+      void expect(char c)
+      {
+        if (peek() != c)
+          fallback();
+        ++pos_;
+      }
+
+      bool at(const char* word)
+      {
+        size_t len = strlen(word);
+        return (static_cast<size_t>(end_ - pos_) >= len
+                && !memcmp(pos_, word, len));
+      }
+
+      unsigned uint()
+      {
+        if (peek() < '0' || *pos_ > '9')
+          fallback();
+        unsigned long v = 0;
+        while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9')
+          {
+            v = v * 10 + (*pos_++ - '0');
+            if (v > 0x7fffffffUL)
+              fallback();
+          }
+        return v;
+      }
+
+      std::string ident()
+      {
+        if (!is_ident_start(peek()))
+          fallback();
+        const char* b = pos_;
+        while (pos_ < end_ && is_ident_char(*pos_))
+          ++pos_;
+        return std::string(b, pos_);
+      }
+
+      // Strings with escape sequences are left to the Bison parser.
+      std::string str()
+      {
+        expect('"');
+        const char* b = pos_;
+        while (pos_ < end_ && *pos_ != '"')
+          if (*pos_++ == '\\')
+            fallback();
+        if (pos_ == end_)
+          fallback();
+        return std::string(b, pos_++);
+      }
+
+      // Read a header name, without its colon.  Returns an empty
+      // string on "--BODY--".
+      std::string header_name()
+      {
+        if (peek() == '-')
+          {
+            if (!at("--BODY--"))
+              fallback();
+            pos_ += 8;
+            return {};
+          }
+        std::string name = ident();
+        if (pos_ == end_ || *pos_ != ':')
+          fallback();
+        ++pos_;
+        return name;
+      }
+
+      // Whether the next token is a header name or "--BODY--", i.e.,
+      // whether the current header item is over.
+      bool header_item_done()
+      {
+        char c = peek();
+        if (c == '-')
+          return true;
+        if (!is_ident_start(c))
+          return false;
+        const char* p = pos_;
+        while (p < end_ && is_ident_char(*p))
+          ++p;
+        return p < end_ && *p == ':';
+      }
+
+      // Skip the values of a header we do not need.
+      void skip_header_values()
+      {
+        while (!header_item_done())
+          {
+            char c = peek();
+            if (c == '"')
+              str();
+            else if (c >= '0' && c <= '9')
+              uint();
+            else
+              ident();
+          }
+      }
+
+      unsigned acc_set()
+      {
+        unsigned n = uint();
+        if (static_cast<int>(n) >= accset_)
+          fallback();
+        return n;
+      }
+
+      // acceptance-cond, with the same associativity and the same
+      // construction order as the Bison parser, so that both build
+      // the same acc_code.
+      acc_cond::acc_code acc_primary()
+      {
+        if (peek() == '(')
+          {
+            ++pos_;
+            auto c = acc_or();
+            expect(')');
+            return c;
+          }
+        std::string id = ident();
+        if (id == "t")
+          return {};
+        if (id == "f")
+          return acc_cond::acc_code::fin({});
+        if (id != "Inf" && id != "Fin")
+          fallback();
+        expect('(');
+        if (peek() == '!')
+          fallback();
+        acc_cond::mark_t m({acc_set()});
+        expect(')');
+        return id == "Inf"
+          ? acc_cond::acc_code::inf(m) : acc_cond::acc_code::fin(m);
+      }
+
+      acc_cond::acc_code acc_and()
+      {
+        auto c = acc_primary();
+        while (peek() == '&')
+          {
+            ++pos_;
+            auto r = acc_primary();
+            r &= std::move(c);
+            c = std::move(r);
+          }
+        return c;
+      }
+
+      acc_cond::acc_code acc_or()
+      {
+        auto c = acc_and();
+        while (peek() == '|')
+          {
+            ++pos_;
+            auto r = acc_and();
+            r |= std::move(c);
+            c = std::move(r);
+          }
+        return c;
+      }
+
+      void header()
+      {
+        if (header_name() != "HOA" || ident() != "v1")
+          fallback();
+        bool seen_ap = false;
+        for (;;)
+          {
+            std::string h = header_name();
+            if (h.empty())
+              break;
+            if (h == "States")
+              {
+                if (states_ >= 0)
+                  fallback();
+                states_ = uint();
+              }
+            else if (h == "Start")
+              {
+                if (start_ >= 0)
+                  fallback();
+                start_ = uint();
+                if (peek() == '&')
+                  fallback();
+              }
+            else if (h == "AP")
+              {
+                if (seen_ap)
+                  fallback();
+                seen_ap = true;
+                unsigned n = uint();
+                ap_.reserve(n);
+                for (unsigned i = 0; i < n; ++i)
+                  {
+                    formula f = env_.require(str());
+                    if (f == nullptr)
+                      fallback();
+                    int v = aut_->register_ap(f);
+                    for (bdd& b: ap_)
+                      if (bdd_var(b) == v)
+                        fallback();
+                    ap_.emplace_back(bdd_ithvar(v));
+                  }
+                if (peek() == '"')
+                  fallback();
+              }
+            else if (h == "Acceptance")
+              {
+                if (accset_ >= 0)
+                  fallback();
+                unsigned n = uint();
+                if (n > SPOT_MAX_ACCSETS)
+                  fallback();
+                aut_->acc().add_sets(n);
+                accset_ = n;
+                aut_->set_acceptance(n, acc_or());
+              }
+            else if (h == "name")
+              {
+                aut_->set_named_prop("automaton-name",
+                                     new std::string(str()));
+              }
+            else if (h == "properties")
+              {
+                while (!header_item_done())
+                  {
+                    bool val = true;
+                    if (peek() == '!')
+                      {
+                        ++pos_;
+                        val = false;
+                      }
+                    std::string p = ident();
+                    if (p == "no-univ-branch" && val)
+                      {
+                        p = "univ-branch";
+                        val = false;
+                      }
+                    auto i = props_.emplace(p, val);
+                    if (i.first->second != val)
+                      fallback();
+                  }
+              }
+            else if (h == "acc-name" || h == "tool")
+              {
+                skip_header_values();
+              }
+            else
+              {
+                fallback();
+              }
+          }
+        if (states_ <= 0 || start_ < 0 || start_ >= states_ || accset_ < 0)
+          fallback();
+        aut_->new_states(states_);
+        aut_->set_init_state(start_);
+        declared_.resize(states_);
+        used_.resize(states_);
+        properties();
+      }
+
+      // -1 if \a p is not given, else its value.
+      int prop(const char* p) const
+      {
+        auto i = props_.find(p);
+        return i == props_.end() ? -1 : i->second;
+      }
+
+      void properties()
+      {
+        if (prop("implicit-labels") == 1 || prop("state-labels") == 1)
+          fallback();
+        int state_acc = prop("state-acc");
+        int trans_acc = prop("trans-acc");
+        if (trans_acc == 1)
+          {
+            if (state_acc == 1)
+              fallback();
+            acc_style_ = Trans_Acc;
+          }
+        else if (state_acc == 1)
+          {
+            acc_style_ = State_Acc;
+          }
+        // Assume the automaton is deterministic and complete until
+        // proven wrong.
+        universal_ = true;
+        complete_ = true;
+
+        int si = prop("stutter-invariant");
+        int ss = prop("stutter-sensitive");
+        int vw = prop("very-weak");
+        int iw = prop("inherently-weak");
+        int w = prop("weak");
+        int t = prop("terminal");
+        int u = prop("unambiguous");
+        int sd = prop("semi-deterministic");
+        int d = prop("deterministic");
+        // Contradictions are diagnosed by the Bison parser.
+        if ((si >= 0 && si == ss)
+            || (vw == 1 && (w == 0 || iw == 0))
+            || (iw == 0 && (w == 1 || t == 1))
+            || (w == 0 && t == 1)
+            || (d == 1 && (u == 0 || sd == 0)))
+          fallback();
+        if (!trust_hoa_)
+          return;
+        if (si >= 0)
+          aut_->prop_stutter_invariant(si == 1);
+        else if (ss >= 0)
+          aut_->prop_stutter_invariant(ss == 0);
+        if (vw >= 0)
+          aut_->prop_very_weak(vw == 1);
+        if (iw >= 0)
+          aut_->prop_inherently_weak(iw == 1);
+        if (w >= 0)
+          aut_->prop_weak(w == 1);
+        if (t >= 0)
+          aut_->prop_terminal(t == 1);
+        if (u >= 0)
+          aut_->prop_unambiguous(u == 1);
+        if (sd >= 0)
+          aut_->prop_semi_deterministic(sd == 1);
+      }
+
+      acc_cond::mark_t acc_sig()
+      {
+        expect('{');
+        acc_cond::mark_t m = {};
+        while (peek() != '}')
+          m.set(acc_set());
+        ++pos_;
+        return m;
+      }
+
+      // label-expr, read from the text between brackets.
+      bdd label_primary()
+      {
+        char c = peek();
+        if (c == '!')
+          {
+            ++pos_;
+            return !label_primary();
+          }
+        if (c == '(')
+          {
+            ++pos_;
+            bdd b = label_or();
+            expect(')');
+            return b;
+          }
+        if (c == 't' || c == 'f')
+          {
+            ++pos_;
+            if (pos_ < end_ && is_ident_char(*pos_))
+              fallback();
+            return c == 't' ? bdd(bddtrue) : bdd(bddfalse);
+          }
+        unsigned n = uint();
+        if (n >= ap_.size())
+          fallback();
+        return ap_[n];
+      }
+
+      bdd label_and()
+      {
+        bdd b = label_primary();
+        while (peek() == '&')
+          {
+            ++pos_;
+            b &= label_primary();
+          }
+        return b;
+      }
+
+      bdd label_or()
+      {
+        bdd b = label_and();
+        while (peek() == '|')
+          {
+            ++pos_;
+            b |= label_and();
+          }
+        return b;
+      }
+
+      bdd label()
+      {
+        ++pos_;                        // '['
+        const char* close =
+          static_cast<const char*>(memchr(pos_, ']', end_ - pos_));
+        if (!close)
+          fallback();
+        label_text key{pos_, static_cast<size_t>(close - pos_)};
+        auto i = labels_.find(key);
+        if (i != labels_.end())
+          {
+            pos_ = close + 1;
+            return i->second;
+          }
+        // Parse the label within the brackets only.
+        const char* end = end_;
+        end_ = close;
+        bdd b = label_or();
+        if (peek() != '\0')
+          fallback();
+        end_ = end;
+        pos_ = close + 1;
+        labels_.emplace(key, b);
+        return b;
+      }
+
+      void body()
+      {
+        // Reserve one edge per label.
+        {
+          size_t n = 0;
+          for (const char* p = pos_;
+               (p = static_cast<const char*>(memchr(p, '[', end_ - p)));
+               ++p)
+            ++n;
+          aut_->get_graph().edge_vector().reserve(n + 1);
+        }
+
+        for (;;)
+          {
+            if (peek() == '-')
+              {
+                if (!at("--END--"))
+                  fallback();
+                pos_ += 7;
+                break;
+              }
+            if (ident() != "State" || pos_ == end_ || *pos_++ != ':')
+              fallback();
+            // State labels are left to the Bison parser.
+            if (peek() == '[')
+              fallback();
+            unsigned s = uint();
+            if (s >= declared_.size() || declared_[s])
+              fallback();
+            declared_[s] = 1;
+            acc_cond::mark_t acc_state = {};
+            char c = peek();
+            if (c == '"')
+              fallback();
+            if (c == '{')
+              {
+                if (acc_style_ == Trans_Acc)
+                  fallback();
+                acc_state = acc_sig();
+              }
+
+            while (peek() == '[')
+              {
+                bdd cond = label();
+                unsigned dst = uint();
+                if (dst >= declared_.size())
+                  fallback();
+                used_[dst] = 1;
+                acc_cond::mark_t acc = acc_state;
+                c = peek();
+                if (c == '&')
+                  fallback();
+                if (c == '{')
+                  {
+                    if (acc_style_ == State_Acc)
+                      fallback();
+                    trans_acc_seen_ = true;
+                    acc |= acc_sig();
+                  }
+                if (cond != bddfalse)
+                  aut_->new_edge(s, dst, cond, acc);
+              }
+            c = peek();
+            if (c != 'S' && c != '-')
+              fallback();
+
+            if (universal_.is_true() || complete_.is_true())
+              {
+                bdd available = bddtrue;
+                bool det = true;
+                for (auto& t: aut_->out(s))
+                  {
+                    if (det && !bdd_implies(t.cond, available))
+                      det = false;
+                    available -= t.cond;
+                  }
+                if (universal_.is_true() && !det)
+                  {
+                    if (prop("deterministic") == 1
+                        || prop("exist-branch") == 0)
+                      fallback();
+                    universal_ = false;
+                  }
+                if (complete_.is_true() && available != bddfalse)
+                  {
+                    if (prop("complete") == 1)
+                      fallback();
+                    complete_ = false;
+                  }
+              }
+          }
+
+        if (!declared_[start_])
+          fallback();
+        for (unsigned s = 0; s < declared_.size(); ++s)
+          if (!declared_[s])
+            {
+              if (used_[s] || (complete_ && prop("complete") == 1))
+                fallback();
+              complete_ = false;
+            }
+        if ((complete_ && prop("complete") == 0)
+            || (universal_ && prop("deterministic") == 0)
+            || (universal_.is_true() && prop("exist-branch") == 1)
+            || prop("univ-branch") == 1)
+          fallback();
+      }
+    };
+  }
+
+  parsed_aut_ptr
+  hoa_fast_parse(const std::string& filename, const bdd_dict_ptr& dict,
+                 environment& env, const automaton_parser_options& opts)
+  {
+    if (opts.want_kripke || opts.debug || filename == "-")
+      return nullptr;
+    mapped_file f(filename);
+    if (!f.data())
+      return nullptr;
+    try
+      {
+        hoa_fast_reader r(f.data(), f.data() + f.size(), dict, env,
+                          opts.trust_hoa);
+        auto pa = std::make_shared<parsed_aut>(filename);
+        pa->type = parsed_aut_type::HOA;
+        pa->aut = r.run();
+        return pa;
+      }
+    catch (const hoa_fallback&)
+      {
+        return nullptr;
+      }
+  }
+}
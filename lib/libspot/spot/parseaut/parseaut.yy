@@ -2629,10 +2629,86 @@ namespace spot
     return r.h;
   }
 
+  bool
+  automaton_stream_parser::skip()
+  {
+    typedef hoayy::parser::token token;
+    hoayy::parser::semantic_type val;
+    spot::location loc = last_loc;
+    spot::parse_aut_error_list errors;
+    hoayyreset(scanner_);
+    // The first token of the automaton tells how it ends.  Any
+    // leading garbage is skipped with the automaton that follows, as
+    // parse() reports it with that automaton.
+    int kind = 0;
+    int braces = 0;
+    bool seen = false;
+    for (;;)
+      {
+	int t;
+	try
+	  {
+	    t = hoayylex(&val, &loc, scanner_, errors);
+	  }
+	catch (const spot::hoa_abort&)
+	  {
+	    if (!opts_.ignore_abort)
+	      {
+		seen = true;
+		break;
+	      }
+	    kind = 0;
+	    continue;
+	  }
+	switch (t)
+	  {
+	  case token::IDENTIFIER:
+	  case token::HEADERNAME:
+	  case token::ANAME:
+	  case token::STRING:
+	  case token::FORMULA:
+	    delete val.str;
+	    break;
+	  default:
+	    break;
+	  }
+	if (t == token::ENDOFFILE)
+	  break;
+	seen = true;
+	if (!kind)
+	  {
+	    if (t == token::HOA || t == token::NEVER || t == token::LBTT
+		|| t == token::DRA || t == token::DSA)
+	      kind = t;
+	    continue;
+	  }
+	if ((kind == token::HOA && t == token::END)
+	    || (kind == token::LBTT
+		&& (t == token::ENDAUT || t == token::LBTT_EMPTY))
+	    || ((kind == token::DRA || kind == token::DSA)
+		&& t == token::ENDDSTAR))
+	  break;
+	if (kind == token::NEVER)
+	  {
+	    if (t == '{')
+	      ++braces;
+	    else if (t == '}' && --braces == 0)
+	      break;
+	  }
+      }
+    last_loc = loc;
+    last_loc.step();
+    return seen;
+  }
+
   parsed_aut_ptr
   parse_aut(const std::string& filename, const bdd_dict_ptr& dict,
 	    environment& env, automaton_parser_options opts)
   {
+    // Most large files are in the subset of HOA supported by the
+    // fast reader; the others go through the full parser.
+    if (auto pa = hoa_fast_parse(filename, dict, env, opts))
+      return pa;
     auto localopts = opts;
     localopts.raise_errors = false;
     parsed_aut_ptr pa;
@@ -43,4 +43,13 @@ namespace spot
   {
     spot::location pos;
   };
+
+  // Read the first automaton of \a filename with the reader of
+  // fasthoa.cc.  Returns nullptr if the file uses anything outside
+  // of the subset of HOA supported by this reader, so that the caller
+  // can fall back to the Bison parser.
+  parsed_aut_ptr hoa_fast_parse(const std::string& filename,
+                                const bdd_dict_ptr& dict,
+                                environment& env,
+                                const automaton_parser_options& opts);
 }
@@ -170,6 +170,20 @@ namespace spot
     parsed_aut_ptr parse(const bdd_dict_ptr& dict,
                          environment& env =
                          default_environment::instance());
+
+    /// \brief Skip the next automaton in the stream.
+    ///
+    /// This only tokenizes the input up to the end of the next
+    /// automaton, without building it, so that the following call to
+    /// parse() reads the automaton after it.  Aborted automata are
+    /// skipped as parse() would return them, i.e., only if the parser
+    /// is not configured to ignore them.
+    ///
+    /// \return false if the end of the stream was reached without
+    /// anything to skip.
+    ///
+    /// \warning This function is not reentrant.
+    bool skip();
   };
 
   /// \brief Read the first spot::twa_graph from a file.
@@ -1038,6 +1038,17 @@ tlyy::parser::error(const location_type& location, const std::string& message)
   error_list.emplace_back(location, message);
 }
 
+#ifdef BUDDY_THREAD_LOCAL
+#include <mutex>
+// The formula table is per-thread in this configuration, but the
+// scanner is not reentrant: parse one string at a time.  The lock
+// is recursive because blocks are parsed by recursive calls.
+static std::recursive_mutex parse_mutex;
+# define PARSE_LOCK std::lock_guard<std::recursive_mutex> lock(parse_mutex)
+#else
+# define PARSE_LOCK (void)0
+#endif
+
 namespace spot
 {
   parsed_formula
@@ -1045,6 +1056,7 @@ namespace spot
 		  environment& env,
 		  bool debug, bool lenient)
   {
+    PARSE_LOCK;
     parsed_formula result(ltl_string);
     flex_set_buffer(ltl_string,
 		    tlyy::parser::token::START_LTL,
@@ -1061,6 +1073,7 @@ namespace spot
 		      environment& env,
 		      bool debug, bool lenient)
   {
+    PARSE_LOCK;
     parsed_formula result(ltl_string);
     flex_set_buffer(ltl_string,
 		    tlyy::parser::token::START_BOOL,
@@ -1077,6 +1090,7 @@ namespace spot
 		   environment& env,
 		   bool debug)
   {
+    PARSE_LOCK;
     parsed_formula result(ltl_string);
     flex_set_buffer(ltl_string,
 		    tlyy::parser::token::START_LBT,
@@ -1094,6 +1108,7 @@ namespace spot
 		   bool debug,
 		   bool lenient)
   {
+    PARSE_LOCK;
     parsed_formula result(sere_string);
     flex_set_buffer(sere_string,
 		    tlyy::parser::token::START_SERE,
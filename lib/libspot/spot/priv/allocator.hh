@@ -41,7 +41,9 @@ namespace spot
   ///   moving allocator (constructor and assignment) must not throw
   ///
   /// WARNING this class is NOT thread-safe: the allocator relies on a static
-  ///   fixed_size_pool (which is not thread-safe either).
+  ///   fixed_size_pool (which is not thread-safe either).  When compiled
+  ///   with BUDDY_THREAD_LOCAL the pool is per-thread, so containers
+  ///   using it must not be shared between threads.
   template<class T>
   class pool_allocator
   {
@@ -49,7 +51,11 @@ namespace spot
     fixed_size_pool&
     pool()
     {
+#ifdef BUDDY_THREAD_LOCAL
+      static thread_local fixed_size_pool p = fixed_size_pool(sizeof(T));
+#else
       static fixed_size_pool p = fixed_size_pool(sizeof(T));
+#endif
       return p;
     }
 
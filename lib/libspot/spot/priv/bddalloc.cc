@@ -30,7 +30,11 @@
 namespace spot
 {
 
+#ifdef BUDDY_THREAD_LOCAL
+  thread_local bool bdd_allocator::initialized = false;
+#else
   bool bdd_allocator::initialized = false;
+#endif
 
   static void show_bdd_stats()
   {
@@ -46,6 +50,13 @@ namespace spot
               << " hashsize=" << s.hashsize
               << " gbcnum=" << s.gbcnum
               << '\n';
+    static const char* names[BDD_OPCACHENUM] =
+      { "apply", "ite", "quant", "appex", "replace", "misc" };
+    std::cerr << "spot: BDD caches:";
+    for (int n = 0; n < BDD_OPCACHENUM; ++n)
+      std::cerr << ' ' << names[n] << '=' << s.opcache[n].size
+                << '/' << s.opcache[n].hit << '/' << s.opcache[n].miss;
+    std::cerr << " (size/hits/misses)\n";
   }
 
   static void resize_handler(int oldsize, int newsize)
@@ -57,7 +57,12 @@ namespace spot
 
     using free_list::dump_free_list;
   protected:
+#ifdef BUDDY_THREAD_LOCAL
+    // Each thread runs its own BuDDy instance.
+    static thread_local bool initialized;
+#else
     static bool initialized; ///< Whether the BDD library has been initialized.
+#endif
     int lvarnum; ///< number of variables in use in this allocator.
   private:
     /// Require more variables.
@@ -93,7 +93,7 @@ namespace spot
 
       std::set<const fnode*, formula_cmp> uniq;
     };
-    static maps_t m;
+    static SPOT_FNODE_TLS maps_t m;
 
     static void
     gather_bool(vec& v, op o)
@@ -1060,11 +1060,12 @@ namespace spot
     return i->second;
   }
 
-  size_t fnode::next_id_ = 0U;
-  const fnode* fnode::ff_ = new fnode(op::ff, {});
-  const fnode* fnode::tt_ = new fnode(op::tt, {});
-  const fnode* fnode::ew_ = new fnode(op::eword, {});
-  const fnode* fnode::one_star_ = nullptr; // Only built when necessary.
+  SPOT_FNODE_TLS size_t fnode::next_id_ = 0U;
+  SPOT_FNODE_TLS const fnode* fnode::ff_ = new fnode(op::ff, {});
+  SPOT_FNODE_TLS const fnode* fnode::tt_ = new fnode(op::tt, {});
+  SPOT_FNODE_TLS const fnode* fnode::ew_ = new fnode(op::eword, {});
+  // Only built when necessary.
+  SPOT_FNODE_TLS const fnode* fnode::one_star_ = nullptr;
 
   void fnode::setup_props(op o)
   {
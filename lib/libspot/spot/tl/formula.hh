@@ -44,6 +44,7 @@
 /// \ingroup tl
 
 #include <spot/misc/common.hh>
+#include <spot/misc/_config.h>
 #include <memory>
 #include <cstdint>
 #include <initializer_list>
@@ -101,6 +102,17 @@ namespace spot
   };
 
 #ifndef SWIG
+  // When BuDDy is compiled with -DBUDDY_THREAD_LOCAL, every thread
+  // also gets its own table of formulas, so that threads can build
+  // formulas concurrently.  Like BDDs, formulas must then not be
+  // passed between threads.  configure records this setting in
+  // spot/misc/_config.h, so that client code agrees with the library.
+#ifdef SPOT_BUDDY_THREAD_LOCAL
+#  define SPOT_FNODE_TLS thread_local
+#else
+#  define SPOT_FNODE_TLS
+#endif
+
   /// \brief Actual storage for formula nodes.
   ///
   /// spot::formula objects contain references to instances of this
@@ -547,10 +559,10 @@ namespace spot
         setup_props(o);
       }
 
-      static const fnode* ff_;
-      static const fnode* tt_;
-      static const fnode* ew_;
-      static const fnode* one_star_;
+      static SPOT_FNODE_TLS const fnode* ff_;
+      static SPOT_FNODE_TLS const fnode* tt_;
+      static SPOT_FNODE_TLS const fnode* ew_;
+      static SPOT_FNODE_TLS const fnode* one_star_;
 
       op op_;                      // operator
       uint8_t min_;                // range minimum (for star-like operators)
@@ -559,7 +571,7 @@ namespace spot
       uint16_t size_;              // number of children
       mutable uint16_t refs_ = 0;  // reference count - 1;
       size_t id_;                  // Also used as hash.
-      static size_t next_id_;
+      static SPOT_FNODE_TLS size_t next_id_;
 
       struct ltl_prop
       {
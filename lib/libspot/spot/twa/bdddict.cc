@@ -24,6 +24,7 @@
 #include <ostream>
 #include <sstream>
 #include <cassert>
+#include <unordered_map>
 #include <spot/tl/print.hh>
 #include <spot/tl/formula.hh>
 #include <spot/tl/defaultenv.hh>
@@ -93,6 +94,31 @@ namespace spot
     /// List of unused anonymous variable number for each automaton.
     typedef std::map<const void*, anon_free_list> free_anonymous_list_of_type;
     free_anonymous_list_of_type free_anonymous_list_of;
+
+    /// Labels formatted by bdd_format_formula(), keyed by BDD id,
+    /// without and with UTF-8.  The BDD is kept along with its label
+    /// so that its id cannot be reused while it is cached.
+    typedef std::unordered_map<int, std::pair<bdd, std::string>> label_map;
+    label_map labels[2];
+    /// Number of garbage collections when the labels were cached.
+    int labels_gbcnum = 0;
+
+    void check_labels()
+    {
+      bddStat s;
+      bdd_stats(&s);
+      if (s.gbcnum != labels_gbcnum)
+        {
+          clear_labels();
+          labels_gbcnum = s.gbcnum;
+        }
+    }
+
+    void clear_labels()
+    {
+      labels[0].clear();
+      labels[1].clear();
+    }
   };
 
   bdd_dict::bdd_dict()
@@ -261,6 +287,28 @@ namespace spot
     priv_->release_variables(v, 1);
     bdd_map[v].type = anon;
     bdd_map[v].f = nullptr;
+    // The variable may be reused for another proposition.
+    priv_->clear_labels();
+  }
+
+  const std::string*
+  bdd_dict::cached_label(bdd b, bool utf8)
+  {
+    priv_->check_labels();
+    auto& labels = priv_->labels[utf8];
+    auto i = labels.find(b.id());
+    if (i == labels.end())
+      return nullptr;
+    return &i->second.second;
+  }
+
+  const std::string&
+  bdd_dict::cache_label(bdd b, bool utf8, std::string label)
+  {
+    priv_->check_labels();
+    auto& labels = priv_->labels[utf8];
+    return labels.emplace(b.id(), std::make_pair(b, std::move(label)))
+      .first->second.second;
   }
 
   void
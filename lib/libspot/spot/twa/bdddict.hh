@@ -25,6 +25,7 @@
 #include <list>
 #include <set>
 #include <map>
+#include <string>
 #include <iosfwd>
 #include <bddx.h>
 #include <vector>
@@ -215,6 +216,17 @@ namespace spot
     }
     /// @}
 
+    /// \brief Look up a label cached by bdd_format_formula().
+    ///
+    /// Labels are keyed by the id of \a b.  The cache is emptied
+    /// whenever BuDDy collects garbage, and whenever a variable is
+    /// released.  Returns nullptr if \a b has no cached label.
+    const std::string* cached_label(bdd b, bool utf8);
+
+    /// \brief Cache the label of \a b, as formatted by
+    /// bdd_format_formula().
+    const std::string& cache_label(bdd b, bool utf8, std::string label);
+
     /// \brief Dump all variables for debugging.
     /// \param os The output stream.
     std::ostream& dump(std::ostream& os) const;
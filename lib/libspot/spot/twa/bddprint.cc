@@ -22,23 +22,30 @@
 
 #include "config.h"
 #include <sstream>
+#include <unordered_map>
 #include <cassert>
 #include <ostream>
 #include <spot/twa/bddprint.hh>
 #include <spot/tl/print.hh>
 #include <spot/twa/formula2bdd.hh>
+#include <spot/twa/twagraph.hh>
 #include <spot/misc/minato.hh>
 
 namespace spot
 {
-  /// Global dictionary used by print_handler() to lookup variables.
-  static bdd_dict* dict;
+  // The following variables pass the state of a printing function
+  // to the BuDDy callbacks, which take no user data.  They are
+  // thread-local so that threads with their own BDD package can
+  // print concurrently.
 
-  /// Global flag to enable Acc[x] output (instead of `x').
-  static bool want_acc;
+  /// Dictionary used by print_handler() to lookup variables.
+  static thread_local bdd_dict* dict;
 
-  /// Global flag to enable UTF-8 output.
-  static bool utf8;
+  /// Flag to enable Acc[x] output (instead of `x').
+  static thread_local bool want_acc;
+
+  /// Flag to enable UTF-8 output.
+  static thread_local bool utf8;
 
   static
   std::ostream& print_(std::ostream& o, formula f)
@@ -79,7 +86,7 @@ namespace spot
   }
 
 
-  static std::ostream* where;
+  static thread_local std::ostream* where;
   static void
   print_sat_handler(signed char* varset, int size)
   {
@@ -109,7 +116,7 @@ namespace spot
     return os;
   }
 
-  static bool first_done = false;
+  static thread_local bool first_done = false;
   static void
   print_accset_handler(signed char* varset, int size)
   {
@@ -173,15 +180,41 @@ namespace spot
   std::ostream&
   bdd_print_formula(std::ostream& os, const bdd_dict_ptr& d, bdd b)
   {
-    return print_(os, bdd_to_formula(b, d));
+    return os << bdd_format_formula(d, b);
   }
 
   std::string
   bdd_format_formula(const bdd_dict_ptr& d, bdd b)
   {
+    if (const std::string* label = d->cached_label(b, utf8))
+      return *label;
     std::ostringstream os;
-    bdd_print_formula(os, d, b);
-    return os.str();
+    print_(os, bdd_to_formula(b, d));
+    return d->cache_label(b, utf8, os.str());
+  }
+
+  std::vector<std::string>
+  bdd_format_edge_labels(const const_twa_graph_ptr& aut)
+  {
+    const bdd_dict_ptr& d = aut->get_dict();
+    auto& edges = aut->edge_vector();
+    unsigned n = edges.size();
+    std::vector<std::string> res(n);
+    // Edges with the same condition share a label; remember the last
+    // edge formatted for each condition, and copy its label.
+    std::unordered_map<int, unsigned> seen;
+    for (unsigned e = 1; e < n; ++e)
+      {
+        if (aut->is_dead_edge(e))
+          continue;
+        bdd cond = edges[e].cond;
+        auto p = seen.emplace(cond.id(), e);
+        if (p.second)
+          res[e] = bdd_format_formula(d, cond);
+        else
+          res[e] = res[p.first->second];
+      }
+    return res;
   }
 
   void
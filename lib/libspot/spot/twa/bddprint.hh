@@ -24,7 +24,9 @@
 
 #include <string>
 #include <iosfwd>
+#include <vector>
 #include <spot/twa/bdddict.hh>
+#include <spot/twa/fwd.hh>
 #include <bddx.h>
 
 namespace spot
@@ -92,9 +94,23 @@ namespace spot
   /// \param dict The dictionary to use, to lookup variables.
   /// \param b The BDD to print.
   /// \return The BDD formated as a string.
+  ///
+  /// Labels are cached in \a dict, keyed by the BDD, so formatting
+  /// the same condition again only costs a lookup.
   SPOT_API std::string
   bdd_format_formula(const bdd_dict_ptr& dict, bdd b);
 
+  /// \brief Format the conditions of all edges of an automaton.
+  ///
+  /// Each distinct condition is formatted once, with
+  /// bdd_format_formula().
+  /// \param aut The automaton whose edges should be labeled.
+  /// \return A vector indexed by edge number (see
+  /// twa_graph::edge_number()); entries of dead edges, and the entry
+  /// 0, are empty.
+  SPOT_API std::vector<std::string>
+  bdd_format_edge_labels(const const_twa_graph_ptr& aut);
+
   /// \brief Enable UTF-8 output for bdd printers.
   SPOT_API void enable_utf8();
 
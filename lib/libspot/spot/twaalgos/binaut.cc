@@ -0,0 +1,381 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+#include <spot/twaalgos/binaut.hh>
+#include <spot/twa/twagraph.hh>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace spot
+{
+  namespace
+  {
+    // Format: magic, atomic propositions, acceptance, properties,
+    // automaton name, states and initial state, universal destinations, BDD nodes,
+    // and edges grouped by source state.  All integers are unsigned
+    // LEB128 varints.  BDD nodes are numbered from 2 (0 and 1 are the
+    // constants) in an order where children precede their parents.
+    static const char magic[8] = { 'S', 'P', 'O', 'T', 'B', 'I', 'N', 1 };
+
+    class bin_writer final
+    {
+      std::string& out_;
+    public:
+      explicit bin_writer(std::string& out)
+        : out_(out)
+      {
+      }
+
+      void num(unsigned long v)
+      {
+        while (v >= 0x80)
+          {
+            out_.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+          }
+        out_.push_back(static_cast<char>(v));
+      }
+
+      void str(const std::string& s)
+      {
+        num(s.size());
+        out_.append(s);
+      }
+    };
+
+    class bin_reader final
+    {
+      const char* pos_;
+      const char* end_;
+    public:
+      bin_reader(const char* begin, const char* end)
+        : pos_(begin), end_(end)
+      {
+      }
+
+      [[noreturn]] static void error(const char* what)
+      {
+        throw std::runtime_error(std::string("load_binary_aut(): ") + what);
+      }
+
+      unsigned long num()
+      {
+        unsigned long v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+          {
+            if (SPOT_UNLIKELY(pos_ == end_))
+              error("truncated input");
+            unsigned char c = *pos_++;
+            v |= static_cast<unsigned long>(c & 0x7f) << shift;
+            if (!(c & 0x80))
+              return v;
+          }
+        error("invalid number");
+      }
+
+      unsigned num(unsigned long limit, const char* what)
+      {
+        unsigned long v = num();
+        if (SPOT_UNLIKELY(v >= limit))
+          error(what);
+        return v;
+      }
+
+      // Read the number of items that follow, knowing that each of
+      // them takes at least SIZE bytes: a corrupt count is rejected
+      // before anything is allocated for it.
+      unsigned count(unsigned size, const char* what)
+      {
+        unsigned long left = (end_ - pos_) / size;
+        unsigned long max = std::numeric_limits<unsigned>::max() - 2;
+        return num((left < max ? left : max) + 1, what);
+      }
+
+      std::string str()
+      {
+        unsigned long len = num();
+        if (SPOT_UNLIKELY(len > static_cast<unsigned long>(end_ - pos_)))
+          error("truncated input");
+        std::string res(pos_, len);
+        pos_ += len;
+        return res;
+      }
+
+      void expect(const char* data, size_t len)
+      {
+        if (static_cast<size_t>(end_ - pos_) < len
+            || memcmp(pos_, data, len))
+          error("not a binary automaton");
+        pos_ += len;
+      }
+    };
+
+    // Properties, in the order they are saved.
+    typedef trival (twa::*prop_getter)() const;
+    typedef void (twa::*prop_setter)(trival);
+    static const struct
+    {
+      prop_getter get;
+      prop_setter set;
+    } props[] = {
+      { &twa::prop_state_acc, &twa::prop_state_acc },
+      { &twa::prop_inherently_weak, &twa::prop_inherently_weak },
+      { &twa::prop_weak, &twa::prop_weak },
+      { &twa::prop_very_weak, &twa::prop_very_weak },
+      { &twa::prop_terminal, &twa::prop_terminal },
+      { &twa::prop_complete, &twa::prop_complete },
+      { &twa::prop_universal, &twa::prop_universal },
+      { &twa::prop_unambiguous, &twa::prop_unambiguous },
+      { &twa::prop_semi_deterministic, &twa::prop_semi_deterministic },
+      { &twa::prop_stutter_invariant, &twa::prop_stutter_invariant },
+    };
+
+    // Number the nodes of a BDD, children first.
+    static unsigned
+    number_nodes(bdd b, std::unordered_map<int, unsigned>& num,
+                 const std::unordered_map<int, unsigned>& var2ap,
+                 bin_writer& w)
+    {
+      int id = b.id();
+      if (id < 2)
+        return id;
+      auto it = num.find(id);
+      if (it != num.end())
+        return it->second;
+      auto ap = var2ap.find(bdd_var(b));
+      if (SPOT_UNLIKELY(ap == var2ap.end()))
+        throw std::runtime_error("save_binary_aut(): edge label uses a "
+                                 "variable that is not an atomic "
+                                 "proposition of the automaton");
+      unsigned low = number_nodes(bdd_low(b), num, var2ap, w);
+      unsigned high = number_nodes(bdd_high(b), num, var2ap, w);
+      unsigned res = num.size() + 2;
+      num.emplace(id, res);
+      w.num(ap->second);
+      w.num(low);
+      w.num(high);
+      return res;
+    }
+  }
+
+  std::ostream&
+  save_binary_aut(std::ostream& os, const const_twa_graph_ptr& aut)
+  {
+    std::string out;
+    bin_writer w(out);
+    out.append(magic, sizeof magic);
+
+    const std::vector<formula>& aps = aut->ap();
+    bdd_dict_ptr dict = aut->get_dict();
+    std::unordered_map<int, unsigned> var2ap;
+    w.num(aps.size());
+    for (unsigned i = 0; i < aps.size(); ++i)
+      {
+        w.str(aps[i].ap_name());
+        var2ap.emplace(dict->varnum(aps[i]), i);
+      }
+
+    w.num(aut->num_sets());
+    {
+      std::ostringstream acc;
+      acc << aut->get_acceptance();
+      w.str(acc.str());
+    }
+
+    for (auto& p: props)
+      w.num(((*aut).*(p.get))().val() + 1);
+
+    // The name is preceded by a flag, since it may be empty.
+    if (auto name = aut->get_named_prop<std::string>("automaton-name"))
+      {
+        w.num(1);
+        w.str(*name);
+      }
+    else
+      {
+        w.num(0);
+      }
+
+    auto& g = aut->get_graph();
+    unsigned ns = aut->num_states();
+    w.num(ns);
+    w.num(aut->get_init_state_number());
+    const auto& dests = g.dests_vector();
+    w.num(dests.size());
+    for (unsigned d: dests)
+      w.num(d);
+
+    // Collect the distinct labels first, so that all nodes come before
+    // the edges and the loader can build every BDD in one pass.
+    std::unordered_map<int, unsigned> nodenum;
+    std::unordered_map<int, unsigned> labels;
+    std::string nodes;
+    bin_writer nw(nodes);
+    for (unsigned s = 0; s < ns; ++s)
+      for (auto& e: aut->out(s))
+        if (labels.find(e.cond.id()) == labels.end())
+          labels.emplace(e.cond.id(),
+                         number_nodes(e.cond, nodenum, var2ap, nw));
+    w.num(nodenum.size());
+    out.append(nodes);
+
+    for (unsigned s = 0; s < ns; ++s)
+      {
+        unsigned deg = 0;
+        for (auto& e: aut->out(s))
+          {
+            (void) e;
+            ++deg;
+          }
+        w.num(deg);
+        for (auto& e: aut->out(s))
+          {
+            w.num(e.dst);
+            w.num(labels[e.cond.id()]);
+            w.num(e.acc.count());
+            for (unsigned m: e.acc.sets())
+              w.num(m);
+          }
+      }
+
+    return os.write(out.data(), out.size());
+  }
+
+  twa_graph_ptr
+  load_binary_aut(std::istream& is, const bdd_dict_ptr& dict)
+  {
+    std::ostringstream buf;
+    buf << is.rdbuf();
+    std::string in = buf.str();
+    bin_reader r(in.data(), in.data() + in.size());
+    r.expect(magic, sizeof magic);
+
+    auto aut = make_twa_graph(dict);
+
+    unsigned nap = r.count(1, "invalid number of atomic propositions");
+    std::vector<bdd> apvar;
+    apvar.reserve(nap);
+    for (unsigned i = 0; i < nap; ++i)
+      apvar.emplace_back(bdd_ithvar(aut->register_ap(r.str())));
+
+    unsigned nsets = r.num(acc_cond::mark_t::max_accsets() + 1,
+                           "too many acceptance sets");
+    {
+      std::string acc = r.str();
+      try
+        {
+          aut->set_acceptance(nsets, acc_cond::acc_code(acc.c_str()));
+        }
+      catch (const std::exception&)
+        {
+          bin_reader::error("invalid acceptance condition");
+        }
+    }
+
+    for (auto& p: props)
+      {
+        unsigned v = r.num(3, "invalid property");
+        ((*aut).*(p.set))(trival(static_cast<trival::value_t>(v - 1)));
+      }
+
+    if (r.num(2, "invalid automaton name"))
+      aut->set_named_prop("automaton-name", new std::string(r.str()));
+
+    unsigned ns = r.count(1, "invalid number of states");
+    unsigned init = r.num();
+    unsigned nd = r.count(1, "invalid number of universal destinations");
+    auto& g = aut->get_graph();
+    auto& dests = g.dests_vector();
+    dests.reserve(nd);
+    // Each group is a count followed by that many states.  Remember
+    // where groups start, so that a destination pointing inside a
+    // group cannot be taken for a count.
+    std::vector<bool> group_start(nd, false);
+    while (dests.size() < nd)
+      {
+        group_start[dests.size()] = true;
+        unsigned n = r.num(nd - dests.size(),
+                           "invalid universal destination");
+        dests.push_back(n);
+        while (n--)
+          dests.push_back(r.num(ns, "invalid universal destination"));
+      }
+    auto check_dst = [&](unsigned d)
+      {
+        if (twa_graph::is_univ_dest(d))
+          {
+            // Groups have at least two states, as set_init_state()
+            // and new_univ_edge() expect.
+            unsigned u = ~d;
+            if (u >= nd || !group_start[u] || dests[u] < 2)
+              bin_reader::error("invalid universal destination");
+            for (unsigned i = 1; i <= dests[u]; ++i)
+              if (dests[u + i] >= ns)
+                bin_reader::error("invalid universal destination");
+          }
+        else if (d >= ns)
+          {
+            bin_reader::error("invalid destination state");
+          }
+      };
+
+    unsigned nn = r.count(3, "invalid number of BDD nodes");
+    std::vector<bdd> nodes;
+    nodes.reserve(nn + 2);
+    nodes.emplace_back(bddfalse);
+    nodes.emplace_back(bddtrue);
+    for (unsigned i = 0; i < nn; ++i)
+      {
+        unsigned ap = r.num(nap, "invalid atomic proposition");
+        unsigned low = r.num(nodes.size(), "invalid BDD node");
+        unsigned high = r.num(nodes.size(), "invalid BDD node");
+        nodes.emplace_back(bdd_ite(apvar[ap], nodes[high], nodes[low]));
+      }
+
+    aut->new_states(ns);
+    if (ns > 0)
+      {
+        check_dst(init);
+        aut->set_init_state(init);
+      }
+    for (unsigned s = 0; s < ns; ++s)
+      {
+        unsigned deg = r.num();
+        while (deg--)
+          {
+            unsigned dst = r.num();
+            check_dst(dst);
+            unsigned cond = r.num(nodes.size(), "invalid BDD node");
+            unsigned nm = r.num(nsets + 1, "invalid acceptance mark");
+            acc_cond::mark_t acc = {};
+            while (nm--)
+              acc.set(r.num(nsets, "invalid acceptance mark"));
+            aut->new_edge(s, dst, nodes[cond], acc);
+          }
+      }
+    return aut;
+  }
+}
@@ -0,0 +1,54 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <iosfwd>
+#include <spot/misc/common.hh>
+#include <spot/twa/fwd.hh>
+#include <spot/twa/bdddict.hh>
+
+namespace spot
+{
+  /// \ingroup twa_io
+  /// \brief Save an automaton in a compact binary format.
+  ///
+  /// The output contains the atomic propositions of the automaton,
+  /// its acceptance condition and properties, a single BDD node graph
+  /// shared by all edge labels (each distinct node is stored once,
+  /// with variables referring to the list of atomic propositions),
+  /// and the edges of each state in order.  Universal edges are
+  /// supported.  The only named property saved is the name of the
+  /// automaton; others (like state names) are dropped.
+  ///
+  /// The format is meant for fast persistence between runs of the
+  /// same version of Spot; use print_hoa() for interchange.
+  SPOT_API std::ostream&
+  save_binary_aut(std::ostream& os, const const_twa_graph_ptr& aut);
+
+  /// \ingroup twa_io
+  /// \brief Load an automaton saved by save_binary_aut().
+  ///
+  /// The atomic propositions are registered in \a dict, and all the
+  /// edge labels are rebuilt in one pass over the saved node graph,
+  /// children first.  Throws std::runtime_error if the input is not
+  /// a valid binary automaton.
+  SPOT_API twa_graph_ptr
+  load_binary_aut(std::istream& is, const bdd_dict_ptr& dict);
+}
@@ -0,0 +1,70 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+#include <iostream>
+#include <sstream>
+#include <spot/tl/parse.hh>
+#include <spot/tl/print.hh>
+#include <spot/twa/bddprint.hh>
+#include <spot/twa/formula2bdd.hh>
+#include <spot/twaalgos/translate.hh>
+
+// Compare the labels returned by bdd_format_edge_labels() with labels
+// formatted without the cache, before and after a garbage collection,
+// and after the variables of the automaton have been released and
+// reused for other propositions.
+static int
+check(const spot::twa_graph_ptr& aut)
+{
+  int res = 0;
+  auto labels = spot::bdd_format_edge_labels(aut);
+  for (auto& e: aut->edges())
+    {
+      std::ostringstream expected;
+      spot::print_psl(expected,
+                      spot::bdd_to_formula(e.cond, aut->get_dict()));
+      const std::string& got = labels[aut->edge_number(e)];
+      if (got != expected.str()
+          || got != spot::bdd_format_formula(aut->get_dict(), e.cond))
+        {
+          std::cerr << "got " << got << ", expected "
+                    << expected.str() << '\n';
+          res = 1;
+        }
+      std::cout << e.src << ' ' << got << ' ' << e.dst << '\n';
+    }
+  return res;
+}
+
+int main(int argc, char** argv)
+{
+  int res = 0;
+  auto dict = spot::make_bdd_dict();
+  spot::translator trans(dict);
+  for (int i = 1; i < argc; ++i)
+    {
+      auto aut = trans.run(spot::parse_formula(argv[i]));
+      res |= check(aut);
+      bdd_gbc();
+      res |= check(aut);
+    }
+  return res;
+}
@@ -0,0 +1,163 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <spot/parseaut/public.hh>
+#include <spot/twaalgos/binaut.hh>
+#include <spot/twaalgos/hoa.hh>
+
+// Save each automaton of the input file in binary, load it back in
+// another dictionary, and check that both print the same.  Then make
+// sure that truncated inputs are rejected, and that a huge number
+// anywhere in the input is rejected or ignored without allocating
+// for it.  Finally, check that a universal destination pointing
+// inside a group of destinations is rejected.
+
+static void
+put_num(std::string& out, unsigned long v)
+{
+  while (v >= 0x80)
+    {
+      out.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+  out.push_back(static_cast<char>(v));
+}
+
+// A 4-state automaton without edges whose universal destinations are
+// the groups {3, 0} (at offset 0) and {1, 2} (at offset 3).
+static std::string
+univ_aut(unsigned init)
+{
+  std::string out("SPOTBIN\1");
+  put_num(out, 1);              // APs
+  put_num(out, 1);
+  out += "a";
+  put_num(out, 0);              // acceptance sets
+  put_num(out, 1);
+  out += "t";
+  for (int i = 0; i < 10; ++i)  // properties
+    put_num(out, 1);
+  put_num(out, 0);              // no name
+  put_num(out, 4);              // states
+  put_num(out, init);
+  put_num(out, 6);              // universal destinations
+  for (unsigned d: { 2, 3, 0, 2, 1, 2 })
+    put_num(out, d);
+  put_num(out, 0);              // BDD nodes
+  for (int i = 0; i < 4; ++i)   // edges
+    put_num(out, 0);
+  return out;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+    return 2;
+  int return_value = 0;
+  unsigned count = 0;
+
+  spot::automaton_stream_parser parser(argv[1]);
+  auto dict = spot::make_bdd_dict();
+  while (auto paut = parser.parse(dict))
+    {
+      if (paut->format_errors(std::cerr))
+        return 2;
+      if (!paut->aut)
+        break;
+
+      std::ostringstream bin;
+      spot::save_binary_aut(bin, paut->aut);
+      std::istringstream in(bin.str());
+      auto aut = spot::load_binary_aut(in, spot::make_bdd_dict());
+
+      std::ostringstream orig;
+      std::ostringstream copy;
+      spot::print_hoa(orig, paut->aut);
+      spot::print_hoa(copy, aut);
+      if (orig.str() != copy.str())
+        {
+          std::cerr << "mismatch:\n" << orig.str() << "\n"
+                    << copy.str() << '\n';
+          return_value = 1;
+        }
+
+      std::string data = bin.str();
+      for (size_t len = 0; len < data.size(); len += 1 + len / 4)
+        {
+          std::istringstream part(data.substr(0, len));
+          try
+            {
+              spot::load_binary_aut(part, spot::make_bdd_dict());
+              std::cerr << "truncated input of " << len
+                        << " bytes was accepted\n";
+              return_value = 1;
+            }
+          catch (const std::runtime_error&)
+            {
+            }
+        }
+      for (size_t pos = 0; pos < data.size(); ++pos)
+        {
+          // Replace the number at POS by 2^32-1 or more.
+          std::string bad = data.substr(0, pos) + "\xff\xff\xff\xff\x0f"
+            + data.substr(std::min(pos + 5, data.size()));
+          std::istringstream part(bad);
+          try
+            {
+              spot::load_binary_aut(part, spot::make_bdd_dict());
+            }
+          catch (const std::runtime_error&)
+            {
+            }
+        }
+      ++count;
+    }
+
+  for (unsigned off: { 0U, 3U })
+    {
+      std::istringstream in(univ_aut(~off));
+      auto aut = spot::load_binary_aut(in, spot::make_bdd_dict());
+      auto init = aut->univ_dests(aut->get_init_state_number());
+      if (init.end() - init.begin() != 2)
+        {
+          std::cerr << "bad universal initial state\n";
+          return_value = 1;
+        }
+    }
+  for (unsigned off: { 1U, 2U, 4U, 5U, 6U })
+    {
+      std::istringstream in(univ_aut(~off));
+      try
+        {
+          spot::load_binary_aut(in, spot::make_bdd_dict());
+          std::cerr << "universal destination " << off
+                    << " inside a group was accepted\n";
+          return_value = 1;
+        }
+      catch (const std::runtime_error&)
+        {
+        }
+    }
+  std::cout << count << " automata\n";
+  return return_value;
+}
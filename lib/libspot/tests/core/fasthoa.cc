@@ -0,0 +1,69 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <spot/parseaut/public.hh>
+#include <spot/twaalgos/hoa.hh>
+
+// parse_aut() reads files in a subset of HOA without the Bison
+// parser.  Check that it returns the same automaton and the same
+// diagnostics as automaton_stream_parser, which always uses Bison.
+// With -f, only call parse_aut(), so that running with
+// SPOT_DEBUG_PARSER set shows whether Bison was used.
+static std::string
+show(const spot::parsed_aut_ptr& pa)
+{
+  std::ostringstream os;
+  pa->format_errors(os);
+  if (pa->aut)
+    spot::print_hoa(os, pa->aut);
+  return os.str();
+}
+
+int main(int argc, char** argv)
+{
+  int return_value = 0;
+  bool only_fast = argc > 1 && !strcmp(argv[1], "-f");
+  for (int i = 1 + only_fast; i < argc; ++i)
+    {
+      auto fast = spot::parse_aut(argv[i], spot::make_bdd_dict());
+      if (only_fast)
+        {
+          if (fast->format_errors(std::cerr))
+            return_value = 1;
+          continue;
+        }
+      spot::automaton_stream_parser parser(argv[i]);
+      auto full = parser.parse(spot::make_bdd_dict());
+      std::string f = show(fast);
+      std::string s = show(full);
+      if (f != s)
+        {
+          std::cerr << argv[i] << ": mismatch\n" << f << "\n" << s << '\n';
+          return_value = 1;
+        }
+      std::cout << argv[i] << ": "
+                << (full->errors.empty() ? "ok" : "errors") << '\n';
+    }
+  return return_value;
+}
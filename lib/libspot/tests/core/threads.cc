@@ -0,0 +1,95 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2019 Laboratoire de Recherche et Développement
+// de l'Epita (LRDE).
+//
+// This file is part of Spot, a model checking library.
+//
+// Spot is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// Spot is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <spot/tl/parse.hh>
+#include <spot/tl/print.hh>
+#include <spot/twa/bddprint.hh>
+#include <spot/twaalgos/translate.hh>
+#include <spot/twaalgos/product.hh>
+#include <bddx.h>
+
+// With -DBUDDY_THREAD_LOCAL, each thread has its own BDD package
+// and its own table of formulas.  Translate the same formulas on
+// two threads at the same time: both should build the same
+// automata, since they start from empty tables.
+
+static const char* inputs[] =
+  {
+    "GFa -> GFb",
+    "a U (b R c)",
+    "F(a & XXb) | G(c -> Fd)",
+    "(a U b) W GF(c xor d)",
+    "G(a -> F(b & X(c U d)))",
+    "FG(a | Xb) & GF!c",
+    "{a;b[*];c[+]}<>-> Fd",
+    "G(p0 -> (p1 U (p2 & !p3))) & F(p4 M p5)",
+    nullptr
+  };
+
+static void
+translate_all(std::string& res)
+{
+  std::ostringstream out;
+  auto dict = spot::make_bdd_dict();
+  spot::translator trans(dict);
+  for (int round = 0; round < 20; ++round)
+    for (const char** i = inputs; *i; ++i)
+      {
+        spot::formula f = spot::parse_formula(*i);
+        auto pos = trans.run(f);
+        auto neg = trans.run(spot::formula::Not(f));
+        if (!spot::product(pos, neg)->is_empty())
+          out << "error: " << f << " and its negation intersect\n";
+        if (round)
+          continue;
+        out << f << ": " << pos->num_states() << " states\n";
+        for (auto& e: pos->edges())
+          spot::bdd_print_formula(out << e.src << " -> " << e.dst << ' ',
+                                  dict, e.cond) << '\n';
+      }
+  res = out.str();
+}
+
+int
+main()
+{
+  if (!bdd_isthreadlocal())
+    {
+      std::cerr << "BuDDy was compiled without -DBUDDY_THREAD_LOCAL\n";
+      return 77;
+    }
+  std::string res1;
+  std::string res2;
+  std::thread t1(translate_all, std::ref(res1));
+  std::thread t2(translate_all, std::ref(res2));
+  t1.join();
+  t2.join();
+  std::cout << res1;
+  if (res1 != res2 || res1.find("error:") != std::string::npos)
+    {
+      std::cerr << "second thread:\n" << res2;
+      return 1;
+    }
+  return 0;
+}
@@ -525,7 +525,7 @@ std::string CJsonObject::ToString() const
     if (pJsonString != NULL)
     {
         strJsonData = pJsonString;
-        free(pJsonString);
+        cJSON_Free(pJsonString);
     }
     return(strJsonData);
 }
@@ -545,7 +545,7 @@ std::string CJsonObject::ToFormattedString() const
     if (pJsonString != NULL)
     {
         strJsonData = pJsonString;
-        free(pJsonString);
+        cJSON_Free(pJsonString);
     }
     return(strJsonData);
 }
@@ -574,7 +574,7 @@ bool CJsonObject::Get(const std::string& strKey, CJsonObject& oJsonObject) const
     }
     char* pJsonString = cJSON_Print(pJsonStruct);
     std::string strJsonData = pJsonString;
-    free(pJsonString);
+    cJSON_Free(pJsonString);
     if (oJsonObject.Parse(strJsonData))
     {
         return(true);
@@ -1875,7 +1875,7 @@ bool CJsonObject::Get(int iWhich, CJsonObject& oJsonObject) const
     }
     char* pJsonString = cJSON_Print(pJsonStruct);
     std::string strJsonData = pJsonString;
-    free(pJsonString);
+    cJSON_Free(pJsonString);
     if (oJsonObject.Parse(strJsonData))
     {
         return(true);
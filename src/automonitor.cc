@@ -5,6 +5,9 @@
 #include <string>
 #include <fstream> //Using ofstream
 #include <stack>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include <cstdio>
 
@@ -12,6 +15,7 @@
 #include <spot/twaalgos/translate.hh>
 #include <spot/twaalgos/hoa.hh>
 #include <spot/twaalgos/dot.hh>
+#include <spot/twaalgos/sccinfo.hh>
 
 #include <spot/twa/bddprint.hh>
 #include <spot/parseaut/public.hh>
@@ -31,18 +35,38 @@
 #include "util-parse.hh"
 
 #include "solidity.hh"
+#include "shm-ring.hh"
+#include "util-metrics.hh"
 
 extern "C"
 {
 
 #include "cJSON.h"
 }
+#include "event-decode.hh"
+#include "util-arena.hh"
+#include "monitor-reload.hh"
+#include "checkpoint.hh"
+#include "slice.hh"
+#include "router.hh"
+#include "timed.hh"
 
 using namespace std;
 
+#define AM_SHM_BATCH 256 //共享内存线程每次持有检测锁时最多检测的记录数
+
+//ZeroMQ和共享内存两个入口共用一个检测器(monitor, 计时, 检查点, 错误日志), 检测时持有此锁
+static std::mutex am_check_mutex;
+
 static int state_number = 0;
 static int Test_splitstr();
 
+/*bench等程序直接链接检测引擎时定义AUTOMONITOR_NO_MAIN*/
+#ifndef AUTOMONITOR_NO_MAIN
+static int Run_shm_server(SHMRing &ring, AMReloadCursor &cursor, AMTimed *timed, std::ofstream &errorLog);
+static int Setup_timed(YAML::Node &node, AMTimed &timed, std::ofstream &errorLog,
+                       std::function<void(const std::string &)> publish);
+
 int main(void)
 {
     FuncBegin();
@@ -57,12 +81,399 @@ int main(void)
 */
     std::ofstream errorLog(node["output"]["error_log"].as<std::string>(), std::ios::app);
 
+    if (node["log"])
+    {
+        int level = AMLogLevelFromString(node["log"]["level"].as<std::string>());
+        if (level < 0)
+        {
+            ErrorPrintNReturn(YAML_NODE_PARSE_ERROR);
+        }
+        AMLogInit(level, node["log"]["async"].as<bool>(), node["log"]["rate_limit"].as<unsigned>(),
+                  node["log"]["filename"].as<std::string>());
+    }
+
+    //router只转发事件, 不生成monitor; router启动的worker带有AUTOMONITOR_WORKER环境变量
+    const char *worker = getenv("AUTOMONITOR_WORKER");
+    if (worker == nullptr && node["router"] && node["router"]["enabled"].as<bool>() == true)
+    {
+        return Run_router(node);
+    }
+    bool sliced = worker != nullptr || (node["slice"] && node["slice"]["enabled"].as<bool>() == true);
+
+    spot::twa_graph_ptr aut;
+    if (Generate_automata(node, spot::make_bdd_dict(), aut) != SUCCESS)
+    {
+        AMReturn(ERROR);
+    }
+
+#if ZMQ == 1
+
+    const spot::bdd_dict_ptr &dict = aut->get_dict();
+
+    //Monitor表放在可以热加载替换的版本里
+    AMCompiled *initial = new AMCompiled();
+    initial->aut = aut;
+    Monitor &monitor = initial->monitor;
+
+    //读取所有的状态以及接受集，放入Monitor类型的容器中去。
+    if (node["solidity"] && node["solidity"]["format"].as<std::string>() == "packed")
+    {
+        Parse_automata_to_monitor(monitor, aut, dict);
+        std::string solfile = node["solidity"]["filename"].as<std::string>();
+        std::string contract = node["solidity"]["contract"].as<std::string>();
+        if (export_automata_to_solidity_packed(aut, solfile, contract) != SUCCESS)
+        {
+            ErrorPrintNReturn(ERROR);
+        }
+        std::string harness = node["solidity"]["gas_harness"].as<std::string>();
+        std::string harness_log = node["solidity"]["harness_log"].as<std::string>();
+        unsigned batch = node["solidity"]["harness_batch"].as<unsigned>();
+        if (!harness.empty() && !harness_log.empty())
+        {
+            export_solidity_gas_harness_from_log(aut, harness_log, harness, solfile, contract, batch);
+        }
+        else if (!harness.empty())
+        {
+            export_solidity_gas_harness(aut, harness, solfile, contract,
+                                        node["solidity"]["harness_events"].as<unsigned>(), batch);
+        }
+    }
+    else
+    {
+        export_automata_to_solidity(monitor, aut, dict);
+        Classify_monitor_states(monitor, aut);
+    }
+    monitor.state_number = aut->get_init_state_number(); //全局状态
+    monitor.init_state = monitor.state_number;
+    monitor.sampled = 0;
+    initial->fingerprint = AMMonitorFingerprint(monitor);
+    AMReloadPublishInitial(initial);
+
+    if (sliced && node["checkpoint"] && node["checkpoint"]["enabled"].as<bool>() == true)
+    {
+        INFOPrint("Checkpoint only covers the unsliced monitor, disabled with slice");
+    }
+    else if (node["checkpoint"] && node["checkpoint"]["enabled"].as<bool>() == true)
+    {
+        //从上次的检查点恢复状态, 只回放接收日志中检查点之后的事件
+        AMCheckpointState st;
+        std::string ckptfile = node["checkpoint"]["filename"].as<std::string>();
+        std::string journal = node["checkpoint"]["journal"].as<std::string>();
+        AMCheckpointRestore(ckptfile, journal, initial->fingerprint, aut, monitor, dict, errorLog, st);
+        if (AMCheckpointStart(ckptfile, journal, node["checkpoint"]["interval_ms"].as<unsigned>(), st) != SUCCESS)
+        {
+            ErrorPrintNReturn(CHECKPOINT_ERROR);
+        }
+    }
+
+    if (node["reload"] && node["reload"]["enabled"].as<bool>() == true)
+    {
+        int policy = AMReloadPolicyFromString(node["reload"]["policy"].as<std::string>());
+        if (policy < 0 || AMReloadStart("automonitor.yaml", (AMReloadPolicy)policy) != SUCCESS)
+        {
+            ErrorPrintNReturn(YAML_NODE_PARSE_ERROR);
+        }
+    }
+
+    if (worker == nullptr && node["metrics"] && node["metrics"]["enabled"].as<bool>() == true)
+    {
+        if (AMMetricsInit(aut->num_states(), node["metrics"]["http_addr"].as<std::string>(),
+                          node["metrics"]["dump_file"].as<std::string>(),
+                          node["metrics"]["dump_interval_ms"].as<unsigned>()) != SUCCESS)
+        {
+            ErrorPrintNReturn(ERROR);
+        }
+    }
+
+    //同一台主机上的客户端走共享内存环, 远程主机仍然连接下面的ZeroMQ套接字
+    SHMRing ring;
+    ring.fd = -1;
+    ring.hdr = nullptr;
+    ring.owner = 0;
+    bool shm_enabled = worker == nullptr && node["shm_transport"] && node["shm_transport"]["enabled"].as<bool>() == true;
+    if (shm_enabled)
+    {
+        if (sliced)
+        {
+            ERRORPrint("shm_transport records have no slice field, disable slice or shm_transport");
+            AMReturn(YAML_NODE_PARSE_ERROR);
+        }
+        std::string name = node["shm_transport"]["name"].as<std::string>();
+        size_t size = node["shm_transport"]["size_mb"].as<size_t>() << 20;
+        if (shm_ring_create(ring, name, size) != SUCCESS)
+        {
+            ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+        }
+    }
+
+    /*接受MQ发送过来的字符串*/
+    std::string addr = node["server_bind_addr"].as<std::string>(); //改为读取配置文件
+    if (worker != nullptr)
+    {
+        addr = getenv("AUTOMONITOR_BIND");
+    }
+    VePrint(addr);
+    zmq::context_t context(1);
+    zmq::socket_t socket(context, ZMQ_REP);
+
+    socket.bind(addr);
+    
+    INFOPrint("Sever has binded the address");
+
+    //有时间界限的性质: 没有事件时按超时唤醒, 截止时间过去就报告, 共享内存的客户端从环头部看到202
+    bool timed_enabled = node["timed"] && node["timed"]["enabled"].as<bool>() == true;
+    AMTimed timed;
+    zmq::socket_t *verdict_pub = nullptr;
+    if (timed_enabled)
+    {
+        std::string pub_addr = node["timed"]["verdict_pub"].as<std::string>();
+        if (!pub_addr.empty())
+        {
+            verdict_pub = new zmq::socket_t(context, ZMQ_PUB);
+            verdict_pub->bind(pub_addr);
+        }
+        if (Setup_timed(node, timed, errorLog, [verdict_pub, &ring](const std::string &v) {
+                if (verdict_pub != nullptr)
+                {
+                    zmq::message_t msg(v.data(), v.size());
+                    verdict_pub->send(msg);
+                }
+                if (ring.hdr != nullptr)
+                {
+                    ring.hdr->verdict.store(202, std::memory_order_release);
+                }
+            }) != SUCCESS)
+        {
+            ErrorPrintNReturn(TIMED_RULE_ERROR);
+        }
+    }
+    zmq::pollitem_t items[] = {{(void *)socket, 0, ZMQ_POLLIN, 0}};
+
+    //含转义字符的事件交给cJSON解析, 节点分配在每个事件结束时重置的arena上
+    AMArenaInstallJsonHooks();
+    AMArena eventArena;
+    AMArenaInit(eventArena);
+    AMReloadCursor cursor = {0, 0, 0};
+    AMSliceTable slices;
+    if (shm_enabled)
+    {
+        std::thread(Run_shm_server, std::ref(ring), std::ref(cursor), timed_enabled ? &timed : nullptr,
+                    std::ref(errorLog))
+            .detach();
+    }
+
+    while (1)
+    {
+
+        while (timed_enabled)
+        {
+            int timeout;
+            {
+                std::lock_guard<std::mutex> check(am_check_mutex);
+                timeout = AMTimedPollTimeout(timed);
+            }
+            zmq::poll(items, 1, timeout);
+            if (items[0].revents & ZMQ_POLLIN)
+            {
+                break;
+            }
+            std::lock_guard<std::mutex> check(am_check_mutex);
+            AMTimedIdle(timed);
+        }
+        zmq::message_t request;
+        socket.recv(&request);
+        uint64_t t_recv = AMMetricsNow();
+        std::lock_guard<std::mutex> check(am_check_mutex);
+        //本事件使用的版本; 热加载只替换指针, 不阻塞这里
+        AMReloadGuard guard(cursor);
+        Monitor &monitor = guard.cm->monitor;
+        spot::twa_graph_ptr &aut = guard.cm->aut;
+        if (sliced && AMSliceIsControl((const char *)request.data(), request.size()))
+        {
+            //router迁移slice时的控制消息
+            std::string text;
+            AMSliceControl(slices, guard.cm, std::string((const char *)request.data(), request.size()), text);
+            zmq::message_t reply(text.data(), text.size());
+            socket.send(reply);
+            continue;
+        }
+        AMMetricsInc(events_received);
+        //在消息缓冲区上直接解码, 不复制也不构造cJSON树
+        AMEventView ev;
+        if (AMDecodeEvent((const char *)request.data(), request.size(), ev) != SUCCESS ||
+            ev.eventName.ptr == nullptr)
+        {
+            AMMetricsInc(parse_errors);
+            INFOPrint("Parse Json Error");
+            zmq::message_t reply(3);
+            memcpy(reply.data(), "300", 3);
+            socket.send(reply);
+            return ERROR;
+        }
+        VePrint(ev.raw);
+
+        std::string accept_word(ev.eventName.ptr, ev.eventName.len);
+        if (ev.escaped)
+        {
+            AMArenaScope scope(eventArena);
+            std::string raw(ev.raw.ptr, ev.raw.len);
+            cJSON *cj = cJSON_Parse(raw.c_str());
+            cJSON *aw = cj ? cJSON_GetObjectItem(cj, "eventName") : nullptr;
+            if (aw == nullptr || aw->type != cJSON_String)
+            {
+                AMMetricsInc(parse_errors);
+                INFOPrint("Parse Json Error");
+                zmq::message_t reply(3);
+                memcpy(reply.data(), "300", 3);
+                socket.send(reply);
+                return ERROR;
+            }
+            accept_word = aw->valuestring;
+            cJSON_Delete(cj);
+        }
+        VePrint(accept_word);
+
+        if (timed_enabled)
+        {
+            AMTimedEvent(timed, std::string(ev.slice.ptr ? ev.slice.ptr : "", ev.slice.len), accept_word,
+                         AMEventTimeNs(ev));
+        }
+
+        //每个slice的状态换入共用的monitor
+        AMSlice *slice = nullptr;
+        std::string slice_key;
+        if (sliced)
+        {
+            slice_key.assign(ev.slice.ptr ? ev.slice.ptr : "", ev.slice.len);
+            if (AMSliceSatisfied(slices, slice_key, guard.cm))
+            {
+                //该slice已经确定满足, 之后的事件不再检测
+                AMMetricsInc(events_checked);
+                zmq::message_t reply(3);
+                memcpy(reply.data(), "101", 3);
+                socket.send(reply);
+                continue;
+            }
+            slice = &AMSliceSwapIn(slices, slice_key, guard.cm);
+        }
+        else if (Monitor_current_verdict(monitor) == AM_VERDICT_GOOD && monitor.sampled == 0)
+        {
+            //已经确定满足, 之后的事件不再检测
+            AMMetricsInc(events_checked);
+            AMCheckpointRecord(ev.raw.ptr, ev.raw.len, monitor, guard.cm->fingerprint);
+            zmq::message_t reply(3);
+            memcpy(reply.data(), "101", 3);
+            socket.send(reply);
+            continue;
+        }
+
+        //采样事件：丢弃了调用或者只有计数，之后的轨迹不完整
+        if (ev.sample.ptr && !AMStrViewEqual(ev.sample, "always", 6))
+        {
+            if (ev.count >= 0 || ev.skipped > 0)
+            {
+                monitor.sampled = 1;
+            }
+        }
+
+        uint64_t t_decode = AMMetricsNow();
+        AMMetricsInc(events_decoded);
+
+        int step = Monitor_step(aut, monitor, dict, accept_word);
+        uint64_t t_step = AMMetricsNow();
+        AMMetricsInc(events_checked);
+        AMMetricsStateVisit(monitor.state_number);
+        AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_DECODE], t_decode - t_recv);
+        AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_STEP], t_step - t_decode);
+
+        if (step == AM_STEP_POSSIBLE_VIOLATION)
+        {
+            //轨迹不完整时不能断定违规，报告可能违规, Monitor_step已经从初始状态重新同步
+            AMMetricsInc(possible_violations);
+            INFOPrint(AMErrorToString(WORD_ACCEPTANCE_WRONG_SAMPLED));
+            zmq::message_t reply(3);
+            memcpy(reply.data(), "201", 3);
+            socket.send(reply);
+            errorLog << "[sampled] " << ev.raw << std::endl;
+            if (slice != nullptr)
+            {
+                AMSliceSwapOut(*slice, monitor);
+            }
+            AMCheckpointRecord(ev.raw.ptr, ev.raw.len, monitor, guard.cm->fingerprint);
+            continue;
+        }
+        if (step == AM_STEP_VIOLATION)
+        {
+            AMMetricsInc(violations);
+            INFOPrint("Wrong Acceptance!");
+            zmq::message_t reply(3);
+            memcpy(reply.data(), "200", 3);
+            socket.send(reply);
+            std::cout << ev.raw << std::endl;
+            errorLog << ev.raw << std::endl;
+            //输出错误日志，把json格式输出。
+            if (slice != nullptr)
+            {
+                //只有这个slice违规, 其余slice继续检测; 该slice之后的事件从初始状态开始
+                slices.live.erase(slice_key);
+                continue;
+            }
+            AMCheckpointRecord(ev.raw.ptr, ev.raw.len, monitor, guard.cm->fingerprint);
+            AMCheckpointStop();
+            ErrorPrintNEXIT_0(WORD_ACCEPTANCE_WRONG);
+        }
+        //进入GOOD状态: 已经确定满足, 回复"101"; 轨迹不完整时不能断定
+        bool good = Monitor_current_verdict(monitor) == AM_VERDICT_GOOD && monitor.sampled == 0;
+        if (slice != nullptr)
+        {
+            AMSliceSwapOut(*slice, monitor);
+            if (good)
+            {
+                AMSliceConclude(slices, slice_key);
+            }
+        }
+        AMCheckpointRecord(ev.raw.ptr, ev.raw.len, monitor, guard.cm->fingerprint);
+        zmq::message_t reply(3);
+        memcpy(reply.data(), good ? "101" : "100", 3);
+        socket.send(reply);
+        uint64_t t_reply = AMMetricsNow();
+        AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_REPLY], t_reply - t_step);
+        AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_TOTAL], t_reply - t_recv);
+    }
+
+#else
+
+#endif
+
+#else
+    /*测试一个monitor是否可检测出输入的行为违规*/
+    Test_Check_word_acceptance_01();
+    //Test_Check_word_acceptance_02(pa->aut, monitor, dict);
+
+    // Test_splitstr();/*测试splitstr()*/
+
+    // Test_Parse_bstr_to_wordset();/*测试Test_Parse_bstr_to_wordset()*/
+
+    /*Test Communication module*/
+    //Test_Commnunication_module_01();
+    //Test_Commnunication_module_01(pa->aut, monitor, dict);
+    //Test_Communication_module_02();
+    //Test_Parse_label_exp_to_RPN();
+    //Test_Parse_label_RPN_to_string_sets();
+#endif
+    FuncEnd();
+}
+#endif
+
+/*
+功能：按配置生成自动机, 热加载时在后台线程调用, 沿用原来的bdd_dict。
+*/
+int Generate_automata(YAML::Node &node, const spot::bdd_dict_ptr &dict, spot::twa_graph_ptr &aut)
+{
+    FuncBegin();
     std::string filename;
     std::string fileFormat;
     spot::parsed_aut_ptr pa;
-    spot::twa_graph_ptr aut;
-
-    //Todo Init the Log();
 
     //Parse the Yaml file to Generate monitor.
     if (node["monitor_generate_module"]["open_hoa_file"]["enabled"].as<bool>() == true)
@@ -71,7 +482,7 @@ int main(void)
         INFOPrint("Enter open_hoa_file module");
         filename = node["monitor_generate_module"]["open_hoa_file"]["filename"].as<std::string>();
         VePrint(filename);
-        pa = parse_aut(filename, spot::make_bdd_dict());
+        pa = parse_aut(filename, dict);
 
         if (pa->format_errors(std::cerr))
         {
@@ -105,7 +516,7 @@ int main(void)
         /*
             Translate LTL formula into a Monitor, form spot/twaalgos/ltl2tgba_fm.hh
         */
-        spot::translator trans;
+        spot::translator trans(dict);
         trans.set_type(spot::postprocessor::Monitor);
         trans.set_pref(spot::postprocessor::Deterministic);
         spot::twa_graph_ptr autmata = trans.run(pf.f);
@@ -142,98 +553,167 @@ int main(void)
     {
         ErrorPrintNReturn(YAML_NODE_PARSE_ERROR);
     }
+    FuncEnd();
+    return SUCCESS;
+}
 
-#if ZMQ == 1
-
-    const spot::bdd_dict_ptr &dict = aut->get_dict();
-
-    Monitor monitor_;
-    Monitor &monitor = monitor_;
-
-    //读取所有的状态以及接受集，放入Monitor类型的容器中去。
-    //Parse_automata_to_monitor(monitor, aut, dict);
-    export_automata_to_solidity(monitor,aut,dict);
-    monitor.state_number = aut->get_init_state_number(); //全局状态
-    
-    /*接受MQ发送过来的字符串*/
-    std::string addr = node["server_bind_addr"].as<std::string>(); //改为读取配置文件
-    VePrint(addr);
-    zmq::context_t context(1);
-    zmq::socket_t socket(context, ZMQ_REP);
-
-    socket.bind(addr);
-    
-    INFOPrint("Sever has binded the address");
+#ifndef AUTOMONITOR_NO_MAIN
+/*
+功能：按automonitor.yaml的timed读取有时间界限的性质。
+截止时间过去时计为违规, 写入错误日志(前面加"[deadline] "), 并把"202 <json>"交给publish。
+*/
+static int Setup_timed(YAML::Node &node, AMTimed &timed, std::ofstream &errorLog,
+                       std::function<void(const std::string &)> publish)
+{
+    FuncBegin();
+    std::vector<AMTimedRule> rules;
+    for (auto r : node["timed"]["rules"])
+    {
+        AMTimedRule rule;
+        if (AMTimedParseRule(r["name"].as<std::string>(), r["formula"].as<std::string>(), rule) != SUCCESS)
+        {
+            ErrorPrintNReturn(TIMED_RULE_ERROR);
+        }
+        rules.push_back(rule);
+    }
+    int64_t tick_ns = node["timed"]["tick_us"].as<int64_t>() * 1000;
+    auto handler = [&errorLog, publish](const AMTimedRule &rule, const std::string &slice, int64_t t,
+                                        int64_t deadline) {
+        AMMetricsInc(violations);
+        INFOPrint("Deadline missed: " << rule.name << " slice \"" << slice << "\"");
+        std::ostringstream os;
+        os << "{\"rule\":\"" << rule.name << "\",\"slice\":\"" << slice << "\",\"trigger\":" << t
+           << ",\"deadline\":" << deadline << "}";
+        errorLog << "[deadline] " << os.str() << std::endl;
+        publish("202 " + os.str());
+    };
+    if (AMTimedInit(timed, rules, tick_ns, handler) != SUCCESS)
+    {
+        ErrorPrintNReturn(TIMED_RULE_ERROR);
+    }
+    FuncEnd();
+    return SUCCESS;
+}
 
+/*
+功能：从共享内存环中读取二进制事件并检测, 检测结论写回环头部的verdict。
+与ZeroMQ入口在同一个进程中运行, 共用检测器: 取到记录后持有检测锁, 连续检测环中已有的记录(最多AM_SHM_BATCH条)再放开。
+timed为nullptr时没有有时间界限的性质。
+*/
+static int Run_shm_server(SHMRing &ring, AMReloadCursor &cursor, AMTimed *timed, std::ofstream &errorLog)
+{
+    FuncBegin();
     while (1)
     {
-
-        zmq::message_t request;
-        socket.recv(&request);
-        char *event = (char *)request.data();
-        Check_json_log_format(event);
-
-        std::string recvlog = event;
-        VePrint(recvlog);
-
-        //解析json文件
-        //neb::CJsonObject oJson(recvlog);
-
-        cJSON *cj = cJSON_Parse(recvlog.c_str());
-        if (!cj)
+        SHMRecord *rec;
+        int timeout = 1000;
+        if (timed != nullptr)
         {
-            INFOPrint("Parse Json Error");
-            zmq::message_t reply(3);
-            memcpy(reply.data(), "300", 3);
-            socket.send(reply);
-            return ERROR;
+            std::lock_guard<std::mutex> check(am_check_mutex);
+            timeout = AMTimedPollTimeout(*timed) > 0 ? AMTimedPollTimeout(*timed) : 1000;
         }
-        cJSON *aw = cJSON_GetObjectItem(cj, "eventName");
-        std::string accept_word = aw->valuestring;
-        cJSON_Delete(aw);
-        //oJson.Get("eventName", accept_word);
-        VePrint(accept_word);
-        if (Check_word_acceptance(aut, monitor, dict, accept_word) == WORD_ACCEPTANCE_WRONG)
+        if (shm_ring_pop(ring, &rec, timeout) != SUCCESS)
         {
-            INFOPrint("Wrong Acceptance!");
-            zmq::message_t reply(3);
-            memcpy(reply.data(), "200", 3);
-            socket.send(reply);
-            std::cout << recvlog << std::endl;
-            errorLog << recvlog << std::endl;
-            //输出错误日志，把json格式输出。
-            ErrorPrintNEXIT_0(WORD_ACCEPTANCE_WRONG);
+            if (timed != nullptr)
+            {
+                std::lock_guard<std::mutex> check(am_check_mutex);
+                AMTimedIdle(*timed);
+            }
+            continue;
         }
-        sleep(1);
-        zmq::message_t reply(3);
-        memcpy(reply.data(), "100", 3);
-        socket.send(reply);
 
-        //cJSON_Delete(cj);
-    }
-
-#else
+        std::lock_guard<std::mutex> check(am_check_mutex);
+        for (int batch = 0;; batch++)
+        {
+            if (batch > 0 && (batch == AM_SHM_BATCH || shm_ring_pop(ring, &rec, 0) != SUCCESS))
+            {
+                break;
+            }
+            uint64_t t_recv = AMMetricsNow();
+            AMReloadGuard guard(cursor);
+            Monitor &monitor = guard.cm->monitor;
+            spot::twa_graph_ptr &aut = guard.cm->aut;
+            const spot::bdd_dict_ptr &dict = aut->get_dict();
+            AMMetricsInc(events_received);
+            am_metrics.queue_depth.store(ring.hdr->head.load(std::memory_order_relaxed) -
+                                             ring.hdr->tail.load(std::memory_order_relaxed),
+                                         std::memory_order_relaxed);
+            if (rec->type != SHM_RECORD_EVENT)
+            {
+                shm_ring_release(ring, rec);
+                continue;
+            }
 
-#endif
+            AMEventRecord *ev = reinterpret_cast<AMEventRecord *>(rec->payload);
+            std::string accept_word(am_event_name(ev), ev->nameLen);
+            uint64_t t_decode = AMMetricsNow();
+            AMMetricsInc(events_decoded);
+            if (timed != nullptr)
+            {
+                AMTimedEvent(*timed, "", accept_word, ev->eventTime);
+            }
+            //采样事件, 与ZMQ路径的"sample"字段含义相同, 0为AOP_SAMPLE_ALWAYS, 3为AOP_SAMPLE_COUNT_ONLY
+            if (ev->sampleMode != 0 && (ev->skipped > 0 || ev->sampleMode == 3))
+            {
+                monitor.sampled = 1;
+            }
 
-#else
-    /*测试一个monitor是否可检测出输入的行为违规*/
-    Test_Check_word_acceptance_01();
-    //Test_Check_word_acceptance_02(pa->aut, monitor, dict);
+            int step = Monitor_step(aut, monitor, dict, accept_word);
+            uint64_t t_step = AMMetricsNow();
+            AMMetricsInc(events_checked);
+            AMMetricsStateVisit(monitor.state_number);
+            AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_DECODE], t_decode - t_recv);
+            AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_STEP], t_step - t_decode);
+            AMHistogramRecord(am_metrics.stage_latency[AM_STAGE_TOTAL], t_step - t_recv);
+            if (step == AM_STEP_OK && Monitor_current_verdict(monitor) == AM_VERDICT_GOOD && monitor.sampled == 0)
+            {
+                //已经确定满足, 客户端看到101后可以停止发送
+                ring.hdr->verdict.store(101, std::memory_order_release);
+            }
 
-    // Test_splitstr();/*测试splitstr()*/
+            std::string raw;
+            if (step != AM_STEP_OK || AMCheckpointEnabled())
+            {
+                std::string file(am_event_file(ev), ev->fileLen);
+                std::ostringstream os;
+                //名字来自客户端, 可能含有引号或控制字符
+                os << "{\"eventId\":" << ev->eventId << ",\"eventName\":\"";
+                AMJsonEscape(os, accept_word.data(), accept_word.size()) << "\",\"fileName\":\"";
+                AMJsonEscape(os, file.data(), file.size())
+                    << "\",\"line\":" << ev->line << ",\"eventTime\":" << ev->eventTime << "}";
+                raw = os.str();
+            }
 
-    // Test_Parse_bstr_to_wordset();/*测试Test_Parse_bstr_to_wordset()*/
+            if (step != AM_STEP_OK)
+            {
+                errorLog << (step == AM_STEP_POSSIBLE_VIOLATION ? "[sampled] " : "") << raw << std::endl;
+                if (step == AM_STEP_POSSIBLE_VIOLATION)
+                {
+                    //Monitor_step已经从初始状态重新同步
+                    AMMetricsInc(possible_violations);
+                    INFOPrint(AMErrorToString(WORD_ACCEPTANCE_WRONG_SAMPLED));
+                    ring.hdr->verdict.store(201, std::memory_order_release);
+                }
+                else
+                {
+                    AMMetricsInc(violations);
+                    ring.hdr->verdict.store(200, std::memory_order_release);
+                    shm_ring_release(ring, rec);
+                    shm_ring_close(ring);
+                    AMCheckpointRecord(raw.data(), raw.size(), monitor, guard.cm->fingerprint);
+                    AMCheckpointStop();
+                    ErrorPrintNEXIT_0(WORD_ACCEPTANCE_WRONG);
+                }
+            }
+            AMCheckpointRecord(raw.data(), raw.size(), monitor, guard.cm->fingerprint);
+            shm_ring_release(ring, rec);
+        }
+    }
 
-    /*Test Communication module*/
-    //Test_Commnunication_module_01();
-    //Test_Commnunication_module_01(pa->aut, monitor, dict);
-    //Test_Communication_module_02();
-    //Test_Parse_label_exp_to_RPN();
-    //Test_Parse_label_RPN_to_string_sets();
-#endif
     FuncEnd();
+    return SUCCESS;
 }
+#endif
 
 //===================================================================
 /*
@@ -297,7 +777,7 @@ int Parse_label_to_word_sets(std::string &label, std::vector<Word_set> &word_set
             Parse_bstr_to_wordset(t, ws);
             word_sets.push_back(ws);
 */
-    std::cout <<BOLDBLUE <<"Parse label " << label << " SUCCESS" <<RESET<< std::endl;
+    AMLogDebug("Parse label " << label << " SUCCESS");
     FuncEnd();
     return SUCCESS;
 }
@@ -308,6 +788,9 @@ int Parse_automata_to_monitor(Monitor &monitor, spot::twa_graph_ptr &aut, const
 
     FuncBegin();
     
+    //每个不同的转移条件只格式化一次
+    std::vector<std::string> labels = spot::bdd_format_edge_labels(aut);
+
     for (num_state; num_state < aut->num_states(); ++num_state)
     {
         Monitor_state monitor_state;
@@ -322,7 +805,7 @@ int Parse_automata_to_monitor(Monitor &monitor, spot::twa_graph_ptr &aut, const
                 return ERROR;
             }
 
-            monitor_label.label = spot::bdd_format_formula(dict, t.cond);
+            monitor_label.label = labels[aut->edge_number(t)];
 
             VePrint(monitor_label.label);
             monitor_label.next_state = t.dst;
@@ -337,9 +820,89 @@ int Parse_automata_to_monitor(Monitor &monitor, spot::twa_graph_ptr &aut, const
             monitor_state.monitor_labels.push_back(monitor_label);
         }
         monitor_state.label_numbers = monitor_state.monitor_labels.size();
+        monitor_state.verdict = AM_VERDICT_INCONCLUSIVE;
         monitor.nodes[num_state] = monitor_state;
     }
 
+    Classify_monitor_states(monitor, aut);
+    FuncEnd();
+    return SUCCESS;
+}
+
+/*
+功能：LTL3分类。scc_info按逆拓扑序给SCC编号, 后继SCC总在前面, 一遍即可。
+BAD: SCC不能到达接受环(is_useful_scc为假), 从这里出发没有任何被接受的无穷字。
+GOOD: 接受条件为t(monitor), 并且从这里可达的每个状态出边条件之并都是bddtrue, 任何后缀都被接受。
+*/
+std::vector<int> Classify_automaton_states(const spot::const_twa_graph_ptr &aut)
+{
+    std::vector<int> verdict(aut->num_states(), AM_VERDICT_INCONCLUSIVE);
+    spot::scc_info si(aut);
+    bool all_accepting = aut->acc().is_t();
+    std::vector<int> scc_verdict(si.scc_count(), AM_VERDICT_INCONCLUSIVE);
+
+    for (unsigned scc = 0; scc < si.scc_count(); ++scc)
+    {
+        if (!si.is_useful_scc(scc))
+        {
+            scc_verdict[scc] = AM_VERDICT_BAD;
+            continue;
+        }
+        if (!all_accepting)
+        {
+            continue;
+        }
+        bool good = true;
+        for (unsigned succ : si.succ(scc))
+        {
+            if (scc_verdict[succ] != AM_VERDICT_GOOD)
+            {
+                good = false;
+                break;
+            }
+        }
+        for (unsigned st : si.states_of(scc))
+        {
+            if (!good)
+            {
+                break;
+            }
+            bdd any = bddfalse;
+            for (auto &t : aut->out(st))
+            {
+                any |= t.cond;
+            }
+            good = any == bddtrue;
+        }
+        if (good)
+        {
+            scc_verdict[scc] = AM_VERDICT_GOOD;
+        }
+    }
+
+    for (unsigned st = 0; st < aut->num_states(); ++st)
+    {
+        if (si.reachable_state(st))
+        {
+            verdict[st] = scc_verdict[si.scc_of(st)];
+        }
+    }
+    return verdict;
+}
+
+int Classify_monitor_states(Monitor &monitor, const spot::twa_graph_ptr &aut)
+{
+    FuncBegin();
+    std::vector<int> verdict = Classify_automaton_states(aut);
+    unsigned good = 0, bad = 0;
+    for (unsigned st = 0; st < verdict.size(); ++st)
+    {
+        monitor.nodes[st].verdict = verdict[st];
+        good += verdict[st] == AM_VERDICT_GOOD;
+        bad += verdict[st] == AM_VERDICT_BAD;
+    }
+    INFOPrint("LTL3 classification: " << good << " good, " << bad << " bad, "
+                                      << verdict.size() - good - bad << " inconclusive states");
     FuncEnd();
     return SUCCESS;
 }
@@ -417,8 +980,9 @@ static int Print_Word_set(Word_set & wset)
     std::map<std::string,size_t>::iterator iter;
     for(iter=wset.wordset.begin();iter!=wset.wordset.end();iter++)
     {
-        std::cout<< iter->first <<" : "<<iter->second<<std::endl;
+        AMLogDebug(iter->first << " : " << iter->second);
     }
+    return SUCCESS;
 }
 
 
@@ -435,7 +999,10 @@ int label_match_word(Monitor_label &monitor_label, std::string accept_word)
         ERRORPrint("ACCEPT_WORD_FORMAT_WRONG");
         exit(0);
     }
-    Print_Word_set(wset);
+    if (AMLogOn(AM_LOG_DEBUG))
+    {
+        Print_Word_set(wset);
+    }
     
     //检查label中的每个key是否存在于 accept_word中
     for (auto &word_set : monitor_label.word_sets)//遍历每个word_set，
@@ -451,16 +1018,16 @@ int label_match_word(Monitor_label &monitor_label, std::string accept_word)
                 //如果accept_word中不存在这个key,则检测成功，进行下一步检测
                 if(wset.wordset.find(iter->first) == wset.wordset.end())
                 {
-                    INFOPrint("qwer");
+                    AMLogDebug("qwer");
                     continue;
                 }
                 else if(wset.wordset.find(iter->first) != wset.wordset.end() && wset.wordset[iter->first] == word_set.wordset[iter->first])
                     {
-                        INFOPrint("asdf");
+                        AMLogDebug("asdf");
                         continue;
                     }
                 else{
-                    INFOPrint("Not Match");
+                    AMLogDebug("Not Match");
                     return NOMATCH;
                 }
             }
@@ -469,14 +1036,14 @@ int label_match_word(Monitor_label &monitor_label, std::string accept_word)
                 //如果accept_word中不存在这个key,则直接报错
                 if(wset.wordset.find(iter->first) == wset.wordset.end())
                 {
-                    INFOPrint("NOT MATCH");
+                    AMLogDebug("NOT MATCH");
                     return NOMATCH;
                 }
                 else if(wset.wordset.find(iter->first) != wset.wordset.end() && wset.wordset[iter->first]==word_set.wordset[iter->first]){
                     continue;
                 }
                 else{
-                    INFOPrint("NOT MATCH");
+                    AMLogDebug("NOT MATCH");
                     return NOMATCH;
                 }
             }
@@ -538,7 +1105,7 @@ int Check_word_acceptance(spot::twa_graph_ptr &aut,
             if (label_match_word(monitor_label, accept_word) == SUCCESS)
             {
                 monitor.state_number = monitor_label.next_state; //更新Monitor的全局状态
-                INFOPrint("Accepted!");
+                AMLogDebug("Accepted!");
                 VePrint(monitor.state_number);
                 FuncEnd();
                 return SUCCESS; //这里需要优化
@@ -547,14 +1114,14 @@ int Check_word_acceptance(spot::twa_graph_ptr &aut,
                      i < monitor.nodes[state_number].label_numbers)
             {
                 i++;
-                INFOPrint("Try next label\n");
+                AMLogDebug("Try next label");
                 continue;
             }
             else
             {
-                INFOPrint("\nAccepted Failed");
-                std::cout << BOLDRED << "The label is \"" << monitor_label.label << RESET << std::endl;
-                std::cout << BOLDRED << "The accepted word is \"" << accept_word << "\"" << RESET << std::endl;
+                INFOPrint("Accepted Failed");
+                ERRORPrint("The label is \"" << monitor_label.label << "\"");
+                ERRORPrint("The accepted word is \"" << accept_word << "\"");
                 FuncEnd();
                 return WORD_ACCEPTANCE_WRONG;
             }
@@ -14,6 +14,11 @@
 #include <spot/twa/bddprint.hh>
 #include <spot/parseaut/public.hh>
 
+namespace YAML
+{
+class Node;
+}
+
 #define Test_AUTOMONITOR 0
 /*初始化时自动机的全局状态*/
 
@@ -31,9 +36,18 @@ typedef struct Monitor_label_t
     int next_state;
 } Monitor_label;
 
+/*
+LTL3结论: 从该状态出发的所有后缀都满足(GOOD)、都违反(BAD), 或者还不能确定。
+到达GOOD状态后不必再检测, 到达BAD状态时即使标签匹配也已经违规。
+*/
+#define AM_VERDICT_INCONCLUSIVE 0
+#define AM_VERDICT_GOOD 1
+#define AM_VERDICT_BAD 2
+
 typedef struct Monitor_state_t
 {
     int own_state;
+    int verdict; //AM_VERDICT_*
     int label_numbers;
     std::vector<Monitor_label> monitor_labels;
 } Monitor_state;
@@ -48,6 +62,8 @@ typedef std::map<size_t, Monitor_state> Nodes;
 typedef struct Monitor_
 {
     int state_number; //monitor的全局状态
+    int init_state;   //初始状态
+    int sampled;      //已收到采样事件，轨迹不完整，违规只能判为"可能违规"
     Nodes nodes;
 } Monitor;
 
@@ -57,6 +73,51 @@ int check_accept_word_format(std::string accept_word);
 int Check_word_acceptance(spot::twa_graph_ptr &aut,
                           Monitor &monitor, const spot::bdd_dict_ptr &dict, std::string accept_word);
 int Parse_automata_to_monitor(Monitor &monitor, spot::twa_graph_ptr &aut, const spot::bdd_dict_ptr &dict);
+/*用spot::scc_info把每个状态分为GOOD/BAD/INCONCLUSIVE, 不可达的状态为INCONCLUSIVE*/
+std::vector<int> Classify_automaton_states(const spot::const_twa_graph_ptr &aut);
+int Classify_monitor_states(Monitor &monitor, const spot::twa_graph_ptr &aut);
+/*当前状态的LTL3结论*/
+static inline int Monitor_current_verdict(const Monitor &monitor)
+{
+    auto it = monitor.nodes.find(monitor.state_number);
+    return it == monitor.nodes.end() ? AM_VERDICT_INCONCLUSIVE : it->second.verdict;
+}
+
+#define AM_STEP_OK 0
+#define AM_STEP_VIOLATION 1
+#define AM_STEP_POSSIBLE_VIOLATION 2
+/*
+检测一个事件并按LTL3结论判断是否违规, 检测线程和检查点回放共用, 回放后的状态与在线检测一致:
+到达GOOD状态后不再检测; 标签不匹配或进入BAD状态为违规; 轨迹不完整(sampled)时只是可能违规, monitor回到初始状态重新同步。
+返回AM_STEP_*。
+*/
+static inline int Monitor_step(spot::twa_graph_ptr &aut, Monitor &monitor, const spot::bdd_dict_ptr &dict,
+                               const std::string &accept_word)
+{
+    if (Monitor_current_verdict(monitor) == AM_VERDICT_GOOD && monitor.sampled == 0)
+    {
+        return AM_STEP_OK; //已经确定满足, 不必再检测
+    }
+    int verdict = Check_word_acceptance(aut, monitor, dict, accept_word);
+    if (verdict == SUCCESS && Monitor_current_verdict(monitor) == AM_VERDICT_BAD)
+    {
+        verdict = WORD_ACCEPTANCE_WRONG;
+    }
+    if (verdict != WORD_ACCEPTANCE_WRONG)
+    {
+        return AM_STEP_OK;
+    }
+    if (monitor.sampled == 1)
+    {
+        monitor.state_number = monitor.init_state;
+        monitor.sampled = 0;
+        return AM_STEP_POSSIBLE_VIOLATION;
+    }
+    return AM_STEP_VIOLATION;
+}
+
+/*按automonitor.yaml的monitor_generate_module生成自动机, 启动和热加载时使用*/
+int Generate_automata(YAML::Node &node, const spot::bdd_dict_ptr &dict, spot::twa_graph_ptr &aut);
 
 /*自定义输出自动机*/
 int Parse_BoolString_to_set(std::string str, Word_set &word_set,
@@ -86,6 +86,11 @@ void cJSON_InitHooks(cJSON_Hooks* hooks)
     cJSON_free = (hooks->free_fn) ? hooks->free_fn : free;
 }
 
+void cJSON_Free(void *ptr)
+{
+    cJSON_free(ptr);
+}
+
 /* Internal constructor. */
 static cJSON *cJSON_New_Item()
 {
@@ -79,6 +79,8 @@ extern char *cJSON_Print(cJSON *item);
 extern char *cJSON_PrintUnformatted(cJSON *item);
 /* Delete a cJSON entity and all subentities. */
 extern void cJSON_Delete(cJSON *c);
+/* Free a string returned by cJSON_Print/cJSON_PrintUnformatted through the installed free hook. */
+extern void cJSON_Free(void *ptr);
 
 /* Returns the number of items in an array (or object). */
 extern int cJSON_GetArraySize(cJSON *array);
@@ -0,0 +1,467 @@
+#include "checkpoint.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "event-decode.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+extern "C"
+{
+#include "cJSON.h"
+}
+
+//检测线程发布的快照在ckpt_buf[ckpt_seq & 1]中, 下一个写另一半
+static AMCheckpointState ckpt_buf[2];
+static std::atomic<uint64_t> ckpt_seq(0);
+static AMCheckpointState ckpt_live; //只在检测线程访问
+
+static int ckpt_fd = -1;
+static int journal_fd = -1;
+static uint64_t ckpt_file_seq = 0;
+static uint64_t ckpt_written = 0; //已写入文件的快照序号
+static unsigned ckpt_interval_ms = 1000;
+static std::atomic<bool> ckpt_stop(false);
+static std::thread *ckpt_thread = nullptr;
+
+//接收日志轮转: 后台线程打开下一代的文件放进ckpt_next_fd, 检测线程在下一个事件之前换过去
+static std::string ckpt_journal;
+static uint64_t ckpt_rotate_bytes = AM_CHECKPOINT_ROTATE_BYTES;
+static std::atomic<int> ckpt_next_fd(-1);
+static uint64_t ckpt_next_gen = 0;  //后台线程打开过的最新一代
+static uint64_t ckpt_clean_gen = 0; //比它旧的几代已经删除
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+#define FNV_OFFSET 14695981039346656037ULL
+
+uint64_t AMMonitorFingerprint(const Monitor &monitor)
+{
+    uint64_t h = FNV_OFFSET;
+    h = fnv1a(h, &monitor.init_state, sizeof(monitor.init_state));
+    for (auto &n : monitor.nodes)
+    {
+        h = fnv1a(h, &n.second.own_state, sizeof(n.second.own_state));
+        for (auto &l : n.second.monitor_labels)
+        {
+            h = fnv1a(h, l.label.data(), l.label.size() + 1);
+            h = fnv1a(h, &l.next_state, sizeof(l.next_state));
+        }
+    }
+    return h;
+}
+
+std::string AMCheckpointJournalName(const std::string &journal, uint64_t gen)
+{
+    return gen == 0 ? journal : journal + "." + std::to_string(gen);
+}
+
+/*从第gen代开始, 最新一代接收日志的代号*/
+static uint64_t journal_last_gen(const std::string &journal, uint64_t gen)
+{
+    struct stat sb;
+    while (stat(AMCheckpointJournalName(journal, gen + 1).c_str(), &sb) == 0)
+    {
+        gen++;
+    }
+    return gen;
+}
+
+static uint64_t slot_checksum(const AMCheckpointSlot &slot)
+{
+    return fnv1a(FNV_OFFSET, &slot, offsetof(AMCheckpointSlot, checksum));
+}
+
+int AMCheckpointLoad(const std::string &file, AMCheckpointState &st)
+{
+    FuncBegin();
+    char buf[2 * AM_CHECKPOINT_SLOT_SIZE];
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        AMReturn(CHECKPOINT_ERROR);
+    }
+    ssize_t n = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+
+    const AMCheckpointSlot *best = nullptr;
+    AMCheckpointSlot slots[2];
+    for (int i = 0; i < 2; i++)
+    {
+        if (n < (ssize_t)((i + 1) * AM_CHECKPOINT_SLOT_SIZE))
+        {
+            break;
+        }
+        memcpy(&slots[i], buf + i * AM_CHECKPOINT_SLOT_SIZE, sizeof(AMCheckpointSlot));
+        if (slots[i].magic != AM_CHECKPOINT_MAGIC || slots[i].version != AM_CHECKPOINT_VERSION ||
+            slots[i].checksum != slot_checksum(slots[i]))
+        {
+            continue;
+        }
+        if (best == nullptr || slots[i].seq > best->seq)
+        {
+            best = &slots[i];
+        }
+    }
+    if (best == nullptr)
+    {
+        AMReturn(CHECKPOINT_ERROR);
+    }
+    st = best->state;
+    ckpt_file_seq = best->seq;
+    FuncEnd();
+    return SUCCESS;
+}
+
+/*回放一代接收日志*/
+static int replay_one(const std::string &name, spot::twa_graph_ptr &aut, Monitor &monitor,
+                      const spot::bdd_dict_ptr &dict, std::ostream &errorLog, AMCheckpointState &st,
+                      uint64_t &replayed)
+{
+    FuncBegin();
+    std::ifstream in(name, std::ios::binary);
+    if (!in)
+    {
+        AMReturn(SUCCESS);
+    }
+    in.seekg(0, std::ios::end);
+    uint64_t size = in.tellg();
+    if (size < st.log_offset)
+    {
+        //日志被截断或者换了文件, 偏移已经没有意义
+        ERRORPrint("Journal " << name << " is shorter than the checkpoint offset, skip replay");
+        st.log_offset = size;
+        AMReturn(CHECKPOINT_ERROR);
+    }
+    in.seekg(st.log_offset);
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (in.eof())
+        {
+            break; //最后一行没有换行符, 是写到一半的事件
+        }
+        st.log_offset += line.size() + 1;
+        st.events++;
+        replayed++;
+
+        AMEventView ev;
+        if (AMDecodeEvent(line.data(), line.size(), ev) != SUCCESS || ev.eventName.ptr == nullptr)
+        {
+            continue;
+        }
+        std::string accept_word(ev.eventName.ptr, ev.eventName.len);
+        if (ev.escaped)
+        {
+            cJSON *cj = cJSON_Parse(line.c_str());
+            cJSON *aw = cj ? cJSON_GetObjectItem(cj, "eventName") : nullptr;
+            if (aw == nullptr || aw->type != cJSON_String)
+            {
+                cJSON_Delete(cj);
+                continue;
+            }
+            accept_word = aw->valuestring;
+            cJSON_Delete(cj);
+        }
+        if (ev.sample.ptr && !AMStrViewEqual(ev.sample, "always", 6) && (ev.count >= 0 || ev.skipped > 0))
+        {
+            monitor.sampled = 1;
+        }
+
+        //与检测线程相同的判定, 包括BAD状态和采样时回到初始状态
+        int step = Monitor_step(aut, monitor, dict, accept_word);
+        if (step == AM_STEP_POSSIBLE_VIOLATION)
+        {
+            errorLog << "[replay] [sampled] " << line << std::endl;
+        }
+        else if (step == AM_STEP_VIOLATION)
+        {
+            errorLog << "[replay] " << line << std::endl;
+        }
+    }
+    st.state_number = monitor.state_number;
+    st.sampled = monitor.sampled;
+    FuncEnd();
+    return SUCCESS;
+}
+
+int AMCheckpointReplay(const std::string &journal, spot::twa_graph_ptr &aut, Monitor &monitor,
+                       const spot::bdd_dict_ptr &dict, std::ostream &errorLog, AMCheckpointState &st)
+{
+    FuncBegin();
+    int ret = SUCCESS;
+    uint64_t replayed = 0;
+    //检查点之后可能已经轮转过, 后面的几代都要回放, 新的事件追加到最新一代
+    uint64_t last_gen = journal_last_gen(journal, st.journal_gen);
+    for (;; st.journal_gen++, st.log_offset = 0)
+    {
+        if (replay_one(AMCheckpointJournalName(journal, st.journal_gen), aut, monitor, dict, errorLog, st,
+                       replayed) != SUCCESS)
+        {
+            ret = CHECKPOINT_ERROR;
+        }
+        if (st.journal_gen == last_gen)
+        {
+            break;
+        }
+    }
+    INFOPrint("Replayed " << replayed << " events from " << journal);
+    FuncEnd();
+    return ret;
+}
+
+int AMCheckpointRestore(const std::string &file, const std::string &journal, uint64_t fingerprint,
+                        spot::twa_graph_ptr &aut, Monitor &monitor, const spot::bdd_dict_ptr &dict,
+                        std::ostream &errorLog, AMCheckpointState &st)
+{
+    FuncBegin();
+    auto t0 = std::chrono::steady_clock::now();
+    if (AMCheckpointLoad(file, st) == SUCCESS && st.fingerprint == fingerprint)
+    {
+        monitor.state_number = st.state_number;
+        monitor.sampled = st.sampled;
+        AMCheckpointReplay(journal, aut, monitor, dict, errorLog, st);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        INFOPrint("Restored state " << monitor.state_number << " after " << st.events << " events in " << ms
+                                    << " ms");
+        FuncEnd();
+        return SUCCESS;
+    }
+
+    //没有检查点或者monitor已经变了, 日志里已有的事件不再回放
+    INFOPrint("No usable checkpoint in " << file << ", start from the initial state");
+    struct stat sb;
+    memset(&st, 0, sizeof(st));
+    st.fingerprint = fingerprint;
+    st.journal_gen = journal_last_gen(journal, 0);
+    st.log_offset = stat(AMCheckpointJournalName(journal, st.journal_gen).c_str(), &sb) == 0 ? sb.st_size : 0;
+    st.state_number = monitor.state_number;
+    st.sampled = monitor.sampled;
+    AMReturn(CHECKPOINT_ERROR);
+}
+
+/*取检测线程最新发布的快照, 复制期间被覆盖时重试*/
+static bool ckpt_snapshot(AMCheckpointState &st, uint64_t &seq)
+{
+    for (int retry = 0; retry < 100; retry++)
+    {
+        seq = ckpt_seq.load(std::memory_order_acquire);
+        st = ckpt_buf[seq & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        //检测线程发布seq+1之前不会改写ckpt_buf[seq & 1]
+        if (ckpt_seq.load(std::memory_order_relaxed) == seq)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+指向第gen代的检查点已经写入文件, 更早的几代不会再回放, 从gen-1往前删除。
+删除按代号从小到大进行, 遇到不存在的文件说明更早的已经删过。
+*/
+static void ckpt_clean(uint64_t gen)
+{
+    for (uint64_t g = gen; g > ckpt_clean_gen; g--)
+    {
+        if (unlink(AMCheckpointJournalName(ckpt_journal, g - 1).c_str()) != 0)
+        {
+            break;
+        }
+    }
+    ckpt_clean_gen = gen;
+}
+
+/*当前这一代已经被写入文件的检查点覆盖到rotate_bytes, 打开下一代交给检测线程*/
+static void ckpt_rotate(const AMCheckpointState &st)
+{
+    if (st.log_offset < ckpt_rotate_bytes || ckpt_next_gen != st.journal_gen)
+    {
+        return; //还没到大小, 或者上一次打开的文件检测线程还没有换过去
+    }
+    std::string name = AMCheckpointJournalName(ckpt_journal, st.journal_gen + 1);
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        ERRORPrint("Open " << name << " failed: " << strerror(errno));
+        return;
+    }
+    ckpt_next_gen = st.journal_gen + 1;
+    ckpt_next_fd.store(fd, std::memory_order_release);
+}
+
+static void ckpt_write(bool rotate)
+{
+    AMCheckpointState st;
+    uint64_t seq;
+    if (!ckpt_snapshot(st, seq) || seq == ckpt_written)
+    {
+        return;
+    }
+
+    char buf[AM_CHECKPOINT_SLOT_SIZE];
+    AMCheckpointSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.magic = AM_CHECKPOINT_MAGIC;
+    slot.version = AM_CHECKPOINT_VERSION;
+    slot.seq = ++ckpt_file_seq;
+    slot.state = st;
+    slot.checksum = slot_checksum(slot);
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, &slot, sizeof(slot));
+
+    //新快照写入较旧的槽, 另一个槽在写入完成前保持有效
+    if (pwrite(ckpt_fd, buf, sizeof(buf), (slot.seq & 1) * AM_CHECKPOINT_SLOT_SIZE) != sizeof(buf) ||
+        fdatasync(ckpt_fd) != 0)
+    {
+        ERRORPrint("Write checkpoint failed: " << strerror(errno));
+        return;
+    }
+    ckpt_written = seq;
+    if (st.journal_gen > ckpt_clean_gen)
+    {
+        ckpt_clean(st.journal_gen);
+    }
+    if (rotate)
+    {
+        ckpt_rotate(st);
+    }
+}
+
+static void ckpt_main_loop()
+{
+    auto next = std::chrono::steady_clock::now();
+    while (!ckpt_stop.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (std::chrono::steady_clock::now() < next)
+        {
+            continue;
+        }
+        next += std::chrono::milliseconds(ckpt_interval_ms);
+        ckpt_write(true);
+    }
+}
+
+int AMCheckpointStart(const std::string &file, const std::string &journal, unsigned interval_ms,
+                      const AMCheckpointState &st, uint64_t rotate_bytes)
+{
+    FuncBegin();
+    std::string name = AMCheckpointJournalName(journal, st.journal_gen);
+    ckpt_fd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    journal_fd = open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (ckpt_fd < 0 || journal_fd < 0)
+    {
+        ERRORPrint("Open " << file << " or " << name << " failed: " << strerror(errno));
+        AMReturn(CHECKPOINT_ERROR);
+    }
+    //去掉没有检测过的半行, 之后追加的事件从一行的开头开始
+    struct stat sb;
+    if (fstat(journal_fd, &sb) == 0 && (uint64_t)sb.st_size > st.log_offset)
+    {
+        if (ftruncate(journal_fd, st.log_offset) != 0)
+        {
+            AMReturn(CHECKPOINT_ERROR);
+        }
+    }
+
+    ckpt_live = st;
+    ckpt_buf[0] = ckpt_buf[1] = st;
+    ckpt_seq.store(1, std::memory_order_release);
+    ckpt_written = 0;
+    ckpt_interval_ms = interval_ms ? interval_ms : 1;
+    ckpt_journal = journal;
+    ckpt_rotate_bytes = rotate_bytes;
+    ckpt_next_gen = st.journal_gen;
+    ckpt_clean_gen = 0; //文件中的检查点可能还指向更早的一代, 写入新的检查点之后再删除
+    ckpt_stop.store(false);
+    ckpt_thread = new std::thread(ckpt_main_loop);
+    FuncEnd();
+    return SUCCESS;
+}
+
+void AMCheckpointStop()
+{
+    if (ckpt_thread == nullptr)
+    {
+        return;
+    }
+    ckpt_stop.store(true);
+    ckpt_thread->join();
+    delete ckpt_thread;
+    ckpt_thread = nullptr;
+    ckpt_write(false);
+    //检测线程没有换过去的下一代还是空的, 不留给下次启动
+    int next = ckpt_next_fd.exchange(-1);
+    if (next >= 0)
+    {
+        close(next);
+        unlink(AMCheckpointJournalName(ckpt_journal, ckpt_next_gen).c_str());
+    }
+    close(ckpt_fd);
+    close(journal_fd);
+    ckpt_fd = journal_fd = -1;
+}
+
+bool AMCheckpointEnabled()
+{
+    return ckpt_thread != nullptr;
+}
+
+void AMCheckpointRecord(const char *raw, size_t len, const Monitor &monitor, uint64_t fingerprint)
+{
+    if (journal_fd < 0)
+    {
+        return;
+    }
+    //后台线程打开了下一代接收日志, 这个事件开始写入新的一代
+    if (ckpt_next_fd.load(std::memory_order_relaxed) >= 0)
+    {
+        int next = ckpt_next_fd.exchange(-1, std::memory_order_acquire);
+        close(journal_fd);
+        journal_fd = next;
+        ckpt_live.journal_gen++;
+        ckpt_live.log_offset = 0;
+    }
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)raw;
+    iov[0].iov_len = len;
+    iov[1].iov_base = (void *)"\n";
+    iov[1].iov_len = 1;
+    if (writev(journal_fd, iov, 2) != (ssize_t)(len + 1))
+    {
+        ERRORPrint("Append to journal failed: " << strerror(errno));
+        return;
+    }
+
+    ckpt_live.events++;
+    ckpt_live.log_offset += len + 1;
+    ckpt_live.fingerprint = fingerprint;
+    ckpt_live.state_number = monitor.state_number;
+    ckpt_live.sampled = monitor.sampled;
+
+    uint64_t seq = ckpt_seq.load(std::memory_order_relaxed) + 1;
+    ckpt_buf[seq & 1] = ckpt_live;
+    ckpt_seq.store(seq, std::memory_order_release);
+}
@@ -0,0 +1,84 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+/*
+monitor状态的检查点。
+检测线程把收到的事件原样追加到接收日志(每行一个json, 与客户端的event.log格式相同),
+每个事件之后把状态和日志偏移写入内存中的双缓冲快照, 只是几十个字节的复制, 不做系统调用以外的等待。
+后台线程定期把最新快照写入检查点文件。文件有两个槽, 轮流写入, 写到一半崩溃时另一个槽仍然有效。
+重启时读取序号最大的有效槽, 恢复状态, 只回放接收日志中偏移之后的部分。
+接收日志按代轮转: 写入文件的检查点偏移超过AM_CHECKPOINT_ROTATE_BYTES后, 检测线程换到下一代的文件,
+检查点记录当前的代号; 指向新一代的检查点写入文件之后, 旧的几代不再需要, 由后台线程删除。
+*/
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "automonitor.hh"
+
+#define AM_CHECKPOINT_MAGIC 0x4b434d41 //"AMCK"
+#define AM_CHECKPOINT_VERSION 2
+#define AM_CHECKPOINT_SLOT_SIZE 64
+#define AM_CHECKPOINT_ROTATE_BYTES (64ULL << 20)
+
+typedef struct AMCheckpointState
+{
+    uint64_t events;      //已检测的事件数
+    uint64_t journal_gen; //接收日志的代号
+    uint64_t log_offset;  //这一代接收日志中已检测部分的字节数
+    uint64_t fingerprint; //Monitor表的指纹, 恢复时必须与当前monitor一致
+    int32_t state_number;
+    int32_t sampled;
+} AMCheckpointState;
+
+/*检查点文件中的一个槽*/
+typedef struct AMCheckpointSlot
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+    AMCheckpointState state;
+    uint64_t checksum; //前面各字段的FNV-1a
+} AMCheckpointSlot;
+
+static_assert(sizeof(AMCheckpointSlot) <= AM_CHECKPOINT_SLOT_SIZE, "checkpoint slot too large");
+
+/*Monitor表的指纹, 公式或自动机变化后旧的检查点不能使用*/
+uint64_t AMMonitorFingerprint(const Monitor &monitor);
+
+/*第gen代接收日志的文件名: 第0代就是journal, 之后是journal.<gen>*/
+std::string AMCheckpointJournalName(const std::string &journal, uint64_t gen);
+
+/*读取检查点文件, 两个槽都无效时返回ERROR*/
+int AMCheckpointLoad(const std::string &file, AMCheckpointState &st);
+
+/*
+从第st.journal_gen代接收日志的st.log_offset处开始逐个检测剩下的事件, 之后的几代从头检测, 更新monitor和st。
+回放中发现的违规写入errorLog, 前面加"[replay] "。
+*/
+int AMCheckpointReplay(const std::string &journal, spot::twa_graph_ptr &aut, Monitor &monitor,
+                       const spot::bdd_dict_ptr &dict, std::ostream &errorLog, AMCheckpointState &st);
+
+/*
+启动时调用: 检查点有效且指纹与fingerprint一致时恢复monitor的状态并回放日志尾部, 返回SUCCESS;
+否则monitor保持初始状态, st从最新一代接收日志的末尾开始, 返回CHECKPOINT_ERROR。
+*/
+int AMCheckpointRestore(const std::string &file, const std::string &journal, uint64_t fingerprint,
+                        spot::twa_graph_ptr &aut, Monitor &monitor, const spot::bdd_dict_ptr &dict,
+                        std::ostream &errorLog, AMCheckpointState &st);
+
+/*
+打开第st.journal_gen代接收日志(追加)和检查点文件, 启动写检查点的线程。
+st为恢复或回放后的状态, 新的事件从这里继续计数。写入文件的偏移达到rotate_bytes后轮转接收日志。
+*/
+int AMCheckpointStart(const std::string &file, const std::string &journal, unsigned interval_ms,
+                      const AMCheckpointState &st, uint64_t rotate_bytes = AM_CHECKPOINT_ROTATE_BYTES);
+/*写入最后一个快照并停止线程, 进程退出前调用*/
+void AMCheckpointStop();
+
+/*检测线程: 记录一个已检测的事件, raw为事件的json*/
+void AMCheckpointRecord(const char *raw, size_t len, const Monitor &monitor, uint64_t fingerprint);
+
+/*检查点是否已经启动*/
+bool AMCheckpointEnabled();
+
+#endif
@@ -0,0 +1,426 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "AsyncLogWriter.hpp"
+
+using namespace std;
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+AsyncLogWriter::AsyncLogWriter(const AsyncLogConfig &config)
+    : mConfig(config),
+    mThreadStopRequest(true),
+    mFlushRequest(false),
+    mFd(-1),
+    mFileSeq(0),
+    mFileBytes(0),
+    mFileOpenTime(0),
+    mDroppedBytes(0),
+    mWrittenBytes(0),
+    mRing(nullptr)
+{
+    mCurrent = NewBuffer();
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    Stop();
+}
+
+AsyncLogWriter::BufferPtr AsyncLogWriter::NewBuffer()
+{
+    BufferPtr buffer(new Buffer);
+    buffer->data.reset(new char[mConfig.bufferSize]);
+    buffer->used = 0;
+    return buffer;
+}
+
+int64_t AsyncLogWriter::Start()
+{
+    if(OpenLogFile() != 0)
+    {
+        return static_cast<int64_t>(-1);
+    }
+
+#ifdef HAVE_LIBURING
+    if(mConfig.useIoUring)
+    {
+        struct io_uring *ring = new struct io_uring;
+        if(io_uring_queue_init(8, ring, 0) == 0)
+        {
+            mRing = ring;
+        }
+        else
+        {
+            delete ring;
+            cout << "io_uring is not available, fall back to writev" << endl;
+        }
+    }
+#endif
+
+    mThreadStopRequest = false;
+    mThread.reset(new thread([this]{MainLoop();}));
+
+    return static_cast<int64_t>(0);
+}
+
+void AsyncLogWriter::Stop()
+{
+    {
+        lock_guard<mutex> scopedLock(mBufferMutex);
+        if(mThreadStopRequest)
+        {
+            return;
+        }
+        mThreadStopRequest = true;
+    }
+    mBufferCondition.notify_all();
+
+    if(mThread && mThread->joinable())
+    {
+        mThread->join();
+    }
+
+#ifdef HAVE_LIBURING
+    if(mRing != nullptr)
+    {
+        io_uring_queue_exit(static_cast<struct io_uring *>(mRing));
+        delete static_cast<struct io_uring *>(mRing);
+        mRing = nullptr;
+    }
+#endif
+
+    if(mFd >= 0)
+    {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+void AsyncLogWriter::Append(const char *data, size_t len)
+{
+    bool wakeup = false;
+
+    // scoped lock for buffers
+    {
+        lock_guard<mutex> scopedLock(mBufferMutex);
+
+        // 磁盘跟不上时丢弃，不能阻塞被插装的代码。
+        // 按整条记录丢弃，日志中不能留下半条记录
+        size_t pending = 0;
+        if(mFull.size() < mConfig.maxPendingBuffers)
+        {
+            pending = mConfig.maxPendingBuffers - mFull.size();
+        }
+        if(len > mConfig.bufferSize - mCurrent->used + pending * mConfig.bufferSize)
+        {
+            mDroppedBytes += len;
+            return;
+        }
+
+        while(len > 0)
+        {
+            size_t room = mConfig.bufferSize - mCurrent->used;
+            if(room == 0)
+            {
+                mFull.push_back(std::move(mCurrent));
+                if(!mFree.empty())
+                {
+                    mCurrent = std::move(mFree.back());
+                    mFree.pop_back();
+                }
+                else
+                {
+                    mCurrent = NewBuffer();
+                }
+                wakeup = true;
+                continue;
+            }
+
+            size_t n = len < room ? len : room;
+            memcpy(mCurrent->data.get() + mCurrent->used, data, n);
+            mCurrent->used += n;
+            data += n;
+            len -= n;
+        }
+    }
+
+    if(wakeup)
+    {
+        mBufferCondition.notify_one();
+    }
+}
+
+void AsyncLogWriter::Flush()
+{
+    {
+        lock_guard<mutex> scopedLock(mBufferMutex);
+        mFlushRequest = true;
+    }
+    mBufferCondition.notify_one();
+}
+
+void AsyncLogWriter::MainLoop()
+{
+    vector<BufferPtr> buffers;
+    bool stop = false;
+
+    while(!stop)
+    {
+        // scopedLock for buffers
+        {
+            unique_lock<mutex> scopedLock(mBufferMutex);
+            mBufferCondition.wait_for(scopedLock,
+                chrono::milliseconds(mConfig.flushMillis),
+                [this]{return !mFull.empty() ||
+                    mFlushRequest ||
+                    mThreadStopRequest;});
+
+            stop = mThreadStopRequest;
+            mFlushRequest = false;
+
+            buffers.swap(mFull);
+            if(mCurrent->used > 0)
+            {
+                buffers.push_back(std::move(mCurrent));
+                if(!mFree.empty())
+                {
+                    mCurrent = std::move(mFree.back());
+                    mFree.pop_back();
+                }
+                else
+                {
+                    mCurrent = NewBuffer();
+                }
+            }
+        }
+
+        if(buffers.empty())
+        {
+            continue;
+        }
+
+        WriteBuffers(buffers);
+
+        // 写完的缓冲区还给前台，最多保留两个，其余释放
+        {
+            lock_guard<mutex> scopedLock(mBufferMutex);
+            for(auto &buffer : buffers)
+            {
+                if(mFree.size() < 2)
+                {
+                    buffer->used = 0;
+                    mFree.push_back(std::move(buffer));
+                }
+            }
+        }
+        buffers.clear();
+    }
+}
+
+void AsyncLogWriter::WriteBuffers(vector<BufferPtr> &buffers)
+{
+    vector<vector<char>> compressed;
+    vector<struct iovec> iov;
+
+    if(mConfig.compress != LOG_COMPRESS_NONE)
+    {
+        compressed.resize(buffers.size());
+    }
+
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+        struct iovec v;
+        if(mConfig.compress != LOG_COMPRESS_NONE &&
+           Compress(*buffers[i], compressed[i]) > 0)
+        {
+            v.iov_base = compressed[i].data();
+            v.iov_len = compressed[i].size();
+        }
+        else
+        {
+            v.iov_base = buffers[i]->data.get();
+            v.iov_len = buffers[i]->used;
+        }
+        iov.push_back(v);
+    }
+
+    for(size_t i = 0; i < iov.size(); i += IOV_MAX)
+    {
+        int n = static_cast<int>(iov.size() - i < IOV_MAX ? iov.size() - i : IOV_MAX);
+        ssize_t written = WriteIovec(&iov[i], n);
+        if(written > 0)
+        {
+            mFileBytes += written;
+            mWrittenBytes += written;
+        }
+        RotateIfNeeded();
+    }
+}
+
+/*写出全部iovec，处理部分写入*/
+ssize_t AsyncLogWriter::WriteIovec(struct iovec *iov, int iovcnt)
+{
+    ssize_t total = 0;
+
+    while(iovcnt > 0)
+    {
+        ssize_t n = -1;
+#ifdef HAVE_LIBURING
+        if(mRing != nullptr)
+        {
+            struct io_uring *ring = static_cast<struct io_uring *>(mRing);
+            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            struct io_uring_cqe *cqe = nullptr;
+            // offset为-1时使用文件当前位置，配合O_APPEND
+            io_uring_prep_writev(sqe, mFd, iov, iovcnt, -1);
+            io_uring_submit(ring);
+            if(io_uring_wait_cqe(ring, &cqe) == 0)
+            {
+                n = cqe->res;
+                io_uring_cqe_seen(ring, cqe);
+                if(n < 0)
+                {
+                    errno = static_cast<int>(-n);
+                    n = -1;
+                }
+            }
+        }
+        else
+#endif
+        {
+            n = writev(mFd, iov, iovcnt);
+        }
+
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            cout << "AsyncLogWriter write error: " << strerror(errno) << endl;
+            return total;
+        }
+
+        total += n;
+        while(iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return total;
+}
+
+/*按块压缩，每个缓冲区是一个独立的帧，拼接后仍可被zstd/lz4命令直接解压*/
+size_t AsyncLogWriter::Compress(const Buffer &in, vector<char> &out)
+{
+#ifdef HAVE_ZSTD
+    if(mConfig.compress == LOG_COMPRESS_ZSTD)
+    {
+        out.resize(ZSTD_compressBound(in.used));
+        size_t n = ZSTD_compress(out.data(), out.size(), in.data.get(), in.used,
+                                 mConfig.compressLevel);
+        if(ZSTD_isError(n))
+        {
+            return 0;
+        }
+        out.resize(n);
+        return n;
+    }
+#endif
+#ifdef HAVE_LZ4
+    if(mConfig.compress == LOG_COMPRESS_LZ4)
+    {
+        out.resize(LZ4F_compressFrameBound(in.used, nullptr));
+        size_t n = LZ4F_compressFrame(out.data(), out.size(), in.data.get(), in.used,
+                                      nullptr);
+        if(LZ4F_isError(n))
+        {
+            return 0;
+        }
+        out.resize(n);
+        return n;
+    }
+#endif
+    (void)in;
+    (void)out;
+    return 0;
+}
+
+int AsyncLogWriter::OpenLogFile()
+{
+    char tmp[64];
+    time_t timep;
+
+    time(&timep);
+    strftime(tmp, sizeof(tmp), "%Y_%m_%d_%H_%M_%S", localtime(&timep));
+
+    string filename = mConfig.basename + "_" + tmp + "_" + to_string(mFileSeq++);
+#ifdef HAVE_ZSTD
+    if(mConfig.compress == LOG_COMPRESS_ZSTD)
+    {
+        filename += ".zst";
+    }
+#endif
+#ifdef HAVE_LZ4
+    if(mConfig.compress == LOG_COMPRESS_LZ4)
+    {
+        filename += ".lz4";
+    }
+#endif
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        cout << "Can not open log file " << filename << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    if(mFd >= 0)
+    {
+        close(mFd);
+    }
+    mFd = fd;
+    mFileBytes = 0;
+    mFileOpenTime = timep;
+
+    return 0;
+}
+
+void AsyncLogWriter::RotateIfNeeded()
+{
+    bool bySize = mConfig.rotateSize > 0 && mFileBytes >= mConfig.rotateSize;
+    bool byTime = mConfig.rotateSeconds > 0 &&
+        time(nullptr) - mFileOpenTime >= mConfig.rotateSeconds;
+
+    if(bySize || byTime)
+    {
+        OpenLogFile();
+    }
+}
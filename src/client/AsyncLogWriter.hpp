@@ -0,0 +1,111 @@
+#ifndef ASYNCLOGWRITER_ASYNCLOGWRITER_HPP
+#define ASYNCLOGWRITER_ASYNCLOGWRITER_HPP
+
+#include <cstdint>
+#include <ctime>
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+本地事件日志的异步写入器。
+插装代码只把格式化好的事件拷贝进内存缓冲区，
+后台线程用writev(O_APPEND)批量写盘，并按大小和时间切分日志文件。
+
+编译选项:
+    -DHAVE_LIBURING  可选用io_uring提交写请求(-luring)
+    -DHAVE_ZSTD      可选用zstd按块压缩(-lzstd)
+    -DHAVE_LZ4       可选用LZ4按块压缩(-llz4)
+*/
+
+typedef enum
+{
+    LOG_COMPRESS_NONE = 0,
+    LOG_COMPRESS_ZSTD,
+    LOG_COMPRESS_LZ4,
+} AsyncLogCompress;
+
+typedef struct AsyncLogConfig
+{
+    std::string basename = "event.log"; // 日志文件名前缀，实际文件名为 basename_日期
+    size_t bufferSize = 4 << 20;        // 每个缓冲区大小
+    size_t maxPendingBuffers = 64;      // 等待写盘的缓冲区上限，超过后丢弃并计数
+    size_t rotateSize = 256 << 20;      // 单个文件的大小上限，0表示不按大小切分
+    int rotateSeconds = 3600;           // 单个文件的时间上限，0表示不按时间切分
+    int flushMillis = 200;              // 缓冲区未满时的最长写盘间隔
+    AsyncLogCompress compress = LOG_COMPRESS_NONE;
+    int compressLevel = 1;
+    bool useIoUring = false;
+} AsyncLogConfig;
+
+class AsyncLogWriter
+{
+public:
+    AsyncLogWriter(const AsyncLogConfig &config = AsyncLogConfig());
+    virtual ~AsyncLogWriter();
+
+    int64_t Start();
+    void Stop();
+
+    /*线程安全，只做内存拷贝*/
+    void Append(const char *data, size_t len);
+    void Append(const std::string &str)
+    {
+        Append(str.data(), str.length());
+    }
+
+    /*唤醒后台线程立即写盘，不等待写盘完成*/
+    void Flush();
+
+    uint64_t DroppedBytes() const { return mDroppedBytes.load(); }
+    uint64_t WrittenBytes() const { return mWrittenBytes.load(); }
+
+private:
+    typedef struct Buffer
+    {
+        std::unique_ptr<char[]> data;
+        size_t used;
+    } Buffer;
+
+    typedef std::unique_ptr<Buffer> BufferPtr;
+
+    BufferPtr NewBuffer();
+    virtual void MainLoop();
+
+    void WriteBuffers(std::vector<BufferPtr> &buffers);
+    ssize_t WriteIovec(struct iovec *iov, int iovcnt);
+    size_t Compress(const Buffer &in, std::vector<char> &out);
+
+    int OpenLogFile();
+    void RotateIfNeeded();
+
+    AsyncLogConfig mConfig;
+
+    BufferPtr mCurrent;
+    std::vector<BufferPtr> mFull;
+    std::vector<BufferPtr> mFree;
+    std::mutex mBufferMutex;
+    std::condition_variable mBufferCondition;
+
+    std::shared_ptr<std::thread> mThread;
+    bool mThreadStopRequest;
+    bool mFlushRequest;
+
+    int mFd;
+    int mFileSeq;
+    size_t mFileBytes;
+    time_t mFileOpenTime;
+
+    std::atomic<uint64_t> mDroppedBytes;
+    std::atomic<uint64_t> mWrittenBytes;
+
+    void *mRing; // struct io_uring*, 仅在HAVE_LIBURING时使用
+};
+
+#endif // ASYNCLOGWRITER_ASYNCLOGWRITER_HPP
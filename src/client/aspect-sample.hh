@@ -0,0 +1,237 @@
+/*
+该头文件提供了热点切入点的采样与限流模式，供aspect.hh中的日志宏使用。
+每个pointcut拥有一个AOPSampler，在advice中决定本次调用是否产生事件。
+
+    AOP_SAMPLE_ALWAYS       每次调用都产生事件(默认，与原有行为相同)
+    AOP_SAMPLE_ONE_IN_N     每N次调用产生一次事件
+    AOP_SAMPLE_TOKEN_BUCKET 令牌桶限流，每秒最多rate个事件，允许burst个突发
+    AOP_SAMPLE_COUNT_ONLY   只计数，每隔interval毫秒发送一次聚合事件，程序退出时发送剩余的计数
+
+非ALWAYS模式产生的事件带有"sample"与"skipped"(或"count")字段，
+服务端据此知道轨迹不完整，违规结论只能作为"可能违规"报告。
+*/
+
+#ifndef __ASPECT_SAMPLE_H__
+#define __ASPECT_SAMPLE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <time.h>
+
+typedef enum
+{
+    AOP_SAMPLE_ALWAYS = 0,
+    AOP_SAMPLE_ONE_IN_N,
+    AOP_SAMPLE_TOKEN_BUCKET,
+    AOP_SAMPLE_COUNT_ONLY,
+} AOPSampleMode;
+
+struct AOPSampler;
+/*发送一个聚合事件, count为聚合的调用数*/
+typedef void (*AOPSampleFlushFn)(AOPSampler &s, uint64_t count);
+
+typedef struct AOPSampler
+{
+    AOPSampleMode mode;
+    uint64_t param; // N, rate(事件/秒) 或 interval(毫秒)
+    uint64_t burst; // 令牌桶容量
+
+    std::atomic<uint64_t> hits;    // 调用次数(COUNT_ONLY下为未发送的计数)
+    std::atomic<uint64_t> skipped; // 自上次发送以来被丢弃的调用次数
+    std::atomic<uint64_t> tokens;  // 令牌桶剩余令牌
+    std::atomic<uint64_t> last_ns; // 上次补充令牌/上次聚合发送的时间
+
+    // COUNT_ONLY: 第一次调用的位置与发送方式, 程序退出时用来发送剩余的计数
+    std::atomic<int> registered;
+    const char *siteEvent;
+    const char *siteFile;
+    int siteLine;
+    AOPSampleFlushFn flush;
+
+    AOPSampler(AOPSampleMode m, uint64_t p = 0, uint64_t b = 0)
+        : mode(m), param(p), burst(b), hits(0), skipped(0), tokens(b), last_ns(0),
+          registered(0), siteEvent(""), siteFile(""), siteLine(0), flush(nullptr)
+    {
+        if (mode == AOP_SAMPLE_ONE_IN_N && param == 0)
+            param = 1;
+        if (mode == AOP_SAMPLE_TOKEN_BUCKET && burst == 0)
+            burst = tokens = (param ? param : 1);
+    }
+} AOPSampler;
+
+/*在.ah文件中为pointcut声明采样器*/
+#define AOP_SAMPLER_ALWAYS(name) AOPSampler name(AOP_SAMPLE_ALWAYS)
+#define AOP_SAMPLER_ONE_IN_N(name, n) AOPSampler name(AOP_SAMPLE_ONE_IN_N, n)
+#define AOP_SAMPLER_TOKEN_BUCKET(name, rate, burst) AOPSampler name(AOP_SAMPLE_TOKEN_BUCKET, rate, burst)
+#define AOP_SAMPLER_COUNT_ONLY(name, interval_ms) AOPSampler name(AOP_SAMPLE_COUNT_ONLY, interval_ms)
+
+static inline uint64_t AOPMonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline const char *AOPSampleModeToString(AOPSampleMode mode)
+{
+    switch (mode)
+    {
+    case AOP_SAMPLE_ALWAYS:
+        return "always";
+    case AOP_SAMPLE_ONE_IN_N:
+        return "1inN";
+    case AOP_SAMPLE_TOKEN_BUCKET:
+        return "rate";
+    case AOP_SAMPLE_COUNT_ONLY:
+        return "count";
+    }
+    return "unknown";
+}
+
+static inline std::mutex &AOPSampleRegistryMutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+static inline std::vector<AOPSampler *> &AOPSampleRegistry()
+{
+    static std::vector<AOPSampler *> samplers;
+    return samplers;
+}
+
+/*AOPSampleFlushAll正在atexit中运行: 发送宏不能再调用exit, 也不能无限等待服务端的回复*/
+static inline std::atomic<int> &AOPSampleAtExit()
+{
+    static std::atomic<int> atExit(0);
+    return atExit;
+}
+
+/*发送所有COUNT_ONLY采样器中还没有发送的计数, 程序退出时由atexit调用*/
+static inline void AOPSampleFlushAll()
+{
+    AOPSampleAtExit().store(1);
+    std::vector<AOPSampler *> samplers;
+    {
+        std::lock_guard<std::mutex> lock(AOPSampleRegistryMutex());
+        samplers = AOPSampleRegistry();
+    }
+    for (AOPSampler *s : samplers)
+    {
+        uint64_t count = s->hits.exchange(0, std::memory_order_relaxed);
+        if (count > 0)
+            s->flush(*s, count);
+    }
+}
+
+/*
+功能：COUNT_ONLY采样器第一次被调用时记录事件的位置与发送方式, 其他模式什么也不做。
+否则最后一个间隔内的计数只有在间隔结束后再被调用时才会发送, 程序退出时就丢失了。
+eventName必须在程序退出前一直有效(通常是字符串常量)。
+*/
+static inline void AOPSampleRegister(AOPSampler &s, const char *eventName, const char *fileName, int line,
+                                     AOPSampleFlushFn flush)
+{
+    if (s.mode != AOP_SAMPLE_COUNT_ONLY || s.registered.load(std::memory_order_acquire))
+        return;
+    std::lock_guard<std::mutex> lock(AOPSampleRegistryMutex());
+    if (s.registered.load(std::memory_order_relaxed))
+        return;
+    s.siteEvent = eventName;
+    s.siteFile = fileName;
+    s.siteLine = line;
+    s.flush = flush;
+    std::vector<AOPSampler *> &samplers = AOPSampleRegistry();
+    if (samplers.empty())
+        atexit(AOPSampleFlushAll);
+    samplers.push_back(&s);
+    s.registered.store(1, std::memory_order_release);
+}
+
+static inline void AOPTokenBucketRefill(AOPSampler &s, uint64_t now)
+{
+    uint64_t last = s.last_ns.load(std::memory_order_relaxed);
+    if (last == 0)
+    {
+        s.last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed);
+        return;
+    }
+    uint64_t elapsed = now > last ? now - last : 0;
+    uint64_t add = elapsed * s.param / 1000000000ull;
+    if (add == 0)
+        return;
+    //只有抢到时间戳的线程负责补充令牌
+    if (!s.last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        return;
+    uint64_t cur = s.tokens.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        next = cur + add > s.burst ? s.burst : cur + add;
+    } while (!s.tokens.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+}
+
+/*
+功能：决定本次调用是否产生事件，不加锁。
+返回1表示需要发送事件，此时out为:
+    ONE_IN_N/TOKEN_BUCKET下自上次发送以来被丢弃的调用数，
+    COUNT_ONLY下本次聚合的调用数。
+*/
+static inline int AOPSampleTake(AOPSampler &s, uint64_t &out)
+{
+    out = 0;
+    switch (s.mode)
+    {
+    case AOP_SAMPLE_ALWAYS:
+        return 1;
+
+    case AOP_SAMPLE_ONE_IN_N:
+        if (s.hits.fetch_add(1, std::memory_order_relaxed) % s.param == 0)
+        {
+            out = s.skipped.exchange(0, std::memory_order_relaxed);
+            return 1;
+        }
+        s.skipped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+
+    case AOP_SAMPLE_TOKEN_BUCKET:
+    {
+        AOPTokenBucketRefill(s, AOPMonotonicNs());
+        uint64_t cur = s.tokens.load(std::memory_order_relaxed);
+        while (cur > 0)
+        {
+            if (s.tokens.compare_exchange_weak(cur, cur - 1, std::memory_order_relaxed))
+            {
+                out = s.skipped.exchange(0, std::memory_order_relaxed);
+                return 1;
+            }
+        }
+        s.skipped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    case AOP_SAMPLE_COUNT_ONLY:
+    {
+        s.hits.fetch_add(1, std::memory_order_relaxed);
+        uint64_t now = AOPMonotonicNs();
+        uint64_t last = s.last_ns.load(std::memory_order_relaxed);
+        if (last == 0)
+        {
+            s.last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed);
+            return 0;
+        }
+        if (now - last < s.param * 1000000ull)
+            return 0;
+        if (!s.last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed))
+            return 0;
+        out = s.hits.exchange(0, std::memory_order_relaxed);
+        return out > 0;
+    }
+    }
+    return 1;
+}
+
+#endif
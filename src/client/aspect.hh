@@ -13,29 +13,15 @@
 #include <mutex>
 #include <sstream>
 #include <time.h>
+#include <cstdio>
 #include <cstring>
 #include "automonitor-client.hpp"
+#include "aspect-sample.hh"
+#include "AsyncLogWriter.hpp"
+#include "../shm-ring.hh"
 
 using namespace std;
-/*color*/
-#define RESET "\033[0m"
-#define BLACK "\033[30m"              /* Black */
-#define RED "\033[31m"                /* Red */
-#define GREEN "\033[32m"              /* Green */
-#define YELLOW "\033[33m"             /* Yellow */
-#define BLUE "\033[34m"               /* Blue */
-#define MAGENTA "\033[35m"            /* Magenta */
-#define CYAN "\033[36m"               /* Cyan */
-#define WHITE "\033[37m"              /* White */
-#define BOLDBLACK "\033[1m\033[30m"   /* Bold Black */
-#define BOLDRED "\033[1m\033[31m"     /* Bold Red */
-#define BOLDGREEN "\033[1m\033[32m"   /* Bold Green */
-#define BOLDYELLOW "\033[1m\033[33m"  /* Bold Yellow */
-#define BOLDBLUE "\033[1m\033[34m"    /* Bold Blue */
-#define BOLDMAGENTA "\033[1m\033[35m" /* Bold Magenta */
-#define BOLDCYAN "\033[1m\033[36m"    /* Bold Cyan */
-#define BOLDWHITE "\033[1m\033[37m"   /* Bold White */
-//end
+#include "../util-debug.hh" //颜色与INFOPrint等打印宏
 
 typedef enum
 {
@@ -55,6 +41,9 @@ std::mutex mtx;
 int fileIsExisted = -1;
 int eventid = 0;
 int socket_connect_state = -1;
+int asyncLogStarted = -1;
+std::once_flag shmRingOnce; //各线程第一次写入共享内存环前打开环
+SHMRing amShmRing;
 
 #define INIT_AOP_CONFIG
 
@@ -74,6 +63,10 @@ char* getDate()
 */
 #define EVENTLOG(mycout) std::ofstream mycout;
 
+/*异步写入的本地事件日志, 由后台线程批量写盘并切分文件*/
+#define ASYNCEVENTLOG(logwriter) AsyncLogWriter logwriter;
+#define ASYNCEVENTLOG_CONFIG(logwriter, config) AsyncLogWriter logwriter(config);
+
 #define CREATELOGFILEBYDATE(filename)                                       \
     {                                                                       \
         std::stringstream sstream;                                          \
@@ -118,24 +111,19 @@ char* getDate()
     }
 #define DATE_FORMAT "%Y-%m-%d-%H:%M:%s"
 
-#define TimeStamp_str(tstr)                                         \
-    {                                                               \
-        time_t timep;                                               \
-        time(&timep);                                               \
-        char tmp[64] = {'\0'};                                      \
-        strftime(tmp, sizeof(tmp), DATE_FORMAT, localtime(&timep)); \
-        tstr = tmp;                                                 \
+/*秒数之后带".微秒", 服务端的有时间界限的性质需要毫秒以下的精度*/
+#define TimeStamp_str(tstr)                                                  \
+    {                                                                        \
+        struct timespec ts;                                                  \
+        clock_gettime(CLOCK_REALTIME, &ts);                                  \
+        char tmp[64] = {'\0'};                                               \
+        strftime(tmp, sizeof(tmp), DATE_FORMAT, localtime(&ts.tv_sec));      \
+        size_t n = strlen(tmp);                                              \
+        snprintf(tmp + n, sizeof(tmp) - n, ".%06ld", ts.tv_nsec / 1000);     \
+        tstr = tmp;                                                          \
     }
 
 #define TimeStamp_Num(num)
-//======================================
-//Logger module=========================
-//======================================
-#define INFOPrint(x)                                        \
-    {                                                       \
-        std::cout << BOLDYELLOW << x << RESET << std::endl; \
-    }
-//END Logger module=====================
 
 //======================================
 //ZeroMQ module=========================
@@ -155,6 +143,32 @@ char* getDate()
     {                                                      \
         INFOPrint("PARSE JSON WRONG");                     \
         exit(0);                                           \
+    }                                                      \
+    else if (strncmp((char *)Reply.data(), "201", 3) == 0) \
+    {                                                      \
+        INFOPrint("POSSIBLE WRONG (SAMPLED TRACE)");       \
+    }                                                      \
+    else if (strncmp((char *)Reply.data(), "101", 3) == 0) \
+    {                                                      \
+        INFOPrint("PROPERTY SATISFIED");                   \
+    }
+
+/*
+程序退出时AOPSampleFlushAll发送最后的计数后等待回复: 最多等待AOP_FLUSH_TIMEOUT_MS, 只记录回复码。
+atexit处理函数中不能再调用exit, 服务端已经停止时也不能一直等待。
+*/
+#define AOP_FLUSH_TIMEOUT_MS 1000
+#define ZMQ_SOCKET_RECV_AT_EXIT(Reply)                                                  \
+    {                                                                                   \
+        zmq::pollitem_t aop_item = {static_cast<void *>(socket), 0, ZMQ_POLLIN, 0};     \
+        if (zmq::poll(&aop_item, 1, AOP_FLUSH_TIMEOUT_MS) <= 0 || !socket.recv(&Reply)) \
+        {                                                                               \
+            INFOPrint("NO REPLY TO THE FINAL SAMPLED COUNT");                           \
+        }                                                                               \
+        else if (Reply.size() >= 3 && strncmp((char *)Reply.data(), "200", 3) == 0)     \
+        {                                                                               \
+            INFOPrint("CHECK OUT WRONG");                                               \
+        }                                                                               \
     }
 
 //End ZeroMQ module=====================
@@ -191,6 +205,53 @@ char* getDate()
         id++;                                       \
     }
 
+/*与AOPLogger_ID_ADD相同, 但由调用者给出位置, 不访问tjp*/
+#define AOPLogger_ID_ADDAt(id, eventName, fileName, line, mycout) \
+    {                                                             \
+        std::string tstr;                                         \
+        TimeStamp_str(tstr);                                      \
+        mycout << "{\"eventId\":" << id << ","                    \
+               << "\"eventName\":"                                \
+               << "\"" << eventName << "\","                      \
+               << "\"fileName\":"                                 \
+               << "\"" << fileName << "\""                        \
+               << ","                                             \
+               << "\"line\":" << line << ","                      \
+               << "\"eventTime\":"                                \
+               << "\"" << tstr << "\""                            \
+               << "}" << std::endl;                               \
+        id++;                                                     \
+    }
+
+/*
+带采样信息的事件日志, sample为采样模式, 
+skipped为丢弃的调用数(COUNT_ONLY模式下为聚合的调用数)。
+*/
+#define AOPLogger_Sampled(id, eventName, mycout, sampler, skipped) \
+    AOPLogger_SampledAt(id, eventName, tjp->filename(), tjp->line(), mycout, sampler, skipped)
+
+/*与AOPLogger_Sampled相同, 但由调用者给出位置, 用于在advice之外发送剩余的计数*/
+#define AOPLogger_SampledAt(id, eventName, fileName, line, mycout, sampler, skipped) \
+    {                                                                       \
+        std::string tstr;                                                   \
+        TimeStamp_str(tstr);                                                \
+        mycout << "{\"eventId\":" << id << ","                              \
+               << "\"eventName\":"                                          \
+               << "\"" << eventName << "\","                                \
+               << "\"fileName\":"                                           \
+               << "\"" << fileName << "\""                                  \
+               << ","                                                       \
+               << "\"line\":" << line << ","                                \
+               << "\"eventTime\":"                                          \
+               << "\"" << tstr << "\","                                     \
+               << "\"sample\":"                                             \
+               << "\"" << AOPSampleModeToString(sampler.mode) << "\","      \
+               << (sampler.mode == AOP_SAMPLE_COUNT_ONLY ? "\"count\":"     \
+                                                         : "\"skipped\":")  \
+               << skipped                                                   \
+               << "}" << std::endl;                                         \
+    }
+
 /*拥有互斥锁
 Print the event log to mycout.
 */
@@ -235,8 +296,8 @@ Print the event log to mycout.
         cout << str;                                                  \
         memcpy(request.data(), (void *)(str.c_str()), str.length());  \
         socket.send(request);                                         \
-        ZMQ_SOCKET_RECV(reply);                                       \
         mtx.unlock();                                                 \
+        ZMQ_SOCKET_RECV(reply);                                       \
     } while (0);
 
 #define AOPLoggerToBufferNewFile(id, eventName, addr, mycout)                   \
@@ -286,8 +347,177 @@ Print the event log to mycout.
         memcpy(request.data(), (void *)(str.c_str()), str.length());            \
         socket.send(request.data(), str.length());                              \
         socket.recv(&reply);                                                    \
-        ZMQ_SOCKET_RECV(reply);                                                 \
         mtx.unlock();                                                           \
+        ZMQ_SOCKET_RECV(reply);                                                 \
+    } while (0);
+
+/*持有互斥锁发送一个采样事件, 并写入本地日志mycout*/
+#define AOPSampledSendToBufferNewFile(sampler, id, eventName, fileName, line, addr, mycout, skipped) \
+    {                                                                                                \
+        mtx.lock();                                                                                  \
+        if (fileIsExisted == -1)                                                                     \
+        {                                                                                            \
+            std::stringstream sstream;                                                               \
+            time_t timep;                                                                            \
+            time(&timep);                                                                            \
+            char tmp[64];                                                                            \
+            strftime(tmp, sizeof(tmp), "%Y_%m_%d_%H_%M_%S", localtime(&timep));                      \
+            sstream << "_" << tmp << std::endl;                                                      \
+            mycout.open("event.log" + sstream.str(), ios::app);                                      \
+            fileIsExisted = 0;                                                                       \
+        }                                                                                            \
+        CHECKSOCKETCONNECT(socket);                                                                  \
+        zmq::message_t reply;                                                                        \
+        stringstream sstream;                                                                        \
+        AOPLogger_SampledAt(id, eventName, fileName, line, sstream, sampler, skipped);               \
+        AOPLogger_SampledAt(id, eventName, fileName, line, mycout, sampler, skipped);                \
+        id++;                                                                                        \
+        string str = sstream.str();                                                                  \
+        socket.send(str.c_str(), str.length());                                                      \
+        if (AOPSampleAtExit().load())                                                                \
+        {                                                                                            \
+            ZMQ_SOCKET_RECV_AT_EXIT(reply);                                                          \
+            mtx.unlock();                                                                            \
+        }                                                                                            \
+        else                                                                                         \
+        {                                                                                            \
+            socket.recv(&reply);                                                                     \
+            mtx.unlock();                                                                            \
+            ZMQ_SOCKET_RECV(reply);                                                                  \
+        }                                                                                            \
+    }
+
+/*
+按pointcut的采样器决定是否产生事件, 采样判断不加锁,
+只有需要发送的事件才进入互斥锁。ALWAYS模式与AOPLoggerToBufferNewFile相同。
+COUNT_ONLY模式下最后一个间隔的计数在程序退出时发送。
+*/
+#define AOPSampledLoggerToBufferNewFile(sampler, id, eventName, addr, mycout)                           \
+    do                                                                                                  \
+    {                                                                                                   \
+        uint64_t aop_skipped = 0;                                                                       \
+        AOPSampleRegister(sampler, eventName, tjp->filename(), tjp->line(),                             \
+                          [](AOPSampler &aop_s, uint64_t aop_count) {                                   \
+                              AOPSampledSendToBufferNewFile(aop_s, id, aop_s.siteEvent, aop_s.siteFile, \
+                                                            aop_s.siteLine, addr, mycout, aop_count);   \
+                          });                                                                           \
+        if (AOPSampleTake(sampler, aop_skipped) == 0)                                                   \
+            break;                                                                                      \
+        if (sampler.mode == AOP_SAMPLE_ALWAYS)                                                          \
+        {                                                                                               \
+            AOPLoggerToBufferNewFile(id, eventName, addr, mycout);                                      \
+            break;                                                                                      \
+        }                                                                                               \
+        AOPSampledSendToBufferNewFile(sampler, id, eventName, tjp->filename(), tjp->line(), addr,       \
+                                      mycout, aop_skipped);                                             \
+    } while (0);
+
+/*持有互斥锁发送一个事件, 并交给AsyncLogWriter*/
+#define AOPSampledSendToAsyncLog(sampler, id, eventName, fileName, line, addr, logwriter, skipped) \
+    {                                                                                              \
+        mtx.lock();                                                                                \
+        if (asyncLogStarted == -1)                                                                 \
+        {                                                                                          \
+            logwriter.Start();                                                                     \
+            asyncLogStarted = 0;                                                                   \
+        }                                                                                          \
+        CHECKSOCKETCONNECT(socket);                                                                \
+        zmq::message_t reply;                                                                      \
+        stringstream sstream;                                                                      \
+        if (sampler.mode == AOP_SAMPLE_ALWAYS)                                                     \
+        {                                                                                          \
+            AOPLogger_ID_ADDAt(id, eventName, fileName, line, sstream);                            \
+        }                                                                                          \
+        else                                                                                       \
+        {                                                                                          \
+            AOPLogger_SampledAt(id, eventName, fileName, line, sstream, sampler, skipped);         \
+            id++;                                                                                  \
+        }                                                                                          \
+        string str = sstream.str();                                                                \
+        logwriter.Append(str);                                                                     \
+        socket.send(str.c_str(), str.length());                                                    \
+        if (AOPSampleAtExit().load())                                                              \
+        {                                                                                          \
+            ZMQ_SOCKET_RECV_AT_EXIT(reply);                                                        \
+            mtx.unlock();                                                                          \
+        }                                                                                          \
+        else                                                                                       \
+        {                                                                                          \
+            socket.recv(&reply);                                                                   \
+            mtx.unlock();                                                                          \
+            ZMQ_SOCKET_RECV(reply);                                                                \
+        }                                                                                          \
+    }
+
+/*
+与AOPSampledLoggerToBufferNewFile相同, 但本地日志交给AsyncLogWriter,
+事件只格式化一次, 互斥锁内不再有磁盘I/O。
+*/
+#define AOPSampledLoggerToAsyncLog(sampler, id, eventName, addr, logwriter)                         \
+    do                                                                                              \
+    {                                                                                               \
+        uint64_t aop_skipped = 0;                                                                   \
+        AOPSampleRegister(sampler, eventName, tjp->filename(), tjp->line(),                         \
+                          [](AOPSampler &aop_s, uint64_t aop_count) {                               \
+                              AOPSampledSendToAsyncLog(aop_s, id, aop_s.siteEvent, aop_s.siteFile,  \
+                                                       aop_s.siteLine, addr, logwriter, aop_count); \
+                          });                                                                       \
+        if (AOPSampleTake(sampler, aop_skipped) == 0)                                               \
+            break;                                                                                  \
+        AOPSampledSendToAsyncLog(sampler, id, eventName, tjp->filename(), tjp->line(), addr,        \
+                                 logwriter, aop_skipped);                                           \
+    } while (0);
+
+/*打开共享内存环(每个进程一次)并写入一个事件*/
+#define AOPSampledSendToShm(sampler, id, eventName, fileName, line, shmname, skipped) \
+    {                                                                                 \
+        std::call_once(shmRingOnce, [] {                                              \
+            if (shm_ring_open(amShmRing, shmname) != SUCCESS)                         \
+            {                                                                         \
+                INFOPrint("Can not open shared memory ring " << shmname);             \
+                if (AOPSampleAtExit().load() == 0)                                    \
+                    exit(0);                                                          \
+            }                                                                         \
+        });                                                                           \
+        if (amShmRing.hdr != nullptr)                                                 \
+        {                                                                             \
+            struct timespec aop_ts;                                                   \
+            clock_gettime(CLOCK_REALTIME, &aop_ts);                                   \
+            uint64_t aop_id = __sync_fetch_and_add(&id, 1);                           \
+            shm_ring_push_event(amShmRing, aop_id, eventName, fileName, line,         \
+                                aop_ts.tv_sec * 1000000000ll + aop_ts.tv_nsec,        \
+                                sampler.mode, skipped);                               \
+        }                                                                             \
+    }
+
+/*
+同一台主机上通过共享内存环发送二进制事件, 不经过ZeroMQ, 也不需要等待服务端回复。
+服务端的检测结论在环头部的verdict中, 含义与ZMQ回复码相同。
+*/
+#define AOPSampledLoggerToShm(sampler, id, eventName, shmname)                                \
+    do                                                                                        \
+    {                                                                                         \
+        uint64_t aop_skipped = 0;                                                             \
+        AOPSampleRegister(sampler, eventName, tjp->filename(), tjp->line(),                   \
+                          [](AOPSampler &aop_s, uint64_t aop_count) {                         \
+                              AOPSampledSendToShm(aop_s, id, aop_s.siteEvent, aop_s.siteFile, \
+                                                  aop_s.siteLine, shmname, aop_count);        \
+                          });                                                                 \
+        if (AOPSampleTake(sampler, aop_skipped) == 0)                                         \
+            break;                                                                            \
+        AOPSampledSendToShm(sampler, id, eventName, tjp->filename(), tjp->line(), shmname,    \
+                            aop_skipped);                                                     \
+        uint32_t aop_verdict = amShmRing.hdr->verdict.load();                                 \
+        if (aop_verdict == 200)                                                               \
+        {                                                                                     \
+            INFOPrint("CHECK OUT WRONG");                                                     \
+            exit(0);                                                                          \
+        }                                                                                     \
+        else if (aop_verdict == 201)                                                          \
+        {                                                                                     \
+            INFOPrint("POSSIBLE WRONG (SAMPLED TRACE)");                                      \
+            amShmRing.hdr->verdict.store(0);                                                  \
+        }                                                                                     \
     } while (0);
 
 #endif
@@ -1,4 +1,4 @@
 #!/bin/sh
-g++ automonitor-client.cpp ../util-error.cc ../util-debug.hh -o client -lzmq
+g++ automonitor-client.cpp ../util-error.cc ../util-log.cc -o client -lzmq
 #g++ server.cpp -o server -lzmq
 
@@ -1,2 +1,2 @@
 #!/bin/sh
-ag++ -g test.cpp EventLoop.cpp automonitor-client.cpp EventLoop.hpp  -o test -lpthread -lzmq 
+ag++ -g test.cpp EventLoop.cpp AsyncLogWriter.cpp automonitor-client.cpp ../shm-ring.cc ../util-error.cc ../util-log.cc EventLoop.hpp  -o test -lpthread -lzmq 
@@ -2,6 +2,6 @@
 g++ -g -std=c++14 -I/usr/local/include automonitor.cc  \
 	cJSON.c	util-error.cc ltl-parse.cc \
 	CJsonObject.cpp	  util-base.cc				\
-	solidity.cc	util-parse.cc	\
+	solidity.cc	util-parse.cc	shm-ring.cc util-log.cc util-metrics.cc event-decode.cc util-arena.cc monitor-reload.cc checkpoint.cc slice.cc router.cc timed.cc \
 	-L/usr/local/lib -lspot -lbddx -lzmq -lyaml-cpp -lgvc -lcgraph -o automonitor
 
@@ -0,0 +1,342 @@
+#include "event-decode.hh"
+#include "util-error.hh"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+找到下一个'"'或'\\', 字符串扫描是解码的主要开销, 每次比较16个字节。
+找不到时返回end。
+*/
+static inline const char *scan_quote(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    while (p + 16 <= end)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                  _mm_cmpeq_epi8(v, bslash)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\')
+    {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *skip_ws(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    {
+        p++;
+    }
+    return p;
+}
+
+/*p指向开头的'"', 成功时返回结尾'"'之后的位置, 失败返回nullptr*/
+static const char *parse_string(const char *p, const char *end, AMStrView &out, int &escaped)
+{
+    const char *start = ++p;
+    for (;;)
+    {
+        p = scan_quote(p, end);
+        if (p >= end)
+        {
+            return nullptr;
+        }
+        if (*p == '"')
+        {
+            break;
+        }
+        //反斜杠: 跳过被转义的字符
+        escaped = 1;
+        p += 2;
+        if (p > end)
+        {
+            return nullptr;
+        }
+    }
+    out.ptr = start;
+    out.len = p - start;
+    return p + 1;
+}
+
+/*整数部分存入out, 小数和指数只做语法检查*/
+static const char *parse_number(const char *p, const char *end, int64_t &out)
+{
+    int neg = 0;
+    uint64_t v = 0;
+    const char *digits;
+
+    if (p < end && *p == '-')
+    {
+        neg = 1;
+        p++;
+    }
+    digits = p;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        if (v > (UINT64_MAX - 9) / 10)
+        {
+            return nullptr;
+        }
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    if (p == digits)
+    {
+        return nullptr;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        if (p >= end || *p < '0' || *p > '9')
+        {
+            return nullptr;
+        }
+        while (p < end && *p >= '0' && *p <= '9')
+            p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if (p < end && (*p == '+' || *p == '-'))
+            p++;
+        if (p >= end || *p < '0' || *p > '9')
+        {
+            return nullptr;
+        }
+        while (p < end && *p >= '0' && *p <= '9')
+            p++;
+    }
+    if (v > (uint64_t)INT64_MAX)
+    {
+        return nullptr;
+    }
+    out = neg ? -(int64_t)v : (int64_t)v;
+    return p;
+}
+
+static const char *parse_literal(const char *p, const char *end, const char *lit, size_t n)
+{
+    if ((size_t)(end - p) < n || memcmp(p, lit, n) != 0)
+    {
+        return nullptr;
+    }
+    return p + n;
+}
+
+#define KEY_IS(k) AMStrViewEqual(key, k, sizeof(k) - 1)
+
+AMError AMDecodeEvent(const char *buf, size_t len, AMEventView &ev)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+
+    ev.eventId = ev.line = ev.skipped = ev.count = ev.eventTimeNum = -1;
+    ev.eventName.ptr = ev.fileName.ptr = ev.eventTime.ptr = ev.sample.ptr = ev.slice.ptr = nullptr;
+    ev.eventName.len = ev.fileName.len = ev.eventTime.len = ev.sample.len = ev.slice.len = 0;
+    ev.escaped = 0;
+
+    p = skip_ws(p, end);
+    if (p >= end || *p != '{')
+    {
+        return JSON_EVENT_DECODE_ERROR;
+    }
+    ev.raw.ptr = p++;
+
+    p = skip_ws(p, end);
+    if (p < end && *p == '}')
+    {
+        ev.raw.len = p + 1 - ev.raw.ptr;
+        return SUCCESS;
+    }
+
+    for (;;)
+    {
+        AMStrView key;
+
+        p = skip_ws(p, end);
+        if (p >= end || *p != '"' || (p = parse_string(p, end, key, ev.escaped)) == nullptr)
+        {
+            return JSON_EVENT_DECODE_ERROR;
+        }
+        p = skip_ws(p, end);
+        if (p >= end || *p != ':')
+        {
+            return JSON_EVENT_DECODE_ERROR;
+        }
+        p = skip_ws(p + 1, end);
+        if (p >= end)
+        {
+            return JSON_EVENT_DECODE_ERROR;
+        }
+
+        if (*p == '"')
+        {
+            AMStrView val;
+            p = parse_string(p, end, val, ev.escaped);
+            if (p == nullptr)
+            {
+                return JSON_EVENT_DECODE_ERROR;
+            }
+            if (KEY_IS("eventName"))
+                ev.eventName = val;
+            else if (KEY_IS("fileName"))
+                ev.fileName = val;
+            else if (KEY_IS("eventTime"))
+                ev.eventTime = val;
+            else if (KEY_IS("sample"))
+                ev.sample = val;
+            else if (KEY_IS("slice"))
+                ev.slice = val;
+        }
+        else if (*p == '-' || (*p >= '0' && *p <= '9'))
+        {
+            int64_t val;
+            p = parse_number(p, end, val);
+            if (p == nullptr)
+            {
+                return JSON_EVENT_DECODE_ERROR;
+            }
+            if (KEY_IS("eventId"))
+                ev.eventId = val;
+            else if (KEY_IS("line"))
+                ev.line = val;
+            else if (KEY_IS("skipped"))
+                ev.skipped = val;
+            else if (KEY_IS("count"))
+                ev.count = val;
+            else if (KEY_IS("eventTime"))
+                ev.eventTimeNum = val;
+        }
+        else if (*p == 't')
+        {
+            p = parse_literal(p, end, "true", 4);
+        }
+        else if (*p == 'f')
+        {
+            p = parse_literal(p, end, "false", 5);
+        }
+        else if (*p == 'n')
+        {
+            p = parse_literal(p, end, "null", 4);
+        }
+        else
+        {
+            //嵌套的对象和数组不属于事件格式
+            return JSON_EVENT_DECODE_ERROR;
+        }
+        if (p == nullptr)
+        {
+            return JSON_EVENT_DECODE_ERROR;
+        }
+
+        p = skip_ws(p, end);
+        if (p >= end)
+        {
+            return JSON_EVENT_DECODE_ERROR;
+        }
+        if (*p == ',')
+        {
+            p++;
+            continue;
+        }
+        if (*p == '}')
+        {
+            ev.raw.len = p + 1 - ev.raw.ptr;
+            return SUCCESS;
+        }
+        return JSON_EVENT_DECODE_ERROR;
+    }
+}
+
+int64_t AMEventTimeNs(const AMEventView &ev)
+{
+    if (ev.eventTimeNum >= 0)
+    {
+        return ev.eventTimeNum;
+    }
+    if (ev.eventTime.ptr == nullptr)
+    {
+        return -1;
+    }
+    //"%Y-%m-%d-%H:%M:%s", 可能带有".微秒"
+    const char *p = ev.eventTime.ptr + ev.eventTime.len;
+    while (p > ev.eventTime.ptr && p[-1] != ':')
+    {
+        p--;
+    }
+    const char *end = ev.eventTime.ptr + ev.eventTime.len;
+    int64_t sec = 0, frac = 0, scale = 1000000000;
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        sec = sec * 10 + (*p++ - '0');
+    }
+    if (p == digits)
+    {
+        return -1;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (scale > 1)
+            {
+                scale /= 10;
+                frac += (*p - '0') * scale;
+            }
+        }
+    }
+    return p == end ? sec * 1000000000 + frac : -1;
+}
+
+std::ostream &AMJsonEscape(std::ostream &os, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *run = s;
+    for (const char *p = s; p < s + len; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+        os.write(run, p - run);
+        run = p + 1;
+        switch (c)
+        {
+        case '"':
+            os << "\\\"";
+            break;
+        case '\\':
+            os << "\\\\";
+            break;
+        case '\n':
+            os << "\\n";
+            break;
+        case '\r':
+            os << "\\r";
+            break;
+        case '\t':
+            os << "\\t";
+            break;
+        default:
+            os << "\\u00" << hex[c >> 4] << hex[c & 15];
+            break;
+        }
+    }
+    return os.write(run, s + len - run);
+}
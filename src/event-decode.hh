@@ -0,0 +1,57 @@
+#pragma once
+/*
+AOPLogger事件的专用JSON解码器, 替代每个事件一次的cJSON_Parse。
+只支持AOPLogger输出的扁平对象(值为字符串、数字或true/false/null),
+在原缓冲区上扫描, 字段以AMStrView的形式指向原缓冲区, 不分配内存。
+缓冲区不需要以'\0'结尾, 第一个完整对象之后的内容被忽略(与Check_json_log_format相同)。
+*/
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "util-error.hh"
+
+typedef struct AMStrView
+{
+    const char *ptr;
+    size_t len;
+} AMStrView;
+
+static inline std::ostream &operator<<(std::ostream &os, const AMStrView &v)
+{
+    return os.write(v.ptr, v.len);
+}
+
+static inline bool AMStrViewEqual(const AMStrView &v, const char *s, size_t n)
+{
+    return v.len == n && __builtin_memcmp(v.ptr, s, n) == 0;
+}
+
+/*字段不存在时ptr为nullptr, 数字字段不存在时为-1*/
+typedef struct AMEventView
+{
+    int64_t eventId;
+    int64_t line;
+    int64_t skipped;
+    int64_t count;
+    int64_t eventTimeNum; //"eventTime"为数字时的值(纳秒)
+    AMStrView eventName;
+    AMStrView fileName;
+    AMStrView eventTime;
+    AMStrView sample;
+    AMStrView slice; //参数化监控的对象标识, 同一个slice的事件由同一个monitor实例检测
+    AMStrView raw;   //整个对象, 从'{'到'}'
+    int escaped;     //键或字符串值中含有转义字符, 视图中保留原样
+} AMEventView;
+
+/*成功返回SUCCESS, 格式错误返回JSON_EVENT_DECODE_ERROR*/
+AMError AMDecodeEvent(const char *buf, size_t len, AMEventView &ev);
+
+/*
+事件时间, 纳秒(CLOCK_REALTIME), 没有或无法解析时返回-1。
+"eventTime"可以是纳秒数, 也可以是AOPLogger输出的字符串, 取最后一个':'之后的秒数(可以带小数)。
+*/
+int64_t AMEventTimeNs(const AMEventView &ev);
+
+/*把s作为JSON字符串的内容(不含两边的引号)写入os, 转义'"'、'\\'和控制字符*/
+std::ostream &AMJsonEscape(std::ostream &os, const char *s, size_t len);
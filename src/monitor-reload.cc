@@ -0,0 +1,283 @@
+#include "monitor-reload.hh"
+
+#include <chrono>
+#include <thread>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <spot/twaalgos/product.hh>
+#include <yaml-cpp/yaml.h>
+
+#include "checkpoint.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+typedef struct AMRetired
+{
+    AMCompiled *cm;
+    uint64_t epoch; //所有读者的epoch都大于它时才能释放
+} AMRetired;
+
+static std::atomic<AMCompiled *> reload_current(nullptr);
+static std::atomic<uint64_t> reload_epoch(1);
+//每个检测线程一个槽, 保存进入临界区时的epoch, 0表示不在临界区
+static std::atomic<uint64_t> reload_readers[AM_RELOAD_MAX_READERS];
+static std::atomic<int> reload_reader_count(0);
+static thread_local int reload_slot = -1;
+
+static std::vector<AMRetired> reload_retired; //只在监视线程访问
+static std::atomic<bool> reload_stop(false);
+static std::thread reload_thread;
+
+int AMReloadPolicyFromString(const std::string &name)
+{
+    if (name == "restart")
+    {
+        return AM_RELOAD_RESTART;
+    }
+    if (name == "product")
+    {
+        return AM_RELOAD_PRODUCT;
+    }
+    return -1;
+}
+
+void AMReloadPublishInitial(AMCompiled *initial)
+{
+    initial->generation = 1;
+    initial->prev_generation = 0;
+    reload_current.store(initial, std::memory_order_seq_cst);
+}
+
+AMCompiled *AMReloadEnter(AMReloadCursor &cursor)
+{
+    if (reload_slot < 0)
+    {
+        reload_slot = reload_reader_count.fetch_add(1);
+        if (reload_slot >= AM_RELOAD_MAX_READERS)
+        {
+            ERRORPrint("Too many checker threads for hot reload");
+            exit(1);
+        }
+    }
+    reload_readers[reload_slot].store(reload_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    AMCompiled *cm = reload_current.load(std::memory_order_seq_cst);
+
+    if (cm->generation != cursor.generation)
+    {
+        if (cursor.generation != 0)
+        {
+            int next = -1;
+            if (cm->prev_generation == cursor.generation && cursor.state_number >= 0 &&
+                (size_t)cursor.state_number < cm->state_map.size())
+            {
+                next = cm->state_map[cursor.state_number];
+            }
+            cm->monitor.state_number = next >= 0 ? next : cm->monitor.init_state;
+            cm->monitor.sampled = cursor.sampled;
+            INFOPrint("Switch to monitor generation " << cm->generation << ", state " << cursor.state_number
+                                                      << " -> " << cm->monitor.state_number);
+        }
+        cursor.generation = cm->generation;
+    }
+    return cm;
+}
+
+void AMReloadLeave(AMReloadCursor &cursor, AMCompiled *cm)
+{
+    cursor.state_number = cm->monitor.state_number;
+    cursor.sampled = cm->monitor.sampled;
+    reload_readers[reload_slot].store(0, std::memory_order_release);
+}
+
+/*释放已经没有读者的旧版本*/
+static void reload_collect()
+{
+    if (reload_retired.empty())
+    {
+        return;
+    }
+    uint64_t oldest = UINT64_MAX;
+    int n = reload_reader_count.load(std::memory_order_acquire);
+    for (int i = 0; i < n && i < AM_RELOAD_MAX_READERS; i++)
+    {
+        uint64_t e = reload_readers[i].load(std::memory_order_seq_cst);
+        if (e != 0 && e < oldest)
+        {
+            oldest = e;
+        }
+    }
+    size_t kept = 0;
+    for (auto &r : reload_retired)
+    {
+        if (r.epoch < oldest)
+        {
+            AMLogDebug("Free monitor generation " << r.cm->generation);
+            delete r.cm;
+        }
+        else
+        {
+            reload_retired[kept++] = r;
+        }
+    }
+    reload_retired.resize(kept);
+}
+
+/*
+在old和cm的乘积上, 旧状态s对应的新状态集合只有一个元素时映射到它。
+同一个旧状态可以由不同的历史到达, 新monitor在这些历史上的状态不同时无法确定, 只能回到初始状态。
+*/
+static void reload_state_map(AMCompiled *old, AMCompiled *cm)
+{
+    spot::twa_graph_ptr prod = spot::product(old->aut, cm->aut);
+    auto ps = prod->get_named_prop<spot::product_states>("product-states");
+
+    cm->state_map.assign(old->aut->num_states(), -2); //-2: 乘积中没有出现
+    for (auto &p : *ps)
+    {
+        int &m = cm->state_map[p.first];
+        if (m == -2)
+        {
+            m = p.second;
+        }
+        else if (m != (int)p.second)
+        {
+            m = -1;
+        }
+    }
+    unsigned mapped = 0;
+    for (auto &m : cm->state_map)
+    {
+        if (m < 0)
+        {
+            m = -1;
+        }
+        else
+        {
+            mapped++;
+        }
+    }
+    INFOPrint("Product mapping: " << mapped << " of " << cm->state_map.size() << " states mapped");
+}
+
+static int reload_compile(const std::string &config, AMReloadPolicy policy)
+{
+    FuncBegin();
+    auto t0 = std::chrono::steady_clock::now();
+    AMCompiled *old = reload_current.load(std::memory_order_acquire);
+    AMCompiled *cm = new AMCompiled();
+
+    try
+    {
+        YAML::Node node = YAML::LoadFile(config);
+        if (Generate_automata(node, old->aut->get_dict(), cm->aut) != SUCCESS || cm->aut == nullptr ||
+            Parse_automata_to_monitor(cm->monitor, cm->aut, cm->aut->get_dict()) != SUCCESS)
+        {
+            ERRORPrint("Reload " << config << " failed, keep monitor generation " << old->generation);
+            delete cm;
+            AMReturn(MONITOR_RELOAD_ERROR);
+        }
+        cm->monitor.init_state = cm->monitor.state_number = cm->aut->get_init_state_number();
+        cm->monitor.sampled = 0;
+        cm->fingerprint = AMMonitorFingerprint(cm->monitor);
+        cm->generation = old->generation + 1;
+        cm->prev_generation = old->generation;
+        if (policy == AM_RELOAD_PRODUCT)
+        {
+            reload_state_map(old, cm);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        //配置写到一半或者公式有误, 保留当前版本
+        ERRORPrint("Reload " << config << " failed: " << e.what());
+        delete cm;
+        AMReturn(MONITOR_RELOAD_ERROR);
+    }
+
+    reload_current.store(cm, std::memory_order_seq_cst);
+    uint64_t epoch = reload_epoch.fetch_add(1, std::memory_order_seq_cst);
+    reload_retired.push_back({old, epoch});
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    INFOPrint("Reloaded monitor generation " << cm->generation << " (" << cm->aut->num_states()
+                                             << " states) in " << ms << " ms");
+    FuncEnd();
+    return SUCCESS;
+}
+
+static void reload_watch(std::string config, AMReloadPolicy policy)
+{
+    size_t slash = config.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : config.substr(0, slash);
+    std::string base = slash == std::string::npos ? config : config.substr(slash + 1);
+
+    //监视所在目录: 编辑器保存时常常是写临时文件再改名
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        ERRORPrint("inotify on " << dir << " failed, hot reload disabled");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+
+    alignas(struct inotify_event) char buf[4096];
+    while (!reload_stop.load(std::memory_order_relaxed))
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 200);
+        reload_collect();
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        bool changed = false;
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            for (char *p = buf; p < buf + n;)
+            {
+                struct inotify_event *ev = (struct inotify_event *)p;
+                if (ev->len > 0 && base == ev->name)
+                {
+                    changed = true;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        if (changed)
+        {
+            reload_compile(config, policy);
+        }
+    }
+    close(fd);
+}
+
+int AMReloadStart(const std::string &config, AMReloadPolicy policy)
+{
+    FuncBegin();
+    if (reload_current.load() == nullptr)
+    {
+        ErrorPrintNReturn(MONITOR_RELOAD_ERROR);
+    }
+    reload_stop.store(false);
+    reload_thread = std::thread(reload_watch, config, policy);
+    INFOPrint("Watching " << config << " for monitor changes");
+    FuncEnd();
+    return SUCCESS;
+}
+
+void AMReloadStop()
+{
+    reload_stop.store(true);
+    if (reload_thread.joinable())
+    {
+        reload_thread.join();
+    }
+}
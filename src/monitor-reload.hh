@@ -0,0 +1,88 @@
+#ifndef MONITOR_RELOAD_HH
+#define MONITOR_RELOAD_HH
+/*
+监控器热加载。
+后台线程用inotify监视automonitor.yaml, 文件变化后在后台重新生成自动机和Monitor表, 用原子指针发布新版本。
+检测线程每个事件开始时取当前版本(一次原子读和一次epoch写), 不会因为重新编译而停顿;
+旧版本在所有检测线程都离开之后才由后台线程释放(epoch回收)。
+BuDDy不是线程安全的: 生成自动机、计算状态映射和释放旧自动机都只在后台线程进行,
+检测线程只读Monitor表里的字符串, 不做BDD运算。
+*/
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "automonitor.hh"
+
+#define AM_RELOAD_MAX_READERS 64
+
+/*切换版本时已有状态的处理方式*/
+typedef enum AMReloadPolicy
+{
+    AM_RELOAD_RESTART, //回到新monitor的初始状态
+    AM_RELOAD_PRODUCT  //在新旧monitor的乘积上映射状态, 无法唯一确定时回到初始状态
+} AMReloadPolicy;
+
+/*
+编译好的一个版本。aut和Monitor表发布之后只读;
+monitor.state_number和monitor.sampled只由检测线程修改(每个版本只有一个检测线程)。
+*/
+typedef struct AMCompiled
+{
+    uint64_t generation;
+    uint64_t prev_generation; //state_map对应的上一个版本
+    spot::twa_graph_ptr aut;
+    Monitor monitor;
+    uint64_t fingerprint;       //AMMonitorFingerprint(monitor), 检查点用
+    std::vector<int> state_map; //上一版本的状态 -> 本版本的状态, -1表示无法映射
+} AMCompiled;
+
+/*检测线程的位置: 上一个事件所在的版本和状态*/
+typedef struct AMReloadCursor
+{
+    uint64_t generation;
+    int state_number;
+    int sampled;
+} AMReloadCursor;
+
+int AMReloadPolicyFromString(const std::string &name);
+
+/*发布第一个版本, 之后AMReloadEnter才能使用*/
+void AMReloadPublishInitial(AMCompiled *initial);
+
+/*
+启动监视线程。config为automonitor.yaml的路径, 新版本沿用初始版本的bdd_dict。
+*/
+int AMReloadStart(const std::string &config, AMReloadPolicy policy);
+void AMReloadStop();
+
+/*
+检测线程: 进入读临界区并返回当前版本。版本变化时按策略把cursor中的状态搬到新版本。
+返回的指针只在AMReloadLeave之前有效。
+*/
+AMCompiled *AMReloadEnter(AMReloadCursor &cursor);
+void AMReloadLeave(AMReloadCursor &cursor, AMCompiled *cm);
+
+/*一个事件的读临界区*/
+class AMReloadGuard
+{
+public:
+    explicit AMReloadGuard(AMReloadCursor &cursor) : m_cursor(cursor), cm(AMReloadEnter(cursor))
+    {
+    }
+    ~AMReloadGuard()
+    {
+        AMReloadLeave(m_cursor, cm);
+    }
+    AMReloadGuard(const AMReloadGuard &) = delete;
+    AMReloadGuard &operator=(const AMReloadGuard &) = delete;
+
+private:
+    AMReloadCursor &m_cursor;
+
+public:
+    AMCompiled *cm;
+};
+
+#endif
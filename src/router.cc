@@ -0,0 +1,530 @@
+#include "router.hh"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "event-decode.hh"
+#include "slice.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+#define AM_ROUTER_CONTROL_ID "#ctl"
+#define AM_ROUTER_CONTROL_TIMEOUT_MS 5000
+#define AM_ROUTER_REAP_INTERVAL_MS 1000 //没有消息时也按这个间隔回收退出的worker
+#define AM_ROUTER_RESPAWN_MIN_S 1      //worker启动后这么快就退出时不再重启
+
+typedef std::vector<zmq::message_t> AMFrames;
+
+typedef struct AMRouterWorker
+{
+    std::string addr;
+    zmq::socket_t *sock; //DEALER, 对端是worker的REP
+    pid_t pid;           //router启动的进程, 否则为0
+    time_t started;      //pid的启动时间
+    bool down;           //进程退出且不再重启, 发给它的事件回复"300"
+    uint64_t forwarded;
+    uint64_t replies[4]; //100 200 201 其他
+} AMRouterWorker;
+
+void AMRingBuild(AMRing &ring, const std::vector<std::string> &addrs, unsigned vnodes)
+{
+    ring.clear();
+    for (unsigned w = 0; w < addrs.size(); w++)
+    {
+        for (unsigned v = 0; v < vnodes; v++)
+        {
+            std::string point = addrs[w] + "#" + std::to_string(v);
+            ring.push_back({AMSliceHash(point.data(), point.size()), w});
+        }
+    }
+    std::sort(ring.begin(), ring.end(),
+              [](const AMRingPoint &a, const AMRingPoint &b) { return a.hash < b.hash; });
+}
+
+unsigned AMRingLookup(const AMRing &ring, uint64_t h)
+{
+    auto it = std::lower_bound(ring.begin(), ring.end(), h,
+                               [](const AMRingPoint &p, uint64_t v) { return p.hash < v; });
+    return it == ring.end() ? ring.front().worker : it->worker;
+}
+
+static bool router_recv(zmq::socket_t &sock, AMFrames &frames)
+{
+    frames.clear();
+    do
+    {
+        frames.emplace_back();
+        if (!sock.recv(&frames.back()))
+        {
+            return false;
+        }
+    } while (frames.back().more());
+    return true;
+}
+
+static void router_send(zmq::socket_t &sock, AMFrames &frames)
+{
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        sock.send(frames[i], i + 1 < frames.size() ? ZMQ_SNDMORE : 0);
+    }
+}
+
+static void router_send_text(zmq::socket_t &sock, zmq::message_t &id, const std::string &text)
+{
+    zmq::message_t empty(0);
+    zmq::message_t body(text.data(), text.size());
+    sock.send(id, ZMQ_SNDMORE);
+    sock.send(empty, ZMQ_SNDMORE);
+    sock.send(body);
+}
+
+static pid_t router_spawn(const std::string &addr, unsigned id)
+{
+    //worker是同一个程序, 用环境变量改变绑定地址和角色。
+    //重启worker时router已经有zmq的线程, 环境在fork之前准备好, 子进程只调用execve
+    std::string bind = "AUTOMONITOR_BIND=" + addr;
+    std::string worker = "AUTOMONITOR_WORKER=" + std::to_string(id);
+    std::vector<char *> envp = {&bind[0], &worker[0]};
+    for (char **e = environ; *e != nullptr; e++)
+    {
+        if (strncmp(*e, "AUTOMONITOR_BIND=", 17) != 0 && strncmp(*e, "AUTOMONITOR_WORKER=", 19) != 0)
+        {
+            envp.push_back(*e);
+        }
+    }
+    envp.push_back(nullptr);
+    char *argv[] = {(char *)"automonitor", nullptr};
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        execve("/proc/self/exe", argv, envp.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+/*
+回收退出的worker进程。运行过一段时间的worker在原地址重启, 它的slice从初始状态重新开始;
+启动后立即退出的worker(例如配置错误)不再重启, 标记为不可用。
+*/
+static void router_reap(std::vector<AMRouterWorker> &workers)
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (unsigned i = 0; i < workers.size(); i++)
+        {
+            AMRouterWorker &w = workers[i];
+            if (w.pid != pid)
+            {
+                continue;
+            }
+            std::string how = WIFSIGNALED(status) ? "signal " + std::to_string(WTERMSIG(status))
+                                                  : "status " + std::to_string(WEXITSTATUS(status));
+            w.pid = 0;
+            if (time(nullptr) - w.started >= AM_ROUTER_RESPAWN_MIN_S)
+            {
+                w.pid = router_spawn(w.addr, i);
+                w.started = time(nullptr);
+            }
+            if (w.pid > 0)
+            {
+                ERRORPrint("Worker " << w.addr << " exited with " << how << ", respawned as pid " << w.pid);
+            }
+            else
+            {
+                w.pid = 0;
+                w.down = true;
+                ERRORPrint("Worker " << w.addr << " exited with " << how << ", marked down");
+            }
+        }
+    }
+}
+
+static zmq::socket_t *router_connect(zmq::context_t &ctx, const std::string &addr)
+{
+    zmq::socket_t *sock = new zmq::socket_t(ctx, ZMQ_DEALER);
+    int linger = 0;
+    sock->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    sock->connect(addr);
+    return sock;
+}
+
+/*worker的回复: 统计并转给客户端, 100/101以外的回复同时发布到verdict流*/
+static void router_reply(AMRouterWorker &w, AMFrames &frames, zmq::socket_t &front, zmq::socket_t *pub)
+{
+    zmq::message_t &body = frames.back();
+    int kind = 3;
+    if (body.size() == 3)
+    {
+        const char *code = (const char *)body.data();
+        kind = memcmp(code, "100", 3) == 0 || memcmp(code, "101", 3) == 0 ? 0
+               : memcmp(code, "200", 3) == 0                             ? 1
+               : memcmp(code, "201", 3) == 0                             ? 2
+                                                                         : 3;
+    }
+    w.replies[kind]++;
+    if (pub != nullptr && kind != 0)
+    {
+        std::string v = std::string((const char *)body.data(), body.size()) + " " + w.addr;
+        zmq::message_t msg(v.data(), v.size());
+        pub->send(msg);
+    }
+    router_send(front, frames);
+}
+
+/*向一个worker发送控制消息并等待回复, 期间该worker的普通回复照常转发*/
+static int router_control(AMRouterWorker &w, const std::string &cmd, std::string &reply, zmq::socket_t &front,
+                          zmq::socket_t *pub)
+{
+    FuncBegin();
+    zmq::message_t id(AM_ROUTER_CONTROL_ID, strlen(AM_ROUTER_CONTROL_ID));
+    router_send_text(*w.sock, id, cmd);
+
+    AMFrames frames;
+    for (;;)
+    {
+        zmq::pollitem_t item = {static_cast<void *>(*w.sock), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll(&item, 1, AM_ROUTER_CONTROL_TIMEOUT_MS) <= 0)
+        {
+            ERRORPrint("Worker " << w.addr << " did not answer " << cmd.substr(0, cmd.find('\n')));
+            AMReturn(ERROR);
+        }
+        if (!router_recv(*w.sock, frames) || frames.size() < 2)
+        {
+            continue;
+        }
+        if (frames[0].size() == strlen(AM_ROUTER_CONTROL_ID) &&
+            memcmp(frames[0].data(), AM_ROUTER_CONTROL_ID, frames[0].size()) == 0)
+        {
+            reply.assign((const char *)frames.back().data(), frames.back().size());
+            break;
+        }
+        router_reply(w, frames, front, pub);
+    }
+    FuncEnd();
+    return SUCCESS;
+}
+
+/*发送"#load"或"#drop"和一组slice记录, worker回复"100"才算成功; 没有记录时不发送*/
+static bool router_apply(AMRouterWorker &w, const char *op, const std::string &records, zmq::socket_t &front,
+                         zmq::socket_t *pub)
+{
+    std::string reply;
+    return records.empty() ||
+           (router_control(w, std::string(op) + "\n" + records, reply, front, pub) == SUCCESS && reply == "100");
+}
+
+/*
+把worker集合换成addrs: 各worker导出slice, 按新的哈希环迁移归属改变的slice, 然后断开被移除的worker。
+迁移期间不接收新事件; 已经发给旧worker的事件排在"#dump"之前, 导出的状态已经包含它们。
+任何一步失败(worker超时或拒绝)都撤销已经完成的导入和删除, 保留原来的worker和哈希环并返回错误,
+slice不会丢失也不会同时留在两个worker上(撤销本身失败时只能记录错误)。
+*/
+static int router_rebalance(std::vector<AMRouterWorker> &workers, const std::vector<std::string> &addrs,
+                            AMRing &ring, unsigned vnodes, zmq::context_t &ctx, zmq::socket_t &front,
+                            zmq::socket_t *pub)
+{
+    FuncBegin();
+    std::vector<AMRouterWorker> next;
+    for (auto &a : addrs)
+    {
+        auto it = std::find_if(workers.begin(), workers.end(), [&](const AMRouterWorker &w) { return w.addr == a; });
+        if (it != workers.end())
+        {
+            next.push_back(*it);
+        }
+        else
+        {
+            next.push_back({a, router_connect(ctx, a), 0, 0, false, 0, {0, 0, 0, 0}});
+        }
+    }
+    AMRing next_ring;
+    AMRingBuild(next_ring, addrs, vnodes);
+
+    //loads[i]: 迁入next[i]的记录; moved_out[w]: 从workers[w]迁出的记录
+    std::vector<std::string> loads(next.size());
+    std::vector<std::string> moved_out(workers.size());
+    size_t moved = 0;
+    bool ok = true;
+    for (size_t w = 0; ok && w < workers.size(); w++)
+    {
+        std::string dump;
+        if (workers[w].down)
+        {
+            continue; //worker已经退出, 它的slice只能丢弃
+        }
+        if (router_control(workers[w], "#dump", dump, front, pub) != SUCCESS)
+        {
+            ok = false;
+            break;
+        }
+        std::istringstream in(dump);
+        AMSliceRecord rec;
+        while (AMSliceReadRecord(in, rec))
+        {
+            unsigned owner = AMRingLookup(next_ring, AMSliceHash(rec.key.data(), rec.key.size()));
+            if (next[owner].addr != workers[w].addr)
+            {
+                std::ostringstream out;
+                AMSliceWriteRecord(out, rec);
+                loads[owner] += out.str();
+                moved_out[w] += out.str();
+                moved++;
+            }
+        }
+    }
+
+    //先导入新的归属, 全部成功后再从原来的worker删除
+    size_t loaded = 0;
+    for (; ok && loaded < next.size(); loaded++)
+    {
+        if (!next[loaded].down && !router_apply(next[loaded], "#load", loads[loaded], front, pub))
+        {
+            ok = false;
+            loaded++; //超时的worker之后可能仍然导入了, 一起撤销
+            break;
+        }
+    }
+    size_t dropped = 0;
+    for (; ok && dropped < workers.size(); dropped++)
+    {
+        if (!workers[dropped].down && !router_apply(workers[dropped], "#drop", moved_out[dropped], front, pub))
+        {
+            ok = false;
+            dropped++;
+            break;
+        }
+    }
+
+    if (!ok)
+    {
+        ERRORPrint("Rebalance to " << addrs.size() << " workers failed, keeping the current workers");
+        for (size_t w = 0; w < dropped && w < workers.size(); w++)
+        {
+            if (!workers[w].down && !router_apply(workers[w], "#load", moved_out[w], front, pub))
+            {
+                ERRORPrint("Cannot restore the slices of " << workers[w].addr);
+            }
+        }
+        for (size_t i = 0; i < loaded; i++)
+        {
+            if (!next[i].down && !router_apply(next[i], "#drop", loads[i], front, pub))
+            {
+                ERRORPrint("Cannot remove the copied slices from " << next[i].addr);
+            }
+        }
+        for (auto &n : next)
+        {
+            if (std::find_if(workers.begin(), workers.end(), [&](const AMRouterWorker &w) {
+                    return w.addr == n.addr;
+                }) == workers.end())
+            {
+                n.sock->close();
+                delete n.sock;
+            }
+        }
+        AMReturn(ERROR);
+    }
+
+    for (auto &w : workers)
+    {
+        if (std::find(addrs.begin(), addrs.end(), w.addr) == addrs.end())
+        {
+            w.sock->close();
+            delete w.sock;
+            if (w.pid > 0)
+            {
+                kill(w.pid, SIGTERM);
+            }
+        }
+    }
+    for (auto &n : next)
+    {
+        for (auto &w : workers)
+        {
+            if (w.addr == n.addr)
+            {
+                n = w; //保留迁移期间更新的计数
+            }
+        }
+    }
+    workers.swap(next);
+    ring.swap(next_ring);
+    INFOPrint("Rebalanced to " << workers.size() << " workers, " << moved << " slices moved");
+    FuncEnd();
+    return SUCCESS;
+}
+
+static std::string router_stats(const std::vector<AMRouterWorker> &workers)
+{
+    std::ostringstream out;
+    uint64_t total[5] = {0, 0, 0, 0, 0};
+    for (auto &w : workers)
+    {
+        out << w.addr << " forwarded=" << w.forwarded << " ok=" << w.replies[0] << " violation=" << w.replies[1]
+            << " possible_violation=" << w.replies[2] << " error=" << w.replies[3] << (w.down ? " down" : "")
+            << "\n";
+        total[0] += w.forwarded;
+        for (int i = 0; i < 4; i++)
+        {
+            total[i + 1] += w.replies[i];
+        }
+    }
+    out << "total forwarded=" << total[0] << " ok=" << total[1] << " violation=" << total[2]
+        << " possible_violation=" << total[3] << " error=" << total[4] << "\n";
+    return out.str();
+}
+
+int Run_router(YAML::Node &node)
+{
+    FuncBegin();
+    std::vector<std::string> addrs;
+    for (auto w : node["router"]["workers"])
+    {
+        addrs.push_back(w.as<std::string>());
+    }
+    if (addrs.empty())
+    {
+        ErrorPrintNReturn(YAML_NODE_PARSE_ERROR);
+    }
+    unsigned vnodes = node["router"]["vnodes"].as<unsigned>();
+    if (vnodes == 0)
+    {
+        vnodes = AM_ROUTER_VNODES;
+    }
+
+    //先启动worker再创建zmq上下文, 子进程不继承zmq的线程
+    std::vector<pid_t> pids(addrs.size(), 0);
+    if (node["router"]["spawn"].as<bool>() == true)
+    {
+        for (unsigned i = 0; i < addrs.size(); i++)
+        {
+            pids[i] = router_spawn(addrs[i], i);
+            INFOPrint("Spawned worker " << i << " pid " << pids[i] << " on " << addrs[i]);
+        }
+    }
+
+    zmq::context_t ctx(1);
+    zmq::socket_t front(ctx, ZMQ_ROUTER);
+    front.bind(node["server_bind_addr"].as<std::string>());
+    zmq::socket_t *pub = nullptr;
+    std::string pub_addr = node["router"]["verdict_pub"].as<std::string>();
+    if (!pub_addr.empty())
+    {
+        pub = new zmq::socket_t(ctx, ZMQ_PUB);
+        pub->bind(pub_addr);
+    }
+
+    std::vector<AMRouterWorker> workers;
+    for (unsigned i = 0; i < addrs.size(); i++)
+    {
+        workers.push_back({addrs[i], router_connect(ctx, addrs[i]), pids[i], time(nullptr), false, 0, {0, 0, 0, 0}});
+    }
+    AMRing ring;
+    AMRingBuild(ring, addrs, vnodes);
+    INFOPrint("Router on " << node["server_bind_addr"].as<std::string>() << " with " << workers.size()
+                           << " workers");
+
+    AMFrames frames;
+    std::vector<zmq::pollitem_t> items;
+    while (1)
+    {
+        items.clear();
+        items.push_back({static_cast<void *>(front), 0, ZMQ_POLLIN, 0});
+        for (auto &w : workers)
+        {
+            items.push_back({static_cast<void *>(*w.sock), 0, ZMQ_POLLIN, 0});
+        }
+        int ready = zmq::poll(items.data(), items.size(), AM_ROUTER_REAP_INTERVAL_MS);
+        router_reap(workers);
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if ((items[i + 1].revents & ZMQ_POLLIN) && router_recv(*workers[i].sock, frames) && frames.size() >= 2)
+            {
+                router_reply(workers[i], frames, front, pub);
+            }
+        }
+
+        //客户端的REQ经过ROUTER后为[id, "", 事件]
+        if (!(items[0].revents & ZMQ_POLLIN) || !router_recv(front, frames) || frames.size() < 3)
+        {
+            continue;
+        }
+        const char *body = (const char *)frames.back().data();
+        size_t len = frames.back().size();
+
+        if (AMSliceIsControl(body, len))
+        {
+            std::string cmd(body, len);
+            std::string reply = "100";
+            if (cmd.compare(0, 6, "#stats") == 0)
+            {
+                reply = router_stats(workers);
+            }
+            else if (cmd.compare(0, 5, "#add ") == 0 || cmd.compare(0, 8, "#remove ") == 0)
+            {
+                std::string addr = cmd.substr(cmd.find(' ') + 1);
+                std::vector<std::string> next;
+                for (auto &w : workers)
+                {
+                    if (w.addr != addr)
+                    {
+                        next.push_back(w.addr);
+                    }
+                }
+                if (cmd[1] == 'a')
+                {
+                    next.push_back(addr);
+                }
+                if (next.empty() || router_rebalance(workers, next, ring, vnodes, ctx, front, pub) != SUCCESS)
+                {
+                    reply = "300";
+                }
+            }
+            else
+            {
+                reply = "300";
+            }
+            router_send_text(front, frames[0], reply);
+            continue;
+        }
+
+        AMEventView ev;
+        if (AMDecodeEvent(body, len, ev) != SUCCESS)
+        {
+            router_send_text(front, frames[0], "300");
+            continue;
+        }
+        //没有slice字段的事件都属于空slice, 由同一个worker检测
+        unsigned w = AMRingLookup(ring, AMSliceHash(ev.slice.ptr ? ev.slice.ptr : "", ev.slice.len));
+        if (workers[w].down)
+        {
+            router_send_text(front, frames[0], "300");
+            continue;
+        }
+        workers[w].forwarded++;
+        router_send(*workers[w].sock, frames);
+    }
+
+    FuncEnd();
+    return SUCCESS;
+}
@@ -0,0 +1,37 @@
+#ifndef ROUTER_HH
+#define ROUTER_HH
+/*
+router模式: 前端按事件的slice字段做一致性哈希, 把事件转发给N个worker(普通的automonitor进程,
+开启slice), 再把worker的回复转给客户端。worker通常在同一台主机上, 用ipc://连接。
+客户端协议不变(REQ发送事件json, 收到"100"/"101"/"200"/"201"/"300")。
+管理消息同样从前端发送:
+"#add <addr>"    接入一个worker并迁移属于它的slice
+"#remove <addr>" 把该worker的slice迁移给其余worker后断开
+"#stats"         各worker转发的事件数和各种回复的数量
+*/
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#define AM_ROUTER_VNODES 64 //每个worker在哈希环上的虚拟节点数
+
+/*哈希环上的一个点*/
+typedef struct AMRingPoint
+{
+    uint64_t hash;
+    unsigned worker;
+} AMRingPoint;
+
+typedef std::vector<AMRingPoint> AMRing;
+
+/*按worker的地址生成哈希环, 地址不变时slice的归属不变*/
+void AMRingBuild(AMRing &ring, const std::vector<std::string> &addrs, unsigned vnodes);
+/*hash为AMSliceHash(slice键)*/
+unsigned AMRingLookup(const AMRing &ring, uint64_t hash);
+
+/*运行router, 直到进程退出*/
+int Run_router(YAML::Node &node);
+
+#endif
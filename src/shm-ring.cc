@@ -0,0 +1,360 @@
+#include "shm-ring.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+#include <cstring>
+#include <cerrno>
+#include <climits>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+
+using namespace std;
+
+#define SHM_RING_VERSION 2
+#define SHM_RING_ALIGN 16
+#define SHM_RING_SPIN 2000
+
+/*记录长度与环容量都是记录头大小的倍数, 环尾剩余的空间要么为0, 要么至少能放下一个填充记录头*/
+static_assert(sizeof(SHMRecord) == SHM_RING_ALIGN, "SHMRecord header must fill one alignment unit");
+
+static inline uint64_t align_up(uint64_t x)
+{
+    return (x + SHM_RING_ALIGN - 1) & ~(uint64_t)(SHM_RING_ALIGN - 1);
+}
+
+/*futex在共享映射上使用, 不能加FUTEX_PRIVATE_FLAG*/
+static int futex_wait(std::atomic<uint32_t> *addr, uint32_t val, int timeout_ms)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, val,
+                   timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+}
+
+static int futex_wake(std::atomic<uint32_t> *addr)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, INT_MAX,
+                   nullptr, nullptr, 0);
+}
+
+static AMError shm_ring_map(SHMRing &ring, size_t mapSize)
+{
+    void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd, 0);
+    if (p == MAP_FAILED)
+    {
+        close(ring.fd);
+        ring.fd = -1;
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+    ring.mapSize = mapSize;
+    ring.hdr = static_cast<SHMRingHeader *>(p);
+    ring.data = static_cast<char *>(p) + align_up(sizeof(SHMRingHeader));
+    return SUCCESS;
+}
+
+AMError shm_ring_create(SHMRing &ring, const std::string &name, size_t capacity)
+{
+    uint64_t cap = 4096;
+    while (cap < capacity)
+    {
+        cap <<= 1;
+    }
+
+    shm_unlink(name.c_str()); //上一次运行残留的环
+    ring.fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (ring.fd < 0)
+    {
+        ERRORPrint("shm_open " << name << ": " << strerror(errno));
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+
+    size_t mapSize = align_up(sizeof(SHMRingHeader)) + cap;
+    if (ftruncate(ring.fd, mapSize) != 0)
+    {
+        close(ring.fd);
+        shm_unlink(name.c_str());
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+    if (shm_ring_map(ring, mapSize) != SUCCESS)
+    {
+        shm_unlink(name.c_str());
+        return SHM_RING_OPEN_ERROR;
+    }
+
+    //ftruncate后内容全为0, 只需写入非零字段, magic最后写入表示环已可用
+    ring.hdr->capacity = cap;
+    ring.hdr->version = SHM_RING_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    ring.hdr->magic = SHM_RING_MAGIC;
+
+    ring.name = name;
+    ring.owner = 1;
+    INFOPrint("Created shared memory ring " << name << " capacity " << cap);
+    return SUCCESS;
+}
+
+AMError shm_ring_open(SHMRing &ring, const std::string &name)
+{
+    struct stat st;
+
+    ring.fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (ring.fd < 0)
+    {
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+    if (fstat(ring.fd, &st) != 0 || (size_t)st.st_size <= align_up(sizeof(SHMRingHeader)))
+    {
+        close(ring.fd);
+        ring.fd = -1;
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+    if (shm_ring_map(ring, st.st_size) != SUCCESS)
+    {
+        return SHM_RING_OPEN_ERROR;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (ring.hdr->magic != SHM_RING_MAGIC || ring.hdr->version != SHM_RING_VERSION ||
+        ring.hdr->capacity < SHM_RING_ALIGN || (ring.hdr->capacity & (ring.hdr->capacity - 1)) != 0 ||
+        align_up(sizeof(SHMRingHeader)) + ring.hdr->capacity > ring.mapSize)
+    {
+        shm_ring_close(ring);
+        ErrorPrintNReturn(SHM_RING_OPEN_ERROR);
+    }
+
+    ring.name = name;
+    ring.owner = 0;
+    return SUCCESS;
+}
+
+void shm_ring_close(SHMRing &ring)
+{
+    if (ring.hdr)
+    {
+        munmap(ring.hdr, ring.mapSize);
+        ring.hdr = nullptr;
+        ring.data = nullptr;
+    }
+    if (ring.fd >= 0)
+    {
+        close(ring.fd);
+        ring.fd = -1;
+    }
+    if (ring.owner == 1)
+    {
+        shm_unlink(ring.name.c_str());
+        ring.owner = 0;
+    }
+}
+
+/*
+预留一条长度为recLen的记录, 成功时*rec指向环中的记录, *pos为其位置。
+记录内容写完后调用shm_ring_commit发布。
+*/
+static AMError shm_ring_reserve(SHMRing &ring, uint64_t recLen, int nonblock, SHMRecord **rec, uint64_t *pos)
+{
+    SHMRingHeader *hdr = ring.hdr;
+    const uint64_t cap = hdr->capacity;
+    const uint64_t mask = cap - 1;
+
+    if (recLen > cap / 2)
+    {
+        ErrorPrintNReturn(SHM_RING_FULL);
+    }
+
+    //预留空间: 记录不能跨越环尾, 放不下时在尾部写填充记录
+    uint64_t p = hdr->head.load(std::memory_order_relaxed);
+    uint64_t pad, need;
+    for (;;)
+    {
+        uint64_t off = p & mask;
+        pad = cap - off < recLen ? cap - off : 0;
+        need = pad + recLen;
+
+        if (p + need - hdr->tail.load(std::memory_order_acquire) > cap)
+        {
+            if (nonblock)
+            {
+                hdr->dropped.fetch_add(1, std::memory_order_relaxed);
+                return SHM_RING_FULL;
+            }
+            sched_yield();
+            p = hdr->head.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (hdr->head.compare_exchange_weak(p, p + need, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (pad)
+    {
+        SHMRecord *padRec = reinterpret_cast<SHMRecord *>(ring.data + (p & mask));
+        padRec->length = (uint32_t)pad;
+        padRec->type = SHM_RECORD_PAD;
+        padRec->stamp.store(p + 1, std::memory_order_release);
+        p += pad;
+    }
+
+    *rec = reinterpret_cast<SHMRecord *>(ring.data + (p & mask));
+    (*rec)->length = (uint32_t)recLen;
+    *pos = p;
+    return SUCCESS;
+}
+
+/*
+消费者在推进tail之前清除[pos, pos + len)中每个16字节单元的stamp。
+下一圈的记录头可能落在这段空间的任意单元上, 若留着旧记录的负载(客户端写入的eventId, eventTime或名字),
+其中的8个字节恰好等于新位置+1时, 消费者会读到还没有写完的记录。
+*/
+static void shm_ring_clear(SHMRing &ring, uint64_t pos, uint64_t len)
+{
+    const uint64_t mask = ring.hdr->capacity - 1;
+    for (uint64_t off = 0; off < len; off += SHM_RING_ALIGN)
+    {
+        reinterpret_cast<SHMRecord *>(ring.data + ((pos + off) & mask))->stamp.store(0, std::memory_order_relaxed);
+    }
+}
+
+static void shm_ring_commit(SHMRing &ring, SHMRecord *rec, uint64_t pos)
+{
+    SHMRingHeader *hdr = ring.hdr;
+
+    rec->stamp.store(pos + 1, std::memory_order_release);
+
+    /*
+    消费者先置consumer_sleeping再检查stamp, 生产者先写stamp再检查consumer_sleeping,
+    两边都需要store-load顺序, 否则双方可能都看到旧值而丢失唤醒。
+    */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    //消费者正在睡眠时才唤醒
+    if (hdr->consumer_sleeping.load(std::memory_order_seq_cst))
+    {
+        hdr->wake_seq.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(&hdr->wake_seq);
+    }
+}
+
+AMError shm_ring_push(SHMRing &ring, uint32_t type, const void *payload, size_t len, int nonblock)
+{
+    SHMRecord *rec;
+    uint64_t pos;
+    AMError ret = shm_ring_reserve(ring, align_up(sizeof(SHMRecord) + len), nonblock, &rec, &pos);
+    if (ret != SUCCESS)
+    {
+        return ret;
+    }
+    rec->type = type;
+    memcpy(rec->payload, payload, len);
+    shm_ring_commit(ring, rec, pos);
+    return SUCCESS;
+}
+
+AMError shm_ring_push_event(SHMRing &ring, uint64_t eventId, const char *eventName,
+                            const char *fileName, uint32_t line, int64_t eventTime,
+                            uint8_t sampleMode, uint64_t skipped)
+{
+    size_t nameLen = strlen(eventName);
+    size_t fileLen = fileName ? strlen(fileName) : 0;
+
+    if (nameLen > 0xffff)
+    {
+        ErrorPrintNReturn(ACCEPT_WORD_FORMAT_WRONG);
+    }
+    if (fileLen > 0xff)
+    {
+        //只保留文件名的末尾部分
+        fileName += fileLen - 0xff;
+        fileLen = 0xff;
+    }
+
+    //直接在环中构造事件记录, 不经过中间缓冲区
+    SHMRecord *rec;
+    uint64_t pos;
+    AMError ret = shm_ring_reserve(ring, align_up(sizeof(SHMRecord) + sizeof(AMEventRecord) + nameLen + fileLen),
+                                   0, &rec, &pos);
+    if (ret != SUCCESS)
+    {
+        return ret;
+    }
+    rec->type = SHM_RECORD_EVENT;
+    AMEventRecord *ev = reinterpret_cast<AMEventRecord *>(rec->payload);
+    ev->eventId = eventId;
+    ev->eventTime = eventTime;
+    ev->skipped = skipped;
+    ev->line = line;
+    ev->nameLen = (uint16_t)nameLen;
+    ev->fileLen = (uint8_t)fileLen;
+    ev->sampleMode = sampleMode;
+    memcpy(ev->data, eventName, nameLen);
+    memcpy(ev->data + nameLen, fileName, fileLen);
+    shm_ring_commit(ring, rec, pos);
+    return SUCCESS;
+}
+
+AMError shm_ring_pop(SHMRing &ring, SHMRecord **rec, int timeout_ms)
+{
+    SHMRingHeader *hdr = ring.hdr;
+    const uint64_t mask = hdr->capacity - 1;
+    uint64_t pos = hdr->tail.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        SHMRecord *p = reinterpret_cast<SHMRecord *>(ring.data + (pos & mask));
+        int spin = 0;
+
+        //先自旋, 再在futex上睡眠
+        while (p->stamp.load(std::memory_order_acquire) != pos + 1)
+        {
+            if (++spin < SHM_RING_SPIN)
+            {
+                continue;
+            }
+            uint32_t seq = hdr->wake_seq.load(std::memory_order_seq_cst);
+            hdr->consumer_sleeping.store(1, std::memory_order_seq_cst);
+            if (p->stamp.load(std::memory_order_seq_cst) != pos + 1)
+            {
+                int ret = futex_wait(&hdr->wake_seq, seq, timeout_ms);
+                if (ret != 0 && errno == ETIMEDOUT &&
+                    p->stamp.load(std::memory_order_acquire) != pos + 1)
+                {
+                    hdr->consumer_sleeping.store(0, std::memory_order_relaxed);
+                    return SHM_RING_EMPTY;
+                }
+            }
+            hdr->consumer_sleeping.store(0, std::memory_order_relaxed);
+            spin = 0;
+        }
+
+        if (p->type == SHM_RECORD_PAD)
+        {
+            uint64_t len = p->length;
+            shm_ring_clear(ring, pos, len);
+            pos += len;
+            hdr->tail.store(pos, std::memory_order_release);
+            continue;
+        }
+
+        *rec = p;
+        return SUCCESS;
+    }
+}
+
+void shm_ring_release(SHMRing &ring, SHMRecord *rec)
+{
+    //只有一个消费者, tail只在这里和shm_ring_pop中修改; 清除的stamp随tail的release发布给生产者
+    uint64_t pos = ring.hdr->tail.load(std::memory_order_relaxed);
+    uint64_t len = rec->length;
+    shm_ring_clear(ring, pos, len);
+    ring.hdr->tail.store(pos + len, std::memory_order_release);
+}
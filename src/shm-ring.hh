@@ -0,0 +1,102 @@
+#pragma once
+/*
+同一台主机上被插装进程与automonitor之间的共享内存传输。
+环形缓冲区位于/dev/shm/<name>, 多个生产者(被插装线程/进程), 一个消费者(automonitor)。
+记录按16字节(记录头大小)对齐, 每条记录头中的stamp最后写入(release), 消费者看到stamp == 位置+1即可读取。
+消费者释放记录时清除其中每个16字节单元的stamp, 下一圈的记录头不会读到旧记录的负载。
+消费者空闲时在futex上睡眠, 生产者只在消费者睡眠时才发起系统调用。
+跨主机时仍然使用ZeroMQ。
+*/
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "util-error.hh"
+
+#define SHM_RING_MAGIC 0x414d5348u /*"AMSH"*/
+#define SHM_RING_DEFAULT_NAME "/automonitor"
+
+typedef enum
+{
+    SHM_RECORD_PAD = 0, //环尾部的填充记录
+    SHM_RECORD_EVENT,   //AMEventRecord
+} SHMRecordType;
+
+/*环的头部, 生产者与消费者的计数器分别放在不同的cache line上*/
+typedef struct SHMRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity; //数据区字节数, 2的幂
+
+    alignas(64) std::atomic<uint64_t> head; //生产者预留到的位置
+    alignas(64) std::atomic<uint64_t> tail; //消费者读到的位置
+    alignas(64) std::atomic<uint32_t> wake_seq;
+    std::atomic<uint32_t> consumer_sleeping;
+    std::atomic<uint32_t> verdict; //服务端的检测结论, 0为正常, 101为已确定满足, 200为违规, 与ZMQ的回复码一致
+    std::atomic<uint64_t> dropped; //环满时被丢弃的记录数
+} SHMRingHeader;
+
+typedef struct SHMRecord
+{
+    std::atomic<uint64_t> stamp; //位置+1, 最后写入
+    uint32_t length;             //含记录头, 16字节对齐
+    uint32_t type;
+    char payload[];
+} SHMRecord;
+
+/*二进制事件记录, 与AOPLogger输出的JSON字段一一对应*/
+typedef struct AMEventRecord
+{
+    uint64_t eventId;
+    int64_t eventTime; //纳秒, CLOCK_REALTIME
+    uint64_t skipped;  //采样丢弃数, COUNT_ONLY模式下为计数
+    uint32_t line;
+    uint16_t nameLen;
+    uint8_t fileLen;
+    uint8_t sampleMode; //AOPSampleMode
+    char data[];        //eventName 后接 fileName, 不含'\0'
+} AMEventRecord;
+
+typedef struct SHMRing
+{
+    std::string name;
+    int fd;
+    size_t mapSize;
+    SHMRingHeader *hdr;
+    char *data;
+    int owner; //创建者负责shm_unlink
+} SHMRing;
+
+/*服务端创建环, capacity会向上取整为2的幂*/
+AMError shm_ring_create(SHMRing &ring, const std::string &name, size_t capacity);
+/*客户端打开已存在的环*/
+AMError shm_ring_open(SHMRing &ring, const std::string &name);
+void shm_ring_close(SHMRing &ring);
+
+/*
+生产者: 写入一条记录。nonblock为1时环满立即返回SHM_RING_FULL,
+否则等待消费者腾出空间。
+*/
+AMError shm_ring_push(SHMRing &ring, uint32_t type, const void *payload, size_t len, int nonblock);
+/*生产者: 写入一个事件*/
+AMError shm_ring_push_event(SHMRing &ring, uint64_t eventId, const char *eventName,
+                            const char *fileName, uint32_t line, int64_t eventTime,
+                            uint8_t sampleMode, uint64_t skipped);
+
+/*
+消费者: 取出下一条记录, 超时返回SHM_RING_EMPTY。
+记录在shm_ring_release之前一直有效, 再次调用shm_ring_pop之前必须先释放。
+*/
+AMError shm_ring_pop(SHMRing &ring, SHMRecord **rec, int timeout_ms);
+void shm_ring_release(SHMRing &ring, SHMRecord *rec);
+
+static inline const char *am_event_name(const AMEventRecord *ev)
+{
+    return ev->data;
+}
+static inline const char *am_event_file(const AMEventRecord *ev)
+{
+    return ev->data + ev->nameLen;
+}
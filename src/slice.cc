@@ -0,0 +1,198 @@
+#include "slice.hh"
+
+#include <algorithm>
+#include <sstream>
+
+#include "util-debug.hh"
+#include "util-error.hh"
+
+uint64_t AMSliceHash(const char *key, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    //FNV的低位分布较差, 再混合一次
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+AMSlice &AMSliceSwapIn(AMSliceTable &table, const std::string &key, AMCompiled *cm)
+{
+    Monitor &monitor = cm->monitor;
+    auto it = table.live.find(key);
+    if (it == table.live.end())
+    {
+        AMSlice &slice = table.live[key];
+        slice.state_number = monitor.init_state;
+        slice.sampled = 0;
+        slice.generation = cm->generation;
+        monitor.state_number = slice.state_number;
+        monitor.sampled = 0;
+        return slice;
+    }
+
+    AMSlice &slice = it->second;
+    if (slice.generation != cm->generation)
+    {
+        int next = -1;
+        if (slice.generation == cm->prev_generation && slice.state_number >= 0 &&
+            (size_t)slice.state_number < cm->state_map.size())
+        {
+            next = cm->state_map[slice.state_number];
+        }
+        slice.state_number = next >= 0 ? next : monitor.init_state;
+        slice.generation = cm->generation;
+    }
+    monitor.state_number = slice.state_number;
+    monitor.sampled = slice.sampled;
+    return slice;
+}
+
+bool AMSliceSatisfied(AMSliceTable &table, const std::string &key, AMCompiled *cm)
+{
+    if (table.satisfied.empty())
+    {
+        return false;
+    }
+    auto it = table.satisfied.find(key);
+    if (it == table.satisfied.end())
+    {
+        return false;
+    }
+    if (it->second.generation == cm->generation)
+    {
+        return true;
+    }
+    table.live[key] = it->second;
+    table.satisfied.erase(it);
+    return false;
+}
+
+void AMSliceWriteRecord(std::ostream &out, const AMSliceRecord &rec)
+{
+    if (rec.satisfied)
+    {
+        out << "= " << rec.state_number << ' ';
+    }
+    else
+    {
+        out << rec.state_number << ' ' << rec.sampled << ' ';
+    }
+    out << rec.key.size() << ':' << rec.key << '\n';
+}
+
+bool AMSliceReadRecord(std::istream &in, AMSliceRecord &rec)
+{
+    size_t len;
+    char colon, nl;
+    rec.satisfied = in.peek() == '=';
+    if (rec.satisfied)
+    {
+        in.get();
+        rec.sampled = 0;
+        if (!(in >> rec.state_number))
+        {
+            return false;
+        }
+    }
+    else if (!(in >> rec.state_number >> rec.sampled))
+    {
+        return false;
+    }
+    if (!(in >> len) || !in.get(colon) || colon != ':' ||
+        len > (size_t)std::max<std::streamsize>(in.rdbuf()->in_avail(), 0))
+    {
+        return false;
+    }
+    rec.key.resize(len);
+    if (!in.read(&rec.key[0], len) || !in.get(nl) || nl != '\n')
+    {
+        return false;
+    }
+    return true;
+}
+
+int AMSliceControl(AMSliceTable &table, AMCompiled *cm, const std::string &cmd, std::string &reply)
+{
+    FuncBegin();
+    std::istringstream in(cmd);
+    std::string op;
+    std::getline(in, op);
+
+    if (op == "#dump")
+    {
+        std::ostringstream out;
+        std::vector<std::string> stale;
+        for (auto &s : table.satisfied)
+        {
+            if (s.second.generation != cm->generation)
+            {
+                stale.push_back(s.first);
+            }
+        }
+        for (auto &key : stale)
+        {
+            AMSliceSatisfied(table, key, cm);
+        }
+        for (auto &s : table.live)
+        {
+            //迁移之前先换算到当前版本, 接收方只认识当前版本的状态编号
+            AMSliceSwapIn(table, s.first, cm);
+            AMSliceWriteRecord(out, {false, s.second.state_number, s.second.sampled, s.first});
+        }
+        for (auto &s : table.satisfied)
+        {
+            AMSliceWriteRecord(out, {true, s.second.state_number, 0, s.first});
+        }
+        reply = out.str();
+    }
+    else if (op == "#load")
+    {
+        AMSliceRecord rec;
+        size_t n = 0;
+        while (AMSliceReadRecord(in, rec))
+        {
+            if (rec.state_number < 0 || (size_t)rec.state_number >= cm->monitor.nodes.size())
+            {
+                continue;
+            }
+            AMSlice &slice = rec.satisfied ? table.satisfied[rec.key] : table.live[rec.key];
+            slice.state_number = rec.state_number;
+            slice.sampled = rec.sampled;
+            slice.generation = cm->generation;
+            n++;
+        }
+        INFOPrint("Loaded " << n << " slices");
+        reply = "100";
+    }
+    else if (op == "#drop")
+    {
+        AMSliceRecord rec;
+        size_t n = 0;
+        while (AMSliceReadRecord(in, rec))
+        {
+            if (rec.satisfied)
+            {
+                n += table.satisfied.erase(rec.key);
+            }
+            else
+            {
+                n += table.live.erase(rec.key);
+            }
+        }
+        INFOPrint("Dropped " << n << " slices");
+        reply = "100";
+    }
+    else
+    {
+        reply = "300";
+        AMReturn(ERROR);
+    }
+    FuncEnd();
+    return SUCCESS;
+}
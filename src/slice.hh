@@ -0,0 +1,90 @@
+#ifndef SLICE_HH
+#define SLICE_HH
+/*
+参数化监控: 事件的"slice"字段标识被监控的对象, 每个slice有自己的monitor状态。
+所有slice共用一张编译好的Monitor表, 检测时把slice的状态换入monitor.state_number, 检测完再换出。
+router模式下slice按一致性哈希分配到各个worker, 增减worker时通过控制消息迁移slice的状态。
+*/
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "monitor-reload.hh"
+
+typedef struct AMSlice
+{
+    int state_number;
+    int sampled;
+    uint64_t generation; //state_number所属的monitor版本
+} AMSlice;
+
+/*
+live为正在检测的slice; 到达GOOD状态的slice已经确定满足, 移入satisfied, 之后的事件直接回复满足, 不再检测。
+satisfied保留键和GOOD状态所属的版本: 热加载换了性质之后, 旧版本的满足不再成立, 这些slice回到live按新版本检测。
+因此结论只节省检测, 不节省内存, 每个slice的键一直保留到#drop删除为止, 内存随slice键的数量增长。
+*/
+typedef struct AMSliceTable
+{
+    std::unordered_map<std::string, AMSlice> live;
+    std::unordered_map<std::string, AMSlice> satisfied;
+} AMSliceTable;
+
+/*slice键的哈希, router的一致性哈希也使用它*/
+uint64_t AMSliceHash(const char *key, size_t len);
+
+/*slice在当前版本下已经满足。更早版本的满足移回live, 由AMSliceSwapIn映射状态*/
+bool AMSliceSatisfied(AMSliceTable &table, const std::string &key, AMCompiled *cm);
+
+/*slice到达GOOD状态: 不再检测, 移入satisfied*/
+static inline void AMSliceConclude(AMSliceTable &table, const std::string &key)
+{
+    auto it = table.live.find(key);
+    if (it != table.live.end())
+    {
+        table.satisfied[key] = it->second;
+        table.live.erase(it);
+    }
+}
+
+/*
+把slice的状态换入cm->monitor, 没有这个slice时从初始状态开始。
+slice停在上一个版本时按cm->state_map映射, 更早的版本回到初始状态。
+*/
+AMSlice &AMSliceSwapIn(AMSliceTable &table, const std::string &key, AMCompiled *cm);
+
+static inline void AMSliceSwapOut(AMSlice &slice, const Monitor &monitor)
+{
+    slice.state_number = monitor.state_number;
+    slice.sampled = monitor.sampled;
+}
+
+/*
+控制消息中的一条slice记录: "<state> <sampled> <len>:<key>\n", 已满足的slice为"= <state> <len>:<key>\n"。
+键按长度读取, 可以包含空格和换行。
+*/
+typedef struct AMSliceRecord
+{
+    bool satisfied;
+    int state_number;
+    int sampled;
+    std::string key;
+} AMSliceRecord;
+
+void AMSliceWriteRecord(std::ostream &out, const AMSliceRecord &rec);
+/*读取下一条记录, 没有记录或格式错误时返回false*/
+bool AMSliceReadRecord(std::istream &in, AMSliceRecord &rec);
+
+/*
+控制消息, 以'#'开头, 与事件的json区分, 第一行之后为slice记录:
+"#dump"            回复所有slice的记录
+"#load\n<记录>..."  导入slice
+"#drop\n<记录>..."  删除记录中键对应的slice, 忽略状态
+*/
+static inline bool AMSliceIsControl(const char *buf, size_t len)
+{
+    return len > 0 && buf[0] == '#';
+}
+int AMSliceControl(AMSliceTable &table, AMCompiled *cm, const std::string &cmd, std::string &reply);
+
+#endif
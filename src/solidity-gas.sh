@@ -0,0 +1,15 @@
+#!/bin/sh
+# 在Foundry的本地EVM上测量生成的monitor合约每次step的gas, 不需要连接任何网络。
+# 用法: ./solidity-gas.sh contract_monitor.sol contract_monitor.t.sol
+set -e
+if [ $# -lt 2 ]; then
+    echo "usage: $0 contract.sol contract.t.sol" >&2
+    exit 1
+fi
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+mkdir -p "$dir/src" "$dir/test"
+cp "$1" "$dir/src/"
+cp "$2" "$dir/test/"
+printf '[profile.default]\nsrc = "src"\ntest = "test"\nout = "out"\nlibs = []\noptimizer = true\noptimizer_runs = 200\n' > "$dir/foundry.toml"
+cd "$dir" && forge test -vv --gas-report
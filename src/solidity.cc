@@ -5,7 +5,11 @@
 #include <fstream>
 #include <map>
 #include <vector>
+#include <bitset>
+#include <random>
+#include <spot/misc/minato.hh>
 #include "util-parse.hh"
+#include "event-decode.hh"
 using namespace std;
 
 int m = 0,i=0,j=0;
@@ -68,7 +72,7 @@ int m = 0,i=0,j=0;
         m++;
     }
 
-    std::cout <<BOLDBLUE <<"Parse label " << label << " SUCCESS" <<RESET<< std::endl;
+    AMLogDebug("Parse label " << label << " SUCCESS");
     FuncEnd();
     return SUCCESS;
 }
@@ -96,7 +100,7 @@ static int Parse_label_to_word_sets_of_sol_pre(int i, std::string &label, std::v
         m++;
     }
 
-    std::cout <<BOLDBLUE <<"Parse label " << label << " SUCCESS" <<RESET<< std::endl;
+    AMLogDebug("Parse label " << label << " SUCCESS");
     FuncEnd();
     m=0;
     return SUCCESS;
@@ -135,6 +139,9 @@ static int export_automata_to_solidity_pre(Monitor &monitor,spot::twa_graph_ptr
           <<"       Monitor monitor;\n"
           << endl;
 
+    //每个不同的转移条件只格式化一次
+    std::vector<std::string> labels = spot::bdd_format_edge_labels(aut);
+
     for (num_state; num_state < aut->num_states(); ++num_state) //对每个状态赋值
     {
 
@@ -143,6 +150,7 @@ static int export_automata_to_solidity_pre(Monitor &monitor,spot::twa_graph_ptr
              << "\n";
 
         monitor_state.own_state = num_state;
+        monitor_state.verdict = AM_VERDICT_INCONCLUSIVE;
 
 
         for (auto &t : aut->out(num_state))
@@ -156,7 +164,7 @@ static int export_automata_to_solidity_pre(Monitor &monitor,spot::twa_graph_ptr
                 return ERROR;
             }
 
-            monitor_label.label = spot::bdd_format_formula(dict, t.cond);
+            monitor_label.label = labels[aut->edge_number(t)];
 
             VePrint(monitor_label.label);
             monitor_label.next_state = t.dst;
@@ -200,6 +208,9 @@ int export_automata_to_solidity(Monitor &monitor, spot::twa_graph_ptr &aut, cons
     j=0;
     ofile << "  function Monitor_init() public{\n"<<"\n";
 
+    //每个不同的转移条件只格式化一次
+    std::vector<std::string> labels = spot::bdd_format_edge_labels(aut);
+
     for (num_state; num_state < aut->num_states(); ++num_state) //对每个状态赋值
     {
 
@@ -207,6 +218,7 @@ int export_automata_to_solidity(Monitor &monitor, spot::twa_graph_ptr &aut, cons
         ofile << "      monitor_state_" << j << ".own_state=" << num_state << ";"
               << "\n\n";
         monitor_state.own_state = num_state;
+        monitor_state.verdict = AM_VERDICT_INCONCLUSIVE;
 
 
         for (auto &t : aut->out(num_state))
@@ -219,8 +231,8 @@ int export_automata_to_solidity(Monitor &monitor, spot::twa_graph_ptr &aut, cons
                 return ERROR;
             }
 
-            ofile << "      monitor_label_" << i << ".label=\"" << spot::bdd_format_formula(dict, t.cond) << "\";\n";
-            monitor_label.label = spot::bdd_format_formula(dict, t.cond);
+            monitor_label.label = labels[aut->edge_number(t)];
+            ofile << "      monitor_label_" << i << ".label=\"" << monitor_label.label << "\";\n";
 
             VePrint(monitor_label.label);
             monitor_label.next_state = t.dst;
@@ -259,41 +271,610 @@ int export_automata_to_solidity(Monitor &monitor, spot::twa_graph_ptr &aut, cons
     FuncEnd();
     return SUCCESS;
 }
-//缺少将Monitor结构体进行赋值的状态。读取初始状态
-//声明Monitor以及需要将Monitor进行一个比较。
-/*生成检测模块*/
 
-int generate_Check_word_acceptance(Monitor &monitor, std::string accept_word, ofstream& ofile)
+//===================================================================
+/*
+按位编码的monitor合约。
+原子命题按aut->ap()的顺序编号, 第i个命题对应apMask的第i位。
+状态和违规标志放在同一个uint8里, step()只读写一个存储槽;
+转移表是编译进代码的常量, 查表不读存储。
+*/
+
+#define SOL_VIOLATED 0xff      //state为该值表示已违规
+#define SOL_MAX_STATES 254
+#define SOL_MAX_APS 256
+#define SOL_DENSE_MAX_APS 8    //命题不超过8个且表不太大时, 用按(state, apMask)直接索引的表
+#define SOL_DENSE_MAX_ENTRIES 8192
+
+typedef std::bitset<SOL_MAX_APS> Sol_ap_mask;
+
+typedef struct Sol_cube_t
+{
+    Sol_ap_mask care;  //出现在cube中的命题
+    Sol_ap_mask value; //这些命题要求的取值
+    unsigned dst;
+} Sol_cube;
+
+static std::string sol_hex(const Sol_ap_mask &mask)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (int nib = SOL_MAX_APS / 4 - 1; nib >= 0; nib--)
+    {
+        int d = mask[nib * 4] | mask[nib * 4 + 1] << 1 | mask[nib * 4 + 2] << 2 | mask[nib * 4 + 3] << 3;
+        if (d != 0 || !hex.empty())
+        {
+            hex += digits[d];
+        }
+    }
+    return "0x" + (hex.empty() ? std::string("0") : hex);
+}
+
+/*命题名中的其他字符换成'_', 加上位号后"a.b"与"a_b"、"COUNT"与AP_COUNT不会重名*/
+static std::string sol_identifier(const std::string &name, unsigned bit)
+{
+    std::string id = "AP_";
+    for (char c : name)
+    {
+        id += isalnum((unsigned char)c) ? c : '_';
+    }
+    return id + "_" + std::to_string(bit);
+}
+
+/*BDD变量号到命题位的映射*/
+static std::map<int, unsigned> sol_ap_bits(spot::twa_graph_ptr &aut)
+{
+    std::map<int, unsigned> bits;
+    const spot::bdd_dict_ptr &dict = aut->get_dict();
+    unsigned i = 0;
+    for (auto &ap : aut->ap())
+    {
+        bits[dict->varnum(ap)] = i++;
+    }
+    return bits;
+}
+
+static std::vector<Sol_cube> sol_state_cubes(spot::twa_graph_ptr &aut, unsigned state,
+                                             std::map<int, unsigned> &bits)
+{
+    std::vector<Sol_cube> cubes;
+    for (auto &t : aut->out(state))
+    {
+        spot::minato_isop isop(t.cond);
+        bdd cube;
+        while ((cube = isop.next()) != bddfalse)
+        {
+            Sol_cube c;
+            c.dst = t.dst;
+            while (cube != bddtrue)
+            {
+                unsigned bit = bits[bdd_var(cube)];
+                c.care.set(bit);
+                if (bdd_high(cube) == bddfalse)
+                {
+                    cube = bdd_low(cube);
+                }
+                else
+                {
+                    c.value.set(bit);
+                    cube = bdd_high(cube);
+                }
+            }
+            cubes.push_back(c);
+        }
+    }
+    return cubes;
+}
+
+/*把apMask的低k位转成BDD赋值*/
+static bdd sol_mask_to_bdd(spot::twa_graph_ptr &aut, unsigned mask)
+{
+    const spot::bdd_dict_ptr &dict = aut->get_dict();
+    bdd assign = bddtrue;
+    unsigned i = 0;
+    for (auto &ap : aut->ap())
+    {
+        int var = dict->varnum(ap);
+        assign &= (mask >> i & 1) ? bdd_ithvar(var) : bdd_nithvar(var);
+        i++;
+    }
+    return assign;
+}
+
+/*按下标二分查找常量字, 全部是栈上的比较, 不读存储*/
+static void sol_emit_word_tree(ofstream &ofile, const std::vector<std::string> &words,
+                               size_t lo, size_t hi, const std::string &indent)
+{
+    if (hi - lo == 1)
+    {
+        ofile << indent << "return " << words[lo] << ";\n";
+        return;
+    }
+    size_t mid = (lo + hi) / 2;
+    ofile << indent << "if (i < " << mid << ") {\n";
+    sol_emit_word_tree(ofile, words, lo, mid, indent + "    ");
+    ofile << indent << "}\n";
+    sol_emit_word_tree(ofile, words, mid, hi, indent);
+}
+
+static void sol_emit_dense(ofstream &ofile, spot::twa_graph_ptr &aut)
+{
+    unsigned k = aut->ap().size();
+    unsigned entries = aut->num_states() << k;
+    std::vector<uint8_t> table(entries, 0);
+
+    for (unsigned s = 0; s < aut->num_states(); s++)
+    {
+        for (unsigned m = 0; m < (1u << k); m++)
+        {
+            bdd assign = sol_mask_to_bdd(aut, m);
+            for (auto &t : aut->out(s))
+            {
+                if ((t.cond & assign) != bddfalse)
+                {
+                    table[(s << k) | m] = t.dst + 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    //每个uint256放32项, 第j项在第8*j位
+    std::vector<std::string> words;
+    static const char digits[] = "0123456789abcdef";
+    for (unsigned w = 0; w * 32 < entries; w++)
+    {
+        std::string hex;
+        for (int j = 31; j >= 0; j--)
+        {
+            uint8_t v = w * 32 + j < entries ? table[w * 32 + j] : 0;
+            if (v != 0 || !hex.empty())
+            {
+                hex += digits[v >> 4];
+                hex += digits[v & 15];
+            }
+        }
+        words.push_back("0x" + (hex.empty() ? std::string("0") : hex));
+    }
+
+    ofile << "    /// 转移表: 第(state << AP_COUNT | apMask)项为后继状态+1, 0表示没有可走的边\n"
+          << "    function next(uint8 s, uint256 apMask) internal pure returns (uint8) {\n"
+          << "        uint256 idx = (uint256(s) << AP_COUNT) | (apMask & AP_MASK);\n"
+          << "        return uint8(word(idx >> 5) >> ((idx & 31) << 3));\n"
+          << "    }\n\n"
+          << "    function word(uint256 i) private pure returns (uint256) {\n";
+    sol_emit_word_tree(ofile, words, 0, words.size(), "        ");
+    ofile << "    }\n";
+}
+
+static void sol_emit_state_tree(ofstream &ofile, std::vector<std::vector<Sol_cube>> &cubes,
+                                size_t lo, size_t hi, const std::string &indent)
+{
+    if (hi - lo == 1)
+    {
+        for (auto &c : cubes[lo])
+        {
+            if (c.care.none())
+            {
+                ofile << indent << "return " << c.dst + 1 << ";\n";
+                return;
+            }
+            ofile << indent << "if ((apMask & " << sol_hex(c.care) << ") == " << sol_hex(c.value)
+                  << ") return " << c.dst + 1 << ";\n";
+        }
+        ofile << indent << "return 0;\n";
+        return;
+    }
+    size_t mid = (lo + hi) / 2;
+    ofile << indent << "if (s < " << mid << ") {\n";
+    sol_emit_state_tree(ofile, cubes, lo, mid, indent + "    ");
+    ofile << indent << "}\n";
+    sol_emit_state_tree(ofile, cubes, mid, hi, indent);
+}
+
+static void sol_emit_sparse(ofstream &ofile, spot::twa_graph_ptr &aut)
+{
+    std::map<int, unsigned> bits = sol_ap_bits(aut);
+    std::vector<std::vector<Sol_cube>> cubes;
+    for (unsigned s = 0; s < aut->num_states(); s++)
+    {
+        cubes.push_back(sol_state_cubes(aut, s, bits));
+    }
+
+    ofile << "    /// 每个状态的边按cube展开: (apMask & care) == value时走到后继状态, 返回后继状态+1\n"
+          << "    function next(uint8 s, uint256 apMask) internal pure returns (uint8) {\n";
+    sol_emit_state_tree(ofile, cubes, 0, cubes.size(), "        ");
+    ofile << "    }\n";
+}
+
+
+/*输出按位编码的monitor合约*/
+int export_automata_to_solidity_packed(spot::twa_graph_ptr &aut, const std::string &filename,
+                                       const std::string &contract)
 {
     FuncBegin();
-    ofile<< "function check_word_acceptance(string accept_word) public{\n"
-            "   state_number=monitor.state_number;\n"
-            "   while(1)\n"
-            "   {\n"
-            "       if(monitor.nodes[state_number].own_state!=state_number\n"
-            "       {\n"
-            "           return ERROR;\n"
-            "       }\n"
-            "       int i = 1;\n\n"
-            "       while(j)\n//j要设置"
-            "       {\n"
-            "           string monitor_label = monitor.nodes[state_number].monitor_labels[j];\n"
-            "           if(label_match_word(monitor_label,accpet_word)==0)\n"
-            "           {\n"
-            "               monitor.state_number = monitor_label.next_state;\n"
-            "               return SUCCESS;\n"
-            "            }\n"
-            "           else if(label_match_word(monitor_label,accept_word)!=SUCCESS && i < monitor.nodes[state_number].label_numbers)\n"
-            "           {\n"
-            "               i++;\n"
-            "               continue;\n"
-            "           }\n"
-            "           else\n"
-            "           {\n"
-            "               logger(\"Accepted Failed\");\n"
-            "               return WORD_ACCEPTANCE_WRONG;\n"
-            "           }\n"
-            "       }\n"
-            "   }\n"
-            "}\n"
+    unsigned k = aut->ap().size();
+    if (aut->num_states() > SOL_MAX_STATES || k > SOL_MAX_APS)
+    {
+        ERRORPrint("Too many states or atomic propositions for the packed contract");
+        AMReturn(ERROR);
+    }
+
+    ofstream ofile(filename, ios::out | ios::trunc);
+    std::string lib = contract + "_table";
+    Sol_ap_mask all;
+    for (unsigned i = 0; i < k; i++)
+    {
+        all.set(i);
+    }
+
+    ofile << "// SPDX-License-Identifier: MIT\n"
+          << "pragma solidity ^0.8.4;\n\n"
+          << "/// 由automonitor生成的monitor合约。\n"
+          << "/// 调用方把为真的原子命题对应的位置1, 作为apMask传给step。\n"
+          << "library " << lib << " {\n";
+    unsigned bit = 0;
+    for (auto &ap : aut->ap())
+    {
+        ofile << "    uint256 internal constant " << sol_identifier(ap.ap_name(), bit) << " = 1 << " << bit
+              << "; // \"" << ap.ap_name() << "\"\n";
+        bit++;
+    }
+    //LTL3结论: GOOD状态之后不必再检测, 进入BAD状态即违规
+    std::vector<int> verdict = Classify_automaton_states(aut);
+    Sol_ap_mask good, bad;
+    for (unsigned st = 0; st < verdict.size(); st++)
+    {
+        good[st] = verdict[st] == AM_VERDICT_GOOD;
+        bad[st] = verdict[st] == AM_VERDICT_BAD;
+    }
+    ofile << "    uint256 internal constant AP_COUNT = " << k << ";\n"
+          << "    uint256 internal constant AP_MASK = " << sol_hex(all) << ";\n"
+          << "    uint8 internal constant INIT_STATE = " << aut->get_init_state_number() << ";\n"
+          << "    uint8 internal constant VIOLATED = " << SOL_VIOLATED << ";\n"
+          << "    /// 第s位为1表示状态s之后的任何后缀都满足/都违反\n"
+          << "    uint256 internal constant GOOD_STATES = " << sol_hex(good) << ";\n"
+          << "    uint256 internal constant BAD_STATES = " << sol_hex(bad) << ";\n\n";
+    if (k <= SOL_DENSE_MAX_APS && (aut->num_states() << k) <= SOL_DENSE_MAX_ENTRIES)
+    {
+        sol_emit_dense(ofile, aut);
+    }
+    else
+    {
+        sol_emit_sparse(ofile, aut);
+    }
+    ofile << "    function isGood(uint8 s) internal pure returns (bool) {\n"
+          << "        return s != VIOLATED && ((GOOD_STATES >> s) & 1) != 0;\n"
+          << "    }\n"
+          << "}\n\n";
+    //没有BAD状态时(通常如此, spot已经删掉了无用的状态)不生成这项检查
+    std::string reject = bad.none() ? "next == 0" : "next == 0 || ((" + lib + ".BAD_STATES >> (next - 1)) & 1) != 0";
+
+    ofile << "contract " << contract << " {\n"
+          << "    /// 当前状态, VIOLATED表示已经违规; 只占一个存储槽\n"
+          << "    uint8 public state;\n"
+          << "    address private immutable owner;\n\n"
+          << "    event Violation(uint8 state, uint256 apMask);\n\n"
+          << "    constructor() {\n"
+          << "        owner = msg.sender;\n"
+          << "        state = " << lib << ".INIT_STATE;\n"
+          << "    }\n\n"
+          << "    function violated() external view returns (bool) {\n"
+          << "        return state == " << lib << ".VIOLATED;\n"
+          << "    }\n\n"
+          << "    /// 已经确定满足, 之后的事件不必再提交\n"
+          << "    function satisfied() external view returns (bool) {\n"
+          << "        return " << lib << ".isGood(state);\n"
+          << "    }\n\n"
+          << "    function reset() external {\n"
+          << "        require(msg.sender == owner);\n"
+          << "        state = " << lib << ".INIT_STATE;\n"
+          << "    }\n\n"
+          << "    /// 一次存储读, 状态变化时一次存储写\n"
+          << "    function step(uint256 apMask) external returns (bool) {\n"
+          << "        uint8 s = state;\n"
+          << "        if (s == " << lib << ".VIOLATED) {\n"
+          << "            return false;\n"
+          << "        }\n"
+          << "        uint8 next = " << lib << ".next(s, apMask);\n"
+          << "        if (" << reject << ") {\n"
+          << "            state = " << lib << ".VIOLATED;\n"
+          << "            emit Violation(s, apMask);\n"
+          << "            return false;\n"
+          << "        }\n"
+          << "        unchecked {\n"
+          << "            next -= 1;\n"
+          << "        }\n"
+          << "        if (next != s) {\n"
+          << "            state = next;\n"
+          << "        }\n"
+          << "        return true;\n"
+          << "    }\n\n"
+          << "    /// 整批只读写一次存储; 返回违规之前接受的事件数, 全部接受或者已经确定满足时等于masks.length\n"
+          << "    function stepBatch(uint256[] calldata masks) external returns (uint256) {\n"
+          << "        uint8 s = state;\n"
+          << "        if (s == " << lib << ".VIOLATED) {\n"
+          << "            return 0;\n"
+          << "        }\n"
+          << "        uint8 start = s;\n"
+          << "        for (uint256 i = 0; i < masks.length; ) {\n"
+          << "            uint8 next = " << lib << ".next(s, masks[i]);\n"
+          << "            if (" << reject << ") {\n"
+          << "                state = " << lib << ".VIOLATED;\n"
+          << "                emit Violation(s, masks[i]);\n"
+          << "                return i;\n"
+          << "            }\n"
+          << "            unchecked {\n"
+          << "                s = next - 1;\n"
+          << "                ++i;\n"
+          << "            }\n"
+          << "            if (" << lib << ".isGood(s)) {\n"
+          << "                break;\n"
+          << "            }\n"
+          << "        }\n"
+          << "        if (s != start) {\n"
+          << "            state = s;\n"
+          << "        }\n"
+          << "        return masks.length;\n"
+          << "    }\n"
+          << "}\n\n";
+
+    ofile << "/// 参数化的monitor: 每个调用地址有自己的状态\n"
+          << "contract " << contract << "_per_address {\n"
+          << "    /// 存的是状态+1, 0表示该地址还没有事件(即初始状态), VIOLATED表示已经违规\n"
+          << "    mapping(address => uint8) private states;\n\n"
+          << "    event Violation(address indexed subject, uint8 state, uint256 apMask);\n\n"
+          << "    function satisfied(address subject) external view returns (bool) {\n"
+          << "        return " << lib << ".isGood(stateOf(subject));\n"
+          << "    }\n\n"
+          << "    function stateOf(address subject) public view returns (uint8) {\n"
+          << "        uint8 v = states[subject];\n"
+          << "        if (v == 0) {\n"
+          << "            return " << lib << ".INIT_STATE;\n"
+          << "        }\n"
+          << "        return v == " << lib << ".VIOLATED ? v : v - 1;\n"
+          << "    }\n\n"
+          << "    function step(uint256 apMask) external returns (bool) {\n"
+          << "        uint8 s = stateOf(msg.sender);\n"
+          << "        if (s == " << lib << ".VIOLATED) {\n"
+          << "            return false;\n"
+          << "        }\n"
+          << "        uint8 next = " << lib << ".next(s, apMask);\n"
+          << "        if (" << reject << ") {\n"
+          << "            states[msg.sender] = " << lib << ".VIOLATED;\n"
+          << "            emit Violation(msg.sender, s, apMask);\n"
+          << "            return false;\n"
+          << "        }\n"
+          << "        if (next != s + 1) {\n"
+          << "            states[msg.sender] = next;\n"
+          << "        }\n"
+          << "        return true;\n"
+          << "    }\n\n"
+          << "    function stepBatch(uint256[] calldata masks) external returns (uint256) {\n"
+          << "        uint8 s = stateOf(msg.sender);\n"
+          << "        if (s == " << lib << ".VIOLATED) {\n"
+          << "            return 0;\n"
+          << "        }\n"
+          << "        uint8 start = s;\n"
+          << "        for (uint256 i = 0; i < masks.length; ) {\n"
+          << "            uint8 next = " << lib << ".next(s, masks[i]);\n"
+          << "            if (" << reject << ") {\n"
+          << "                states[msg.sender] = " << lib << ".VIOLATED;\n"
+          << "                emit Violation(msg.sender, s, masks[i]);\n"
+          << "                return i;\n"
+          << "            }\n"
+          << "            unchecked {\n"
+          << "                s = next - 1;\n"
+          << "                ++i;\n"
+          << "            }\n"
+          << "            if (" << lib << ".isGood(s)) {\n"
+          << "                break;\n"
+          << "            }\n"
+          << "        }\n"
+          << "        if (s != start) {\n"
+          << "            states[msg.sender] = s + 1;\n"
+          << "        }\n"
+          << "        return masks.length;\n"
+          << "    }\n"
+          << "}\n";
+    ofile.close();
+
+    INFOPrint("Output the packed solidity contract: " << filename);
+    FuncEnd();
+    return SUCCESS;
+}
+
+/*在自动机上随机游走, 生成被接受的apMask序列*/
+static std::vector<Sol_ap_mask> sol_random_masks(spot::twa_graph_ptr &aut, unsigned length)
+{
+    std::map<int, unsigned> bits = sol_ap_bits(aut);
+    std::vector<Sol_ap_mask> masks;
+    unsigned state = aut->get_init_state_number();
+    std::mt19937 rng(0);
+
+    while (masks.size() < length)
+    {
+        std::vector<unsigned> succ;
+        for (auto &t : aut->out(state))
+        {
+            succ.push_back(aut->edge_number(t));
+        }
+        if (succ.empty())
+        {
+            break;
+        }
+        auto &t = aut->edge_storage(succ[rng() % succ.size()]);
+        bdd assign = bdd_satoneset(t.cond, aut->ap_vars(), bddtrue);
+        Sol_ap_mask mask;
+        for (auto &b : bits)
+        {
+            if (bdd_implies(assign, bdd_ithvar(b.first)))
+            {
+                mask.set(b.second);
+            }
+        }
+        masks.push_back(mask);
+        state = t.dst;
+    }
+    return masks;
+}
+
+/*
+读取event.log, 把每个事件的eventName转成apMask。
+eventName的格式与Check_word_acceptance相同: 以空格分隔, "x"为真, "!x"为假, 没有出现的命题为假。
+*/
+static std::vector<Sol_ap_mask> sol_log_masks(spot::twa_graph_ptr &aut, const std::string &logfile)
+{
+    std::map<std::string, unsigned> bit_of;
+    unsigned bit = 0;
+    for (auto &ap : aut->ap())
+    {
+        bit_of[ap.ap_name()] = bit++;
+    }
+
+    std::vector<Sol_ap_mask> masks;
+    ifstream in(logfile);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        AMEventView ev;
+        if (AMDecodeEvent(line.data(), line.size(), ev) != SUCCESS || ev.eventName.ptr == nullptr)
+        {
+            continue;
+        }
+        Sol_ap_mask mask;
+        for (auto &t : splitstr(std::string(ev.eventName.ptr, ev.eventName.len), ' '))
+        {
+            auto it = bit_of.find(t);
+            if (it != bit_of.end())
+            {
+                mask.set(it->second);
+            }
+        }
+        masks.push_back(mask);
+    }
+    return masks;
+}
+
+static void sol_emit_harness_single(ofstream &ofile, const std::string &name, const std::string &type,
+                                    const std::string &label)
+{
+    ofile << "    function " << name << "() public {\n"
+          << "        " << type << " mon = new " << type << "();\n"
+          << "        uint256[] memory m = masks();\n"
+          << "        uint256 total;\n"
+          << "        uint256 maxGas;\n"
+          << "        uint256 n;\n"
+          << "        while (n < m.length) {\n"
+          << "            uint256 g = gasleft();\n"
+          << "            bool ok = mon.step(m[n]);\n"
+          << "            g -= gasleft();\n"
+          << "            total += g;\n"
+          << "            if (g > maxGas) {\n"
+          << "                maxGas = g;\n"
+          << "            }\n"
+          << "            n++;\n"
+          << "            if (!ok) {\n"
+          << "                break;\n"
+          << "            }\n"
+          << "        }\n"
+          << "        emit log_named_uint(\"" << label << ": events\", n);\n"
+          << "        emit log_named_uint(\"" << label << ": avg gas per event\", total / n);\n"
+          << "        emit log_named_uint(\"" << label << ": max gas per event\", maxGas);\n"
+          << "    }\n\n";
+}
+
+static void sol_emit_harness_batch(ofstream &ofile, const std::string &name, const std::string &type,
+                                   const std::string &label)
+{
+    ofile << "    function " << name << "() public {\n"
+          << "        " << type << " mon = new " << type << "();\n"
+          << "        uint256[] memory m = masks();\n"
+          << "        uint256 total;\n"
+          << "        uint256 n;\n"
+          << "        for (uint256 i = 0; i < m.length; i += BATCH) {\n"
+          << "            uint256 len = m.length - i < BATCH ? m.length - i : BATCH;\n"
+          << "            uint256[] memory c = new uint256[](len);\n"
+          << "            for (uint256 j = 0; j < len; j++) {\n"
+          << "                c[j] = m[i + j];\n"
+          << "            }\n"
+          << "            uint256 g = gasleft();\n"
+          << "            uint256 accepted = mon.stepBatch(c);\n"
+          << "            total += g - gasleft();\n"
+          << "            if (accepted < len) {\n"
+          << "                n = i + accepted + 1;\n"
+          << "                break;\n"
+          << "            }\n"
+          << "            n = i + len;\n"
+          << "        }\n"
+          << "        emit log_named_uint(\"" << label << ": events\", n);\n"
+          << "        emit log_named_uint(\"" << label << ": avg gas per event\", total / n);\n"
+          << "    }\n\n";
+}
+
+/*
+输出Foundry测试合约, 在本地EVM上分别测量step、stepBatch和按地址的monitor每个事件的gas。
+合约放在src/目录下, 测试放在test/目录下, 用法见solidity-gas.sh。
+*/
+static int sol_write_harness(const std::vector<Sol_ap_mask> &masks, const std::string &filename,
+                             const std::string &contract_file, const std::string &contract,
+                             unsigned batch)
+{
+    if (masks.empty())
+    {
+        return ERROR;
+    }
+
+    std::string base = contract_file.substr(contract_file.rfind('/') + 1);
+    ofstream ofile(filename, ios::out | ios::trunc);
+    ofile << "// SPDX-License-Identifier: MIT\n"
+          << "pragma solidity ^0.8.4;\n\n"
+          << "import \"../src/" << base << "\";\n\n"
+          << "contract " << contract << "_gas_test {\n"
+          << "    event log_named_uint(string key, uint256 val);\n\n"
+          << "    uint256 internal constant BATCH = " << (batch ? batch : 1) << ";\n\n"
+          << "    function masks() internal pure returns (uint256[] memory m) {\n"
+          << "        m = new uint256[](" << masks.size() << ");\n";
+    for (size_t i = 0; i < masks.size(); i++)
+    {
+        ofile << "        m[" << i << "] = " << sol_hex(masks[i]) << ";\n";
+    }
+    ofile << "    }\n\n";
+    sol_emit_harness_single(ofile, "test_step_gas", contract, "step");
+    sol_emit_harness_batch(ofile, "test_step_batch_gas", contract, "stepBatch");
+    sol_emit_harness_single(ofile, "test_per_address_step_gas", contract + "_per_address",
+                            "per-address step");
+    sol_emit_harness_batch(ofile, "test_per_address_batch_gas", contract + "_per_address",
+                           "per-address stepBatch");
+    ofile << "}\n";
+    ofile.close();
+    return SUCCESS;
+}
+
+int export_solidity_gas_harness(spot::twa_graph_ptr &aut, const std::string &filename,
+                                const std::string &contract_file, const std::string &contract,
+                                unsigned length, unsigned batch)
+{
+    FuncBegin();
+    if (sol_write_harness(sol_random_masks(aut, length), filename, contract_file, contract, batch) != SUCCESS)
+    {
+        AMReturn(ERROR);
+    }
+    INFOPrint("Output the gas harness: " << filename);
+    FuncEnd();
+    return SUCCESS;
+}
+
+int export_solidity_gas_harness_from_log(spot::twa_graph_ptr &aut, const std::string &logfile,
+                                         const std::string &filename, const std::string &contract_file,
+                                         const std::string &contract, unsigned batch)
+{
+    FuncBegin();
+    if (sol_write_harness(sol_log_masks(aut, logfile), filename, contract_file, contract, batch) != SUCCESS)
+    {
+        AMReturn(ERROR);
+    }
+    INFOPrint("Output the gas harness replaying " << logfile << ": " << filename);
+    FuncEnd();
+    return SUCCESS;
 }
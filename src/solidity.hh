@@ -15,4 +15,21 @@
 */
 int export_automata_to_solidity(Monitor &monitor, spot::twa_graph_ptr &aut, const spot::bdd_dict_ptr &dict);
 
+/*
+按位编码的合约: 原子命题对应apMask的各位, 转移表编译为常量, step(uint256 apMask)只读写一个存储槽,
+stepBatch(uint256[] masks)整批只读写一次; 同时输出每个地址各有状态的<contract>_per_address。
+*/
+int export_automata_to_solidity_packed(spot::twa_graph_ptr &aut, const std::string &filename,
+                                       const std::string &contract);
+/*
+输出在本地EVM上测量gas的Foundry测试合约, 分别测量step、stepBatch(每批batch个事件)和按地址的monitor。
+事件序列来自自动机上的随机游走, 或者来自event.log。
+*/
+int export_solidity_gas_harness(spot::twa_graph_ptr &aut, const std::string &filename,
+                                const std::string &contract_file, const std::string &contract,
+                                unsigned length, unsigned batch);
+int export_solidity_gas_harness_from_log(spot::twa_graph_ptr &aut, const std::string &logfile,
+                                         const std::string &filename, const std::string &contract_file,
+                                         const std::string &contract, unsigned batch);
+
 #endif
\ No newline at end of file
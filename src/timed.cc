@@ -0,0 +1,284 @@
+#include "timed.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <regex>
+
+#include <time.h>
+
+#include "util-debug.hh"
+
+static uint64_t timed_mono_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int64_t timed_unit_ns(const std::string &unit)
+{
+    if (unit == "ns")
+    {
+        return 1;
+    }
+    if (unit == "us")
+    {
+        return 1000;
+    }
+    if (unit == "ms")
+    {
+        return 1000000;
+    }
+    return 1000000000;
+}
+
+/*把digits个unit换算成纳秒, 超出int64_t范围时返回false*/
+static bool timed_to_ns(const std::string &digits, const std::string &unit, int64_t &ns)
+{
+    errno = 0;
+    long long n = strtoll(digits.c_str(), nullptr, 10);
+    int64_t scale = timed_unit_ns(unit);
+    if (errno == ERANGE || n > INT64_MAX / scale)
+    {
+        return false;
+    }
+    ns = n * scale;
+    return true;
+}
+
+int AMTimedParseRule(const std::string &name, const std::string &formula, AMTimedRule &rule)
+{
+    static const std::regex re("\\s*G\\s*\\(\\s*([A-Za-z_][A-Za-z0-9_.:]*)\\s*->\\s*F\\s*\\[\\s*([0-9]+)\\s*(ns|us|ms|s)?"
+                               "\\s*,\\s*([0-9]+)\\s*(ns|us|ms|s)\\s*\\]\\s*([A-Za-z_][A-Za-z0-9_.:]*)\\s*\\)\\s*");
+    std::smatch m;
+    if (!std::regex_match(formula, m, re))
+    {
+        ERRORPrint("Unsupported timed property \"" << formula << "\", expected G(a -> F[lo,hi] b)");
+        AMReturn(TIMED_RULE_ERROR);
+    }
+    rule.name = name;
+    rule.trigger = m[1];
+    rule.response = m[6];
+    if (!timed_to_ns(m[4], m[5], rule.hi_ns) ||
+        !timed_to_ns(m[2], m[3].matched ? m[3].str() : m[5].str(), rule.lo_ns))
+    {
+        ERRORPrint("Bound out of range in timed property \"" << formula << "\"");
+        AMReturn(TIMED_RULE_ERROR);
+    }
+    if (rule.lo_ns > rule.hi_ns)
+    {
+        ERRORPrint("Empty interval in timed property \"" << formula << "\"");
+        AMReturn(TIMED_RULE_ERROR);
+    }
+    return SUCCESS;
+}
+
+int AMTimedInit(AMTimed &timed, const std::vector<AMTimedRule> &rules, int64_t tick_ns, AMDeadlineHandler handler)
+{
+    FuncBegin();
+    if (tick_ns <= 0 || rules.empty())
+    {
+        ErrorPrintNReturn(TIMED_RULE_ERROR);
+    }
+    timed.rules = rules;
+    timed.slices.clear();
+    timed.wheel.assign(AM_TIMER_SLOTS, std::vector<AMTimer>());
+    timed.tick_ns = tick_ns;
+    timed.now = 0;
+    timed.last_tick = -1;
+    timed.armed = 0;
+    timed.idle_base = 0;
+    timed.idle_mono = timed_mono_ns();
+    timed.on_deadline = handler;
+    for (auto &r : rules)
+    {
+        INFOPrint("Timed property " << r.name << ": G(" << r.trigger << " -> F[" << r.lo_ns << "ns," << r.hi_ns
+                                   << "ns] " << r.response << ")");
+    }
+    FuncEnd();
+    return SUCCESS;
+}
+
+static void timed_schedule(AMTimed &timed, AMTimedSlice *slice, uint32_t rule, int64_t deadline)
+{
+    int64_t tk = deadline / timed.tick_ns;
+    if (tk <= timed.last_tick)
+    {
+        tk = timed.last_tick + 1;
+    }
+    timed.wheel[tk % AM_TIMER_SLOTS].push_back({slice, rule, deadline});
+    slice->regs[rule].armed = 1;
+    timed.armed++;
+}
+
+static bool timed_slice_idle(const AMTimedSlice &slice)
+{
+    for (auto &reg : slice.regs)
+    {
+        if (reg.armed || reg.head < reg.pending.size())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*出队后寄存器为空时回收空间, 否则在出队过半时压缩*/
+static void timed_compact(AMClockRegister &reg)
+{
+    if (reg.head == reg.pending.size())
+    {
+        reg.pending.clear();
+        reg.head = 0;
+    }
+    else if (reg.head > 32 && reg.head * 2 > reg.pending.size())
+    {
+        reg.pending.erase(reg.pending.begin(), reg.pending.begin() + reg.head);
+        reg.head = 0;
+    }
+}
+
+/*定时器到期: 报告已经过期的a, 按新的最早截止时间重新放入*/
+static void timed_fire(AMTimed &timed, const AMTimer &timer)
+{
+    AMTimedSlice *slice = timer.slice;
+    AMClockRegister &reg = slice->regs[timer.rule];
+    const AMTimedRule &rule = timed.rules[timer.rule];
+    reg.armed = 0;
+    timed.armed--;
+
+    //截止时间本身仍在区间内, 之后才算超时
+    while (reg.head < reg.pending.size() && reg.pending[reg.head] + rule.hi_ns < timed.now)
+    {
+        int64_t t = reg.pending[reg.head++];
+        timed.on_deadline(rule, *slice->key, t, t + rule.hi_ns);
+    }
+    timed_compact(reg);
+    if (reg.head < reg.pending.size())
+    {
+        timed_schedule(timed, slice, timer.rule, reg.pending[reg.head] + rule.hi_ns);
+    }
+    else if (timed_slice_idle(*slice))
+    {
+        timed.slices.erase(*slice->key);
+    }
+}
+
+static void timed_advance(AMTimed &timed, int64_t t)
+{
+    if (t <= timed.now)
+    {
+        return;
+    }
+    timed.now = t;
+    //当前tick只过去了一部分, 下次推进时要再处理一遍它的槽
+    int64_t target = t / timed.tick_ns;
+    if (timed.armed == 0)
+    {
+        timed.last_tick = target - 1;
+        return;
+    }
+    //跳过的tick超过一圈时每个槽只需要处理一次
+    int64_t steps = std::min<int64_t>(target - timed.last_tick, AM_TIMER_SLOTS);
+    std::vector<AMTimer> due;
+    for (int64_t i = 1; i <= steps; i++)
+    {
+        std::vector<AMTimer> &slot = timed.wheel[(timed.last_tick + i) % AM_TIMER_SLOTS];
+        size_t kept = 0;
+        for (auto &timer : slot)
+        {
+            if (timer.deadline < t)
+            {
+                due.push_back(timer);
+            }
+            else
+            {
+                slot[kept++] = timer; //当前tick中还没到期的, 或以后的圈
+            }
+        }
+        slot.resize(kept);
+    }
+    timed.last_tick = target - 1;
+    //全部取出后再处理, 重新放入的定时器不会在本次推进中被重复访问
+    for (auto &timer : due)
+    {
+        timed_fire(timed, timer);
+    }
+}
+
+void AMTimedEvent(AMTimed &timed, const std::string &slice, const std::string &eventName, int64_t time_ns)
+{
+    uint64_t mono = timed_mono_ns();
+    if (time_ns < 0)
+    {
+        time_ns = timed.idle_base + (int64_t)(mono - timed.idle_mono);
+    }
+    timed_advance(timed, time_ns);
+    timed.idle_base = timed.now;
+    timed.idle_mono = mono;
+
+    AMTimedSlice *s = nullptr;
+    auto it = timed.slices.find(slice);
+    if (it != timed.slices.end())
+    {
+        s = &it->second;
+    }
+    for (uint32_t r = 0; r < timed.rules.size(); r++)
+    {
+        const AMTimedRule &rule = timed.rules[r];
+        if (s != nullptr && eventName == rule.response)
+        {
+            //b响应所有不晚于time_ns - lo的a; 已经过期的a在推进时间时报告过了
+            AMClockRegister &reg = s->regs[r];
+            while (reg.head < reg.pending.size() && reg.pending[reg.head] + rule.lo_ns <= time_ns)
+            {
+                reg.head++;
+            }
+            timed_compact(reg);
+        }
+        if (eventName == rule.trigger)
+        {
+            if (s == nullptr)
+            {
+                auto res = timed.slices.emplace(slice, AMTimedSlice());
+                s = &res.first->second;
+                s->key = &res.first->first;
+                s->regs.assign(timed.rules.size(), AMClockRegister{std::vector<int64_t>(), 0, 0});
+            }
+            AMClockRegister &reg = s->regs[r];
+            if (reg.pending.empty() || reg.pending.back() <= time_ns)
+            {
+                reg.pending.push_back(time_ns);
+            }
+            else
+            {
+                //乱序到达的事件
+                reg.pending.insert(std::upper_bound(reg.pending.begin() + reg.head, reg.pending.end(), time_ns),
+                                   time_ns);
+            }
+            if (!reg.armed)
+            {
+                timed_schedule(timed, s, r, reg.pending[reg.head] + rule.hi_ns);
+            }
+        }
+    }
+}
+
+void AMTimedIdle(AMTimed &timed)
+{
+    if (timed.armed == 0)
+    {
+        return;
+    }
+    timed_advance(timed, timed.idle_base + (int64_t)(timed_mono_ns() - timed.idle_mono));
+}
+
+int AMTimedPollTimeout(const AMTimed &timed)
+{
+    if (timed.armed == 0)
+    {
+        return -1;
+    }
+    return (int)std::max<int64_t>(1, timed.tick_ns / 1000000);
+}
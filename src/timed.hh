@@ -0,0 +1,87 @@
+#ifndef TIMED_HH
+#define TIMED_HH
+/*
+有时间界限的性质(MTL的有界响应): G(a -> F[lo,hi] b), 即每个a之后的[lo,hi]内必须出现b。
+事件时间取自"eventTime"(纳秒)。每个slice的每条规则有一个时钟寄存器, 保存尚未响应的a的时间;
+最早的截止时间放入时间轮, 截止时间过去而没有b时报告违规, 即使之后没有任何事件到达。
+
+时间轮只做惰性删除: b到达时不从轮中取消定时器, 定时器到期时再检查寄存器,
+截止时间已经变化就按新的截止时间重新放入。每个寄存器在轮中最多有一个定时器。
+检测线程独占, 不加锁。
+*/
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util-error.hh"
+
+#define AM_TIMER_SLOTS 4096 //时间轮的槽数, 覆盖tick * AM_TIMER_SLOTS, 更远的截止时间在轮中多转几圈
+
+typedef struct AMTimedRule
+{
+    std::string name;
+    std::string trigger;  //a, 事件名
+    std::string response; //b, 事件名
+    int64_t lo_ns;
+    int64_t hi_ns;
+} AMTimedRule;
+
+/*一个时钟寄存器: 未响应的a的时间, 按时间递增; head之前的已经出队*/
+typedef struct AMClockRegister
+{
+    std::vector<int64_t> pending;
+    uint32_t head;
+    uint32_t armed; //轮中有该寄存器的定时器
+} AMClockRegister;
+
+typedef struct AMTimedSlice
+{
+    const std::string *key; //指向表中的键, unordered_map的节点地址不变
+    std::vector<AMClockRegister> regs;
+} AMTimedSlice;
+
+typedef struct AMTimer
+{
+    AMTimedSlice *slice;
+    uint32_t rule;
+    int64_t deadline;
+} AMTimer;
+
+/*截止时间过去时调用: 规则、slice键、a的时间和截止时间*/
+typedef std::function<void(const AMTimedRule &, const std::string &, int64_t, int64_t)> AMDeadlineHandler;
+
+typedef struct AMTimed
+{
+    std::vector<AMTimedRule> rules;
+    std::unordered_map<std::string, AMTimedSlice> slices;
+    std::vector<std::vector<AMTimer>> wheel;
+    int64_t tick_ns;
+    int64_t now;       //已经处理到的时间, 单调不减
+    int64_t last_tick; //时间轮已经处理完的tick, 当前tick的槽每次推进都会再处理
+    uint64_t armed;    //轮中的定时器数
+    //空闲时用本机时钟推算事件时间: now + (本机时钟 - 最后一个事件到达时的本机时钟)
+    int64_t idle_base;
+    uint64_t idle_mono;
+    AMDeadlineHandler on_deadline;
+} AMTimed;
+
+/*解析"G(request -> F[0,50ms] response)", 单位为ns、us、ms或s, 下界省略单位时与上界相同*/
+int AMTimedParseRule(const std::string &name, const std::string &formula, AMTimedRule &rule);
+
+int AMTimedInit(AMTimed &timed, const std::vector<AMTimedRule> &rules, int64_t tick_ns, AMDeadlineHandler handler);
+
+/*
+一个事件: 先把时间推进到time_ns(到期的截止时间在这里报告), 再按事件名更新slice的寄存器。
+time_ns < 0时使用推算的当前时间。
+*/
+void AMTimedEvent(AMTimed &timed, const std::string &slice, const std::string &eventName, int64_t time_ns);
+
+/*没有事件时按本机时钟推进时间, 报告到期的截止时间*/
+void AMTimedIdle(AMTimed &timed);
+
+/*距离下一个tick的毫秒数, 作为等待事件的超时; 轮中没有定时器时返回-1(一直等待)*/
+int AMTimedPollTimeout(const AMTimed &timed);
+
+#endif
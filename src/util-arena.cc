@@ -0,0 +1,143 @@
+#include "util-arena.hh"
+
+#include <cstdlib>
+#include <new>
+
+extern "C"
+{
+#include "cJSON.h"
+}
+
+thread_local AMArena *am_arena_current = nullptr;
+
+static AMArenaChunk *chunk_new(size_t size)
+{
+    AMArenaChunk *c = (AMArenaChunk *)malloc(offsetof(AMArenaChunk, data) + size);
+    if (c == nullptr)
+    {
+        return nullptr;
+    }
+    c->next = nullptr;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+static void chunk_free_list(AMArenaChunk *c)
+{
+    while (c != nullptr)
+    {
+        AMArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+void AMArenaInit(AMArena &arena, size_t chunk_size)
+{
+    arena.chunk_size = chunk_size;
+    arena.head = arena.current = chunk_new(chunk_size);
+    arena.allocated = 0;
+    arena.high_water = 0;
+    arena.resets = 0;
+}
+
+void AMArenaDestroy(AMArena &arena)
+{
+    chunk_free_list(arena.head);
+    arena.head = arena.current = nullptr;
+}
+
+void *AMArenaAlloc(AMArena &arena, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    AMArenaChunk *c = arena.current;
+
+    if (c == nullptr || c->used + size > c->size)
+    {
+        size_t want = size > arena.chunk_size ? size : arena.chunk_size;
+        AMArenaChunk *n = chunk_new(want);
+        if (n == nullptr)
+        {
+            return nullptr;
+        }
+        if (c == nullptr)
+        {
+            arena.head = n;
+        }
+        else
+        {
+            c->next = n;
+        }
+        arena.current = c = n;
+    }
+
+    void *p = c->data + c->used;
+    c->used += size;
+    arena.allocated += size;
+    return p;
+}
+
+void AMArenaReset(AMArena &arena)
+{
+    if (arena.allocated > arena.high_water)
+    {
+        arena.high_water = arena.allocated;
+    }
+    arena.resets++;
+
+    if (arena.head != nullptr && arena.head->next != nullptr)
+    {
+        //本次请求超出了第一个块, 换成一个能装下整个请求的块
+        chunk_free_list(arena.head);
+        arena.chunk_size = arena.allocated > arena.chunk_size ? arena.allocated : arena.chunk_size;
+        arena.head = chunk_new(arena.chunk_size);
+    }
+    if (arena.head != nullptr)
+    {
+        arena.head->used = 0;
+    }
+    arena.current = arena.head;
+    arena.allocated = 0;
+}
+
+bool AMArenaOwns(const AMArena &arena, const void *ptr)
+{
+    const char *p = (const char *)ptr;
+    for (const AMArenaChunk *c = arena.head; c != nullptr; c = c->next)
+    {
+        if (p >= c->data && p < c->data + c->size)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *arena_json_malloc(size_t size)
+{
+    AMArena *arena = am_arena_current;
+    if (arena == nullptr)
+    {
+        return malloc(size);
+    }
+    return AMArenaAlloc(*arena, size);
+}
+
+static void arena_json_free(void *ptr)
+{
+    AMArena *arena = am_arena_current;
+    if (arena != nullptr && AMArenaOwns(*arena, ptr))
+    {
+        return; //随arena一起重置
+    }
+    free(ptr);
+}
+
+void AMArenaInstallJsonHooks()
+{
+    cJSON_Hooks hooks;
+    hooks.malloc_fn = arena_json_malloc;
+    hooks.free_fn = arena_json_free;
+    cJSON_InitHooks(&hooks);
+}
@@ -0,0 +1,69 @@
+#ifndef UTIL_ARENA_HH
+#define UTIL_ARENA_HH
+/*
+按请求复用的线性分配区(bump arena)。
+cJSON和neb::CJsonObject通过cJSON_InitHooks在分配区上分配节点和字符串,
+释放是空操作, 请求处理完后整体重置, 避免每个事件几十次malloc/free。
+分配区只对当前线程的AMArenaScope生效, 作用域之外仍然使用malloc/free。
+*/
+#include <cstddef>
+#include <cstdint>
+
+#define AM_ARENA_DEFAULT_CHUNK (64 * 1024)
+
+typedef struct AMArenaChunk
+{
+    struct AMArenaChunk *next;
+    size_t size;
+    size_t used;
+    alignas(16) char data[1];
+} AMArenaChunk;
+
+typedef struct AMArena
+{
+    AMArenaChunk *head;     //第一个块, 重置后保留
+    AMArenaChunk *current;  //正在分配的块
+    size_t chunk_size;
+    size_t allocated;       //自上次重置以来分配的字节数
+    size_t high_water;      //单次请求分配的最大字节数
+    uint64_t resets;
+} AMArena;
+
+/*当前线程正在使用的分配区, 没有时为nullptr*/
+extern thread_local AMArena *am_arena_current;
+
+void AMArenaInit(AMArena &arena, size_t chunk_size = AM_ARENA_DEFAULT_CHUNK);
+void AMArenaDestroy(AMArena &arena);
+void *AMArenaAlloc(AMArena &arena, size_t size);
+/*回到空状态; 上次请求用了多个块时合并成一个足够大的块, 下次请求不再需要追加*/
+void AMArenaReset(AMArena &arena);
+bool AMArenaOwns(const AMArena &arena, const void *ptr);
+
+/*把cJSON的分配函数换成分配区版本, 进程启动时调用一次*/
+void AMArenaInstallJsonHooks();
+
+/*
+在作用域内让本线程的cJSON/CJsonObject使用arena, 离开作用域时重置arena。
+作用域内创建的cJSON树和cJSON_Print的结果不能带出作用域。
+*/
+class AMArenaScope
+{
+public:
+    explicit AMArenaScope(AMArena &arena) : m_arena(arena), m_prev(am_arena_current)
+    {
+        am_arena_current = &arena;
+    }
+    ~AMArenaScope()
+    {
+        am_arena_current = m_prev;
+        AMArenaReset(m_arena);
+    }
+    AMArenaScope(const AMArenaScope &) = delete;
+    AMArenaScope &operator=(const AMArenaScope &) = delete;
+
+private:
+    AMArena &m_arena;
+    AMArena *m_prev;
+};
+
+#endif
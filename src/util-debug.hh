@@ -41,84 +41,76 @@ typedef enum
 #define ZMQ 1
 #define DEBUG 1
 
-#if DEBUG == 1
-#define FuncBegin()                                                                                                      \
-    {                                                                                                                    \
-        std::cout << "\n"                                                                                                \
-                  << BOLDCYAN << "Function " << BOLDRED << __FUNCTION__ << BOLDYELLOW << " begin" << RESET << std::endl; \
-    }
+/*
+以下打印宏都通过util-log.hh输出。
+FuncBegin/FuncEnd/VePrint/ENTERPrint/LocationPrint/TABPrint为DEBUG级别,
+INFOPrint为INFO级别, ERRORPrint/AMReturn为ERROR级别。
+用-DAM_LOG_COMPILE_LEVEL=AM_LOG_COMPILE_INFO等编译时, 更高级别的宏展开为空。
+*/
+#if DEBUG == 0 && !defined(AM_LOG_COMPILE_LEVEL)
+#define AM_LOG_COMPILE_LEVEL AM_LOG_COMPILE_INFO
+#endif
+#include "util-log.hh"
 
-#define FuncEnd()                                                                                                     \
-    {                                                                                                                 \
-        std::cout << BOLDCYAN << "Function " << BOLDRED << __FUNCTION__ << BOLDYELLOW << " end\n" RESET<<"\n" << std::endl; \
-    }
+#if AM_LOG_COMPILE_LEVEL >= AM_LOG_COMPILE_DEBUG
+#define AMLogDebug(x) AMLog(AM_LOG_DEBUG, x)
+#else
+#define AMLogDebug(x) do {} while (0)
+#endif
 
-#define FuncEnd_print(x)                                     \
-    {                                                        \
-        std::cout << "Function " << __FUNCTION__ << " end\n" \
-                  << std::endl;                              \
-        std::cout << x << std::endl;                         \
-    }
+#if AM_LOG_COMPILE_LEVEL >= AM_LOG_COMPILE_INFO
+#define AMLogInfo(x) AMLog(AM_LOG_INFO, x)
+#else
+#define AMLogInfo(x) do {} while (0)
+#endif
 
+#if AM_LOG_COMPILE_LEVEL >= AM_LOG_COMPILE_ERROR
+#define AMLogError(x) AMLog(AM_LOG_ERROR, x)
 #else
+#define AMLogError(x) do {} while (0)
+#endif
+
+#define FuncBegin() AMLogDebug("Function " << __FUNCTION__ << " begin")
 
-#define FuncBegin()
-#define FuncEnd()
+#define FuncEnd() AMLogDebug("Function " << __FUNCTION__ << " end")
 
-#endif //DEBUG
+#define FuncEnd_print(x) AMLogDebug("Function " << __FUNCTION__ << " end: " << x)
 
 //判断输入的是否是字符串,待补充
-#define INFOPrint(x)                                        \
-    {                                                       \
-        std::cout << BOLDYELLOW << x << RESET << std::endl; \
-    }
+#define INFOPrint(x) AMLogInfo(x)
 
-#define ERRORPrint(x)                                    \
-    {                                                    \
-        std::cout << BOLDRED << x << RESET << std::endl; \
-    }
+#define ERRORPrint(x) AMLogError(x)
+
+#define ENTERPrint(x) AMLogDebug("Now Enter Condition " << x)
 
-#define ENTERPrint(x)                                                                           \
-    {                                                                                           \
-        std::cout << BOLDGREEN << "Now Enter Condition " << BOLDRED << x << RESET << std::endl; \
-    }
 /*打印x的值,便于debug*/
-#define VePrint(x)                                                                                      \
-    {                                                                                                   \
-        std::cout << BOLDYELLOW << "The value of " << #x << ": " << BOLDRED << x << RESET << std::endl; \
-    }
+#define VePrint(x) AMLogDebug("The value of " << #x << ": " << x)
 
-#define VePrintByArg(x, i)                                                  \
-    {                                                                       \
-        std::cout << BOLDYELLOW << "The value of " << #x << "[" << i << "]" \
-                  << ": " << BOLDRED << x[i] << RESET << std::endl;         \
-    }
-    
-#define VePrintVector(x)                                     \
-    {                                                        \
-        INFOPrint("+++The values of " << #x << "+++++++++"); \
-        for (int i = 0; i < x.size(); i++)                   \
-        {                                                    \
-            VePrintByArg(x, i);                              \
-        }                                                    \
-        INFOPrint("+++++++++++++++++++++++++++++++++\n");    \
-    }
+#define VePrintByArg(x, i) AMLogDebug("The value of " << #x << "[" << i << "]" \
+                                                      << ": " << x[i])
+
+#define VePrintVector(x)                                         \
+    do                                                           \
+    {                                                            \
+        if (AMLogOn(AM_LOG_DEBUG))                               \
+        {                                                        \
+            AMLogDebug("+++The values of " << #x << "+++++++++"); \
+            for (size_t i = 0; i < x.size(); i++)                \
+            {                                                    \
+                VePrintByArg(x, i);                              \
+            }                                                    \
+        }                                                        \
+    } while (0)
 
 /*Locate the line number*/
-#define LocationPrint()                       \
-    {                                         \
-        INFOPrint("Located at " << __LINE__); \
-    }
+#define LocationPrint() AMLogDebug("Located at " << __LINE__)
 
 //测试时间性能的模块
-#define AMReturn(x)                                                                             \
-    {                                                                                           \
-        std::cout << BOLDRED << "Fucntion " << __FUNCTION__ << " Error!" << RESET << std::endl; \
-        return x;                                                                               \
-    }
-#define TABPrint()                                                                                                                 \
-    {                                                                                                                              \
-        std::cout << BOLDRED << "In Fucntion " << __FUNCTION__ << "In Line" << __LINE__ << "In" << __FILE__ << RESET << std::endl; \
+#define AMReturn(x)                                     \
+    {                                                   \
+        AMLogError("Fucntion " << __FUNCTION__ << " Error!"); \
+        return x;                                       \
     }
+#define TABPrint() AMLogDebug("In Fucntion " << __FUNCTION__ << "In Line" << __LINE__ << "In" << __FILE__)
 
-#endif
\ No newline at end of file
+#endif
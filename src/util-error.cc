@@ -25,6 +25,14 @@ const char *AMErrorToString(AMError err)
         CASE_CODE(PARSE_LABEL_TO_RPN_ERROR);
         CASE_CODE(PARSE_ACCEPTEORD_TO_WORDSET_ERROR);
         CASE_CODE(ACCEPT_WORD_FORMAT_WRONG);
+        CASE_CODE(WORD_ACCEPTANCE_WRONG_SAMPLED);
+        CASE_CODE(SHM_RING_OPEN_ERROR);
+        CASE_CODE(SHM_RING_FULL);
+        CASE_CODE(SHM_RING_EMPTY);
+        CASE_CODE(JSON_EVENT_DECODE_ERROR);
+        CASE_CODE(MONITOR_RELOAD_ERROR);
+        CASE_CODE(CHECKPOINT_ERROR);
+        CASE_CODE(TIMED_RULE_ERROR);
         //CASE_CODE();
     }
 
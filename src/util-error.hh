@@ -17,33 +17,35 @@ typedef enum
     SOCKET_SEND_ERROR,
     PARSE_LABEL_TO_RPN_ERROR,
     PARSE_ACCEPTEORD_TO_WORDSET_ERROR,
-    ACCEPT_WORD_FORMAT_WRONG
+    ACCEPT_WORD_FORMAT_WRONG,
+    WORD_ACCEPTANCE_WRONG_SAMPLED,
+    SHM_RING_OPEN_ERROR,
+    SHM_RING_FULL,
+    SHM_RING_EMPTY,
+    JSON_EVENT_DECODE_ERROR,
+    MONITOR_RELOAD_ERROR,
+    CHECKPOINT_ERROR,
+    TIMED_RULE_ERROR
 } AMError;
 
 const char *AMErrorToString(AMError err);
 
-#define ErrorPrintNReturn(AMError)                                                             \
-    {                                                                                          \
-        std::cout << BOLDRED << AMErrorToString(AMError) << BOLDYELLOW << " in line: "         \
-                  << BOLDGREEN << __LINE__ << BOLDCYAN << " in file: " << BOLDBLUE << __FILE__ \
-                  << RESET << std::endl;                                                       \
-        return AMError;                                                                        \
+#define ErrorPrintNReturn(AMError)                                                   \
+    {                                                                                \
+        AMLogError(AMErrorToString(AMError) << " in line: " << __LINE__ << " in file: " \
+                                            << __FILE__);                            \
+        return AMError;                                                              \
     }
-#define ErrorPrintNEXIT_0(AMError)                                                             \
-    {                                                                                          \
-        std::cout << BOLDRED << AMErrorToString(AMError) << BOLDYELLOW << " in line: "         \
-                  << BOLDGREEN << __LINE__ << BOLDCYAN << " in file: " << BOLDBLUE << __FILE__ \
-                  << RESET << std::endl;                                                       \
-        exit(0);                                                                        \
+#define ErrorPrintNEXIT_0(AMError)                                                   \
+    {                                                                                \
+        AMLogError(AMErrorToString(AMError) << " in line: " << __LINE__ << " in file: " \
+                                            << __FILE__);                            \
+        exit(0);                                                                     \
     }
 
-#define ErrorPrintNEXIT_1(AMError)                                                             \
-    {                                                                                          \
-        std::cout << BOLDRED << AMErrorToString(AMError) << BOLDYELLOW << " in line: "         \
-                  << BOLDGREEN << __LINE__ << BOLDCYAN << " in file: " << BOLDBLUE << __FILE__ \
-                  << RESET << std::endl;                                                       \
-        exit(1);                                                                        \
+#define ErrorPrintNEXIT_1(AMError)                                                   \
+    {                                                                                \
+        AMLogError(AMErrorToString(AMError) << " in line: " << __LINE__ << " in file: " \
+                                            << __FILE__);                            \
+        exit(1);                                                                     \
     }
-
-
-    
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "util-log.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+int am_log_level = AM_LOG_COMPILE_LEVEL;
+unsigned am_log_rate_limit = 0;
+
+#define AM_LOG_QUEUE_SIZE 4096 //2的幂
+
+/*队列中的二进制日志记录, file和func都指向字符串常量*/
+typedef struct AMLogRecord
+{
+    int64_t time_ns;
+    int level;
+    int line;
+    const char *file;
+    const char *func;
+    uint32_t len;
+    char msg[AM_LOG_MSG_MAX];
+} AMLogRecord;
+
+typedef struct AMLogSlot
+{
+    std::atomic<uint64_t> seq;
+    AMLogRecord rec;
+} AMLogSlot;
+
+/*有界多生产者单消费者队列, 每个槽位用序号判断是否可写/可读*/
+static AMLogSlot *log_queue = nullptr;
+static std::atomic<uint64_t> log_enqueue_pos(0);
+static uint64_t log_dequeue_pos = 0;
+static std::atomic<uint64_t> log_dropped(0);
+static std::atomic<bool> log_async(false);
+static std::atomic<bool> log_stop(false);
+static std::thread *log_thread = nullptr;
+
+static FILE *log_out = stdout;
+static bool log_color = true;
+
+/*把正文写入线程局部的定长缓冲区, 不分配内存*/
+class AMLogBuf : public std::streambuf
+{
+public:
+    void reset()
+    {
+        setp(buf, buf + AM_LOG_MSG_MAX);
+    }
+    size_t length() const
+    {
+        return pptr() - pbase();
+    }
+    const char *data() const
+    {
+        return buf;
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        return ch; //截断
+    }
+
+private:
+    char buf[AM_LOG_MSG_MAX];
+};
+
+typedef struct AMLogThreadStream
+{
+    AMLogBuf buf;
+    std::ostream os;
+    AMLogThreadStream() : os(&buf) {}
+} AMLogThreadStream;
+
+static thread_local AMLogThreadStream log_stream;
+
+static const char *level_name(int level)
+{
+    switch (level)
+    {
+    case AM_LOG_EMERGENCY:
+        return "EMERG";
+    case AM_LOG_ALERT:
+        return "ALERT";
+    case AM_LOG_ERROR:
+        return "ERROR";
+    case AM_LOG_WARING:
+        return "WARN";
+    case AM_LOG_NOTICE:
+        return "NOTICE";
+    case AM_LOG_INFO:
+        return "INFO";
+    case AM_LOG_PERF:
+        return "PERF";
+    case AM_LOG_CONFIG:
+        return "CONFIG";
+    case AM_LOG_DEBUG:
+        return "DEBUG";
+    }
+    return "LOG";
+}
+
+static const char *level_color(int level)
+{
+    if (level <= AM_LOG_ERROR)
+        return BOLDRED;
+    if (level <= AM_LOG_NOTICE)
+        return BOLDMAGENTA;
+    if (level <= AM_LOG_INFO)
+        return BOLDYELLOW;
+    return BOLDCYAN;
+}
+
+static int64_t now_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void log_write(const AMLogRecord &rec)
+{
+    time_t sec = rec.time_ns / 1000000000ll;
+    struct tm tm;
+    char tbuf[32];
+    localtime_r(&sec, &tm);
+    strftime(tbuf, sizeof(tbuf), "%H:%M:%S", &tm);
+
+    const char *file = strrchr(rec.file, '/');
+    file = file ? file + 1 : rec.file;
+
+    if (log_color)
+    {
+        fprintf(log_out, "%s.%06lld %s%-6s" RESET " %s:%d %s: %.*s\n", tbuf,
+                (long long)(rec.time_ns % 1000000000ll) / 1000, level_color(rec.level),
+                level_name(rec.level), file, rec.line, rec.func, (int)rec.len, rec.msg);
+    }
+    else
+    {
+        fprintf(log_out, "%s.%06lld %-6s %s:%d %s: %.*s\n", tbuf,
+                (long long)(rec.time_ns % 1000000000ll) / 1000, level_name(rec.level), file,
+                rec.line, rec.func, (int)rec.len, rec.msg);
+    }
+}
+
+static bool log_enqueue(const AMLogRecord &rec)
+{
+    uint64_t pos = log_enqueue_pos.load(std::memory_order_relaxed);
+    AMLogSlot *slot;
+
+    for (;;)
+    {
+        slot = &log_queue[pos & (AM_LOG_QUEUE_SIZE - 1)];
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0)
+        {
+            if (log_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false; //队列满
+        }
+        else
+        {
+            pos = log_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->rec.time_ns = rec.time_ns;
+    slot->rec.level = rec.level;
+    slot->rec.line = rec.line;
+    slot->rec.file = rec.file;
+    slot->rec.func = rec.func;
+    slot->rec.len = rec.len;
+    memcpy(slot->rec.msg, rec.msg, rec.len);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+static int log_drain()
+{
+    int n = 0;
+    for (;;)
+    {
+        AMLogSlot *slot = &log_queue[log_dequeue_pos & (AM_LOG_QUEUE_SIZE - 1)];
+        if (slot->seq.load(std::memory_order_acquire) != log_dequeue_pos + 1)
+            break;
+        log_write(slot->rec);
+        slot->seq.store(log_dequeue_pos + AM_LOG_QUEUE_SIZE, std::memory_order_release);
+        log_dequeue_pos++;
+        n++;
+    }
+
+    uint64_t dropped = log_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        fprintf(log_out, "(%llu log messages dropped, queue full)\n", (unsigned long long)dropped);
+    }
+    if (n > 0)
+    {
+        fflush(log_out);
+    }
+    return n;
+}
+
+static void log_main_loop()
+{
+    while (!log_stop.load(std::memory_order_acquire))
+    {
+        if (log_drain() == 0)
+        {
+            usleep(1000);
+        }
+    }
+    log_drain();
+}
+
+int AMLogLevelFromString(const std::string &str)
+{
+    static const char *names[] = {"none", "emergency", "alert", "error", "warning",
+                                  "notice", "info", "perf", "config", "debug"};
+    for (int i = 0; i < AM_LOG_LEVEL_MAX; i++)
+    {
+        if (str == names[i])
+            return i;
+    }
+    return -1;
+}
+
+int AMLogInit(int level, bool async, unsigned rate_limit, const std::string &filename)
+{
+    am_log_level = level;
+    am_log_rate_limit = rate_limit;
+
+    if (!filename.empty())
+    {
+        FILE *fp = fopen(filename.c_str(), "a");
+        if (fp == nullptr)
+        {
+            return ERROR;
+        }
+        log_out = fp;
+    }
+    log_color = isatty(fileno(log_out));
+
+    if (async && log_thread == nullptr)
+    {
+        log_queue = new AMLogSlot[AM_LOG_QUEUE_SIZE];
+        for (uint64_t i = 0; i < AM_LOG_QUEUE_SIZE; i++)
+        {
+            log_queue[i].seq.store(i, std::memory_order_relaxed);
+        }
+        log_stop.store(false);
+        log_thread = new std::thread(log_main_loop);
+        log_async.store(true, std::memory_order_release);
+        atexit(AMLogShutdown);
+    }
+    return SUCCESS;
+}
+
+void AMLogShutdown()
+{
+    if (log_thread == nullptr)
+    {
+        return;
+    }
+    log_async.store(false, std::memory_order_release);
+    log_stop.store(true, std::memory_order_release);
+    log_thread->join();
+    delete log_thread;
+    log_thread = nullptr;
+    fflush(log_out);
+}
+
+bool AMLogRateAllow(AMLogRateLimit &rl)
+{
+    if (am_log_rate_limit == 0)
+    {
+        return true;
+    }
+
+    int64_t sec = now_ns(CLOCK_MONOTONIC_COARSE) / 1000000000ll;
+    int64_t window = rl.window.load(std::memory_order_relaxed);
+    if (window != sec && rl.window.compare_exchange_strong(window, sec, std::memory_order_relaxed))
+    {
+        rl.count.store(0, std::memory_order_relaxed);
+        uint32_t suppressed = rl.suppressed.exchange(0, std::memory_order_relaxed);
+        if (suppressed > 0)
+        {
+            AMLogBegin() << "(" << suppressed << " messages suppressed by rate limit)";
+            AMLogCommit(AM_LOG_NOTICE, "", 0, "");
+        }
+    }
+
+    if (rl.count.fetch_add(1, std::memory_order_relaxed) < am_log_rate_limit)
+    {
+        return true;
+    }
+    rl.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+std::ostream &AMLogBegin()
+{
+    log_stream.buf.reset();
+    return log_stream.os;
+}
+
+void AMLogCommit(int level, const char *file, int line, const char *func)
+{
+    AMLogRecord rec;
+    rec.time_ns = now_ns(CLOCK_REALTIME);
+    rec.level = level;
+    rec.line = line;
+    rec.file = file;
+    rec.func = func;
+    rec.len = log_stream.buf.length();
+    memcpy(rec.msg, log_stream.buf.data(), rec.len);
+
+    if (log_async.load(std::memory_order_acquire))
+    {
+        if (!log_enqueue(rec))
+        {
+            log_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    log_write(rec);
+    fflush(log_out);
+}
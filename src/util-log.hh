@@ -0,0 +1,72 @@
+#ifndef UTIL_LOG_HH
+#define UTIL_LOG_HH
+/*
+AutoMonitor的日志子系统, util-debug.hh中的打印宏都经过这里。
+
+    编译期: 高于AM_LOG_COMPILE_LEVEL的日志在编译时被删除, 生产环境用
+            -DAM_LOG_COMPILE_LEVEL=AM_LOG_COMPILE_ERROR 编译, 调试打印没有任何开销。
+    运行期: am_log_level来自automonitor.yaml的log.level, 高于它的日志只比较一次整数。
+    异步:   开启后, 调用方只把日志记录写入无锁队列, 由后台线程格式化并输出;
+            队列满时丢弃并计数, 不阻塞检测线程。
+    限流:   每个调用点每秒最多输出am_log_rate_limit条, 超出部分只计数。
+*/
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*编译期日志级别, 数值与AMLogLevel一致*/
+#define AM_LOG_COMPILE_NONE 0
+#define AM_LOG_COMPILE_ERROR 3
+#define AM_LOG_COMPILE_INFO 6
+#define AM_LOG_COMPILE_DEBUG 9
+
+#ifndef AM_LOG_COMPILE_LEVEL
+#define AM_LOG_COMPILE_LEVEL AM_LOG_COMPILE_DEBUG
+#endif
+
+#define AM_LOG_MSG_MAX 240 //单条日志正文的最大长度, 超出部分被截断
+
+/*每个日志调用点一个, 静态存储期内零初始化*/
+typedef struct AMLogRateLimit
+{
+    std::atomic<int64_t> window; //当前统计窗口(秒)
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> suppressed;
+} AMLogRateLimit;
+
+extern int am_log_level;
+extern unsigned am_log_rate_limit;
+
+/*
+初始化日志, 在读取automonitor.yaml之后调用。
+filename为空时输出到标准输出。
+*/
+int AMLogInit(int level, bool async, unsigned rate_limit, const std::string &filename);
+/*将队列中的日志全部输出并停止后台线程, AMLogInit会用atexit注册*/
+void AMLogShutdown();
+/*把"debug", "info"等字符串转换为日志级别, 无法识别时返回-1*/
+int AMLogLevelFromString(const std::string &str);
+
+bool AMLogRateAllow(AMLogRateLimit &rl);
+std::ostream &AMLogBegin();
+void AMLogCommit(int level, const char *file, int line, const char *func);
+
+#define AMLogOn(level) ((level) <= AM_LOG_COMPILE_LEVEL && (level) <= am_log_level)
+
+#define AMLog(level, x)                                               \
+    do                                                                \
+    {                                                                 \
+        if (AMLogOn(level))                                           \
+        {                                                             \
+            static AMLogRateLimit am_log_rl_;                         \
+            if (AMLogRateAllow(am_log_rl_))                           \
+            {                                                         \
+                std::ostream &am_log_os_ = AMLogBegin();              \
+                am_log_os_ << x;                                      \
+                AMLogCommit(level, __FILE__, __LINE__, __FUNCTION__); \
+            }                                                         \
+        }                                                             \
+    } while (0)
+
+#endif
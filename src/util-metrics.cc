@@ -0,0 +1,368 @@
+#include "util-metrics.hh"
+#include "util-debug.hh"
+#include "util-error.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+AMMetrics am_metrics;
+thread_local int am_metrics_shard = -1;
+static std::atomic<int> metrics_next_shard(0);
+
+static std::thread *metrics_thread = nullptr;
+static std::atomic<bool> metrics_stop(false);
+static int metrics_listen_fd = -1;
+static int metrics_wake_fd[2] = {-1, -1}; //AMMetricsShutdown写入一个字节唤醒线程
+static std::string metrics_dump_file;
+static unsigned metrics_dump_interval_ms = 0;
+
+//客户端连上后迟迟不发请求时, 最多等这么久
+#define METRICS_CLIENT_TIMEOUT_MS 1000
+
+static const char *stage_name[AM_STAGE_MAX] = {"decode", "step", "reply", "total"};
+
+static uint64_t bucket_upper(unsigned i)
+{
+    if (i < AM_HIST_SUB_BUCKETS)
+    {
+        return i;
+    }
+    unsigned mag = i / AM_HIST_SUB_BUCKETS + AM_HIST_SUB_BITS - 1;
+    unsigned sub = i % AM_HIST_SUB_BUCKETS;
+    uint64_t width = 1ull << (mag - AM_HIST_SUB_BITS);
+    return ((uint64_t)(AM_HIST_SUB_BUCKETS + sub) << (mag - AM_HIST_SUB_BITS)) + width - 1;
+}
+
+int AMMetricsAssignShard()
+{
+    int shard = metrics_next_shard.fetch_add(1, std::memory_order_relaxed);
+    if (shard >= AM_METRICS_SHARDS - 1)
+    {
+        shard = AM_METRICS_SHARDS - 1; //共用分片
+    }
+    am_metrics_shard = shard;
+    return shard;
+}
+
+uint64_t AMCounterRead(const AMCounter &c)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < AM_METRICS_SHARDS; i++)
+    {
+        v += c.shards[i].v.load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+static uint64_t hist_bucket(const AMHistogram &h, unsigned i)
+{
+    uint64_t v = 0;
+    for (int s = 0; s < AM_METRICS_SHARDS; s++)
+    {
+        v += h.shards[s].buckets[i].load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+static uint64_t hist_sum(const AMHistogram &h)
+{
+    uint64_t v = 0;
+    for (int s = 0; s < AM_METRICS_SHARDS; s++)
+    {
+        v += h.shards[s].sum.load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+static uint64_t hist_max(const AMHistogram &h)
+{
+    uint64_t v = 0;
+    for (int s = 0; s < AM_METRICS_SHARDS; s++)
+    {
+        uint64_t m = h.shards[s].max.load(std::memory_order_relaxed);
+        v = m > v ? m : v;
+    }
+    return v;
+}
+
+uint64_t AMHistogramCount(const AMHistogram &h)
+{
+    uint64_t v = 0;
+    for (unsigned i = 0; i < AM_HIST_BUCKETS; i++)
+    {
+        v += hist_bucket(h, i);
+    }
+    return v;
+}
+
+uint64_t AMHistogramQuantile(const AMHistogram &h, double q)
+{
+    uint64_t total = AMHistogramCount(h);
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * total);
+    if (rank >= total)
+    {
+        rank = total - 1;
+    }
+    uint64_t max = hist_max(h);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < AM_HIST_BUCKETS; i++)
+    {
+        seen += hist_bucket(h, i);
+        if (seen > rank)
+        {
+            uint64_t up = bucket_upper(i);
+            return up < max ? up : max;
+        }
+    }
+    return max;
+}
+
+void AMMetricsRender(std::string &out)
+{
+    std::ostringstream os;
+
+#define RENDER_COUNTER(name) \
+    os << "automonitor_" #name " " << AMCounterRead(am_metrics.name) << "\n"
+
+    RENDER_COUNTER(events_received);
+    RENDER_COUNTER(events_decoded);
+    RENDER_COUNTER(events_checked);
+    RENDER_COUNTER(parse_errors);
+    RENDER_COUNTER(violations);
+    RENDER_COUNTER(possible_violations);
+#undef RENDER_COUNTER
+    os << "automonitor_queue_depth " << am_metrics.queue_depth.load(std::memory_order_relaxed) << "\n";
+
+    for (int s = 0; s < AM_STAGE_MAX; s++)
+    {
+        const AMHistogram &h = am_metrics.stage_latency[s];
+        const char *n = stage_name[s];
+        os << "automonitor_latency_ns_count{stage=\"" << n << "\"} " << AMHistogramCount(h) << "\n"
+           << "automonitor_latency_ns_sum{stage=\"" << n << "\"} " << hist_sum(h) << "\n"
+           << "automonitor_latency_ns{stage=\"" << n << "\",quantile=\"0.5\"} "
+           << AMHistogramQuantile(h, 0.5) << "\n"
+           << "automonitor_latency_ns{stage=\"" << n << "\",quantile=\"0.99\"} "
+           << AMHistogramQuantile(h, 0.99) << "\n"
+           << "automonitor_latency_ns{stage=\"" << n << "\",quantile=\"0.999\"} "
+           << AMHistogramQuantile(h, 0.999) << "\n"
+           << "automonitor_latency_ns_max{stage=\"" << n << "\"} " << hist_max(h) << "\n";
+    }
+
+    for (size_t i = 0; i < am_metrics.num_states; i++)
+    {
+        os << "automonitor_state_visits{state=\"" << i << "\"} "
+           << am_metrics.state_visits[i].load(std::memory_order_relaxed) << "\n";
+    }
+
+    out = os.str();
+}
+
+static void metrics_dump()
+{
+    std::string text;
+    AMMetricsRender(text);
+
+    //先写临时文件再改名, 读取方不会看到写了一半的文件
+    std::string tmp = metrics_dump_file + ".tmp";
+    std::ofstream f(tmp, std::ios::trunc);
+    f << text;
+    f.close();
+    rename(tmp.c_str(), metrics_dump_file.c_str());
+}
+
+//等待fd可读, 超时或被AMMetricsShutdown唤醒时返回false
+static bool metrics_wait(int fd, int timeout)
+{
+    struct pollfd pfd[2];
+    int n = 0;
+    if (fd >= 0)
+    {
+        pfd[n].fd = fd;
+        pfd[n].events = POLLIN;
+        n++;
+    }
+    pfd[n].fd = metrics_wake_fd[0];
+    pfd[n].events = POLLIN;
+    n++;
+    if (poll(pfd, n, timeout) <= 0 || pfd[n - 1].revents != 0)
+    {
+        return false;
+    }
+    return fd >= 0 && pfd[0].revents != 0;
+}
+
+static void metrics_serve(int fd)
+{
+    //发送也不能无限阻塞, 否则停不下来
+    struct timeval tv;
+    tv.tv_sec = METRICS_CLIENT_TIMEOUT_MS / 1000;
+    tv.tv_usec = (METRICS_CLIENT_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    if (!metrics_wait(fd, METRICS_CLIENT_TIMEOUT_MS))
+    {
+        return;
+    }
+    char req[1024];
+    ssize_t n = recv(fd, req, sizeof(req) - 1, MSG_DONTWAIT);
+    if (n <= 0)
+    {
+        return;
+    }
+
+    std::string body;
+    AMMetricsRender(body);
+    std::string resp = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " +
+                       to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t off = 0;
+    while (off < resp.size())
+    {
+        ssize_t w = send(fd, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+        if (w <= 0)
+        {
+            break;
+        }
+        off += w;
+    }
+}
+
+static void metrics_main_loop()
+{
+    uint64_t next_dump = AMMetricsNow() + metrics_dump_interval_ms * 1000000ull;
+
+    while (!metrics_stop.load(std::memory_order_acquire))
+    {
+        if (metrics_wait(metrics_listen_fd, 200))
+        {
+            int fd = accept(metrics_listen_fd, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                metrics_serve(fd);
+                close(fd);
+            }
+        }
+
+        if (!metrics_dump_file.empty() && AMMetricsNow() >= next_dump)
+        {
+            metrics_dump();
+            next_dump = AMMetricsNow() + metrics_dump_interval_ms * 1000000ull;
+        }
+    }
+
+    if (!metrics_dump_file.empty())
+    {
+        metrics_dump();
+    }
+}
+
+static int metrics_listen(const std::string &addr)
+{
+    size_t colon = addr.rfind(':');
+    if (colon == std::string::npos)
+    {
+        return -1;
+    }
+    std::string host = addr.substr(0, colon);
+    int port = atoi(addr.c_str() + colon + 1);
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &sa.sin_addr) != 1)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 16) != 0)
+    {
+        ERRORPrint("metrics listen " << addr << ": " << strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int AMMetricsInit(size_t num_states, const std::string &http_addr, const std::string &dump_file,
+                  unsigned dump_interval_ms)
+{
+    am_metrics.num_states = num_states;
+    am_metrics.state_visits = new std::atomic<uint64_t>[num_states];
+    for (size_t i = 0; i < num_states; i++)
+    {
+        am_metrics.state_visits[i].store(0, std::memory_order_relaxed);
+    }
+
+    if (!http_addr.empty())
+    {
+        metrics_listen_fd = metrics_listen(http_addr);
+        if (metrics_listen_fd < 0)
+        {
+            return ERROR;
+        }
+        INFOPrint("Metrics are served on http://" << http_addr << "/metrics");
+    }
+    metrics_dump_file = dump_file;
+    metrics_dump_interval_ms = dump_interval_ms ? dump_interval_ms : 10000;
+
+    if (pipe2(metrics_wake_fd, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        ERRORPrint("metrics pipe: " << strerror(errno));
+        return ERROR;
+    }
+    metrics_stop.store(false);
+    metrics_thread = new std::thread(metrics_main_loop);
+    atexit(AMMetricsShutdown);
+    return SUCCESS;
+}
+
+void AMMetricsShutdown()
+{
+    if (metrics_thread == nullptr)
+    {
+        return;
+    }
+    metrics_stop.store(true, std::memory_order_release);
+    //唤醒阻塞在poll中的线程, 不必等客户端或超时
+    char c = 0;
+    ssize_t w = write(metrics_wake_fd[1], &c, 1);
+    (void)w;
+    metrics_thread->join();
+    delete metrics_thread;
+    metrics_thread = nullptr;
+    close(metrics_wake_fd[0]);
+    close(metrics_wake_fd[1]);
+    metrics_wake_fd[0] = metrics_wake_fd[1] = -1;
+    if (metrics_listen_fd >= 0)
+    {
+        close(metrics_listen_fd);
+        metrics_listen_fd = -1;
+    }
+}
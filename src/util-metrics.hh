@@ -0,0 +1,161 @@
+#ifndef UTIL_METRICS_HH
+#define UTIL_METRICS_HH
+/*
+服务端的运行指标: 无锁计数器, HDR风格的延迟直方图, 以及每个Monitor状态的访问次数。
+更新只是一次relaxed原子加法, 可以在生产环境中一直开启。
+指标以文本格式输出, 可以通过本地HTTP端口读取(curl http://127.0.0.1:9464/metrics),
+也可以定期写入文件。
+*/
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <time.h>
+
+/*
+对数-线性分桶: 每个2的幂区间分成AM_HIST_SUB_BUCKETS个子桶, 相对误差不超过1/AM_HIST_SUB_BUCKETS。
+值的单位为纳秒, 覆盖1ns到2^AM_HIST_MAGNITUDES ns(约18分钟)。
+*/
+#define AM_HIST_SUB_BITS 4
+#define AM_HIST_SUB_BUCKETS (1 << AM_HIST_SUB_BITS)
+#define AM_HIST_MAGNITUDES 40
+#define AM_HIST_BUCKETS ((AM_HIST_MAGNITUDES + 1) * AM_HIST_SUB_BUCKETS)
+
+/*
+每个线程第一次更新时分到一个分片, 独占的分片只有本线程写, 用普通的load/store即可,
+不需要带lock前缀的原子指令; 线程数超过AM_METRICS_SHARDS-1时, 其余线程共用最后一个分片并使用fetch_add。
+读取方把所有分片相加。
+*/
+#define AM_METRICS_SHARDS 8
+
+typedef struct AMHistogramShard
+{
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[AM_HIST_BUCKETS];
+} AMHistogramShard;
+
+typedef struct AMHistogram
+{
+    AMHistogramShard shards[AM_METRICS_SHARDS];
+} AMHistogram;
+
+typedef struct AMCounter
+{
+    struct
+    {
+        alignas(64) std::atomic<uint64_t> v;
+    } shards[AM_METRICS_SHARDS];
+} AMCounter;
+
+typedef enum
+{
+    AM_STAGE_DECODE = 0, //recv -> decode
+    AM_STAGE_STEP,       //decode -> step
+    AM_STAGE_REPLY,      //step -> reply
+    AM_STAGE_TOTAL,      //recv -> reply
+    AM_STAGE_MAX
+} AMStage;
+
+typedef struct AMMetrics
+{
+    AMCounter events_received;
+    AMCounter events_decoded;
+    AMCounter events_checked;
+    AMCounter parse_errors;
+    AMCounter violations;
+    AMCounter possible_violations;
+    std::atomic<int64_t> queue_depth; //共享内存环中未处理的字节数
+    AMHistogram stage_latency[AM_STAGE_MAX];
+
+    size_t num_states;
+    std::atomic<uint64_t> *state_visits;
+} AMMetrics;
+
+extern AMMetrics am_metrics;
+extern thread_local int am_metrics_shard;
+
+/*
+启动指标输出线程。http_addr形如"127.0.0.1:9464", 为空则不监听;
+dump_file为空则不写文件。num_states用于分配状态访问计数。
+*/
+int AMMetricsInit(size_t num_states, const std::string &http_addr, const std::string &dump_file,
+                  unsigned dump_interval_ms);
+void AMMetricsShutdown();
+/*以文本格式输出全部指标*/
+void AMMetricsRender(std::string &out);
+int AMMetricsAssignShard();
+
+static inline int AMMetricsShard()
+{
+    int shard = am_metrics_shard;
+    return shard >= 0 ? shard : AMMetricsAssignShard();
+}
+
+static inline void AMShardAdd(std::atomic<uint64_t> &c, uint64_t v, int shard)
+{
+    if (shard < AM_METRICS_SHARDS - 1)
+    {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+    else
+    {
+        c.fetch_add(v, std::memory_order_relaxed);
+    }
+}
+
+static inline uint64_t AMMetricsNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline unsigned AMHistogramIndex(uint64_t v)
+{
+    if (v < AM_HIST_SUB_BUCKETS)
+    {
+        return (unsigned)v;
+    }
+    unsigned mag = 63 - __builtin_clzll(v); //v的最高位
+    if (mag > AM_HIST_MAGNITUDES + AM_HIST_SUB_BITS - 1)
+    {
+        return AM_HIST_BUCKETS - 1;
+    }
+    unsigned sub = (unsigned)(v >> (mag - AM_HIST_SUB_BITS)) & (AM_HIST_SUB_BUCKETS - 1);
+    return (mag - AM_HIST_SUB_BITS + 1) * AM_HIST_SUB_BUCKETS + sub;
+}
+
+static inline void AMHistogramRecord(AMHistogram &h, uint64_t v)
+{
+    int shard = AMMetricsShard();
+    AMHistogramShard &s = h.shards[shard];
+    AMShardAdd(s.buckets[AMHistogramIndex(v)], 1, shard);
+    AMShardAdd(s.sum, v, shard);
+    uint64_t m = s.max.load(std::memory_order_relaxed);
+    while (v > m && !s.max.compare_exchange_weak(m, v, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t AMCounterRead(const AMCounter &c);
+uint64_t AMHistogramCount(const AMHistogram &h);
+/*返回第q分位(0~1)所在桶的上界*/
+uint64_t AMHistogramQuantile(const AMHistogram &h, double q);
+
+#define AMMetricsInc(name)                                 \
+    do                                                     \
+    {                                                      \
+        int am_shard_ = AMMetricsShard();                  \
+        AMShardAdd(am_metrics.name.shards[am_shard_].v, 1, am_shard_); \
+    } while (0)
+
+static inline void AMMetricsStateVisit(int state)
+{
+    if (am_metrics.state_visits && state >= 0 && (size_t)state < am_metrics.num_states)
+    {
+        am_metrics.state_visits[state].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#endif
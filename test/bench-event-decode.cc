@@ -0,0 +1,169 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/event-decode.hh"
+#include "../src/util-arena.hh"
+extern "C"
+{
+#include "../src/cJSON.h"
+}
+
+/*
+AMDecodeEvent与cJSON的差分模糊测试和吞吐量对比。
+g++ -O2 -std=c++14 bench-event-decode.cc ../src/event-decode.cc ../src/util-error.cc ../src/util-log.cc ../src/util-arena.cc ../src/cJSON.c -lpthread
+libFuzzer: clang++ -DAM_LIBFUZZER -fsanitize=fuzzer,address ...(同上)
+*/
+
+static const char *sample_event =
+    "{\"eventId\":3,\"eventName\":\"event3\",\"fileName\":\"main.cc\",\"line\":42,"
+    "\"eventTime\":\"2020-06-01 10:11:12.345\",\"sample\":\"always\"}";
+
+/*cJSON_GetObjectItem不区分大小写, 事件的键区分大小写*/
+static cJSON *get_item(cJSON *obj, const char *key)
+{
+    for (cJSON *c = obj->child; c != nullptr; c = c->next)
+    {
+        if (strcmp(c->string, key) == 0)
+            return c;
+    }
+    return nullptr;
+}
+
+/*cJSON能解析的扁平对象, 两者的字段必须一致*/
+static void check_same(const char *buf, size_t len)
+{
+    AMEventView ev;
+    //cJSON在字符串以反斜杠结尾时会读越界, 只把本解码器接受的输入交给cJSON对比
+    if (AMDecodeEvent(buf, len, ev) != SUCCESS || ev.escaped)
+    {
+        return;
+    }
+
+    std::string s(ev.raw.ptr, ev.raw.len);
+    cJSON *cj = cJSON_Parse(s.c_str());
+    if (cj == nullptr || cj->type != cJSON_Object)
+    {
+        cJSON_Delete(cj);
+        return;
+    }
+    cJSON *name = get_item(cj, "eventName");
+    if (name && name->type == cJSON_String)
+    {
+        if (ev.eventName.ptr == nullptr || strlen(name->valuestring) != ev.eventName.len ||
+            memcmp(name->valuestring, ev.eventName.ptr, ev.eventName.len) != 0)
+        {
+            fprintf(stderr, "eventName mismatch: %s\n", s.c_str());
+            abort();
+        }
+    }
+    cJSON *id = get_item(cj, "eventId");
+    if (id && id->type == cJSON_Int && id->sign != -1 && id->valueint <= INT64_MAX &&
+        (int64_t)id->valueint != ev.eventId)
+    {
+        fprintf(stderr, "eventId mismatch: %s\n", s.c_str());
+        abort();
+    }
+    cJSON_Delete(cj);
+}
+
+#ifdef AM_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    check_same((const char *)data, size);
+    return 0;
+}
+#else
+
+static void fuzz(unsigned rounds)
+{
+    std::mt19937 rng(12345);
+    const char alphabet[] = "{}[]\":,\\ -0123456789.eEtrufalsn";
+    std::string base = sample_event;
+
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        std::string s = base;
+        int edits = 1 + rng() % 4;
+        for (int e = 0; e < edits; e++)
+        {
+            size_t pos = rng() % (s.size() + 1);
+            switch (rng() % 3)
+            {
+            case 0:
+                if (pos < s.size())
+                    s.erase(pos, 1);
+                break;
+            case 1:
+                s.insert(pos, 1, alphabet[rng() % (sizeof(alphabet) - 1)]);
+                break;
+            default:
+                if (pos < s.size())
+                    s[pos] = (char)(rng() % 256);
+            }
+        }
+        //复制到刚好大小的堆内存, 越界读取在ASan下可以发现
+        std::vector<char> buf(s.begin(), s.end());
+        check_same(buf.data(), buf.size());
+        check_same(buf.data(), rng() % (buf.size() + 1));
+    }
+    printf("fuzz: %u inputs ok\n", rounds);
+}
+
+static void bench(unsigned n)
+{
+    size_t len = strlen(sample_event);
+    int64_t sink = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < n; i++)
+    {
+        AMEventView ev;
+        AMDecodeEvent(sample_event, len, ev);
+        sink += ev.eventName.len + ev.line;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < n; i++)
+    {
+        cJSON *cj = cJSON_Parse(sample_event);
+        sink += strlen(cJSON_GetObjectItem(cj, "eventName")->valuestring) +
+                cJSON_GetObjectItem(cj, "line")->valueint;
+        cJSON_Delete(cj);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    AMArena arena;
+    AMArenaInit(arena);
+    AMArenaInstallJsonHooks();
+    for (unsigned i = 0; i < n; i++)
+    {
+        AMArenaScope scope(arena);
+        cJSON *cj = cJSON_Parse(sample_event);
+        sink += strlen(cJSON_GetObjectItem(cj, "eventName")->valuestring) +
+                cJSON_GetObjectItem(cj, "line")->valueint;
+        cJSON_Delete(cj);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    cJSON_InitHooks(nullptr);
+    AMArenaDestroy(arena);
+
+    double a = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    double b = std::chrono::duration<double, std::nano>(t2 - t1).count() / n;
+    double c = std::chrono::duration<double, std::nano>(t3 - t2).count() / n;
+    printf("AMDecodeEvent: %.1f ns/event (%.0f MB/s)\n", a, len * 1e3 / a);
+    printf("cJSON_Parse:   %.1f ns/event (%.0f MB/s)\n", b, len * 1e3 / b);
+    printf("cJSON + arena: %.1f ns/event (%.0f MB/s)\n", c, len * 1e3 / c);
+    printf("speedup %.1fx (%lld)\n", b / a, (long long)sink);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned rounds = argc > 1 ? atoi(argv[1]) : 1000000;
+    fuzz(rounds);
+    bench(rounds);
+    return 0;
+}
+#endif
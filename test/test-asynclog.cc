@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <fstream>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "../src/client/AsyncLogWriter.hpp"
+
+/*
+等待写盘的缓冲区达到上限时按整条记录丢弃, 写出的每一行都必须是完整的记录。
+g++ -O2 -std=c++14 test-asynclog.cc ../src/client/AsyncLogWriter.cpp -lpthread
+*/
+
+static int failures = 0;
+static uint64_t appendedBytes = 0;
+
+//记录长度随id变化, 有的记录比一个缓冲区还长
+static std::string record(int id)
+{
+    return "{\"eventId\":" + std::to_string(id) + ",\"pad\":\"" + std::string((id * 37) % 300, 'x') + "\"}\n";
+}
+
+static void append(AsyncLogWriter &writer, int id)
+{
+    std::string r = record(id);
+    writer.Append(r);
+    appendedBytes += r.length();
+}
+
+static void check(const char *dir, const AsyncLogWriter &writer)
+{
+    uint64_t writtenBytes = 0;
+    size_t lines = 0;
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL)
+    {
+        if (e->d_name[0] == '.')
+        {
+            continue;
+        }
+        std::string path = std::string(dir) + "/" + e->d_name;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            int id = -1;
+            if (sscanf(line.c_str(), "{\"eventId\":%d,", &id) != 1 || line + "\n" != record(id))
+            {
+                printf("FAIL broken record: %.80s\n", line.c_str());
+                failures++;
+            }
+            writtenBytes += line.length() + 1;
+            lines++;
+        }
+        unlink(path.c_str());
+    }
+    closedir(d);
+
+    if (writer.DroppedBytes() == 0)
+    {
+        printf("FAIL nothing was dropped\n");
+        failures++;
+    }
+    if (writtenBytes + writer.DroppedBytes() != appendedBytes)
+    {
+        printf("FAIL %llu bytes written + %llu dropped, %llu appended\n",
+               (unsigned long long)writtenBytes, (unsigned long long)writer.DroppedBytes(),
+               (unsigned long long)appendedBytes);
+        failures++;
+    }
+    printf("%zu records written\n", lines);
+}
+
+int main()
+{
+    char dir[] = "/tmp/test-asynclogXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    AsyncLogConfig config;
+    config.basename = std::string(dir) + "/event.log";
+    config.bufferSize = 256;
+    config.maxPendingBuffers = 4;
+    config.rotateSize = 0;
+    config.rotateSeconds = 0;
+
+    //后台线程启动之前填满上限, 之后的记录有的放得下有的放不下
+    {
+        AsyncLogWriter writer(config);
+        appendedBytes = 0;
+        for (int id = 0; id < 200; id++)
+        {
+            append(writer, id);
+        }
+        writer.Start();
+        writer.Stop();
+        check(dir, writer);
+    }
+
+    //后台线程写盘时连续追加
+    {
+        AsyncLogWriter writer(config);
+        appendedBytes = 0;
+        writer.Start();
+        for (int id = 0; id < 200000; id++)
+        {
+            append(writer, id);
+        }
+        writer.Stop();
+        check(dir, writer);
+    }
+
+    rmdir(dir);
+    if (failures == 0)
+    {
+        printf("OK\n");
+    }
+    return failures != 0;
+}
@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/checkpoint.hh"
+
+/*
+回放接收日志与在线检测的判定必须一致: 进入BAD状态即违规, 采样时的违规回到初始状态。
+接收日志轮转之后, 旧的几代被删除, 恢复时从检查点记录的一代接着回放。
+Check_word_acceptance在automonitor.cc中, 依赖zmq, 这里用按事件名精确匹配的版本代替。
+g++ -O2 -std=c++14 -I<spot源码目录> -I<spot源码目录>/buddy/src test-checkpoint.cc ../src/checkpoint.cc
+    ../src/event-decode.cc ../src/util-error.cc ../src/util-log.cc -x c ../src/cJSON.c -lspot -lbddx -lpthread
+*/
+
+static int failures = 0;
+
+int Check_word_acceptance(spot::twa_graph_ptr &, Monitor &monitor, const spot::bdd_dict_ptr &,
+                          std::string accept_word)
+{
+    for (auto &l : monitor.nodes[monitor.state_number].monitor_labels)
+    {
+        if (l.label == "1" || l.label == accept_word)
+        {
+            monitor.state_number = l.next_state;
+            return SUCCESS;
+        }
+    }
+    return WORD_ACCEPTANCE_WRONG;
+}
+
+static void add_state(Monitor &monitor, int state, int verdict, std::vector<std::pair<std::string, int>> labels)
+{
+    Monitor_state &n = monitor.nodes[state];
+    n.own_state = state;
+    n.verdict = verdict;
+    n.label_numbers = labels.size();
+    for (auto &l : labels)
+    {
+        Monitor_label ml;
+        ml.label = l.first;
+        ml.next_state = l.second;
+        n.monitor_labels.push_back(ml);
+    }
+}
+
+//0: a回到0, b进入GOOD状态1, c进入BAD状态2
+static Monitor make_monitor()
+{
+    Monitor monitor;
+    monitor.state_number = 0;
+    monitor.init_state = 0;
+    monitor.sampled = 0;
+    add_state(monitor, 0, AM_VERDICT_INCONCLUSIVE, {{"a", 0}, {"b", 1}, {"c", 2}});
+    add_state(monitor, 1, AM_VERDICT_GOOD, {{"1", 1}});
+    add_state(monitor, 2, AM_VERDICT_BAD, {{"1", 2}});
+    return monitor;
+}
+
+static std::string event(int id, const char *name, bool sampled = false)
+{
+    std::ostringstream os;
+    os << "{\"eventId\":" << id << ",\"eventName\":\"" << name << "\"";
+    if (sampled)
+    {
+        os << ",\"sample\":\"rate\",\"skipped\":3";
+    }
+    os << "}";
+    return os.str();
+}
+
+/*回放events, 返回回放后的状态, errors为写入错误日志的行数*/
+static AMCheckpointState replay(const std::vector<std::string> &events, Monitor &monitor, std::string &errors)
+{
+    char journal[] = "/tmp/test-checkpoint-XXXXXX";
+    int fd = mkstemp(journal);
+    close(fd);
+    std::ofstream out(journal);
+    for (auto &e : events)
+    {
+        out << e << "\n";
+    }
+    out.close();
+
+    spot::twa_graph_ptr aut;
+    spot::bdd_dict_ptr dict;
+    std::ostringstream errorLog;
+    AMCheckpointState st = {};
+    st.state_number = monitor.state_number;
+    AMCheckpointReplay(journal, aut, monitor, dict, errorLog, st);
+    unlink(journal);
+    errors = errorLog.str();
+    return st;
+}
+
+static void expect(const char *what, bool ok)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static bool exists(const std::string &name)
+{
+    struct stat sb;
+    return stat(name.c_str(), &sb) == 0;
+}
+
+/*每个检查点之后都轮转接收日志, 停止后只剩检查点指向的几代, 恢复得到相同的状态*/
+static void test_rotate()
+{
+    char file[] = "/tmp/test-checkpoint-XXXXXX";
+    int fd = mkstemp(file);
+    close(fd);
+    unlink(file);
+    std::string journal = std::string(file) + ".journal";
+
+    spot::twa_graph_ptr aut;
+    spot::bdd_dict_ptr dict;
+    std::ostringstream errorLog;
+    Monitor monitor = make_monitor();
+    uint64_t fingerprint = AMMonitorFingerprint(monitor);
+    AMCheckpointState st;
+    AMCheckpointRestore(file, journal, fingerprint, aut, monitor, dict, errorLog, st);
+    expect("start from the first generation", st.journal_gen == 0 && st.log_offset == 0);
+    AMCheckpointStart(file, journal, 1, st, 1);
+    const int n = 30;
+    for (int i = 0; i < n; i++)
+    {
+        std::string e = event(i, i + 1 == n ? "b" : "a");
+        Monitor_step(aut, monitor, dict, i + 1 == n ? "b" : "a");
+        AMCheckpointRecord(e.data(), e.size(), monitor, fingerprint);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    AMCheckpointStop();
+
+    AMCheckpointState saved;
+    expect("checkpoint written", AMCheckpointLoad(file, saved) == SUCCESS);
+    expect("journal rotated", saved.journal_gen > 0 && saved.events == n);
+    expect("covered generations removed", !exists(journal) &&
+                                              !exists(AMCheckpointJournalName(journal, saved.journal_gen - 1)));
+    expect("current generation kept", exists(AMCheckpointJournalName(journal, saved.journal_gen)));
+    expect("no empty generation left", !exists(AMCheckpointJournalName(journal, saved.journal_gen + 1)));
+
+    Monitor restored = make_monitor();
+    expect("restore", AMCheckpointRestore(file, journal, fingerprint, aut, restored, dict, errorLog, st) == SUCCESS);
+    expect("restored state", restored.state_number == 1 && st.events == n && st.journal_gen == saved.journal_gen);
+
+    unlink(file);
+    for (uint64_t g = 0; g <= saved.journal_gen; g++)
+    {
+        unlink(AMCheckpointJournalName(journal, g).c_str());
+    }
+}
+
+int main()
+{
+    std::string errors;
+
+    //c进入BAD状态, 标签匹配但已经违规
+    Monitor monitor = make_monitor();
+    AMCheckpointState st = replay({event(1, "a"), event(2, "c")}, monitor, errors);
+    expect("BAD verdict is a violation", errors == "[replay] " + event(2, "c") + "\n");
+    expect("state after the violation", st.state_number == 2 && st.events == 2);
+
+    //采样时进入BAD状态只是可能违规, 与在线检测一样回到初始状态, 之后b进入GOOD状态
+    monitor = make_monitor();
+    std::vector<std::string> events = {event(1, "a", true), event(2, "c"), event(3, "b"), event(4, "x")};
+    st = replay(events, monitor, errors);
+    expect("sampled BAD verdict is a possible violation", errors == "[replay] [sampled] " + event(2, "c") + "\n");
+    expect("resynchronized after the possible violation", st.state_number == 1 && st.sampled == 0);
+
+    //在线检测同样的事件得到相同的状态
+    Monitor live = make_monitor();
+    spot::twa_graph_ptr aut;
+    spot::bdd_dict_ptr dict;
+    live.sampled = 1;
+    std::vector<int> steps;
+    for (const char *name : {"a", "c", "b", "x"})
+    {
+        steps.push_back(Monitor_step(aut, live, dict, name));
+    }
+    expect("live steps", steps == std::vector<int>({AM_STEP_OK, AM_STEP_POSSIBLE_VIOLATION, AM_STEP_OK, AM_STEP_OK}));
+    expect("replay matches the live state", live.state_number == st.state_number && live.sampled == st.sampled);
+
+    test_rotate();
+
+    if (failures == 0)
+    {
+        printf("OK\n");
+    }
+    return failures != 0;
+}
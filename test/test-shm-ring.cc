@@ -0,0 +1,83 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+#include "../src/shm-ring.hh"
+
+/*
+释放记录时清除stamp: 上一圈记录的负载中恰好有"下一条记录的位置+1",
+消费者也不能把还没有写入的位置当作记录读出。
+g++ -O2 -std=c++14 test-shm-ring.cc ../src/shm-ring.cc ../src/util-error.cc ../src/util-log.cc -lpthread -lrt
+*/
+
+static int failures = 0;
+
+static void expect(const char *what, bool ok)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void consume(SHMRing &ring, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        SHMRecord *rec;
+        if (shm_ring_pop(ring, &rec, 0) != SUCCESS)
+        {
+            printf("FAIL record %d missing\n", i);
+            failures++;
+            return;
+        }
+        shm_ring_release(ring, rec);
+    }
+}
+
+int main()
+{
+    SHMRing ring;
+    ring.fd = -1;
+    ring.hdr = nullptr;
+    ring.owner = 0;
+    std::string name = "/automonitor-test-" + std::to_string(getpid());
+    if (shm_ring_create(ring, name, 4096) != SUCCESS || ring.hdr->capacity != 4096)
+    {
+        printf("FAIL cannot create the ring\n");
+        return 1;
+    }
+    const uint64_t cap = ring.hdr->capacity;
+
+    //第一条记录在位置0, 负载(位置16)是一个完整的记录头: 下一圈位置cap + 16的stamp, 长度16, 事件类型
+    uint64_t forged = cap + 16 + 1;
+    uint32_t forged_len = 16, forged_type = SHM_RECORD_EVENT;
+    char payload[2048];
+    memset(payload, 0, sizeof(payload));
+    memcpy(payload, &forged, sizeof(forged));
+    memcpy(payload + 8, &forged_len, sizeof(forged_len));
+    memcpy(payload + 12, &forged_type, sizeof(forged_type));
+    expect("push forged", shm_ring_push(ring, SHM_RECORD_EVENT, payload, 16, 1) == SUCCESS);
+    //再填满第一圈: 32 + 2048 + 2016 = cap
+    expect("push fill", shm_ring_push(ring, SHM_RECORD_EVENT, payload, 2048 - 16, 1) == SUCCESS);
+    expect("push fill", shm_ring_push(ring, SHM_RECORD_EVENT, payload, 2016 - 16, 1) == SUCCESS);
+    consume(ring, 3);
+    expect("first lap consumed", ring.hdr->tail.load() == cap);
+
+    //第二圈的第一条记录只占16字节, 之后的位置cap + 16还没有写入
+    expect("push second lap", shm_ring_push(ring, SHM_RECORD_EVENT, payload, 0, 1) == SUCCESS);
+    consume(ring, 1);
+    SHMRecord *rec;
+    expect("stale payload is not a record", shm_ring_pop(ring, &rec, 0) == SHM_RING_EMPTY);
+
+    shm_ring_close(ring);
+    if (failures == 0)
+    {
+        printf("OK\n");
+    }
+    return failures != 0;
+}
@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/timed.hh"
+
+/*
+有界响应在区间边界上的行为: G(a -> F[lo,hi] b)的区间是闭区间,
+恰好在a + lo或a + hi到达的b都满足性质, 晚1ns才算超时。
+g++ -O2 -std=c++14 test-timed.cc ../src/timed.cc ../src/util-error.cc ../src/util-log.cc -lpthread
+*/
+
+#define MS 1000000ll
+
+static std::vector<int64_t> misses;
+static int failures = 0;
+
+static void expect(const char *what, size_t count)
+{
+    if (misses.size() != count)
+    {
+        printf("FAIL %s: %zu misses, expected %zu\n", what, misses.size(), count);
+        failures++;
+    }
+    misses.clear();
+}
+
+static void init(AMTimed &timed, const char *formula)
+{
+    AMTimedRule rule;
+    if (AMTimedParseRule("r", formula, rule) != SUCCESS)
+    {
+        printf("FAIL cannot parse %s\n", formula);
+        failures++;
+        return;
+    }
+    AMTimedInit(timed, {rule}, 1 * MS,
+                [](const AMTimedRule &, const std::string &, int64_t, int64_t deadline) { misses.push_back(deadline); });
+}
+
+int main()
+{
+    AMTimed timed;
+    init(timed, "G(a -> F[0ms,10ms] b)");
+
+    //b恰好在截止时间到达
+    AMTimedEvent(timed, "s", "a", 100 * MS);
+    AMTimedEvent(timed, "s", "b", 110 * MS);
+    expect("b at the deadline", 0);
+    AMTimedEvent(timed, "s", "x", 200 * MS);
+    expect("after b at the deadline", 0);
+
+    //其他事件恰好在截止时间到达不算超时, 晚1ns才算
+    AMTimedEvent(timed, "s", "a", 300 * MS);
+    AMTimedEvent(timed, "s", "x", 310 * MS);
+    expect("time at the deadline", 0);
+    AMTimedEvent(timed, "s", "x", 310 * MS + 1);
+    expect("1ns after the deadline", 1);
+
+    //截止时间与b在同一个tick中, b晚了1ns, 不能被当作响应
+    AMTimedEvent(timed, "s", "a", 400 * MS + MS / 4);
+    AMTimedEvent(timed, "s", "b", 410 * MS + MS / 4 + 1);
+    expect("b 1ns late in the same tick", 1);
+
+    //截止时间之前的事件在同一个tick中, 之后的事件仍然能报告超时
+    AMTimedEvent(timed, "s", "a", 500 * MS + MS / 2);
+    AMTimedEvent(timed, "s", "x", 510 * MS + MS / 4);
+    expect("before the deadline in the same tick", 0);
+    AMTimedEvent(timed, "s", "x", 510 * MS + 3 * MS / 4);
+    expect("after the deadline in the same tick", 1);
+
+    //下界: 恰好在a + lo到达的b满足性质, 早1ns不满足
+    init(timed, "G(a -> F[5ms,10ms] b)");
+    AMTimedEvent(timed, "s", "a", 100 * MS);
+    AMTimedEvent(timed, "s", "b", 105 * MS);
+    AMTimedEvent(timed, "s", "x", 200 * MS);
+    expect("b at the lower bound", 0);
+    AMTimedEvent(timed, "s", "a", 300 * MS);
+    AMTimedEvent(timed, "s", "b", 305 * MS - 1);
+    AMTimedEvent(timed, "s", "x", 400 * MS);
+    expect("b 1ns before the lower bound", 1);
+    //超出int64_t范围的界限被拒绝, 而不是抛出异常或溢出
+    AMTimedRule rule;
+    for (const char *f : {"G(a -> F[0ms,99999999999999999999ms] b)", "G(a -> F[0s,9223372037s] b)",
+                          "G(a -> F[9223372037s,9223372037s] b)"})
+    {
+        if (AMTimedParseRule("r", f, rule) != TIMED_RULE_ERROR)
+        {
+            printf("FAIL accepted %s\n", f);
+            failures++;
+        }
+    }
+    if (AMTimedParseRule("r", "G(a -> F[0s,9223372036s] b)", rule) != SUCCESS || rule.hi_ns != 9223372036000000000ll)
+    {
+        printf("FAIL largest bound in seconds\n");
+        failures++;
+    }
+
+    if (failures == 0)
+    {
+        printf("OK\n");
+    }
+    return failures != 0;
+}